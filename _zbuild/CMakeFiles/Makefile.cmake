@@ -0,0 +1,67 @@
+# CMAKE generated file: DO NOT EDIT!
+# Generated by "Unix Makefiles" Generator, CMake Version 3.25
+
+# The generator used is:
+set(CMAKE_DEPENDS_GENERATOR "Unix Makefiles")
+
+# The top level Makefile was generated from the following files:
+set(CMAKE_MAKEFILE_DEPENDS
+  "CMakeCache.txt"
+  "/root/repo/CMakeLists.txt"
+  "CMakeFiles/3.25.1/CMakeCCompiler.cmake"
+  "CMakeFiles/3.25.1/CMakeSystem.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeCInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeCommonLanguageInclude.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeGenericSystem.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeInitializeConfigs.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeLanguageInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInitialize.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckCSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckIncludeFile.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckLibraryExists.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/CMakeCommonCompilerMacros.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU-C.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageHandleStandardArgs.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageMessage.cmake"
+  "/usr/share/cmake-3.25/Modules/FindSQLite3.cmake"
+  "/usr/share/cmake-3.25/Modules/FindThreads.cmake"
+  "/usr/share/cmake-3.25/Modules/Internal/CheckSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU-C.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/UnixPaths.cmake"
+  )
+
+# The corresponding makefile is:
+set(CMAKE_MAKEFILE_OUTPUTS
+  "Makefile"
+  "CMakeFiles/cmake.check_cache"
+  )
+
+# Byproducts of CMake generate step:
+set(CMAKE_MAKEFILE_PRODUCTS
+  "CMakeFiles/CMakeDirectoryInformation.cmake"
+  )
+
+# Dependency information for all targets:
+set(CMAKE_DEPEND_INFO_FILES
+  "CMakeFiles/jamharah.dir/DependInfo.cmake"
+  "CMakeFiles/build_from_sqlite.dir/DependInfo.cmake"
+  "CMakeFiles/build_occurrences.dir/DependInfo.cmake"
+  "CMakeFiles/sort_occurrences.dir/DependInfo.cmake"
+  "CMakeFiles/build_postings.dir/DependInfo.cmake"
+  "CMakeFiles/build_words_index.dir/DependInfo.cmake"
+  "CMakeFiles/build_bigrams.dir/DependInfo.cmake"
+  "CMakeFiles/searcher.dir/DependInfo.cmake"
+  "CMakeFiles/dump_postings_blocks.dir/DependInfo.cmake"
+  "CMakeFiles/indexer.dir/DependInfo.cmake"
+  "CMakeFiles/search_snippets.dir/DependInfo.cmake"
+  "CMakeFiles/test_index_format.dir/DependInfo.cmake"
+  "CMakeFiles/jamharah_zstd.dir/DependInfo.cmake"
+  "CMakeFiles/test_index_format_zstd.dir/DependInfo.cmake"
+  "CMakeFiles/jamharah_lz4.dir/DependInfo.cmake"
+  "CMakeFiles/test_index_format_lz4.dir/DependInfo.cmake"
+  "CMakeFiles/test_books_layout.dir/DependInfo.cmake"
+  )
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/build_bigrams.dir/src/build_bigrams.c.o"
+  "CMakeFiles/build_bigrams.dir/src/build_bigrams.c.o.d"
+  "build_bigrams"
+  "build_bigrams.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/build_bigrams.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
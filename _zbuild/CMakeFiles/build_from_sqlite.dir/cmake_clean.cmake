@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/build_from_sqlite.dir/src/build_from_sqlite.c.o"
+  "CMakeFiles/build_from_sqlite.dir/src/build_from_sqlite.c.o.d"
+  "build_from_sqlite"
+  "build_from_sqlite.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/build_from_sqlite.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/build_occurrences.dir/src/build_occurrences.c.o"
+  "CMakeFiles/build_occurrences.dir/src/build_occurrences.c.o.d"
+  "build_occurrences"
+  "build_occurrences.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/build_occurrences.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/build_postings.dir/src/build_postings.c.o"
+  "CMakeFiles/build_postings.dir/src/build_postings.c.o.d"
+  "build_postings"
+  "build_postings.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/build_postings.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/build_words_index.dir/src/build_words_index.c.o"
+  "CMakeFiles/build_words_index.dir/src/build_words_index.c.o.d"
+  "build_words_index"
+  "build_words_index.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/build_words_index.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dump_postings_blocks.dir/src/dump_postings_blocks.c.o"
+  "CMakeFiles/dump_postings_blocks.dir/src/dump_postings_blocks.c.o.d"
+  "dump_postings_blocks"
+  "dump_postings_blocks.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/dump_postings_blocks.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
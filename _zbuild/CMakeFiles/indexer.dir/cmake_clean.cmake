@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/indexer.dir/src/build_index_pipeline.c.o"
+  "CMakeFiles/indexer.dir/src/build_index_pipeline.c.o.d"
+  "indexer"
+  "indexer.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/indexer.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/jamharah.dir/src/arabic_stem.c.o"
+  "CMakeFiles/jamharah.dir/src/arabic_stem.c.o.d"
+  "CMakeFiles/jamharah.dir/src/build_index.c.o"
+  "CMakeFiles/jamharah.dir/src/build_index.c.o.d"
+  "CMakeFiles/jamharah.dir/src/hash.c.o"
+  "CMakeFiles/jamharah.dir/src/hash.c.o.d"
+  "CMakeFiles/jamharah.dir/src/index_format.c.o"
+  "CMakeFiles/jamharah.dir/src/index_format.c.o.d"
+  "CMakeFiles/jamharah.dir/src/normalize_arabic.c.o"
+  "CMakeFiles/jamharah.dir/src/normalize_arabic.c.o.d"
+  "CMakeFiles/jamharah.dir/src/tokenize_arabic.c.o"
+  "CMakeFiles/jamharah.dir/src/tokenize_arabic.c.o.d"
+  "libjamharah.a"
+  "libjamharah.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/jamharah.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/jamharah_lz4.dir/src/arabic_stem.c.o"
+  "CMakeFiles/jamharah_lz4.dir/src/arabic_stem.c.o.d"
+  "CMakeFiles/jamharah_lz4.dir/src/build_index.c.o"
+  "CMakeFiles/jamharah_lz4.dir/src/build_index.c.o.d"
+  "CMakeFiles/jamharah_lz4.dir/src/hash.c.o"
+  "CMakeFiles/jamharah_lz4.dir/src/hash.c.o.d"
+  "CMakeFiles/jamharah_lz4.dir/src/index_format.c.o"
+  "CMakeFiles/jamharah_lz4.dir/src/index_format.c.o.d"
+  "CMakeFiles/jamharah_lz4.dir/src/normalize_arabic.c.o"
+  "CMakeFiles/jamharah_lz4.dir/src/normalize_arabic.c.o.d"
+  "CMakeFiles/jamharah_lz4.dir/src/tokenize_arabic.c.o"
+  "CMakeFiles/jamharah_lz4.dir/src/tokenize_arabic.c.o.d"
+  "libjamharah_lz4.a"
+  "libjamharah_lz4.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/jamharah_lz4.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
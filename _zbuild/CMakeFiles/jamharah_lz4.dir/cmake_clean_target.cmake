@@ -0,0 +1,3 @@
+file(REMOVE_RECURSE
+  "libjamharah_lz4.a"
+)
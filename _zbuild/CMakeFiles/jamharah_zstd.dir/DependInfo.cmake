@@ -0,0 +1,24 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/arabic_stem.c" "CMakeFiles/jamharah_zstd.dir/src/arabic_stem.c.o" "gcc" "CMakeFiles/jamharah_zstd.dir/src/arabic_stem.c.o.d"
+  "/root/repo/src/build_index.c" "CMakeFiles/jamharah_zstd.dir/src/build_index.c.o" "gcc" "CMakeFiles/jamharah_zstd.dir/src/build_index.c.o.d"
+  "/root/repo/src/hash.c" "CMakeFiles/jamharah_zstd.dir/src/hash.c.o" "gcc" "CMakeFiles/jamharah_zstd.dir/src/hash.c.o.d"
+  "/root/repo/src/index_format.c" "CMakeFiles/jamharah_zstd.dir/src/index_format.c.o" "gcc" "CMakeFiles/jamharah_zstd.dir/src/index_format.c.o.d"
+  "/root/repo/src/normalize_arabic.c" "CMakeFiles/jamharah_zstd.dir/src/normalize_arabic.c.o" "gcc" "CMakeFiles/jamharah_zstd.dir/src/normalize_arabic.c.o.d"
+  "/root/repo/src/tokenize_arabic.c" "CMakeFiles/jamharah_zstd.dir/src/tokenize_arabic.c.o" "gcc" "CMakeFiles/jamharah_zstd.dir/src/tokenize_arabic.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
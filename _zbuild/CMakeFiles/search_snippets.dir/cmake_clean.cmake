@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/search_snippets.dir/src/search_snippets.c.o"
+  "CMakeFiles/search_snippets.dir/src/search_snippets.c.o.d"
+  "search_snippets"
+  "search_snippets.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/search_snippets.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/searcher.dir/src/search_core.c.o"
+  "CMakeFiles/searcher.dir/src/search_core.c.o.d"
+  "searcher"
+  "searcher.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/searcher.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sort_occurrences.dir/src/sort_occurrences.c.o"
+  "CMakeFiles/sort_occurrences.dir/src/sort_occurrences.c.o.d"
+  "sort_occurrences"
+  "sort_occurrences.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sort_occurrences.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_books_layout.dir/tests/test_books_layout.c.o"
+  "CMakeFiles/test_books_layout.dir/tests/test_books_layout.c.o.d"
+  "test_books_layout"
+  "test_books_layout.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/test_books_layout.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_index_format.dir/tests/test_index_format.c.o"
+  "CMakeFiles/test_index_format.dir/tests/test_index_format.c.o.d"
+  "test_index_format"
+  "test_index_format.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/test_index_format.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_index_format_lz4.dir/tests/test_index_format.c.o"
+  "CMakeFiles/test_index_format_lz4.dir/tests/test_index_format.c.o.d"
+  "test_index_format_lz4"
+  "test_index_format_lz4.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/test_index_format_lz4.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_index_format_zstd.dir/tests/test_index_format.c.o"
+  "CMakeFiles/test_index_format_zstd.dir/tests/test_index_format.c.o.d"
+  "test_index_format_zstd"
+  "test_index_format_zstd.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/test_index_format_zstd.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,14 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_zbuild
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(index_format_basic "/root/repo/_zbuild/test_index_format")
+set_tests_properties(index_format_basic PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;159;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(index_format_zstd "/root/repo/_zbuild/test_index_format_zstd")
+set_tests_properties(index_format_zstd PROPERTIES  WORKING_DIRECTORY "/root/repo/_zbuild/index_format_zstd" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;177;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(index_format_lz4 "/root/repo/_zbuild/test_index_format_lz4")
+set_tests_properties(index_format_lz4 PROPERTIES  WORKING_DIRECTORY "/root/repo/_zbuild/index_format_lz4" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;196;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(books_layout "/root/repo/_zbuild/test_books_layout")
+set_tests_properties(books_layout PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;209;add_test;/root/repo/CMakeLists.txt;0;")
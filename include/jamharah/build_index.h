@@ -0,0 +1,82 @@
+/* jamharah build_index.h turns an occurrences file into postings.bin and words.idx inside one process. */
+#ifndef JAMHARAH_BUILD_INDEX_H
+#define JAMHARAH_BUILD_INDEX_H
+
+#include "jamharah/index_format.h"
+
+/* jh_build_index_stats reports what a postings build wrote. */
+typedef struct {
+    jh_u64 run_count;
+    jh_u64 word_count;
+    jh_u64 total_postings;
+    jh_u64 shared_blocks;
+    jh_u64 codec_blocks[4];
+    jh_u32 postings_flags;
+    jh_u32 dict_size;
+} jh_build_index_stats;
+
+/* jh_sort_options bounds an occurrence sort; zero fields take the defaults (128 MB, one thread per online CPU,
+   runs in the current directory, merge fan-in 64). */
+typedef struct {
+    size_t memory_bytes;
+    unsigned int threads;
+    const char *tmp_dir;
+    unsigned int fan_in;
+} jh_sort_options;
+
+/* jh_sort_options_from_env reads JH_SORT_MB, JH_SORT_THREADS, JH_SORT_TMPDIR and JH_SORT_FAN_IN, leaving unset
+   ones at their defaults. */
+void jh_sort_options_from_env(jh_sort_options *opts);
+
+/* jh_sort_occurrences radix-sorts in_path by (word_hash, page_id, position) into out_path through spilled runs,
+   copying the term table alongside; opts may be NULL. */
+int jh_sort_occurrences(const char *in_path, const char *out_path, const jh_sort_options *opts);
+
+/* jh_build_postings writes postings.bin from an already sorted occurrences file; words_path may be NULL. */
+int jh_build_postings(const char *sorted_occ_path, const char *postings_path, const char *words_path, jh_build_index_stats *stats);
+
+/* jh_index_paths_for names the postings and words files built from an occurrences file by replacing the
+   "occurrences" at the start of its basename: dir/occurrences_stem.tmp gives dir/postings_stem.bin and
+   dir/words_stem.idx. Returns -1 for other names or paths longer than cap. */
+int jh_index_paths_for(const char *occ_path, char *postings_path, char *words_path, size_t cap);
+
+/* jh_build_index sorts an unsorted occurrences file and streams the merged runs straight into postings.bin and words.idx. */
+int jh_build_index(const char *occ_path, const char *postings_path, const char *words_path, const jh_sort_options *opts, jh_build_index_stats *stats);
+
+typedef struct jh_inverter_term jh_inverter_term;
+
+/* jh_inverter_part is one writer's in-memory term table plus the sorted partial indexes it has spilled. */
+typedef struct {
+    jh_inverter_term *terms;
+    size_t term_cap;
+    size_t term_count;
+    size_t bytes;
+    char **spill_paths;
+    size_t spill_count;
+    size_t spill_cap;
+} jh_inverter_part;
+
+/* jh_inverter inverts occurrences in memory (SPIMI): each part spills a sorted partial index when over its budget.
+   fan_in bounds how many partial indexes one merge opens; 0 takes the sort default. */
+typedef struct {
+    jh_inverter_part *parts;
+    unsigned int part_count;
+    size_t part_budget;
+    const char *tmp_prefix;
+    unsigned int fan_in;
+} jh_inverter;
+
+/* jh_inverter_init splits budget_bytes across part_count parts, each with a small floor; partial indexes spill to
+   tmp_prefix_<part>_<n>.tmp. */
+int jh_inverter_init(jh_inverter *inv, unsigned int part_count, size_t budget_bytes, const char *tmp_prefix);
+/* jh_inverter_add records one occurrence in a part; only one thread may use a part, and it must see each term in
+   (page_id, position) order. */
+int jh_inverter_add(jh_inverter *inv, unsigned int part, jh_u64 word_hash, jh_u32 page_id, jh_u32 position);
+/* jh_inverter_finish merges every part's partial indexes into postings.bin and words.idx, first merging spilled
+   ones in groups of fan_in when there are too many to open at once. */
+int jh_inverter_finish(jh_inverter *inv, const char *postings_path, const char *words_path, jh_build_index_stats *stats);
+/* jh_inverter_abort removes every spilled partial index without freeing anything, for fatal paths about to exit. */
+void jh_inverter_abort(jh_inverter *inv);
+void jh_inverter_free(jh_inverter *inv);
+
+#endif
@@ -6,4 +6,7 @@
 
 uint64_t jh_hash_utf8_64(const char *data, size_t len, uint64_t seed);
 
+/* jh_hash_pair_64 combines two word hashes into the key of the bigram "first second". */
+uint64_t jh_hash_pair_64(uint64_t first, uint64_t second);
+
 #endif
@@ -12,6 +12,49 @@ typedef uint64_t jh_u64;
 
 #define JH_ANNO_MAGIC "ANNO"
 #define JH_ANNO_VERSION 1
+
+/* postings.bin flags: bit 0 marks legacy whole-list ZSTD frames, bit 1 a codec byte at the start of every block. */
+#define JH_POSTINGS_FLAG_ZSTD 1u
+#define JH_POSTINGS_FLAG_BLOCK_CODEC 2u
+
+/* Per-block codecs; compressed payloads start with the u32 uncompressed size. */
+#define JH_POSTINGS_CODEC_RAW 0u
+#define JH_POSTINGS_CODEC_ZSTD 1u
+#define JH_POSTINGS_CODEC_ZSTD_DICT 2u
+#define JH_POSTINGS_CODEC_LZ4 3u
+
+/* books.bin compression applies to every block; a block whose compressed_size equals its uncompressed_size is stored raw. */
+#define JH_BOOKS_COMPRESSION_NONE 0u
+#define JH_BOOKS_COMPRESSION_ZSTD 1u
+#define JH_BOOKS_COMPRESSION_LZ4 2u
+/* Decompressed books.bin blocks kept by each jh_books_reader. */
+#define JH_BOOKS_CACHE_BLOCKS 16
+/* Decoded shared postings.bin blocks kept by each jh_postings_file_view of a compressed file. */
+#define JH_POSTINGS_CACHE_BLOCKS 8
+
+/* A words.idx postings_offset with bit 63 set names member (low 32 bits) of shared block (bits 32..61); bit 62 is
+   the inline flag below, so block ids stay under JH_POSTINGS_REF_BLOCK_LIMIT. */
+#define JH_POSTINGS_REF_PACKED (1ull << 63)
+#define JH_POSTINGS_REF_BLOCK_LIMIT (1u << 30)
+#define JH_POSTINGS_REF_PACK(block_id, member) (JH_POSTINGS_REF_PACKED | ((jh_u64)(block_id) << 32) | (jh_u64)(member))
+#define JH_POSTINGS_REF_BLOCK(ref) ((jh_u32)(((ref) >> 32) & 0x3fffffffu))
+#define JH_POSTINGS_REF_MEMBER(ref) ((jh_u32)((ref) & 0xffffffffu))
+
+/* With bit 62 set the list lives in the inline section of words.idx (version 2), after the entry table:
+   bits 0..39 are its offset in that section and bits 40..47 its length. */
+#define JH_POSTINGS_REF_INLINE (1ull << 62)
+#define JH_POSTINGS_REF_INLINE_MAKE(offset, length) (JH_POSTINGS_REF_INLINE | ((jh_u64)(length) << 40) | (jh_u64)(offset))
+#define JH_POSTINGS_REF_INLINE_OFFSET(ref) ((ref) & 0xffffffffffull)
+#define JH_POSTINGS_REF_INLINE_LENGTH(ref) ((jh_u32)(((ref) >> 40) & 0xffu))
+/* Lists up to this many bytes are inlined into words.idx and are not written to postings.bin at all. */
+#define JH_WORD_DICT_INLINE_MAX 48
+/* Column value for a book with no category or author in books_meta.idx. */
+#define JH_FACET_NONE 0xffffffffu
+/* Terms per front-coded block in words.lex; terms longer than JH_LEXICON_TERM_MAX bytes are left out. */
+#define JH_LEXICON_BLOCK_TERMS 16
+#define JH_LEXICON_TERM_MAX 255
+/* Longest query term, in codepoints, that fuzzy expansion accepts. */
+#define JH_LEXICON_FUZZY_MAX_CODEPOINTS 32
  
 #pragma pack(push,1)
  
@@ -161,6 +204,28 @@ typedef struct {
     jh_u32 order;
 } jh_book_author_entry;
 
+/* jh_facets_header is the header of facets.col: u32 columns page_book[page_count], then book_category[book_slots]
+   and book_author[book_slots] indexed by book id; JH_FACET_NONE marks a book without metadata. */
+typedef struct {
+    char magic[4];
+    jh_u32 version;
+    jh_u32 page_count;
+    jh_u32 book_slots;
+    jh_u32 category_slots;
+    jh_u32 author_slots;
+} jh_facets_header;
+
+/* jh_token_offsets_header is the header of offsets.bin. Each page, indexed by page_id through the u64 table
+   of page_count + 1 entries at index_offset, holds varint token_count then per token varint(start - prev_end),
+   varint(end - start): the raw byte span of every token in the page text. */
+typedef struct {
+    char magic[4];
+    jh_u32 version;
+    jh_u32 page_count;
+    jh_u32 reserved;
+    jh_u64 index_offset;
+} jh_token_offsets_header;
+
 /* jh_titles_file_header is the header for the packed titles file titles.bin. */
 typedef struct {
     char magic[4];
@@ -202,18 +267,37 @@ typedef struct {
     jh_u32 flags;
 } jh_word_index_entry;
 
+/* jh_occurrence_record is one occurrence resolved to its word hash, the form postings are encoded from. */
 typedef struct {
     jh_u64 word_hash;
     jh_u32 page_id;
     jh_u32 position;
 } jh_occurrence_record;
 
-/* jh_postings_file_header is the header for the postings data file postings.bin. */
+/* jh_term_occurrence is one record of an occurrences file; term_id indexes the file's term table. */
+typedef struct {
+    jh_u32 term_id;
+    jh_u32 page_id;
+    jh_u32 position;
+} jh_term_occurrence;
+
+/* An occurrences file X is paired with the term table X.terms: this header, then term_count u64 word hashes
+   indexed by term id. */
+#define JH_TERM_TABLE_SUFFIX ".terms"
 typedef struct {
     char magic[4];
     jh_u32 version;
-    jh_u32 flags;
+    jh_u32 term_count;
     jh_u32 reserved;
+} jh_term_table_header;
+
+/* jh_postings_file_header is the header for the postings data file postings.bin. Frames start at blocks_data_offset,
+   the block index follows them, and a trained ZSTD dictionary, when dict_size is set, takes the last dict_size bytes. */
+typedef struct {
+    char magic[4];
+    jh_u32 version;
+    jh_u32 flags;
+    jh_u32 dict_size;
     jh_u32 reserved2;
     jh_u64 total_postings;
     jh_u64 block_count;
@@ -221,7 +305,7 @@ typedef struct {
     jh_u64 blocks_data_offset;
 } jh_postings_file_header;
 
-/* jh_postings_block_index_entry locates a compressed postings block in postings.bin. */
+/* jh_postings_block_index_entry locates a shared block of small lists; compressed_offset is its length prefix. */
 typedef struct {
     jh_u64 first_word_id;
     jh_u64 last_word_id;
@@ -230,6 +314,13 @@ typedef struct {
     jh_u64 compressed_size;
 } jh_postings_block_index_entry;
 
+/* jh_postings_block_member is one row of the table that opens a shared block, after its u32 member count. */
+typedef struct {
+    jh_u32 word_id;
+    jh_u32 offset;
+    jh_u32 length;
+} jh_postings_block_member;
+
 typedef struct {
     char magic[4];
     jh_u32 version;
@@ -243,6 +334,18 @@ typedef struct {
     jh_u64 postings_count;
 } jh_word_dict_entry;
 
+/* jh_lexicon_header is the header for words.lex: the term strings in byte order, front-coded in blocks.
+   Each term is u8 shared prefix length, u8 suffix length, the suffix bytes, then its u64 word hash;
+   the first term of a block is stored whole and the block index (u64 file offsets) follows the blocks. */
+typedef struct {
+    char magic[4];
+    jh_u32 version;
+    jh_u32 term_count;
+    jh_u32 block_terms;
+    jh_u64 block_count;
+    jh_u64 block_index_offset;
+} jh_lexicon_header;
+
 typedef struct {
     char magic[4];
     jh_u32 version;
@@ -308,6 +411,56 @@ int jh_read_titles_file_header(const char *path, jh_titles_file_header *out);
 int jh_read_words_index_header(const char *path, jh_words_index_header *out);
 int jh_read_postings_file_header(const char *path, jh_postings_file_header *out);
 int jh_load_page_text(const char *books_path, const char *pages_idx_path, jh_u32 page_id, char **out_text, jh_u32 *out_len);
+
+/* jh_write_term_table writes occ_path's term table; jh_read_term_table loads it into a malloc'd array of hashes. */
+int jh_write_term_table(const char *occ_path, const jh_u64 *hashes, jh_u32 term_count);
+int jh_read_term_table(const char *occ_path, jh_u64 **out_hashes, jh_u32 *out_count);
+
+/* Requested pages closer than this many bytes in books.bin are fetched with a single read. */
+#define JH_PAGE_BATCH_GAP 65536
+
+/* jh_page_arena is a caller-owned buffer reused across jh_load_pages_batch calls. */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} jh_page_arena;
+
+/* jh_page_slice is one page loaded by jh_load_pages_batch; text points into the arena and is not NUL-terminated. */
+typedef struct {
+    const char *text;
+    jh_u32 length;
+    int status;
+} jh_page_slice;
+
+/* jh_load_pages_batch loads page_ids[i] into out[i], reading books.bin in offset order and merging nearby reads.
+   A page that cannot be loaded gets a nonzero status; slices stay valid until the arena is reused or freed. */
+int jh_load_pages_batch(const char *books_path, const char *pages_idx_path, const jh_u32 *page_ids, size_t count, jh_page_arena *arena, jh_page_slice *out);
+void jh_page_arena_free(jh_page_arena *arena);
+
+/* jh_books_cache_slot holds one decompressed books.bin block. */
+typedef struct {
+    jh_u32 block_id;
+    jh_u32 size;
+    jh_u64 age;
+    jh_u8 *data;
+} jh_books_cache_slot;
+
+/* jh_books_reader reads page text out of books.bin, keeping an LRU cache of decompressed blocks; not thread-safe. */
+typedef struct {
+    int fd;
+    jh_books_file_header header;
+    jh_block_index_entry *blocks;
+    jh_books_cache_slot cache[JH_BOOKS_CACHE_BLOCKS];
+    jh_u64 clock;
+    jh_u8 *scratch;
+    size_t scratch_cap;
+} jh_books_reader;
+
+int jh_books_reader_open(const char *path, jh_books_reader *out);
+void jh_books_reader_close(jh_books_reader *reader);
+/* jh_books_reader_read copies length bytes starting offset_in_block into block block_id to out, crossing blocks as needed. */
+int jh_books_reader_read(jh_books_reader *reader, jh_u32 block_id, jh_u32 offset_in_block, jh_u32 length, char *out);
  
 /* jh_posting_entry holds a single document id and its term positions. */
 typedef struct {
@@ -329,6 +482,9 @@ typedef struct {
     double score;
 } jh_ranked_hit;
 
+/* jh_postings_block_decode turns one stored block (after its length prefix) into plain list bytes. */
+int jh_postings_block_decode(const jh_postings_file_header *hdr, const void *codec_dict, const jh_u8 *block, size_t block_size, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap);
+
 /* jh_postings_list_parse decodes an encoded postings buffer into an in-memory list. */
 int jh_postings_list_parse(const jh_u8 *data, size_t data_size, jh_postings_list *out);
 void jh_postings_list_free(jh_postings_list *list);
@@ -337,6 +493,11 @@ int jh_postings_block_read(const char *path, jh_u64 offset, jh_u8 **out_buf, siz
  
 /* jh_postings_list_intersect computes document-level AND between two postings lists. */
 int jh_postings_list_intersect(const jh_postings_list *a, const jh_postings_list *b, jh_postings_list *out);
+/* jh_postings_list_union merges count lists into one, joining the positions of pages found in several. */
+int jh_postings_list_union(const jh_postings_list *lists, size_t count, jh_postings_list *out);
+/* jh_postings_list_union_weighted also returns, per merged page, the term-frequency-weighted mean of weights[i]
+   over the lists found on it; free *out_hit_weights with free(). */
+int jh_postings_list_union_weighted(const jh_postings_list *lists, const double *weights, size_t count, jh_postings_list *out, double **out_hit_weights);
  
 /* jh_postings_cursor streams postings from an encoded buffer without allocations. */
 typedef struct {
@@ -352,7 +513,158 @@ typedef struct {
 int jh_postings_cursor_init(jh_postings_cursor *cur, const jh_u8 *data, size_t size);
 /* jh_postings_cursor_next yields the next posting into caller-provided storage. */
 int jh_postings_cursor_next(jh_postings_cursor *cur, jh_posting_entry *out, jh_u32 *pos_buf, jh_u32 pos_buf_cap);
- 
+
+/* jh_postings_cursor_advance_to yields the first posting at or after target, skipping earlier ones without decoding positions. */
+int jh_postings_cursor_advance_to(jh_postings_cursor *cur, jh_u32 target, jh_posting_entry *out, jh_u32 *pos_buf, jh_u32 pos_buf_cap);
+
+/* jh_page_range is the half-open page id span [first, end). */
+typedef struct {
+    jh_u32 first;
+    jh_u32 end;
+} jh_page_range;
+
+/* jh_page_filter is a sorted set of disjoint page ranges; an inactive filter admits every page. */
+typedef struct {
+    jh_page_range *ranges;
+    size_t count;
+    size_t cap;
+    int active;
+} jh_page_filter;
+
+/* jh_page_filter_spec lists the ids a query is restricted to; kinds combine with AND, ids within a kind with OR. */
+typedef struct {
+    const jh_u32 *book_ids;
+    size_t book_count;
+    const jh_u32 *category_ids;
+    size_t category_count;
+    const jh_u32 *author_ids;
+    size_t author_count;
+    const jh_u32 *chapter_ids;
+    size_t chapter_count;
+} jh_page_filter_spec;
+
+/* jh_page_filter_compile turns a spec into page ranges using books.idx, books_meta.idx and chapters.idx. */
+int jh_page_filter_compile(const jh_page_filter_spec *spec, const char *books_idx_path, const char *books_meta_path, const char *chapters_idx_path, jh_page_filter *out);
+void jh_page_filter_free(jh_page_filter *f);
+int jh_page_filter_contains(const jh_page_filter *f, jh_u32 page_id);
+/* jh_postings_list_parse_filtered materializes only the postings inside filter, seeking over the excluded gaps. */
+int jh_postings_list_parse_filtered(const jh_u8 *data, size_t data_size, const jh_page_filter *filter, jh_postings_list *out);
+
+/* jh_postings_cache_slot holds one decoded shared postings block. */
+typedef struct {
+    jh_u32 block_id;
+    jh_u64 age;
+    const jh_u8 *data;
+    size_t size;
+    jh_u8 *buf;
+    size_t buf_cap;
+} jh_postings_cache_slot;
+
+typedef struct {
+    jh_postings_cache_slot slots[JH_POSTINGS_CACHE_BLOCKS];
+    jh_u64 clock;
+} jh_postings_block_cache;
+
+/* jh_postings_file_view maps postings.bin read-only so lists can be decoded in place. For compressed files it keeps
+   an LRU cache of decoded shared blocks, so a view must not be shared between threads. */
+typedef struct {
+    const jh_u8 *data;
+    size_t size;
+    jh_postings_file_header header;
+    void *codec_dict;
+    jh_postings_block_cache *block_cache;
+} jh_postings_file_view;
+
+/* jh_postings_file_open maps a postings file and validates its header. */
+int jh_postings_file_open(const char *path, jh_postings_file_view *out);
+void jh_postings_file_close(jh_postings_file_view *view);
+/* jh_postings_file_block returns the plain bytes of the list at offset or packed ref; scratch is only used for compressed blocks. */
+int jh_postings_file_block(const jh_postings_file_view *view, jh_u64 offset, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap);
+/* jh_postings_file_shared_block returns the plain payload (member table and lists) of shared block block_id. A cached
+   block stays valid until JH_POSTINGS_CACHE_BLOCKS other blocks have been decoded through the view. */
+int jh_postings_file_shared_block(const jh_postings_file_view *view, jh_u32 block_id, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap);
+/* jh_word_postings_read loads the list for a dictionary entry, from words.idx when inline and from the view otherwise. */
+int jh_word_postings_read(const char *words_idx_path, const jh_postings_file_view *view, const jh_word_dict_entry *entry, jh_postings_list *out);
+/* jh_word_postings_read_filtered is jh_word_postings_read restricted to the pages of filter. */
+int jh_word_postings_read_filtered(const char *words_idx_path, const jh_postings_file_view *view, const jh_word_dict_entry *entry, const jh_page_filter *filter, jh_postings_list *out);
+/* jh_postings_file_cursor positions a cursor on the list at offset without copying it. */
+int jh_postings_file_cursor(const jh_postings_file_view *view, jh_u64 offset, jh_postings_cursor *cur, jh_u8 **scratch, size_t *scratch_cap);
+/* jh_postings_file_list_read materializes the list at offset from a mapped postings file. */
+int jh_postings_file_list_read(const jh_postings_file_view *view, jh_u64 offset, jh_postings_list *out);
+
+/* jh_lexicon_view maps words.lex read-only for prefix enumeration. */
+typedef struct {
+    const jh_u8 *data;
+    size_t size;
+    jh_lexicon_header header;
+} jh_lexicon_view;
+
+/* jh_lexicon_open maps a lexicon file and validates its header and block index. */
+int jh_lexicon_open(const char *path, jh_lexicon_view *out);
+void jh_lexicon_close(jh_lexicon_view *view);
+/* jh_lexicon_expand_prefix writes the hashes of up to max_terms terms starting with prefix; returns 1 when more terms matched. */
+int jh_lexicon_expand_prefix(const jh_lexicon_view *view, const char *prefix, size_t prefix_len, size_t max_terms, jh_u64 *out_hashes, size_t *out_count);
+/* jh_lexicon_expand_fuzzy writes the hashes and edit distances (in codepoints, at most max_dist <= 2) of up to max_terms
+   lexicon terms near term, pruning every prefix whose distance row already exceeds max_dist; returns 1 when truncated. */
+int jh_lexicon_expand_fuzzy(const jh_lexicon_view *view, const char *term, size_t term_len, jh_u32 max_dist, size_t max_terms, jh_u64 *out_hashes, jh_u8 *out_dists, size_t *out_count);
+/* jh_index_sibling_path builds the path of name in the directory that holds path. */
+int jh_index_sibling_path(const char *path, const char *name, char *out, size_t cap);
+/* jh_index_variant_path inserts suffix before the extension of path, e.g. words.idx -> words_stem.idx. */
+int jh_index_variant_path(const char *path, const char *suffix, char *out, size_t cap);
+
+/* jh_postings_soa decodes a postings list into parallel arrays; storage is reused across decodes. */
+typedef struct {
+    jh_u32 *page_ids;
+    jh_u32 *term_freqs;
+    jh_u32 *position_starts;
+    jh_u32 *positions;
+    jh_u32 doc_count;
+    jh_u32 positions_count;
+    jh_u32 doc_cap;
+    jh_u32 positions_cap;
+} jh_postings_soa;
+
+/* jh_postings_soa_decode fills soa from an encoded buffer, growing its arrays only when needed. */
+int jh_postings_soa_decode(const jh_u8 *data, size_t data_size, jh_postings_soa *soa);
+/* jh_postings_soa_decode_filtered keeps only the postings inside filter, seeking over the excluded gaps. */
+int jh_postings_soa_decode_filtered(const jh_u8 *data, size_t data_size, const jh_page_filter *filter, jh_postings_soa *soa);
+/* jh_postings_soa_from_list copies an in-memory list into soa, reusing its arrays. */
+int jh_postings_soa_from_list(const jh_postings_list *list, jh_postings_soa *soa);
+void jh_postings_soa_free(jh_postings_soa *soa);
+/* jh_u32_sorted_intersect writes the common values of two ascending arrays to out and returns their count. */
+size_t jh_u32_sorted_intersect(const jh_u32 *a, size_t a_count, const jh_u32 *b, size_t b_count, jh_u32 *out);
+/* jh_word_postings_read_soa decodes the pages of a dictionary entry's list admitted by filter (NULL admits all) into
+   soa, reusing soa and scratch across calls. */
+int jh_word_postings_read_soa(const char *words_idx_path, const jh_postings_file_view *view, const jh_word_dict_entry *entry, const jh_page_filter *filter, jh_postings_soa *soa, jh_u8 **scratch, size_t *scratch_cap);
+
+/* jh_search_workspace owns the decode and scratch buffers of phrase search and ranking. Passing the same workspace to
+   every query lets them grow to the largest query once and then be reused; a workspace serves one thread at a time.
+   Zero it before first use and release it with jh_search_workspace_free. */
+typedef struct {
+    jh_postings_soa *terms;
+    size_t term_cap;
+    jh_postings_soa *components;
+    jh_u32 *offsets;
+    jh_u32 *heads;
+    unsigned char *covered;
+    jh_posting_entry *docs;
+    const jh_posting_entry **entries;
+    double *term_weights;
+    size_t component_cap;
+    jh_u32 *pages;
+    size_t page_cap;
+    jh_u32 *candidates;
+    size_t candidate_cap;
+    jh_u32 *phrase_sorted;
+    size_t phrase_cap;
+    jh_u8 *scratch;
+    size_t scratch_cap;
+} jh_search_workspace;
+
+/* jh_search_workspace_terms returns count term lists owned by ws for the caller to decode query terms into. */
+jh_postings_soa *jh_search_workspace_terms(jh_search_workspace *ws, size_t count);
+void jh_search_workspace_free(jh_search_workspace *ws);
+
 /* jh_postings_and_cursor walks the intersection of two postings cursors. */
 typedef struct {
     jh_postings_cursor *a;
@@ -410,10 +722,75 @@ int jh_postings_phrase_and_cursor_init(jh_postings_phrase_and_cursor *pc, jh_pos
 /* jh_postings_phrase_and_cursor_next returns docs where term B follows term A by one. */
 int jh_postings_phrase_and_cursor_next(jh_postings_phrase_and_cursor *pc, jh_posting_entry *out);
 
+/* jh_phrase_search uses the _bigram variants of the unigram files (words_bigram.idx, postings_bigram.bin) when they exist. */
 int jh_phrase_search(const char *words_idx_path, const char *postings_path, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, size_t *out_page_count);
+/* jh_phrase_search_filtered only reports pages admitted by filter; a NULL or inactive filter admits every page. ws may
+   be NULL, in which case the call uses a workspace of its own. */
+int jh_phrase_search_filtered(jh_search_workspace *ws, const char *words_idx_path, const char *postings_path, const jh_page_filter *filter, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, size_t *out_page_count);
+/* jh_phrase_search_bigram takes explicit bigram paths; NULL paths answer the phrase from unigram lists only. */
+int jh_phrase_search_bigram(jh_search_workspace *ws, const char *words_idx_path, const char *postings_path, const char *bigram_words_path, const char *bigram_postings_path, const jh_page_filter *filter, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, size_t *out_page_count);
 int jh_phrase_search_multi(const char **words_idx_paths, const char **postings_paths, size_t cat_count, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, jh_u32 **out_categories, size_t *out_count);
 int jh_rank_results(const jh_postings_list *lists, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, jh_ranked_hit **out_hits, size_t *out_hit_count);
 
+/* jh_facets_view maps facets.col; the column pointers point into the mapping. */
+typedef struct {
+    const jh_u8 *data;
+    size_t size;
+    jh_facets_header header;
+    const jh_u32 *page_book;
+    const jh_u32 *book_category;
+    const jh_u32 *book_author;
+} jh_facets_view;
+
+/* jh_facet_counts holds hit counts per book, category and author id. */
+typedef struct {
+    jh_u32 *book_counts;
+    jh_u32 *category_counts;
+    jh_u32 *author_counts;
+    jh_u32 book_slots;
+    jh_u32 category_slots;
+    jh_u32 author_slots;
+} jh_facet_counts;
+
+int jh_facets_open(const char *path, jh_facets_view *out);
+void jh_facets_close(jh_facets_view *view);
+/* jh_facet_counts_init allocates zeroed counters sized from the view's slot counts. */
+int jh_facet_counts_init(const jh_facets_view *view, jh_facet_counts *out);
+void jh_facet_counts_free(jh_facet_counts *counts);
+/* jh_rank_results_faceted is jh_rank_results that also counts every emitted hit into counts during the scoring pass. */
+int jh_rank_results_faceted(const jh_postings_list *lists, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, const jh_facets_view *facets, jh_facet_counts *counts, jh_ranked_hit **out_hits, size_t *out_hit_count);
+/* jh_rank_results_weighted scales each entry's frequency score by hit_weights[t][entry]; a NULL array (or row) weighs 1. */
+int jh_rank_results_weighted(const jh_postings_list *lists, const double *const *hit_weights, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, const jh_facets_view *facets, jh_facet_counts *counts, jh_ranked_hit **out_hits, size_t *out_hit_count);
+/* jh_rank_results_soa is jh_rank_results_weighted over SoA lists with its scratch arrays taken from ws (NULL for a
+   workspace of its own). */
+int jh_rank_results_soa(jh_search_workspace *ws, const jh_postings_soa *lists, const double *const *hit_weights, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, const jh_facets_view *facets, jh_facet_counts *counts, jh_ranked_hit **out_hits, size_t *out_hit_count);
+
+/* jh_token_offsets_view maps offsets.bin for position-to-text lookups without re-tokenizing pages. */
+typedef struct {
+    const jh_u8 *data;
+    size_t size;
+    jh_token_offsets_header header;
+    const jh_u64 *page_offsets;
+} jh_token_offsets_view;
+
+int jh_token_offsets_open(const char *path, jh_token_offsets_view *out);
+void jh_token_offsets_close(jh_token_offsets_view *view);
+/* jh_token_offsets_span returns in [*out_start, *out_end) the raw bytes of token positions first..last on page_id; 1 if out of range. */
+int jh_token_offsets_span(const jh_token_offsets_view *view, jh_u32 page_id, jh_u32 first_pos, jh_u32 last_pos, jh_u32 *out_start, jh_u32 *out_end);
+
+/* Query terms beyond this many are ignored when choosing a snippet window. */
+#define JH_SNIPPET_MAX_TERMS 32
+
+/* jh_snippet_window is the token position range [first_pos, last_pos] of the best passage on a page. */
+typedef struct {
+    jh_u32 first_pos;
+    jh_u32 last_pos;
+    jh_u32 terms_covered;
+} jh_snippet_window;
+
+/* jh_snippet_best_window picks the shortest span holding every term present on page_id; returns 1 if none is. */
+int jh_snippet_best_window(const jh_postings_list *lists, size_t list_count, jh_u32 page_id, jh_snippet_window *out);
+
 typedef struct {
     const jh_u8 *data;
     size_t size;
@@ -26,6 +26,17 @@ size_t jh_normalize_and_tokenize_arabic_utf8(const char *text, size_t text_len,
                                              jh_token *tokens, size_t max_tokens,
                                              char *workspace, size_t workspace_cap);
 
+/* jh_token_span_utf8 maps token positions [first_position, last_position] produced by
+   jh_normalize_and_tokenize_arabic_utf8 back to the raw byte range [*out_start, *out_end) of text. */
+int jh_token_span_utf8(const char *text, size_t text_len,
+                       uint32_t first_position, uint32_t last_position,
+                       size_t *out_start, size_t *out_end);
+
+/* jh_token_raw_spans_utf8 records the raw byte range [starts[i], ends[i]) of every token
+   jh_normalize_and_tokenize_arabic_utf8 would produce; returns the token count or (size_t)-1. */
+size_t jh_token_raw_spans_utf8(const char *text, size_t text_len,
+                               uint32_t *starts, uint32_t *ends, size_t max_tokens);
+
 void jh_light_stem_arabic_tokens(jh_token *tokens, size_t token_count);
 
 #endif
@@ -0,0 +1,356 @@
+#include "jamharah/index_format.h"
+#include "jamharah/tokenize_arabic.h"
+#include "jamharah/hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Only pairs of the most frequent words are candidates; rarer phrases are cheap enough through unigrams. */
+#define JH_BIGRAM_HEAD_WORDS 512
+#define JH_BIGRAM_DEFAULT_PAIRS 4096
+#define JH_BIGRAM_MIN_COUNT 8
+#define JH_BIGRAM_PAIR_TABLE_CAP (1u << 19)
+
+typedef struct {
+    jh_u64 word_hash;
+    jh_u64 count;
+} jh_word_count;
+
+typedef struct {
+    jh_u64 first;
+    jh_u64 second;
+    jh_u64 count;
+    int used;
+    int selected;
+    jh_u32 term_id;
+} jh_pair_slot;
+
+typedef struct {
+    jh_books_reader books;
+    jh_pages_index_header pages_hdr;
+    jh_page_index_entry *pages;
+    char *page_buf;
+    size_t page_cap;
+    jh_token *tokens;
+    size_t tokens_cap;
+    char *workspace;
+    size_t workspace_cap;
+} jh_page_reader;
+
+static void jh_die_bigrams(const char *msg) {
+    fprintf(stderr, "[build_bigrams] %s\n", msg);
+    fflush(stderr);
+    exit(1);
+}
+
+static int jh_word_count_desc(const void *a, const void *b) {
+    const jh_word_count *x = (const jh_word_count *)a;
+    const jh_word_count *y = (const jh_word_count *)b;
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    return x->word_hash < y->word_hash ? -1 : (x->word_hash > y->word_hash ? 1 : 0);
+}
+
+static int jh_pair_count_desc(const void *a, const void *b) {
+    const jh_pair_slot *x = *(const jh_pair_slot *const *)a;
+    const jh_pair_slot *y = *(const jh_pair_slot *const *)b;
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    if (x->first != y->first) {
+        return x->first < y->first ? -1 : 1;
+    }
+    return x->second < y->second ? -1 : (x->second > y->second ? 1 : 0);
+}
+
+/* jh_head_words returns the JH_BIGRAM_HEAD_WORDS most frequent word hashes, counted by words.idx postings_count. */
+static size_t jh_head_words(const char *words_path, jh_u64 *out) {
+    FILE *fp = fopen(words_path, "rb");
+    jh_word_dict_header wh;
+    jh_word_count *words;
+    jh_word_dict_entry e;
+    size_t count = 0;
+    size_t i;
+
+    if (!fp) {
+        jh_die_bigrams("open words.idx failed");
+    }
+    if (fread(&wh, 1, sizeof(wh), fp) != sizeof(wh) || memcmp(wh.magic, "WDIX", 4) != 0) {
+        jh_die_bigrams("words.idx header invalid");
+    }
+    words = (jh_word_count *)malloc((wh.entry_count ? (size_t)wh.entry_count : 1) * sizeof(*words));
+    if (!words) {
+        jh_die_bigrams("out of memory for word counts");
+    }
+    while (count < wh.entry_count && fread(&e, sizeof(e), 1, fp) == 1) {
+        words[count].word_hash = e.word_hash;
+        words[count].count = e.postings_count;
+        count++;
+    }
+    fclose(fp);
+    if (count != wh.entry_count) {
+        jh_die_bigrams("words.idx entry table truncated");
+    }
+
+    qsort(words, count, sizeof(*words), jh_word_count_desc);
+    if (count > JH_BIGRAM_HEAD_WORDS) {
+        count = JH_BIGRAM_HEAD_WORDS;
+    }
+    for (i = 0; i < count; i++) {
+        out[i] = words[i].word_hash;
+    }
+    free(words);
+    return count;
+}
+
+static int jh_head_contains(const jh_u64 *head_set, size_t set_cap, jh_u64 h) {
+    size_t idx = (size_t)(h & (jh_u64)(set_cap - 1));
+    for (;;) {
+        if (head_set[idx] == 0) {
+            return 0;
+        }
+        if (head_set[idx] == h) {
+            return 1;
+        }
+        idx = (idx + 1) & (set_cap - 1);
+    }
+}
+
+static jh_pair_slot *jh_pair_find(jh_pair_slot *table, jh_u64 first, jh_u64 second, int insert) {
+    size_t idx = (size_t)(jh_hash_pair_64(first, second) & (JH_BIGRAM_PAIR_TABLE_CAP - 1));
+    size_t probed = 0;
+    for (;;) {
+        jh_pair_slot *ps = &table[idx];
+        if (!ps->used) {
+            if (!insert) {
+                return NULL;
+            }
+            ps->used = 1;
+            ps->first = first;
+            ps->second = second;
+            return ps;
+        }
+        if (ps->first == first && ps->second == second) {
+            return ps;
+        }
+        idx = (idx + 1) & (JH_BIGRAM_PAIR_TABLE_CAP - 1);
+        if (++probed >= JH_BIGRAM_PAIR_TABLE_CAP) {
+            jh_die_bigrams("pair table full");
+        }
+    }
+}
+
+static void jh_page_reader_open(jh_page_reader *r, const char *books_path, const char *pages_idx_path) {
+    FILE *pages_fp;
+
+    memset(r, 0, sizeof(*r));
+    if (jh_read_pages_index_header(pages_idx_path, &r->pages_hdr) != 0) {
+        jh_die_bigrams("jh_read_pages_index_header failed");
+    }
+    if (jh_books_reader_open(books_path, &r->books) != 0) {
+        jh_die_bigrams("open books.bin failed");
+    }
+    r->pages = (jh_page_index_entry *)malloc(sizeof(jh_page_index_entry) * (size_t)(r->pages_hdr.page_count ? r->pages_hdr.page_count : 1));
+    if (!r->pages) {
+        jh_die_bigrams("alloc pages failed");
+    }
+    pages_fp = fopen(pages_idx_path, "rb");
+    if (!pages_fp) {
+        jh_die_bigrams("open pages.idx failed");
+    }
+    if (fseek(pages_fp, (long)sizeof(jh_pages_index_header), SEEK_SET) != 0 ||
+        fread(r->pages, sizeof(jh_page_index_entry), (size_t)r->pages_hdr.page_count, pages_fp) != r->pages_hdr.page_count) {
+        fclose(pages_fp);
+        jh_die_bigrams("read pages entries failed");
+    }
+    fclose(pages_fp);
+}
+
+static void jh_page_reader_close(jh_page_reader *r) {
+    free(r->pages);
+    free(r->page_buf);
+    free(r->tokens);
+    free(r->workspace);
+    jh_books_reader_close(&r->books);
+}
+
+static void jh_grow(void **buf, size_t *cap, size_t need, size_t elem) {
+    void *nb;
+    if (need <= *cap) {
+        return;
+    }
+    nb = realloc(*buf, need * elem);
+    if (!nb) {
+        jh_die_bigrams("out of memory for page buffers");
+    }
+    *buf = nb;
+    *cap = need;
+}
+
+/* jh_page_reader_tokens loads and tokenizes page i; the tokens stay valid until the next call. */
+static size_t jh_page_reader_tokens(jh_page_reader *r, jh_u32 i) {
+    const jh_page_index_entry *pe = &r->pages[i];
+    size_t len = pe->length;
+    size_t tok_count;
+
+    if (len == 0) {
+        return 0;
+    }
+    if (pe->block_id >= r->books.header.block_count) {
+        jh_die_bigrams("page block_id out of range");
+    }
+    jh_grow((void **)&r->page_buf, &r->page_cap, len, 1);
+    jh_grow((void **)&r->tokens, &r->tokens_cap, len, sizeof(jh_token));
+    jh_grow((void **)&r->workspace, &r->workspace_cap, len, 1);
+
+    if (jh_books_reader_read(&r->books, pe->block_id, pe->offset_in_block, (jh_u32)len, r->page_buf) != 0) {
+        jh_die_bigrams("read page text failed");
+    }
+    tok_count = jh_normalize_and_tokenize_arabic_utf8(r->page_buf, len, r->tokens, r->tokens_cap, r->workspace, r->workspace_cap);
+    if (tok_count == (size_t)-1) {
+        jh_die_bigrams("tokenization failed");
+    }
+    return tok_count;
+}
+
+static void jh_build_bigrams(const char *words_path, const char *books_path, const char *pages_idx_path, const char *out_path, size_t max_pairs) {
+    jh_u64 head[JH_BIGRAM_HEAD_WORDS];
+    jh_u64 head_set[JH_BIGRAM_HEAD_WORDS * 2];
+    size_t head_count;
+    jh_pair_slot *table;
+    jh_pair_slot **ranked;
+    size_t ranked_count = 0;
+    size_t selected = 0;
+    jh_u64 emitted = 0;
+    jh_page_reader r;
+    FILE *out_fp;
+    jh_u64 *hashes = NULL;
+    size_t hashes_cap = 0;
+    jh_u64 *pair_hashes;
+    jh_u32 p;
+    size_t i;
+
+    head_count = jh_head_words(words_path, head);
+    memset(head_set, 0, sizeof(head_set));
+    for (i = 0; i < head_count; i++) {
+        size_t idx = (size_t)(head[i] & (jh_u64)(JH_BIGRAM_HEAD_WORDS * 2 - 1));
+        while (head_set[idx] != 0) {
+            idx = (idx + 1) & (JH_BIGRAM_HEAD_WORDS * 2 - 1);
+        }
+        head_set[idx] = head[i];
+    }
+
+    table = (jh_pair_slot *)calloc(JH_BIGRAM_PAIR_TABLE_CAP, sizeof(jh_pair_slot));
+    if (!table) {
+        jh_die_bigrams("alloc pair table failed");
+    }
+
+    jh_page_reader_open(&r, books_path, pages_idx_path);
+    for (p = 0; p < r.pages_hdr.page_count; p++) {
+        size_t tok_count = jh_page_reader_tokens(&r, p);
+        jh_grow((void **)&hashes, &hashes_cap, tok_count + 1, sizeof(jh_u64));
+        for (i = 0; i < tok_count; i++) {
+            hashes[i] = jh_hash_utf8_64(r.tokens[i].word, r.tokens[i].length, 0);
+        }
+        for (i = 0; i + 1 < tok_count; i++) {
+            if (r.tokens[i + 1].position != r.tokens[i].position + 1) {
+                continue;
+            }
+            if (jh_head_contains(head_set, JH_BIGRAM_HEAD_WORDS * 2, hashes[i]) &&
+                jh_head_contains(head_set, JH_BIGRAM_HEAD_WORDS * 2, hashes[i + 1])) {
+                jh_pair_find(table, hashes[i], hashes[i + 1], 1)->count += 1;
+            }
+        }
+    }
+
+    ranked = (jh_pair_slot **)malloc(sizeof(jh_pair_slot *) * JH_BIGRAM_PAIR_TABLE_CAP);
+    if (!ranked) {
+        jh_die_bigrams("alloc pair ranking failed");
+    }
+    for (i = 0; i < JH_BIGRAM_PAIR_TABLE_CAP; i++) {
+        if (table[i].used && table[i].count >= JH_BIGRAM_MIN_COUNT) {
+            ranked[ranked_count++] = &table[i];
+        }
+    }
+    qsort(ranked, ranked_count, sizeof(*ranked), jh_pair_count_desc);
+    /* Kept pairs are numbered by rank; their pair hashes form the term table of the occurrences file. */
+    pair_hashes = (jh_u64 *)malloc(sizeof(jh_u64) * ((max_pairs < ranked_count ? max_pairs : ranked_count) + 1));
+    if (!pair_hashes) {
+        jh_die_bigrams("alloc pair term table failed");
+    }
+    for (i = 0; i < ranked_count && i < max_pairs; i++) {
+        ranked[i]->selected = 1;
+        ranked[i]->term_id = (jh_u32)i;
+        pair_hashes[i] = jh_hash_pair_64(ranked[i]->first, ranked[i]->second);
+        selected++;
+    }
+    free(ranked);
+
+    out_fp = fopen(out_path, "wb");
+    if (!out_fp) {
+        jh_die_bigrams("open bigram occurrences file failed");
+    }
+    for (p = 0; p < r.pages_hdr.page_count && selected > 0; p++) {
+        size_t tok_count = jh_page_reader_tokens(&r, p);
+        jh_grow((void **)&hashes, &hashes_cap, tok_count + 1, sizeof(jh_u64));
+        for (i = 0; i < tok_count; i++) {
+            hashes[i] = jh_hash_utf8_64(r.tokens[i].word, r.tokens[i].length, 0);
+        }
+        for (i = 0; i + 1 < tok_count; i++) {
+            jh_pair_slot *ps;
+            jh_term_occurrence rec;
+            if (r.tokens[i + 1].position != r.tokens[i].position + 1) {
+                continue;
+            }
+            ps = jh_pair_find(table, hashes[i], hashes[i + 1], 0);
+            if (!ps || !ps->selected) {
+                continue;
+            }
+            rec.term_id = ps->term_id;
+            rec.page_id = r.pages[p].page_id;
+            rec.position = r.tokens[i].position;
+            if (fwrite(&rec, 1, sizeof(rec), out_fp) != sizeof(rec)) {
+                jh_die_bigrams("write bigram occurrence failed");
+            }
+            emitted++;
+        }
+    }
+    fclose(out_fp);
+    if (jh_write_term_table(out_path, pair_hashes, (jh_u32)selected) != 0) {
+        jh_die_bigrams("write bigram term table failed");
+    }
+
+    printf("[build_bigrams] head words %zu, pairs kept %zu, occurrences %llu\n",
+           head_count, selected, (unsigned long long)emitted);
+
+    free(hashes);
+    free(pair_hashes);
+    free(table);
+    jh_page_reader_close(&r);
+}
+
+int main(int argc, char **argv) {
+    const char *words_path = "words.idx";
+    const char *books_path = "books.bin";
+    const char *pages_idx_path = "pages.idx";
+    const char *out_path = "bigram_occurrences.tmp";
+    size_t max_pairs = JH_BIGRAM_DEFAULT_PAIRS;
+    if (argc > 1) {
+        words_path = argv[1];
+    }
+    if (argc > 2) {
+        books_path = argv[2];
+    }
+    if (argc > 3) {
+        pages_idx_path = argv[3];
+    }
+    if (argc > 4) {
+        out_path = argv[4];
+    }
+    if (argc > 5) {
+        max_pairs = (size_t)strtoul(argv[5], NULL, 10);
+    }
+    jh_build_bigrams(words_path, books_path, pages_idx_path, out_path, max_pairs);
+    return 0;
+}
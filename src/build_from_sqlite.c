@@ -1,10 +1,25 @@
 #include "jamharah/index_format.h"
+#include "jamharah/hash.h"
 #include <sqlite3.h>
 #include <dirent.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef JH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef JH_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+/* Full text blocks are compressed in parallel batches of this many before being written in order. */
+#define JH_BOOKS_PENDING_MAX 64
+#define JH_BOOKS_ZSTD_LEVEL 9
 
 /* jh_page_tmp holds temporary page metadata while building the index from SQLite. */
 typedef struct {
@@ -40,12 +55,21 @@ typedef struct {
     jh_u32 title_index;
 } jh_book_tmp;
 
-/* jh_title_tmp stores raw title strings before they are packed into titles.bin. */
+/* jh_title_tmp locates a title string inside the title arena, which is written verbatim as the titles.bin string section. */
 typedef struct {
-    char *text;
+    jh_u64 offset;
+    jh_u32 length;
     jh_u32 flags;
 } jh_title_tmp;
 
+/* jh_title_string_slot is a dedup table entry for one distinct string in the title arena; length 0 marks an empty slot. */
+typedef struct {
+    jh_u64 hash;
+    jh_u64 offset;
+    jh_u32 length;
+    jh_u32 reserved;
+} jh_title_string_slot;
+
 static jh_page_tmp *g_pages = NULL;
 static size_t g_pages_count = 0;
 static size_t g_pages_cap = 0;
@@ -62,6 +86,13 @@ static jh_title_tmp *g_titles = NULL;
 static size_t g_titles_count = 0;
 static size_t g_titles_cap = 0;
 
+static char *g_title_arena = NULL;
+static size_t g_title_arena_len = 0;
+static size_t g_title_arena_cap = 0;
+static jh_title_string_slot *g_title_strings = NULL;
+static size_t g_title_strings_count = 0;
+static size_t g_title_strings_cap = 0;
+
 typedef struct {
     jh_u32 book_id;
     jh_u32 title_index;
@@ -94,6 +125,23 @@ static jh_category_tmp *g_categories = NULL;
 static size_t g_categories_count = 0;
 static size_t g_categories_cap = 0;
 
+/* jh_id_slot maps an id to its index in a global array; index 0 marks an empty slot, so entries store index + 1. */
+typedef struct {
+    jh_u32 id;
+    jh_u32 index_plus_one;
+} jh_id_slot;
+
+/* jh_id_map is an open-addressing id -> array index table kept at most half full. */
+typedef struct {
+    jh_id_slot *slots;
+    size_t cap;
+    size_t count;
+} jh_id_map;
+
+static jh_id_map g_book_meta_map = {NULL, 0, 0};
+static jh_id_map g_authors_map = {NULL, 0, 0};
+static jh_id_map g_categories_map = {NULL, 0, 0};
+
 static jh_block_index_entry *g_blocks = NULL;
 static size_t g_blocks_count = 0;
 static size_t g_blocks_cap = 0;
@@ -103,8 +151,21 @@ static jh_u8 *g_block_buf = NULL;
 static jh_u32 g_block_size = 1u << 16;
 static jh_u32 g_block_fill = 0;
 static jh_u64 g_block_uncompressed_start = 0;
-static jh_u64 g_block_file_offset = 0;
 static jh_u64 g_uncompressed_offset = 0;
+static jh_u32 g_books_compression = JH_BOOKS_COMPRESSION_NONE;
+
+/* jh_pending_block is a full text block waiting for the next parallel compression batch. */
+typedef struct {
+    jh_u8 *plain;
+    jh_u32 plain_size;
+    jh_u64 uncompressed_offset;
+    jh_u8 *packed;
+    size_t packed_size;
+    size_t packed_cap;
+} jh_pending_block;
+
+static jh_pending_block g_pending[JH_BOOKS_PENDING_MAX];
+static size_t g_pending_count = 0;
 
 /* jh_die prints an error message and terminates the process. */
 static void jh_die(const char *msg) {
@@ -152,64 +213,162 @@ static jh_book_tmp *jh_books_push_empty(void) {
     return &g_books[g_books_count++];
 }
 
-/* jh_titles_push stores a title string and returns its index in the title table. */
-static jh_u32 jh_titles_push(const char *text, jh_u32 flags) {
+/* jh_title_strings_grow doubles the dedup table, rehashing the distinct strings seen so far. */
+static void jh_title_strings_grow(void) {
+    size_t nc = g_title_strings_cap ? g_title_strings_cap * 2 : 1024;
+    jh_title_string_slot *slots = (jh_title_string_slot *)calloc(nc, sizeof(jh_title_string_slot));
+    size_t i;
+    if (!slots) {
+        jh_die("out of memory");
+    }
+    for (i = 0; i < g_title_strings_cap; ++i) {
+        if (g_title_strings[i].length != 0) {
+            size_t j = (size_t)g_title_strings[i].hash & (nc - 1);
+            while (slots[j].length != 0) {
+                j = (j + 1) & (nc - 1);
+            }
+            slots[j] = g_title_strings[i];
+        }
+    }
+    free(g_title_strings);
+    g_title_strings = slots;
+    g_title_strings_cap = nc;
+}
+
+/* jh_title_arena_intern returns the arena offset of text, appending it only the first time it is seen. */
+static jh_u64 jh_title_arena_intern(const char *text, size_t len) {
+    jh_u64 h;
+    size_t idx;
+    if (len == 0) {
+        return 0;
+    }
+    if ((g_title_strings_count + 1) * 2 > g_title_strings_cap) {
+        jh_title_strings_grow();
+    }
+    h = jh_hash_utf8_64(text, len, 0);
+    idx = (size_t)h & (g_title_strings_cap - 1);
+    while (g_title_strings[idx].length != 0) {
+        jh_title_string_slot *slot = &g_title_strings[idx];
+        if (slot->hash == h && slot->length == len && memcmp(g_title_arena + slot->offset, text, len) == 0) {
+            return slot->offset;
+        }
+        idx = (idx + 1) & (g_title_strings_cap - 1);
+    }
+    if (g_title_arena_len + len > g_title_arena_cap) {
+        size_t nc = g_title_arena_cap ? g_title_arena_cap * 2 : 65536;
+        while (nc < g_title_arena_len + len) {
+            nc *= 2;
+        }
+        g_title_arena = (char *)jh_xrealloc(g_title_arena, nc, 1);
+        g_title_arena_cap = nc;
+    }
+    memcpy(g_title_arena + g_title_arena_len, text, len);
+    g_title_strings[idx].hash = h;
+    g_title_strings[idx].offset = (jh_u64)g_title_arena_len;
+    g_title_strings[idx].length = (jh_u32)len;
+    g_title_strings_count += 1;
+    g_title_arena_len += len;
+    return g_title_strings[idx].offset;
+}
+
+/* jh_titles_push interns a title string of len bytes and returns its index in the title table. */
+static jh_u32 jh_titles_push(const char *text, size_t len, jh_u32 flags) {
     if (g_titles_count == g_titles_cap) {
         size_t nc = g_titles_cap ? g_titles_cap * 2 : 128;
         g_titles = (jh_title_tmp *)jh_xrealloc(g_titles, nc, sizeof(jh_title_tmp));
         g_titles_cap = nc;
     }
-    size_t len = strlen(text);
-    char *buf = (char *)malloc(len + 1);
-    if (!buf) {
-        jh_die("out of memory");
-    }
-    memcpy(buf, text, len);
-    buf[len] = 0;
-    g_titles[g_titles_count].text = buf;
+    g_titles[g_titles_count].offset = jh_title_arena_intern(text, len);
+    g_titles[g_titles_count].length = (jh_u32)len;
     g_titles[g_titles_count].flags = flags;
     return (jh_u32)g_titles_count++;
 }
 
-static jh_book_meta_tmp *jh_book_meta_find(jh_u32 book_id) {
-    size_t i;
-    for (i = 0; i < g_book_meta_count; ++i) {
-        if (g_book_meta[i].book_id == book_id) {
-            return &g_book_meta[i];
+static size_t jh_id_map_home(jh_u32 id, size_t cap) {
+    return (size_t)(((jh_u64)id * 0x9e3779b97f4a7c15ULL) >> 32) & (cap - 1);
+}
+
+/* jh_id_map_get returns the array index stored for id, or -1 if it is absent. */
+static long jh_id_map_get(const jh_id_map *map, jh_u32 id) {
+    size_t idx;
+    if (map->cap == 0) {
+        return -1;
+    }
+    idx = jh_id_map_home(id, map->cap);
+    while (map->slots[idx].index_plus_one != 0) {
+        if (map->slots[idx].id == id) {
+            return (long)map->slots[idx].index_plus_one - 1;
         }
+        idx = (idx + 1) & (map->cap - 1);
     }
-    return NULL;
+    return -1;
 }
 
-static jh_author_tmp *jh_author_find_or_add(jh_u32 author_id) {
-    size_t i;
-    for (i = 0; i < g_authors_count; ++i) {
-        if (g_authors[i].author_id == author_id) {
-            return &g_authors[i];
+/* jh_id_map_put records index for an id that is not yet in the map, doubling the table past half load. */
+static void jh_id_map_put(jh_id_map *map, jh_u32 id, size_t index) {
+    size_t idx;
+    if ((map->count + 1) * 2 > map->cap) {
+        size_t nc = map->cap ? map->cap * 2 : 256;
+        jh_id_slot *slots = (jh_id_slot *)calloc(nc, sizeof(jh_id_slot));
+        size_t i;
+        if (!slots) {
+            jh_die("out of memory");
         }
+        for (i = 0; i < map->cap; ++i) {
+            if (map->slots[i].index_plus_one != 0) {
+                size_t j = jh_id_map_home(map->slots[i].id, nc);
+                while (slots[j].index_plus_one != 0) {
+                    j = (j + 1) & (nc - 1);
+                }
+                slots[j] = map->slots[i];
+            }
+        }
+        free(map->slots);
+        map->slots = slots;
+        map->cap = nc;
+    }
+    idx = jh_id_map_home(id, map->cap);
+    while (map->slots[idx].index_plus_one != 0) {
+        idx = (idx + 1) & (map->cap - 1);
+    }
+    map->slots[idx].id = id;
+    map->slots[idx].index_plus_one = (jh_u32)(index + 1);
+    map->count += 1;
+}
+
+/* jh_book_meta_find returns the first metadata row loaded for book_id, or NULL. */
+static jh_book_meta_tmp *jh_book_meta_find(jh_u32 book_id) {
+    long i = jh_id_map_get(&g_book_meta_map, book_id);
+    return i < 0 ? NULL : &g_book_meta[i];
+}
+
+static jh_author_tmp *jh_author_find_or_add(jh_u32 author_id) {
+    long i = jh_id_map_get(&g_authors_map, author_id);
+    if (i >= 0) {
+        return &g_authors[i];
     }
     if (g_authors_count == g_authors_cap) {
         size_t nc = g_authors_cap ? g_authors_cap * 2 : 64;
         g_authors = (jh_author_tmp *)jh_xrealloc(g_authors, nc, sizeof(jh_author_tmp));
         g_authors_cap = nc;
     }
+    jh_id_map_put(&g_authors_map, author_id, g_authors_count);
     g_authors[g_authors_count].author_id = author_id;
     g_authors[g_authors_count].name_index = 0;
     return &g_authors[g_authors_count++];
 }
 
 static jh_category_tmp *jh_category_find_or_add(jh_u32 category_id) {
-    size_t i;
-    for (i = 0; i < g_categories_count; ++i) {
-        if (g_categories[i].category_id == category_id) {
-            return &g_categories[i];
-        }
+    long i = jh_id_map_get(&g_categories_map, category_id);
+    if (i >= 0) {
+        return &g_categories[i];
     }
     if (g_categories_count == g_categories_cap) {
         size_t nc = g_categories_cap ? g_categories_cap * 2 : 64;
         g_categories = (jh_category_tmp *)jh_xrealloc(g_categories, nc, sizeof(jh_category_tmp));
         g_categories_cap = nc;
     }
+    jh_id_map_put(&g_categories_map, category_id, g_categories_count);
     g_categories[g_categories_count].category_id = category_id;
     g_categories[g_categories_count].name_index = 0;
     g_categories[g_categories_count].parent_id = 0;
@@ -226,27 +385,155 @@ static void jh_blocks_push(const jh_block_index_entry *b) {
     g_blocks[g_blocks_count++] = *b;
 }
 
-/* jh_flush_block writes the current text block to disk and records its index entry. */
+/* jh_compress_block packs one pending block with the books.bin codec, leaving packed_size 0 to store it raw. */
+static void jh_compress_block(jh_pending_block *pb, void *cctx) {
+    pb->packed_size = 0;
+#ifdef JH_HAVE_ZSTD
+    if (g_books_compression == JH_BOOKS_COMPRESSION_ZSTD) {
+        size_t bound = ZSTD_compressBound(pb->plain_size);
+        size_t csize;
+        if (bound > pb->packed_cap) {
+            jh_u8 *nb = (jh_u8 *)realloc(pb->packed, bound);
+            if (!nb) {
+                jh_die("out of memory");
+            }
+            pb->packed = nb;
+            pb->packed_cap = bound;
+        }
+        csize = ZSTD_compressCCtx((ZSTD_CCtx *)cctx, pb->packed, bound, pb->plain, pb->plain_size, JH_BOOKS_ZSTD_LEVEL);
+        if (ZSTD_isError(csize)) {
+            jh_die("ZSTD compression of books block failed");
+        }
+        pb->packed_size = csize;
+    }
+#endif
+#ifdef JH_HAVE_LZ4
+    if (g_books_compression == JH_BOOKS_COMPRESSION_LZ4) {
+        int bound = LZ4_compressBound((int)pb->plain_size);
+        int csize;
+        if ((size_t)bound > pb->packed_cap) {
+            jh_u8 *nb = (jh_u8 *)realloc(pb->packed, (size_t)bound);
+            if (!nb) {
+                jh_die("out of memory");
+            }
+            pb->packed = nb;
+            pb->packed_cap = (size_t)bound;
+        }
+        csize = LZ4_compress_default((const char *)pb->plain, (char *)pb->packed, (int)pb->plain_size, bound);
+        if (csize <= 0) {
+            jh_die("LZ4 compression of books block failed");
+        }
+        pb->packed_size = (size_t)csize;
+    }
+#endif
+    (void)cctx;
+    /* A block that does not shrink is stored raw; readers spot it by compressed_size == uncompressed_size. */
+    if (pb->packed_size >= pb->plain_size) {
+        pb->packed_size = 0;
+    }
+}
+
+/* jh_compress_worker_ctx is one compression thread's stride over the pending blocks. */
+typedef struct {
+    size_t first;
+    size_t stride;
+} jh_compress_worker_ctx;
+
+static void *jh_compress_worker(void *arg) {
+    jh_compress_worker_ctx *ctx = (jh_compress_worker_ctx *)arg;
+    void *cctx = NULL;
+    size_t i;
+#ifdef JH_HAVE_ZSTD
+    if (g_books_compression == JH_BOOKS_COMPRESSION_ZSTD) {
+        cctx = ZSTD_createCCtx();
+        if (!cctx) {
+            jh_die("ZSTD_createCCtx failed");
+        }
+    }
+#endif
+    for (i = ctx->first; i < g_pending_count; i += ctx->stride) {
+        jh_compress_block(&g_pending[i], cctx);
+    }
+#ifdef JH_HAVE_ZSTD
+    ZSTD_freeCCtx((ZSTD_CCtx *)cctx);
+#endif
+    return NULL;
+}
+
+/* jh_write_pending_blocks compresses the pending batch across threads, then appends the blocks in order. */
+static void jh_write_pending_blocks(void) {
+    size_t i;
+    if (g_pending_count == 0) {
+        return;
+    }
+    if (g_books_compression != JH_BOOKS_COMPRESSION_NONE) {
+        pthread_t threads[JH_BOOKS_PENDING_MAX];
+        jh_compress_worker_ctx ctxs[JH_BOOKS_PENDING_MAX];
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t tc = ncpu > 0 ? (size_t)ncpu : 1;
+        if (tc > g_pending_count) {
+            tc = g_pending_count;
+        }
+        for (i = 0; i < tc; ++i) {
+            ctxs[i].first = i;
+            ctxs[i].stride = tc;
+            if (pthread_create(&threads[i], NULL, jh_compress_worker, &ctxs[i]) != 0) {
+                jh_die("pthread_create failed");
+            }
+        }
+        for (i = 0; i < tc; ++i) {
+            if (pthread_join(threads[i], NULL) != 0) {
+                jh_die("pthread_join failed");
+            }
+        }
+    }
+    for (i = 0; i < g_pending_count; ++i) {
+        jh_pending_block *pb = &g_pending[i];
+        const jh_u8 *data = pb->packed_size ? pb->packed : pb->plain;
+        size_t size = pb->packed_size ? pb->packed_size : pb->plain_size;
+        jh_block_index_entry e;
+        long cur = ftell(g_books_fp);
+        if (cur < 0) {
+            jh_die("ftell failed");
+        }
+        if (fwrite(data, 1, size, g_books_fp) != size) {
+            jh_die("write books block failed");
+        }
+        e.uncompressed_offset = pb->uncompressed_offset;
+        e.uncompressed_size = pb->plain_size;
+        e.compressed_offset = (jh_u64)cur;
+        e.compressed_size = (jh_u32)size;
+        jh_blocks_push(&e);
+    }
+    g_pending_count = 0;
+}
+
+/* jh_flush_block hands the current text block to the pending batch, writing the batch once it is full. */
 static void jh_flush_block(void) {
+    jh_pending_block *pb;
+    jh_u8 *spare;
     if (g_block_fill == 0) {
         return;
     }
     if (!g_books_fp) {
         jh_die("books file not open");
     }
-    if (fseek(g_books_fp, (long)g_block_file_offset, SEEK_SET) != 0) {
-        jh_die("fseek failed");
-    }
-    if (fwrite(g_block_buf, 1, g_block_fill, g_books_fp) != g_block_fill) {
-        jh_die("write books block failed");
+    pb = &g_pending[g_pending_count++];
+    if (!pb->plain) {
+        pb->plain = (jh_u8 *)malloc(g_block_size);
+        if (!pb->plain) {
+            jh_die("out of memory");
+        }
     }
-    jh_block_index_entry e;
-    e.uncompressed_offset = g_block_uncompressed_start;
-    e.uncompressed_size = g_block_fill;
-    e.compressed_offset = g_block_file_offset;
-    e.compressed_size = g_block_fill;
-    jh_blocks_push(&e);
+    spare = pb->plain;
+    pb->plain = g_block_buf;
+    pb->plain_size = g_block_fill;
+    pb->uncompressed_offset = g_block_uncompressed_start;
+    g_block_buf = spare;
     g_block_fill = 0;
+    if (g_pending_count == JH_BOOKS_PENDING_MAX) {
+        jh_write_pending_blocks();
+    }
 }
 
 /* jh_append_books_text appends UTF-8 text to books.bin using fixed-size blocks. */
@@ -255,11 +542,6 @@ static void jh_append_books_text(const char *data, size_t len) {
     while (pos < len) {
         if (g_block_fill == 0) {
             g_block_uncompressed_start = g_uncompressed_offset;
-            long cur = ftell(g_books_fp);
-            if (cur < 0) {
-                jh_die("ftell failed");
-            }
-            g_block_file_offset = (jh_u64)cur;
         }
         size_t space = g_block_size - g_block_fill;
         size_t chunk = len - pos;
@@ -303,6 +585,25 @@ typedef struct {
     jh_u32 book_id;
 } jh_book_file;
 
+/* jh_book_load is one book read from its SQLite file by a loader thread; page text_offset is relative to text and chapter k's title ends at title_ends[k] in title_text. */
+typedef struct {
+    int opened;
+    int done;
+    char *text;
+    size_t text_len;
+    size_t text_cap;
+    jh_page_tmp *pages;
+    size_t page_count;
+    size_t page_cap;
+    jh_chapter_tmp *chapters;
+    size_t *title_ends;
+    char *title_text;
+    size_t title_text_len;
+    size_t title_text_cap;
+    size_t chapter_count;
+    size_t chapter_cap;
+} jh_book_load;
+
 /* jh_book_file_cmp orders book files by id for deterministic processing. */
 static int jh_book_file_cmp(const void *a, const void *b) {
     const jh_book_file *aa = (const jh_book_file *)a;
@@ -353,11 +654,10 @@ static jh_book_file *jh_scan_books_dir(const char *dir_path, size_t *out_count)
     return files;
 }
 
-/* jh_load_titles_for_book reads title rows and creates chapter placeholders. */
-static void jh_load_titles_for_book(sqlite3 *db, jh_u32 book_id, jh_book_tmp *book) {
+/* jh_load_titles_for_book reads title rows into chapter placeholders with their titles. */
+static void jh_load_titles_for_book(sqlite3 *db, jh_u32 book_id, jh_book_load *load) {
     const char *sql = "SELECT tit, lvl, sub, id FROM title ORDER BY id";
     sqlite3_stmt *st = NULL;
-    jh_u32 first_chapter_id = (jh_u32)g_chapters_count;
     jh_u32 chapter_number = 0;
     int rc = sqlite3_prepare_v2(db, sql, -1, &st, NULL);
     if (rc != SQLITE_OK) {
@@ -372,19 +672,28 @@ static void jh_load_titles_for_book(sqlite3 *db, jh_u32 book_id, jh_book_tmp *bo
         if (!tit || tit_len <= 0) {
             continue;
         }
-        char *buf = (char *)malloc((size_t)tit_len + 1);
-        if (!buf) {
-            jh_die("out of memory");
+        if (load->chapter_count == load->chapter_cap) {
+            size_t nc = load->chapter_cap ? load->chapter_cap * 2 : 64;
+            load->chapters = (jh_chapter_tmp *)jh_xrealloc(load->chapters, nc, sizeof(jh_chapter_tmp));
+            load->title_ends = (size_t *)jh_xrealloc(load->title_ends, nc, sizeof(size_t));
+            load->chapter_cap = nc;
         }
-        memcpy(buf, tit, (size_t)tit_len);
-        buf[tit_len] = 0;
-        jh_u32 title_index = jh_titles_push(buf, 0);
-        free(buf);
-        jh_chapter_tmp *ch = jh_chapters_push_empty();
-        ch->chapter_id = (jh_u32)(g_chapters_count - 1);
+        if (load->title_text_len + (size_t)tit_len > load->title_text_cap) {
+            size_t nc = load->title_text_cap ? load->title_text_cap * 2 : 4096;
+            while (nc < load->title_text_len + (size_t)tit_len) {
+                nc *= 2;
+            }
+            load->title_text = (char *)jh_xrealloc(load->title_text, nc, 1);
+            load->title_text_cap = nc;
+        }
+        memcpy(load->title_text + load->title_text_len, tit, (size_t)tit_len);
+        load->title_text_len += (size_t)tit_len;
+        load->title_ends[load->chapter_count] = load->title_text_len;
+        jh_chapter_tmp *ch = &load->chapters[load->chapter_count++];
+        ch->chapter_id = 0;
         ch->book_id = book_id;
         ch->chapter_number = ++chapter_number;
-        ch->title_index = title_index;
+        ch->title_index = 0;
         ch->first_page_id = 0;
         ch->page_count = 0;
         ch->start_page_number = (jh_u32)id_val;
@@ -392,8 +701,6 @@ static void jh_load_titles_for_book(sqlite3 *db, jh_u32 book_id, jh_book_tmp *bo
         ch->sub = (jh_u32)sub_val;
     }
     sqlite3_finalize(st);
-    book->first_chapter_id = first_chapter_id;
-    book->chapter_count = (jh_u32)g_chapters_count - first_chapter_id;
 }
 
 static void jh_load_main_metadata(sqlite3 *db_main) {
@@ -419,34 +726,13 @@ static void jh_load_main_metadata(sqlite3 *db_main) {
         jh_u32 info_index = 0;
 
         if (bk && bk_len > 0) {
-            char *buf = (char *)malloc((size_t)bk_len + 1);
-            if (!buf) {
-                jh_die("out of memory");
-            }
-            memcpy(buf, bk, (size_t)bk_len);
-            buf[bk_len] = 0;
-            title_index = jh_titles_push(buf, 1);
-            free(buf);
+            title_index = jh_titles_push((const char *)bk, (size_t)bk_len, 1);
         }
         if (betaka && betaka_len > 0) {
-            char *buf = (char *)malloc((size_t)betaka_len + 1);
-            if (!buf) {
-                jh_die("out of memory");
-            }
-            memcpy(buf, betaka, (size_t)betaka_len);
-            buf[betaka_len] = 0;
-            betaka_index = jh_titles_push(buf, 2);
-            free(buf);
+            betaka_index = jh_titles_push((const char *)betaka, (size_t)betaka_len, 2);
         }
         if (inf && inf_len > 0) {
-            char *buf = (char *)malloc((size_t)inf_len + 1);
-            if (!buf) {
-                jh_die("out of memory");
-            }
-            memcpy(buf, inf, (size_t)inf_len);
-            buf[inf_len] = 0;
-            info_index = jh_titles_push(buf, 3);
-            free(buf);
+            info_index = jh_titles_push((const char *)inf, (size_t)inf_len, 3);
         }
 
         if (g_book_meta_count == g_book_meta_cap) {
@@ -454,6 +740,9 @@ static void jh_load_main_metadata(sqlite3 *db_main) {
             g_book_meta = (jh_book_meta_tmp *)jh_xrealloc(g_book_meta, nc, sizeof(jh_book_meta_tmp));
             g_book_meta_cap = nc;
         }
+        if (jh_id_map_get(&g_book_meta_map, (jh_u32)bkid_val) < 0) {
+            jh_id_map_put(&g_book_meta_map, (jh_u32)bkid_val, g_book_meta_count);
+        }
         m = &g_book_meta[g_book_meta_count++];
         m->book_id = (jh_u32)bkid_val;
         m->title_index = title_index;
@@ -485,14 +774,7 @@ static void jh_load_categories(sqlite3 *db_main) {
         jh_category_tmp *c;
         jh_u32 name_index = 0;
         if (cat && cat_len > 0) {
-            char *buf = (char *)malloc((size_t)cat_len + 1);
-            if (!buf) {
-                jh_die("out of memory");
-            }
-            memcpy(buf, cat, (size_t)cat_len);
-            buf[cat_len] = 0;
-            name_index = jh_titles_push(buf, 4);
-            free(buf);
+            name_index = jh_titles_push((const char *)cat, (size_t)cat_len, 4);
         }
         c = jh_category_find_or_add((jh_u32)id_val);
         if (name_index != 0) {
@@ -522,14 +804,7 @@ static void jh_load_authors(sqlite3 *db_auth) {
         jh_author_tmp *a;
         jh_u32 name_index = 0;
         if (name && name_len > 0) {
-            char *buf = (char *)malloc((size_t)name_len + 1);
-            if (!buf) {
-                jh_die("out of memory");
-            }
-            memcpy(buf, name, (size_t)name_len);
-            buf[name_len] = 0;
-            name_index = jh_titles_push(buf, 5);
-            free(buf);
+            name_index = jh_titles_push((const char *)name, (size_t)name_len, 5);
         }
         a = jh_author_find_or_add((jh_u32)id_val);
         if (name_index != 0) {
@@ -539,17 +814,30 @@ static void jh_load_authors(sqlite3 *db_auth) {
     sqlite3_finalize(st);
 }
 
-/* jh_process_book_rows groups nass text by page and streams it into books.bin. */
-static void jh_process_book_rows(sqlite3 *db, jh_u32 book_id, jh_book_tmp *book) {
+/* jh_load_page_push closes the page being assembled at the end of load->text. */
+static void jh_load_page_push(jh_book_load *load, jh_u32 book_id, jh_u32 page_number, size_t page_start) {
+    jh_page_tmp *p;
+    if (load->page_count == load->page_cap) {
+        size_t nc = load->page_cap ? load->page_cap * 2 : 256;
+        load->pages = (jh_page_tmp *)jh_xrealloc(load->pages, nc, sizeof(jh_page_tmp));
+        load->page_cap = nc;
+    }
+    p = &load->pages[load->page_count++];
+    p->book_id = book_id;
+    p->page_number = page_number;
+    p->text_offset = (jh_u64)page_start;
+    p->text_length = (jh_u32)(load->text_len - page_start);
+    p->chapter_id = 0;
+}
+
+/* jh_process_book_rows groups nass text by page into the book's text buffer. */
+static void jh_process_book_rows(sqlite3 *db, jh_u32 book_id, jh_book_load *load) {
     const char *sql = "SELECT nass, id, page, part FROM book ORDER BY page, id";
     sqlite3_stmt *st = NULL;
     int rc = sqlite3_prepare_v2(db, sql, -1, &st, NULL);
-    jh_u32 first_page_id = (jh_u32)g_pages_count;
     jh_u32 current_page = 0;
     int have_page = 0;
-    char *page_buf = NULL;
-    size_t page_len = 0;
-    size_t page_cap = 0;
+    size_t page_start = 0;
     if (rc != SQLITE_OK) {
         return;
     }
@@ -561,59 +849,212 @@ static void jh_process_book_rows(sqlite3 *db, jh_u32 book_id, jh_book_tmp *book)
             continue;
         }
         if (!have_page || (jh_u32)page != current_page) {
-            if (have_page && page_len > 0) {
-                jh_page_tmp p;
-                p.book_id = book_id;
-                p.page_number = current_page;
-                p.text_offset = g_uncompressed_offset;
-                p.text_length = (jh_u32)page_len;
-                p.chapter_id = 0;
-                jh_append_books_text(page_buf, page_len);
-                jh_pages_push(&p);
-                page_len = 0;
+            if (have_page && load->text_len > page_start) {
+                jh_load_page_push(load, book_id, current_page, page_start);
+                page_start = load->text_len;
             }
             current_page = (jh_u32)page;
             have_page = 1;
         }
-        if (page_len + (size_t)nass_len + 1 > page_cap) {
-            size_t nc = page_cap ? page_cap * 2 : 1024;
-            while (nc < page_len + (size_t)nass_len + 1) {
+        if (load->text_len + (size_t)nass_len + 1 > load->text_cap) {
+            size_t nc = load->text_cap ? load->text_cap * 2 : 4096;
+            while (nc < load->text_len + (size_t)nass_len + 1) {
                 nc *= 2;
             }
-            page_buf = (char *)jh_xrealloc(page_buf, nc, 1);
-            page_cap = nc;
-        }
-        memcpy(page_buf + page_len, nass, (size_t)nass_len);
-        page_len += (size_t)nass_len;
-        page_buf[page_len] = '\n';
-        page_len += 1;
-    }
-    if (have_page && page_len > 0) {
-        jh_page_tmp p;
-        p.book_id = book_id;
-        p.page_number = current_page;
+            load->text = (char *)jh_xrealloc(load->text, nc, 1);
+            load->text_cap = nc;
+        }
+        memcpy(load->text + load->text_len, nass, (size_t)nass_len);
+        load->text_len += (size_t)nass_len;
+        load->text[load->text_len] = '\n';
+        load->text_len += 1;
+    }
+    if (have_page && load->text_len > page_start) {
+        jh_load_page_push(load, book_id, current_page, page_start);
+    }
+    sqlite3_finalize(st);
+}
+
+/* jh_load_book reads one book database into load; load->opened stays 0 if it cannot be opened. */
+static void jh_load_book(const jh_book_file *file, jh_book_load *load) {
+    sqlite3 *db = NULL;
+    int rc = sqlite3_open_v2(file->path, &db, SQLITE_OPEN_READONLY, NULL);
+    if (rc != SQLITE_OK) {
+        sqlite3_close(db);
+        return;
+    }
+    load->opened = 1;
+    jh_load_titles_for_book(db, file->book_id, load);
+    jh_process_book_rows(db, file->book_id, load);
+    sqlite3_close(db);
+}
+
+/* jh_commit_book appends a loaded book to the global arrays and books.bin exactly as a serial export would. */
+static void jh_commit_book(const jh_book_file *file, jh_book_load *load) {
+    jh_book_tmp *book;
+    size_t k;
+    if (!load->opened) {
+        return;
+    }
+    book = jh_books_push_empty();
+    book->book_id = file->book_id;
+    book->first_page_id = 0;
+    book->page_count = 0;
+    book->first_chapter_id = 0;
+    book->chapter_count = 0;
+    book->text_start_offset = 0;
+    book->text_end_offset = 0;
+    {
+        jh_book_meta_tmp *m = jh_book_meta_find(file->book_id);
+        book->title_index = m ? m->title_index : 0;
+    }
+    book->first_chapter_id = (jh_u32)g_chapters_count;
+    for (k = 0; k < load->chapter_count; ++k) {
+        size_t title_start = k > 0 ? load->title_ends[k - 1] : 0;
+        jh_u32 title_index = jh_titles_push(load->title_text + title_start, load->title_ends[k] - title_start, 0);
+        jh_chapter_tmp *ch = jh_chapters_push_empty();
+        *ch = load->chapters[k];
+        ch->chapter_id = (jh_u32)(g_chapters_count - 1);
+        ch->title_index = title_index;
+    }
+    book->chapter_count = (jh_u32)g_chapters_count - book->first_chapter_id;
+    book->first_page_id = (jh_u32)g_pages_count;
+    for (k = 0; k < load->page_count; ++k) {
+        jh_page_tmp p = load->pages[k];
+        const char *text = load->text + p.text_offset;
         p.text_offset = g_uncompressed_offset;
-        p.text_length = (jh_u32)page_len;
-        p.chapter_id = 0;
-        jh_append_books_text(page_buf, page_len);
+        jh_append_books_text(text, p.text_length);
         jh_pages_push(&p);
     }
-    free(page_buf);
-    sqlite3_finalize(st);
-    book->first_page_id = first_page_id;
-    book->page_count = (jh_u32)g_pages_count - first_page_id;
+    book->page_count = (jh_u32)g_pages_count - book->first_page_id;
     if (book->page_count > 0) {
         jh_page_tmp *first = &g_pages[book->first_page_id];
         jh_page_tmp *last = &g_pages[book->first_page_id + book->page_count - 1];
         book->text_start_offset = first->text_offset;
         book->text_end_offset = last->text_offset + last->text_length;
-    } else {
-        book->text_start_offset = 0;
-        book->text_end_offset = 0;
     }
 }
 
-/* jh_assign_chapters maps pages into chapter ranges based on starting page numbers. */
+static void jh_book_load_free(jh_book_load *load) {
+    free(load->title_ends);
+    free(load->title_text);
+    free(load->chapters);
+    free(load->pages);
+    free(load->text);
+    memset(load, 0, sizeof(*load));
+}
+
+/* jh_ingest_queue hands book files to loader threads, which stay at most window books ahead of the commit. */
+typedef struct {
+    const jh_book_file *files;
+    size_t file_count;
+    jh_book_load *loads;
+    size_t next;
+    size_t committed;
+    size_t window;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} jh_ingest_queue;
+
+static void *jh_ingest_worker(void *arg) {
+    jh_ingest_queue *q = (jh_ingest_queue *)arg;
+    for (;;) {
+        size_t idx;
+        pthread_mutex_lock(&q->mutex);
+        while (q->next < q->file_count && q->next >= q->committed + q->window) {
+            pthread_cond_wait(&q->cond, &q->mutex);
+        }
+        if (q->next >= q->file_count) {
+            pthread_mutex_unlock(&q->mutex);
+            return NULL;
+        }
+        idx = q->next++;
+        pthread_mutex_unlock(&q->mutex);
+
+        jh_load_book(&q->files[idx], &q->loads[idx]);
+
+        pthread_mutex_lock(&q->mutex);
+        q->loads[idx].done = 1;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->mutex);
+    }
+}
+
+/* jh_ingest_thread_count reads JH_SQLITE_THREADS, defaulting to the online CPU count, capped at 32 and file_count. */
+static unsigned int jh_ingest_thread_count(size_t file_count) {
+    const char *env = getenv("JH_SQLITE_THREADS");
+    long n = 0;
+    if (env && *env) {
+        char *endp = NULL;
+        unsigned long v = strtoul(env, &endp, 10);
+        if (endp && *endp == 0 && v > 0) {
+            n = (long)(v > 32UL ? 32UL : v);
+        }
+    }
+    if (n == 0) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n <= 0) {
+            n = 4;
+        } else if (n > 32) {
+            n = 32;
+        }
+    }
+    if ((size_t)n > file_count) {
+        n = (long)file_count;
+    }
+    return (unsigned int)n;
+}
+
+/* jh_ingest_books loads book files on a thread pool and commits them in book-id order. */
+static void jh_ingest_books(const jh_book_file *files, size_t file_count) {
+    jh_ingest_queue q;
+    pthread_t threads[32];
+    unsigned int thread_count = jh_ingest_thread_count(file_count);
+    unsigned int t;
+    size_t i;
+
+    if (file_count == 0) {
+        return;
+    }
+    memset(&q, 0, sizeof(q));
+    q.files = files;
+    q.file_count = file_count;
+    q.window = (size_t)thread_count * 4;
+    q.loads = (jh_book_load *)calloc(file_count, sizeof(jh_book_load));
+    if (!q.loads) {
+        jh_die("out of memory");
+    }
+    pthread_mutex_init(&q.mutex, NULL);
+    pthread_cond_init(&q.cond, NULL);
+    for (t = 0; t < thread_count; ++t) {
+        if (pthread_create(&threads[t], NULL, jh_ingest_worker, &q) != 0) {
+            jh_die("pthread_create failed");
+        }
+    }
+    for (i = 0; i < file_count; ++i) {
+        pthread_mutex_lock(&q.mutex);
+        while (!q.loads[i].done) {
+            pthread_cond_wait(&q.cond, &q.mutex);
+        }
+        pthread_mutex_unlock(&q.mutex);
+
+        jh_commit_book(&files[i], &q.loads[i]);
+        jh_book_load_free(&q.loads[i]);
+
+        pthread_mutex_lock(&q.mutex);
+        q.committed = i + 1;
+        pthread_cond_broadcast(&q.cond);
+        pthread_mutex_unlock(&q.mutex);
+    }
+    for (t = 0; t < thread_count; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_cond_destroy(&q.cond);
+    pthread_mutex_destroy(&q.mutex);
+    free(q.loads);
+}
+
+/* jh_assign_chapters sweeps each book's pages and chapters together; chapters are in title-id order, so starts ascend. */
 static void jh_assign_chapters(void) {
     size_t bi;
     for (bi = 0; bi < g_books_count; ++bi) {
@@ -621,56 +1062,68 @@ static void jh_assign_chapters(void) {
         if (b->chapter_count == 0 || b->page_count == 0) {
             continue;
         }
-        jh_u32 c_first = b->first_chapter_id;
-        jh_u32 c_last = c_first + b->chapter_count;
-        jh_u32 p_first = b->first_page_id;
-        jh_u32 p_last = p_first + b->page_count;
-        jh_u32 ci;
-        for (ci = c_first; ci < c_last; ++ci) {
-            jh_chapter_tmp *ch = &g_chapters[ci];
-            jh_u32 next_start = 0xffffffffu;
-            jh_u32 cj;
-            for (cj = ci + 1; cj < c_last; ++cj) {
-                if (g_chapters[cj].start_page_number > ch->start_page_number) {
-                    next_start = g_chapters[cj].start_page_number;
-                    break;
-                }
+        jh_u32 c_last = b->first_chapter_id + b->chapter_count;
+        jh_u32 pi = b->first_page_id;
+        jh_u32 p_last = pi + b->page_count;
+        jh_u32 ci = b->first_chapter_id;
+        while (ci < c_last) {
+            /* Chapters sharing a start cover the same pages; the last of them owns those pages. */
+            jh_u32 start = g_chapters[ci].start_page_number;
+            jh_u32 group_end = ci + 1;
+            jh_u32 next_start;
+            jh_u32 first_page_id;
+            jh_u32 owner;
+            while (group_end < c_last && g_chapters[group_end].start_page_number == start) {
+                ++group_end;
             }
-            jh_u32 first_page_id = 0xffffffffu;
-            jh_u32 page_count = 0;
-            jh_u32 pi;
-            for (pi = p_first; pi < p_last; ++pi) {
-                jh_page_tmp *pg = &g_pages[pi];
-                if (pg->page_number < ch->start_page_number) {
-                    continue;
-                }
-                if (pg->page_number >= next_start) {
-                    break;
-                }
-                if (first_page_id == 0xffffffffu) {
-                    first_page_id = (jh_u32)pi;
-                }
-                pg->chapter_id = ch->chapter_id;
-                page_count += 1;
+            next_start = group_end < c_last ? g_chapters[group_end].start_page_number : 0xffffffffu;
+            owner = g_chapters[group_end - 1].chapter_id;
+            while (pi < p_last && g_pages[pi].page_number < start) {
+                ++pi;
             }
-            if (first_page_id == 0xffffffffu) {
-                ch->first_page_id = 0;
-                ch->page_count = 0;
-            } else {
-                ch->first_page_id = first_page_id;
-                ch->page_count = page_count;
+            first_page_id = pi;
+            while (pi < p_last && g_pages[pi].page_number < next_start) {
+                g_pages[pi].chapter_id = owner;
+                ++pi;
+            }
+            for (; ci < group_end; ++ci) {
+                g_chapters[ci].first_page_id = pi > first_page_id ? first_page_id : 0;
+                g_chapters[ci].page_count = pi - first_page_id;
             }
         }
     }
 }
 
+/* jh_select_books_compression picks the books.bin codec from JH_BOOKS_CODEC (none, zstd, lz4). books.bin stays
+   uncompressed unless a codec is requested, since the web reader only reads raw blocks. */
+static void jh_select_books_compression(void) {
+    const char *env = getenv("JH_BOOKS_CODEC");
+    g_books_compression = JH_BOOKS_COMPRESSION_NONE;
+    if (!env || !*env) {
+        return;
+    }
+    if (strcmp(env, "none") == 0) {
+        g_books_compression = JH_BOOKS_COMPRESSION_NONE;
+#ifdef JH_HAVE_ZSTD
+    } else if (strcmp(env, "zstd") == 0) {
+        g_books_compression = JH_BOOKS_COMPRESSION_ZSTD;
+#endif
+#ifdef JH_HAVE_LZ4
+    } else if (strcmp(env, "lz4") == 0) {
+        g_books_compression = JH_BOOKS_COMPRESSION_LZ4;
+#endif
+    } else {
+        jh_die("JH_BOOKS_CODEC names a codec that is not built in");
+    }
+}
+
 /* jh_write_books_bin opens books.bin and writes an initial header and state. */
 static void jh_write_books_bin(const char *path) {
     jh_books_file_header hdr;
     memset(&hdr, 0, sizeof(hdr));
     memcpy(hdr.magic, "BKSB", 4);
     hdr.version = 1;
-    hdr.compression = 0;
+    hdr.compression = g_books_compression;
     hdr.block_size = g_block_size;
     hdr.block_count = 0;
     hdr.index_offset = 0;
@@ -688,18 +1141,20 @@ static void jh_write_books_bin(const char *path) {
     g_block_fill = 0;
     g_uncompressed_offset = 0;
     g_block_uncompressed_start = 0;
-    long pos = ftell(g_books_fp);
-    if (pos < 0) {
-        jh_die("ftell failed");
-    }
-    g_block_file_offset = (jh_u64)pos;
 }
 
 /* jh_finalize_books_bin flushes remaining blocks and writes the final header and index. */
 static void jh_finalize_books_bin(const char *path) {
     jh_books_file_header hdr;
     jh_u64 index_offset;
+    size_t i;
     jh_flush_block();
+    jh_write_pending_blocks();
+    for (i = 0; i < JH_BOOKS_PENDING_MAX; ++i) {
+        free(g_pending[i].plain);
+        free(g_pending[i].packed);
+    }
+    memset(g_pending, 0, sizeof(g_pending));
     long pos = ftell(g_books_fp);
     if (pos < 0) {
         jh_die("ftell failed");
@@ -713,7 +1168,7 @@ static void jh_finalize_books_bin(const char *path) {
     memset(&hdr, 0, sizeof(hdr));
     memcpy(hdr.magic, "BKSB", 4);
     hdr.version = 1;
-    hdr.compression = 0;
+    hdr.compression = g_books_compression;
     hdr.block_size = g_block_size;
     hdr.block_count = (jh_u64)g_blocks_count;
     hdr.index_offset = index_offset;
@@ -842,13 +1297,11 @@ static void jh_build_and_write_chapters_idx(const char *path) {
     fclose(fp);
 }
 
-/* jh_build_and_write_titles_bin packs all chapter titles into titles.bin. */
+/* jh_build_and_write_titles_bin writes the title entries followed by the deduplicated string arena. */
 static void jh_build_and_write_titles_bin(const char *path) {
     FILE *fp = fopen(path, "wb");
     jh_titles_file_header hdr;
     jh_title_entry *entries;
-    jh_u64 strings_offset;
-    jh_u64 current_offset = 0;
     size_t i;
     if (!fp) {
         jh_die("cannot open titles.bin");
@@ -857,18 +1310,15 @@ static void jh_build_and_write_titles_bin(const char *path) {
     memcpy(hdr.magic, "TTLB", 4);
     hdr.version = 1;
     hdr.title_count = (jh_u32)g_titles_count;
-    strings_offset = sizeof(jh_titles_file_header) + sizeof(jh_title_entry) * (jh_u64)g_titles_count;
-    hdr.strings_offset = strings_offset;
-    entries = (jh_title_entry *)malloc(sizeof(jh_title_entry) * g_titles_count);
+    hdr.strings_offset = sizeof(jh_titles_file_header) + sizeof(jh_title_entry) * (jh_u64)g_titles_count;
+    entries = (jh_title_entry *)malloc(sizeof(jh_title_entry) * (g_titles_count ? g_titles_count : 1));
     if (!entries) {
         jh_die("out of memory");
     }
     for (i = 0; i < g_titles_count; ++i) {
-        size_t len = strlen(g_titles[i].text);
-        entries[i].offset = current_offset;
-        entries[i].length = (jh_u32)len;
+        entries[i].offset = g_titles[i].offset;
+        entries[i].length = g_titles[i].length;
         entries[i].flags = g_titles[i].flags;
-        current_offset += (jh_u64)len;
     }
     if (fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
         jh_die("write titles header failed");
@@ -878,13 +1328,9 @@ static void jh_build_and_write_titles_bin(const char *path) {
             jh_die("write title entries failed");
         }
     }
-    for (i = 0; i < g_titles_count; ++i) {
-        size_t len = strlen(g_titles[i].text);
-        if (len == 0) {
-            continue;
-        }
-        if (fwrite(g_titles[i].text, 1, len, fp) != len) {
-            jh_die("write title string failed");
+    if (g_title_arena_len > 0) {
+        if (fwrite(g_title_arena, 1, g_title_arena_len, fp) != g_title_arena_len) {
+            jh_die("write title strings failed");
         }
     }
     free(entries);
@@ -924,6 +1370,69 @@ static void jh_build_and_write_books_meta_idx(const char *path) {
     fclose(fp);
 }
 
+/* jh_build_and_write_facets_col writes facets.col, the page->book and book->category/author columns. */
+static void jh_build_and_write_facets_col(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    jh_facets_header hdr;
+    jh_u32 *book_category;
+    jh_u32 *book_author;
+    jh_u32 book_slots = 0;
+    jh_u32 i;
+    if (!fp) {
+        jh_die("cannot open facets.col");
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    for (i = 0; i < g_pages_count; ++i) {
+        if (g_pages[i].book_id + 1 > book_slots) {
+            book_slots = g_pages[i].book_id + 1;
+        }
+    }
+    for (i = 0; i < g_book_meta_count; ++i) {
+        jh_book_meta_tmp *mt = &g_book_meta[i];
+        if (mt->book_id + 1 > book_slots) {
+            book_slots = mt->book_id + 1;
+        }
+        if (mt->category_id + 1 > hdr.category_slots) {
+            hdr.category_slots = mt->category_id + 1;
+        }
+        if (mt->author_id + 1 > hdr.author_slots) {
+            hdr.author_slots = mt->author_id + 1;
+        }
+    }
+    book_category = (jh_u32 *)malloc(sizeof(jh_u32) * (book_slots ? book_slots : 1));
+    book_author = (jh_u32 *)malloc(sizeof(jh_u32) * (book_slots ? book_slots : 1));
+    if (!book_category || !book_author) {
+        jh_die("alloc facet columns failed");
+    }
+    for (i = 0; i < book_slots; ++i) {
+        book_category[i] = JH_FACET_NONE;
+        book_author[i] = JH_FACET_NONE;
+    }
+    for (i = 0; i < g_book_meta_count; ++i) {
+        book_category[g_book_meta[i].book_id] = g_book_meta[i].category_id;
+        book_author[g_book_meta[i].book_id] = g_book_meta[i].author_id;
+    }
+    memcpy(hdr.magic, "FCOL", 4);
+    hdr.version = 1;
+    hdr.page_count = (jh_u32)g_pages_count;
+    hdr.book_slots = book_slots;
+    if (fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
+        jh_die("write facets header failed");
+    }
+    for (i = 0; i < g_pages_count; ++i) {
+        if (fwrite(&g_pages[i].book_id, 1, sizeof(jh_u32), fp) != sizeof(jh_u32)) {
+            jh_die("write facets page column failed");
+        }
+    }
+    if (fwrite(book_category, sizeof(jh_u32), book_slots, fp) != book_slots ||
+        fwrite(book_author, sizeof(jh_u32), book_slots, fp) != book_slots) {
+        jh_die("write facets book columns failed");
+    }
+    free(book_category);
+    free(book_author);
+    fclose(fp);
+}
+
 static void jh_build_and_write_authors_idx(const char *path) {
     FILE *fp = fopen(path, "wb");
     jh_authors_index_header hdr;
@@ -1042,31 +1551,9 @@ int main(int argc, char **argv) {
         }
     }
     files = jh_scan_books_dir(books_dir, &file_count);
+    jh_select_books_compression();
     jh_write_books_bin("books.bin");
-    for (i = 0; i < file_count; ++i) {
-        sqlite3 *db = NULL;
-        jh_book_tmp *book;
-        int rc = sqlite3_open_v2(files[i].path, &db, SQLITE_OPEN_READONLY, NULL);
-        if (rc != SQLITE_OK) {
-            sqlite3_close(db);
-            continue;
-        }
-        book = jh_books_push_empty();
-        book->book_id = files[i].book_id;
-        book->first_page_id = 0;
-        book->page_count = 0;
-        book->first_chapter_id = 0;
-        book->chapter_count = 0;
-        book->text_start_offset = 0;
-        book->text_end_offset = 0;
-        {
-            jh_book_meta_tmp *m = jh_book_meta_find(files[i].book_id);
-            book->title_index = m ? m->title_index : 0;
-        }
-        jh_load_titles_for_book(db, files[i].book_id, book);
-        jh_process_book_rows(db, files[i].book_id, book);
-        sqlite3_close(db);
-    }
+    jh_ingest_books(files, file_count);
     jh_assign_chapters();
     jh_finalize_books_bin("books.bin");
     jh_build_and_write_pages_idx("pages.idx");
@@ -1074,6 +1561,7 @@ int main(int argc, char **argv) {
     jh_build_and_write_chapters_idx("chapters.idx");
     jh_build_and_write_titles_bin("titles.bin");
     jh_build_and_write_books_meta_idx("books_meta.idx");
+    jh_build_and_write_facets_col("facets.col");
     jh_build_and_write_authors_idx("authors.idx");
     jh_build_and_write_categories_idx("categories.idx");
     jh_build_and_write_book_authors_idx("book_authors.idx");
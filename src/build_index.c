@@ -0,0 +1,2004 @@
+#include "jamharah/build_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#ifdef JH_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#ifdef JH_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+/* Lists below this size are stored raw; frame overhead outweighs any gain. */
+#define JH_POSTINGS_RAW_MAX 64
+/* Frames up to this size, shared blocks included, use the trained dictionary once it exists. */
+#define JH_POSTINGS_DICT_LIST_MAX (20 * 1024)
+/* Lists up to this size are packed into shared blocks of about JH_POSTINGS_PACK_TARGET bytes. */
+#define JH_POSTINGS_PACK_LIST_MAX 512
+#define JH_POSTINGS_PACK_TARGET (16 * 1024)
+/* Largest dictionary trained; it is appended after the block index. */
+#define JH_POSTINGS_DICT_CAP (16 * 1024)
+/* Sample budget collected from the leading frames before training. */
+#define JH_POSTINGS_SAMPLE_BYTES (1 * 1024 * 1024)
+#define JH_POSTINGS_SAMPLE_MAX 16384
+#define JH_POSTINGS_ZSTD_LEVEL 3
+/* A sort holds two record buffers (the run and its radix scratch) within this budget unless the caller sets one;
+   an input that fits in one run is never spilled. */
+#define JH_SORT_DEFAULT_MB 128
+#define JH_SORT_MAX_THREADS 32
+/* Runs below this many records per thread are sorted on the calling thread; radix buckets below
+   JH_RADIX_SMALL records use insertion sort. */
+#define JH_RADIX_RECORDS_PER_THREAD 65536
+#define JH_RADIX_SMALL 32
+/* Radix digits are the 12 key bytes, least significant first: position, page_id, then the term's rank. */
+#define JH_RADIX_DIGITS 12
+/* At most this many runs are merged at once; more runs are first merged in groups into longer runs.
+   Each merged run gets an equal share of the budget as its read buffer, within these bounds. */
+#define JH_SORT_DEFAULT_FAN_IN 64
+#define JH_MERGE_READ_MIN_BYTES (64 * 1024)
+#define JH_MERGE_READ_MAX_BYTES (4 * 1024 * 1024)
+/* An inverter part starts with this many term slots and each new postings list with this many bytes. */
+#define JH_INVERT_MIN_TERMS 1024
+#define JH_INVERT_LIST_MIN 16
+/* A part's budget is at least this many times its empty term table, so a spill always frees real room. */
+#define JH_INVERT_MIN_PART_TABLES 4
+
+#if defined(JH_HAVE_ZSTD) || defined(JH_HAVE_LZ4)
+#define JH_POSTINGS_HAVE_CODEC 1
+#endif
+
+static void jh_write_u32_le(jh_u8 *p, jh_u32 v) {
+    p[0] = (jh_u8)(v & 0xffu);
+    p[1] = (jh_u8)((v >> 8) & 0xffu);
+    p[2] = (jh_u8)((v >> 16) & 0xffu);
+    p[3] = (jh_u8)((v >> 24) & 0xffu);
+}
+
+static int jh_ensure_cap(jh_u8 **buf, size_t *cap, size_t need) {
+    size_t nc;
+    jh_u8 *nb;
+    if (need <= *cap) {
+        return 0;
+    }
+    nc = *cap ? *cap * 2 : 1024;
+    while (nc < need) {
+        nc *= 2;
+    }
+    nb = (jh_u8 *)realloc(*buf, nc);
+    if (!nb) {
+        return -1;
+    }
+    *buf = nb;
+    *cap = nc;
+    return 0;
+}
+
+static int jh_occurrence_cmp(const void *a, const void *b) {
+    const jh_occurrence_record *ra = (const jh_occurrence_record *)a;
+    const jh_occurrence_record *rb = (const jh_occurrence_record *)b;
+    if (ra->word_hash < rb->word_hash) return -1;
+    if (ra->word_hash > rb->word_hash) return 1;
+    if (ra->page_id < rb->page_id) return -1;
+    if (ra->page_id > rb->page_id) return 1;
+    if (ra->position < rb->position) return -1;
+    if (ra->position > rb->position) return 1;
+    return 0;
+}
+
+/* jh_term_cmp orders sort records, whose term_id holds the term's rank by hash while a sort is running. */
+static int jh_term_cmp(const jh_term_occurrence *ra, const jh_term_occurrence *rb) {
+    if (ra->term_id < rb->term_id) return -1;
+    if (ra->term_id > rb->term_id) return 1;
+    if (ra->page_id < rb->page_id) return -1;
+    if (ra->page_id > rb->page_id) return 1;
+    if (ra->position < rb->position) return -1;
+    if (ra->position > rb->position) return 1;
+    return 0;
+}
+
+/* jh_occ_digit returns key byte d of r, where byte 0 is the lowest byte of position and byte 11 the top of term_id. */
+static unsigned jh_occ_digit(const jh_term_occurrence *r, unsigned d) {
+    if (d < 8) {
+        jh_u64 lo = ((jh_u64)r->page_id << 32) | r->position;
+        return (unsigned)(lo >> (8 * d)) & 0xffu;
+    }
+    return (unsigned)(r->term_id >> (8 * (d - 8))) & 0xffu;
+}
+
+/* jh_occ_bucket spreads ranks 0..term_count-1 evenly, in order, over the 256 top-level buckets. */
+static unsigned jh_occ_bucket(const jh_term_occurrence *r, jh_u32 term_count) {
+    return (unsigned)(((jh_u64)r->term_id << 8) / term_count);
+}
+
+static void jh_occ_insertion_sort(jh_term_occurrence *a, size_t n) {
+    size_t i;
+    for (i = 1; i < n; ++i) {
+        jh_term_occurrence v = a[i];
+        size_t j = i;
+        while (j > 0 && jh_term_cmp(&v, &a[j - 1]) < 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+/* jh_radix_lsd sorts a[0..n) on key bytes 0..digits-1 with scratch b, skipping bytes that are equal in every record.
+   The sorted records end up back in a. */
+static void jh_radix_lsd(jh_term_occurrence *a, jh_term_occurrence *b, size_t n, unsigned digits) {
+    size_t counts[JH_RADIX_DIGITS][256];
+    jh_term_occurrence *src = a;
+    jh_term_occurrence *dst = b;
+    size_t i;
+    unsigned d;
+
+    if (n <= JH_RADIX_SMALL) {
+        jh_occ_insertion_sort(a, n);
+        return;
+    }
+    memset(counts, 0, sizeof(counts[0]) * digits);
+    for (i = 0; i < n; ++i) {
+        for (d = 0; d < digits; ++d) {
+            counts[d][jh_occ_digit(&a[i], d)]++;
+        }
+    }
+    for (d = 0; d < digits; ++d) {
+        size_t sum = 0;
+        unsigned k;
+        jh_term_occurrence *tmp;
+        if (counts[d][jh_occ_digit(&a[0], d)] == n) {
+            continue;
+        }
+        for (k = 0; k < 256; ++k) {
+            size_t c = counts[d][k];
+            counts[d][k] = sum;
+            sum += c;
+        }
+        for (i = 0; i < n; ++i) {
+            dst[counts[d][jh_occ_digit(&src[i], d)]++] = src[i];
+        }
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != a) {
+        memcpy(a, src, sizeof(jh_term_occurrence) * n);
+    }
+}
+
+/* jh_radix_task is one thread's share of a parallel radix sort: a slice for the top-level pass, then whole buckets. */
+typedef struct {
+    jh_term_occurrence *recs;
+    jh_term_occurrence *tmp;
+    jh_u32 term_count;
+    size_t begin;
+    size_t end;
+    size_t hist[256];
+    const size_t *bucket_start;
+    _Atomic size_t *next_bucket;
+} jh_radix_task;
+
+static void *jh_radix_histogram(void *arg) {
+    jh_radix_task *t = (jh_radix_task *)arg;
+    size_t i;
+    memset(t->hist, 0, sizeof(t->hist));
+    for (i = t->begin; i < t->end; ++i) {
+        t->hist[jh_occ_bucket(&t->recs[i], t->term_count)]++;
+    }
+    return NULL;
+}
+
+/* jh_radix_scatter moves the slice into tmp by bucket; hist holds this slice's first slot for each bucket. */
+static void *jh_radix_scatter(void *arg) {
+    jh_radix_task *t = (jh_radix_task *)arg;
+    size_t i;
+    for (i = t->begin; i < t->end; ++i) {
+        t->tmp[t->hist[jh_occ_bucket(&t->recs[i], t->term_count)]++] = t->recs[i];
+    }
+    return NULL;
+}
+
+/* jh_radix_buckets claims top-level buckets until none are left, sorting each on the full key back into recs. */
+static void *jh_radix_buckets(void *arg) {
+    jh_radix_task *t = (jh_radix_task *)arg;
+    for (;;) {
+        size_t b = atomic_fetch_add(t->next_bucket, 1);
+        size_t lo;
+        size_t n;
+        if (b >= 256) {
+            break;
+        }
+        lo = t->bucket_start[b];
+        n = t->bucket_start[b + 1] - lo;
+        jh_radix_lsd(t->tmp + lo, t->recs + lo, n, JH_RADIX_DIGITS);
+        memcpy(t->recs + lo, t->tmp + lo, sizeof(jh_term_occurrence) * n);
+    }
+    return NULL;
+}
+
+/* jh_radix_run_all runs fn on every task, on worker threads when there is more than one. */
+static int jh_radix_run_all(jh_radix_task *tasks, unsigned int count, void *(*fn)(void *)) {
+    pthread_t threads[JH_SORT_MAX_THREADS];
+    unsigned int i;
+    int rc = 0;
+    if (count == 1) {
+        fn(&tasks[0]);
+        return 0;
+    }
+    for (i = 0; i < count; ++i) {
+        if (pthread_create(&threads[i], NULL, fn, &tasks[i]) != 0) {
+            break;
+        }
+    }
+    if (i < count) {
+        rc = -1;
+    }
+    while (i > 0) {
+        pthread_join(threads[--i], NULL);
+    }
+    return rc;
+}
+
+/* jh_radix_sort_occurrences sorts recs by (rank, page_id, position) using tmp as scratch: a parallel pass that splits
+   the ranks into 256 ordered buckets, then threads sort the buckets independently. Every rank is below term_count. */
+static int jh_radix_sort_occurrences(jh_term_occurrence *recs, jh_term_occurrence *tmp, size_t n, unsigned int threads, jh_u32 term_count) {
+    jh_radix_task tasks[JH_SORT_MAX_THREADS];
+    size_t bucket_start[257];
+    _Atomic size_t next_bucket = 0;
+    unsigned int i;
+    unsigned int b;
+    size_t sum = 0;
+
+    if (threads > n / JH_RADIX_RECORDS_PER_THREAD) {
+        threads = (unsigned int)(n / JH_RADIX_RECORDS_PER_THREAD);
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (i = 0; i < threads; ++i) {
+        tasks[i].recs = recs;
+        tasks[i].tmp = tmp;
+        tasks[i].term_count = term_count;
+        tasks[i].begin = n * i / threads;
+        tasks[i].end = n * (i + 1) / threads;
+        tasks[i].bucket_start = bucket_start;
+        tasks[i].next_bucket = &next_bucket;
+    }
+    if (jh_radix_run_all(tasks, threads, jh_radix_histogram) != 0) {
+        return -1;
+    }
+    for (b = 0; b < 256; ++b) {
+        bucket_start[b] = sum;
+        for (i = 0; i < threads; ++i) {
+            size_t c = tasks[i].hist[b];
+            tasks[i].hist[b] = sum;
+            sum += c;
+        }
+    }
+    bucket_start[256] = sum;
+    if (jh_radix_run_all(tasks, threads, jh_radix_scatter) != 0) {
+        return -1;
+    }
+    return jh_radix_run_all(tasks, threads, jh_radix_buckets);
+}
+
+/* jh_sort_plan is a jh_sort_options with every default filled in and the buffer sizes derived from the budget. */
+typedef struct {
+    size_t run_records;
+    size_t read_records;
+    unsigned int threads;
+    unsigned int fan_in;
+    const char *tmp_dir;
+} jh_sort_plan;
+
+static void jh_sort_resolve(const jh_sort_options *opts, jh_sort_plan *plan) {
+    size_t bytes = opts && opts->memory_bytes ? opts->memory_bytes : (size_t)JH_SORT_DEFAULT_MB * 1024 * 1024;
+    size_t read_bytes;
+    unsigned int tc = opts ? opts->threads : 0;
+    if (tc == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        tc = ncpu > 0 ? (unsigned int)ncpu : 1;
+    }
+    if (tc > JH_SORT_MAX_THREADS) {
+        tc = JH_SORT_MAX_THREADS;
+    }
+    plan->threads = tc;
+    plan->fan_in = opts && opts->fan_in ? opts->fan_in : JH_SORT_DEFAULT_FAN_IN;
+    if (plan->fan_in < 2) {
+        plan->fan_in = 2;
+    }
+    plan->tmp_dir = opts && opts->tmp_dir && *opts->tmp_dir ? opts->tmp_dir : NULL;
+    plan->run_records = bytes / (2 * sizeof(jh_term_occurrence));
+    if (plan->run_records < JH_RADIX_RECORDS_PER_THREAD) {
+        plan->run_records = JH_RADIX_RECORDS_PER_THREAD;
+    }
+    /* The merge also buffers its output, hence fan_in + 1 shares. */
+    read_bytes = bytes / ((size_t)plan->fan_in + 1);
+    if (read_bytes < JH_MERGE_READ_MIN_BYTES) {
+        read_bytes = JH_MERGE_READ_MIN_BYTES;
+    } else if (read_bytes > JH_MERGE_READ_MAX_BYTES) {
+        read_bytes = JH_MERGE_READ_MAX_BYTES;
+    }
+    plan->read_records = read_bytes / sizeof(jh_term_occurrence);
+}
+
+void jh_sort_options_from_env(jh_sort_options *opts) {
+    const char *mb = getenv("JH_SORT_MB");
+    const char *th = getenv("JH_SORT_THREADS");
+    const char *fan_in = getenv("JH_SORT_FAN_IN");
+    const char *tmp_dir = getenv("JH_SORT_TMPDIR");
+    memset(opts, 0, sizeof(*opts));
+    if (tmp_dir && *tmp_dir) {
+        opts->tmp_dir = tmp_dir;
+    }
+    if (fan_in && *fan_in) {
+        opts->fan_in = (unsigned int)strtoul(fan_in, NULL, 10);
+    }
+    if (mb && *mb) {
+        opts->memory_bytes = (size_t)strtoul(mb, NULL, 10) * 1024 * 1024;
+    }
+    if (th && *th) {
+        opts->threads = (unsigned int)strtoul(th, NULL, 10);
+    }
+}
+
+/* jh_run_file is a spilled sorted run, read back through a buffer of whole records during the merge. */
+typedef struct {
+    FILE *fp;
+    char *path;
+    jh_term_occurrence *buf;
+    size_t count;
+    size_t pos;
+} jh_run_file;
+
+/* jh_inverter_term is one term's varint-coded (page gap, position) list inside an inverter part. */
+struct jh_inverter_term {
+    jh_u64 word_hash;
+    jh_u8 *data;
+    jh_u32 len;
+    jh_u32 cap;
+    jh_u32 count;
+    jh_u32 last_page;
+    jh_u32 last_position;
+};
+
+/* jh_partial_header precedes each term's list in a spilled partial index. */
+typedef struct {
+    jh_u64 word_hash;
+    jh_u32 count;
+    jh_u32 length;
+} jh_partial_header;
+
+/* jh_partial_cursor replays one partial index, spilled to path or still in memory, as occurrence records. */
+typedef struct {
+    FILE *fp;
+    char *path;
+    jh_inverter_term **terms;
+    size_t term_count;
+    size_t term_pos;
+    jh_u8 *buf;
+    size_t buf_cap;
+    const jh_u8 *p;
+    const jh_u8 *end;
+    jh_u32 left;
+    jh_occurrence_record current;
+    int has_current;
+} jh_partial_cursor;
+
+/* jh_occ_source yields occurrences in sorted order from a sorted file, a single in-memory run, or a loser-tree
+   merge of spilled runs or partial indexes. Runs hold term records keyed by rank; rank_of and id_of map between
+   the ranks and the ids of the term table, and term_hashes resolves an id to its word hash. */
+typedef struct {
+    FILE *fp;
+    jh_term_occurrence *mem;
+    size_t mem_count;
+    size_t mem_pos;
+    jh_run_file *runs;
+    size_t run_count;
+    size_t run_cap;
+    size_t next_run_id;
+    size_t read_records;
+    const char *tmp_dir;
+    jh_partial_cursor *partials;
+    size_t partial_count;
+    const char *partial_prefix;
+    jh_u64 *term_hashes;
+    jh_u32 *rank_of;
+    jh_u32 *id_of;
+    jh_u32 term_count;
+    size_t *tree;
+    int primed;
+    int failed;
+} jh_occ_source;
+
+static void jh_run_file_release(jh_run_file *run) {
+    if (run->fp) {
+        fclose(run->fp);
+    }
+    if (run->path) {
+        remove(run->path);
+        free(run->path);
+    }
+    free(run->buf);
+    memset(run, 0, sizeof(*run));
+}
+
+/* jh_partial_cursor_release closes a partial index and removes its file, if it has one. */
+static void jh_partial_cursor_release(jh_partial_cursor *c) {
+    if (c->fp) {
+        fclose(c->fp);
+    }
+    if (c->path) {
+        remove(c->path);
+        free(c->path);
+    }
+    free(c->terms);
+    free(c->buf);
+    memset(c, 0, sizeof(*c));
+}
+
+/* jh_run_file_fill reads the next buffer of records; count is 0 once the run is drained. */
+static int jh_run_file_fill(jh_run_file *run, size_t read_records) {
+    run->pos = 0;
+    run->count = fread(run->buf, sizeof(jh_term_occurrence), read_records, run->fp);
+    return ferror(run->fp) ? -1 : 0;
+}
+
+static void jh_occ_source_close(jh_occ_source *src) {
+    size_t i;
+    if (src->fp) {
+        fclose(src->fp);
+    }
+    for (i = 0; i < src->run_count; ++i) {
+        jh_run_file_release(&src->runs[i]);
+    }
+    for (i = 0; i < src->partial_count; ++i) {
+        jh_partial_cursor_release(&src->partials[i]);
+    }
+    free(src->runs);
+    free(src->partials);
+    free(src->tree);
+    free(src->mem);
+    free(src->term_hashes);
+    free(src->rank_of);
+    free(src->id_of);
+    memset(src, 0, sizeof(*src));
+}
+
+/* jh_occ_source_new_file creates the next temporary file for writing a run, or a merged partial index when the
+   source merges partials, and stores its malloc'd path in out_path. */
+static FILE *jh_occ_source_new_file(jh_occ_source *src, char **out_path) {
+    char tmp_name[1024];
+    FILE *rf;
+
+    if (src->partials) {
+        snprintf(tmp_name, sizeof(tmp_name), "%s_merge_%06zu.tmp", src->partial_prefix, src->next_run_id);
+    } else {
+        snprintf(tmp_name, sizeof(tmp_name), "%s%socc_run_%ld_%06zu.tmp", src->tmp_dir ? src->tmp_dir : "",
+                 src->tmp_dir ? "/" : "", (long)getpid(), src->next_run_id);
+    }
+    *out_path = (char *)malloc(strlen(tmp_name) + 1);
+    if (!*out_path) {
+        return NULL;
+    }
+    strcpy(*out_path, tmp_name);
+    rf = fopen(tmp_name, "wb");
+    if (!rf) {
+        free(*out_path);
+        *out_path = NULL;
+        return NULL;
+    }
+    src->next_run_id += 1;
+    return rf;
+}
+
+/* jh_occ_source_spill writes one sorted run to its own temporary file; it is reopened when the merge starts. */
+static int jh_occ_source_spill(jh_occ_source *src, const jh_term_occurrence *buf, size_t count) {
+    FILE *rf;
+    int rc = 0;
+
+    if (src->run_count == src->run_cap) {
+        size_t nc = src->run_cap ? src->run_cap * 2 : 16;
+        jh_run_file *nruns = (jh_run_file *)realloc(src->runs, sizeof(jh_run_file) * nc);
+        if (!nruns) {
+            return -1;
+        }
+        src->runs = nruns;
+        src->run_cap = nc;
+    }
+    memset(&src->runs[src->run_count], 0, sizeof(jh_run_file));
+    rf = jh_occ_source_new_file(src, &src->runs[src->run_count].path);
+    if (!rf) {
+        return -1;
+    }
+    src->run_count += 1;
+    if (fwrite(buf, sizeof(jh_term_occurrence), count, rf) != count) {
+        rc = -1;
+    }
+    if (fclose(rf) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+static int jh_occ_source_next_term(jh_occ_source *src, jh_term_occurrence *out);
+static int jh_occ_source_next(jh_occ_source *src, jh_occurrence_record *out);
+static void jh_occ_source_end_merge(jh_occ_source *src);
+
+/* jh_varint_put writes v as LEB128 at p and returns the number of bytes written. */
+static size_t jh_varint_put(jh_u8 *p, jh_u32 v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (jh_u8)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (jh_u8)v;
+    return n;
+}
+
+/* jh_partial_writer re-encodes merged records as a partial index: per term a jh_partial_header and its
+   varint-coded (page gap, position) list. */
+typedef struct {
+    FILE *fp;
+    jh_partial_header head;
+    jh_u32 last_page;
+    jh_u32 last_position;
+    jh_u8 *buf;
+    size_t len;
+    size_t cap;
+} jh_partial_writer;
+
+static int jh_partial_writer_flush(jh_partial_writer *pw) {
+    if (pw->head.count == 0) {
+        return 0;
+    }
+    pw->head.length = (jh_u32)pw->len;
+    if (fwrite(&pw->head, sizeof(pw->head), 1, pw->fp) != 1 || fwrite(pw->buf, 1, pw->len, pw->fp) != pw->len) {
+        return -1;
+    }
+    pw->head.count = 0;
+    pw->len = 0;
+    return 0;
+}
+
+static int jh_partial_writer_add(jh_partial_writer *pw, const jh_occurrence_record *rec) {
+    jh_u32 gap;
+    if (pw->head.count > 0 && rec->word_hash != pw->head.word_hash && jh_partial_writer_flush(pw) != 0) {
+        return -1;
+    }
+    if (pw->head.count == 0) {
+        pw->head.word_hash = rec->word_hash;
+        pw->last_page = 0;
+        pw->last_position = 0;
+    }
+    if (jh_ensure_cap(&pw->buf, &pw->cap, pw->len + 10) != 0) {
+        return -1;
+    }
+    gap = rec->page_id - pw->last_page;
+    pw->len += jh_varint_put(pw->buf + pw->len, gap);
+    pw->len += jh_varint_put(pw->buf + pw->len, gap != 0 ? rec->position : rec->position - pw->last_position);
+    pw->head.count += 1;
+    pw->last_page = rec->page_id;
+    pw->last_position = rec->position;
+    return 0;
+}
+
+/* jh_occ_source_merge_group merges spilled inputs [g, g + n) into one new spilled input stored at slot out <= g. */
+static int jh_occ_source_merge_group(jh_occ_source *src, size_t g, size_t n, size_t out, const jh_sort_plan *plan) {
+    jh_occ_source group;
+    char *path = NULL;
+    FILE *out_fp = jh_occ_source_new_file(src, &path);
+    int rc = 0;
+
+    if (!out_fp) {
+        return -1;
+    }
+    setvbuf(out_fp, NULL, _IOFBF, plan->read_records * sizeof(jh_term_occurrence));
+    memset(&group, 0, sizeof(group));
+    group.read_records = plan->read_records;
+    if (src->partials) {
+        jh_partial_writer pw;
+        jh_occurrence_record occ;
+        memset(&pw, 0, sizeof(pw));
+        pw.fp = out_fp;
+        group.partials = &src->partials[g];
+        group.partial_count = n;
+        while (rc == 0 && jh_occ_source_next(&group, &occ)) {
+            rc = jh_partial_writer_add(&pw, &occ);
+        }
+        if (rc == 0) {
+            rc = jh_partial_writer_flush(&pw);
+        }
+        free(pw.buf);
+    } else {
+        jh_term_occurrence occ;
+        group.runs = &src->runs[g];
+        group.run_count = n;
+        while (jh_occ_source_next_term(&group, &occ)) {
+            if (fwrite(&occ, sizeof(jh_term_occurrence), 1, out_fp) != 1) {
+                rc = -1;
+                break;
+            }
+        }
+    }
+    if (fclose(out_fp) != 0 || group.failed) {
+        rc = -1;
+    }
+    jh_occ_source_end_merge(&group);
+    /* The merged file takes slot out even on failure, so jh_occ_source_close still removes it. */
+    if (src->partials) {
+        memset(&src->partials[out], 0, sizeof(jh_partial_cursor));
+        src->partials[out].path = path;
+    } else {
+        memset(&src->runs[out], 0, sizeof(jh_run_file));
+        src->runs[out].path = path;
+    }
+    return rc;
+}
+
+/* jh_occ_source_move moves spilled input from to slot to. */
+static void jh_occ_source_move(jh_occ_source *src, size_t from, size_t to) {
+    if (src->partials) {
+        src->partials[to] = src->partials[from];
+    } else {
+        src->runs[to] = src->runs[from];
+    }
+}
+
+/* jh_occ_source_reduce merges the source's spilled inputs, sort runs or partial indexes, in groups of fan_in into
+   longer ones until at most limit remain, so that no merge holds more than fan_in files open. */
+static int jh_occ_source_reduce(jh_occ_source *src, size_t limit, const jh_sort_plan *plan) {
+    size_t *count = src->partials ? &src->partial_count : &src->run_count;
+    if (limit < 1) {
+        limit = 1;
+    }
+    while (*count > limit) {
+        size_t out_count = 0;
+        size_t g;
+        for (g = 0; g < *count; g += plan->fan_in) {
+            size_t n = *count - g < plan->fan_in ? *count - g : plan->fan_in;
+            if (n == 1) {
+                jh_occ_source_move(src, g, out_count++);
+                continue;
+            }
+            if (jh_occ_source_merge_group(src, g, n, out_count++, plan) != 0) {
+                /* Keep the unmerged inputs so jh_occ_source_close still removes their files. */
+                for (g += n; g < *count; ++g) {
+                    jh_occ_source_move(src, g, out_count++);
+                }
+                *count = out_count;
+                return -1;
+            }
+        }
+        *count = out_count;
+    }
+    return 0;
+}
+
+/* jh_term_rank pairs a term id with its word hash while ranks are assigned. */
+typedef struct {
+    jh_u64 word_hash;
+    jh_u32 term_id;
+} jh_term_rank;
+
+static int jh_term_rank_cmp(const void *a, const void *b) {
+    const jh_term_rank *ra = (const jh_term_rank *)a;
+    const jh_term_rank *rb = (const jh_term_rank *)b;
+    if (ra->word_hash != rb->word_hash) {
+        return ra->word_hash < rb->word_hash ? -1 : 1;
+    }
+    return ra->term_id < rb->term_id ? -1 : ra->term_id > rb->term_id;
+}
+
+/* jh_occ_source_load_terms reads occ_path's term table and ranks its ids by word hash, so that sorting by rank sorts
+   by hash. Ids sharing a hash share a rank, and id_of maps each rank back to the first of them. */
+static int jh_occ_source_load_terms(jh_occ_source *src, const char *occ_path) {
+    jh_term_rank *order;
+    jh_u32 rank = 0;
+    jh_u32 i;
+
+    if (jh_read_term_table(occ_path, &src->term_hashes, &src->term_count) != 0) {
+        return -1;
+    }
+    order = (jh_term_rank *)malloc(sizeof(jh_term_rank) * ((size_t)src->term_count + 1));
+    src->rank_of = (jh_u32 *)malloc(sizeof(jh_u32) * ((size_t)src->term_count + 1));
+    src->id_of = (jh_u32 *)malloc(sizeof(jh_u32) * ((size_t)src->term_count + 1));
+    if (!order || !src->rank_of || !src->id_of) {
+        free(order);
+        return -1;
+    }
+    for (i = 0; i < src->term_count; ++i) {
+        order[i].word_hash = src->term_hashes[i];
+        order[i].term_id = i;
+    }
+    qsort(order, src->term_count, sizeof(jh_term_rank), jh_term_rank_cmp);
+    for (i = 0; i < src->term_count; ++i) {
+        if (i == 0 || order[i].word_hash != order[i - 1].word_hash) {
+            rank = i == 0 ? 0 : rank + 1;
+            src->id_of[rank] = order[i].term_id;
+        }
+        src->rank_of[order[i].term_id] = rank;
+    }
+    free(order);
+    return 0;
+}
+
+/* jh_occ_source_rank replaces each record's term id with its rank; returns -1 on an id outside the term table. */
+static int jh_occ_source_rank(const jh_occ_source *src, jh_term_occurrence *recs, size_t n) {
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        if (recs[i].term_id >= src->term_count) {
+            return -1;
+        }
+        recs[i].term_id = src->rank_of[recs[i].term_id];
+    }
+    return 0;
+}
+
+/* jh_occ_source_open_runs sorts in_path in memory-sized runs, keeping a lone run in memory and spilling the rest. */
+static int jh_occ_source_open_runs(const char *in_path, const jh_sort_options *opts, jh_occ_source *src, jh_u64 *out_run_count) {
+    FILE *in_fp;
+    jh_term_occurrence *buf;
+    jh_term_occurrence *tmp;
+    jh_sort_plan plan;
+    size_t buf_cap;
+
+    memset(src, 0, sizeof(*src));
+    jh_sort_resolve(opts, &plan);
+    buf_cap = plan.run_records;
+    src->read_records = plan.read_records;
+    src->tmp_dir = plan.tmp_dir;
+    if (jh_occ_source_load_terms(src, in_path) != 0) {
+        jh_occ_source_close(src);
+        return -1;
+    }
+    in_fp = fopen(in_path, "rb");
+    if (!in_fp) {
+        jh_occ_source_close(src);
+        return -1;
+    }
+    buf = (jh_term_occurrence *)malloc(sizeof(jh_term_occurrence) * buf_cap);
+    tmp = (jh_term_occurrence *)malloc(sizeof(jh_term_occurrence) * buf_cap);
+    if (!buf || !tmp) {
+        free(buf);
+        free(tmp);
+        fclose(in_fp);
+        jh_occ_source_close(src);
+        return -1;
+    }
+
+    for (;;) {
+        size_t nread = fread(buf, sizeof(jh_term_occurrence), buf_cap, in_fp);
+        if (nread == 0) {
+            break;
+        }
+        if (jh_occ_source_rank(src, buf, nread) != 0 ||
+            jh_radix_sort_occurrences(buf, tmp, nread, plan.threads, src->term_count) != 0) {
+            free(buf);
+            free(tmp);
+            fclose(in_fp);
+            jh_occ_source_close(src);
+            return -1;
+        }
+        if (src->run_count == 0 && nread < buf_cap) {
+            src->mem = buf;
+            src->mem_count = nread;
+            buf = NULL;
+            break;
+        }
+        if (jh_occ_source_spill(src, buf, nread) != 0) {
+            free(buf);
+            free(tmp);
+            fclose(in_fp);
+            jh_occ_source_close(src);
+            return -1;
+        }
+    }
+    free(buf);
+    free(tmp);
+    fclose(in_fp);
+    if (out_run_count) {
+        *out_run_count = src->mem ? 1 : (jh_u64)src->run_count;
+    }
+    if (jh_occ_source_reduce(src, plan.fan_in, &plan) != 0) {
+        jh_occ_source_close(src);
+        return -1;
+    }
+    return 0;
+}
+
+/* jh_varint_get decodes one LEB128 u32 from [*p, end); returns 0 on truncation. */
+static int jh_varint_get(const jh_u8 **p, const jh_u8 *end, jh_u32 *out) {
+    jh_u32 v = 0;
+    unsigned shift = 0;
+    while (*p < end && shift < 35) {
+        jh_u8 b = *(*p)++;
+        v |= (jh_u32)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return 1;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+/* jh_partial_cursor_next decodes the cursor's next record into c->current; returns 1, 0 at the end, -1 on a bad partial. */
+static int jh_partial_cursor_next(jh_partial_cursor *c) {
+    jh_u32 gap;
+    jh_u32 pos;
+
+    while (c->left == 0) {
+        if (c->fp) {
+            jh_partial_header ph;
+            if (fread(&ph, sizeof(ph), 1, c->fp) != 1) {
+                return 0;
+            }
+            if (jh_ensure_cap(&c->buf, &c->buf_cap, ph.length) != 0 ||
+                fread(c->buf, 1, ph.length, c->fp) != ph.length) {
+                return -1;
+            }
+            c->current.word_hash = ph.word_hash;
+            c->left = ph.count;
+            c->p = c->buf;
+            c->end = c->buf + ph.length;
+        } else {
+            const jh_inverter_term *t;
+            if (c->term_pos == c->term_count) {
+                return 0;
+            }
+            t = c->terms[c->term_pos++];
+            c->current.word_hash = t->word_hash;
+            c->left = t->count;
+            c->p = t->data;
+            c->end = t->data + t->len;
+        }
+        c->current.page_id = 0;
+        c->current.position = 0;
+    }
+    if (!jh_varint_get(&c->p, c->end, &gap) || !jh_varint_get(&c->p, c->end, &pos)) {
+        return -1;
+    }
+    if (gap != 0) {
+        c->current.page_id += gap;
+        c->current.position = pos;
+    } else {
+        c->current.position += pos;
+    }
+    c->left -= 1;
+    return 1;
+}
+
+/* jh_occ_source_live reports whether merge input i still has a current record. */
+static int jh_occ_source_live(const jh_occ_source *src, size_t i) {
+    if (src->partials) {
+        return src->partials[i].has_current;
+    }
+    return src->runs[i].pos < src->runs[i].count;
+}
+
+/* jh_occ_source_beats orders merge inputs by current record; leaf k is the -inf placeholder used while building. */
+static int jh_occ_source_beats(const jh_occ_source *src, size_t k, size_t a, size_t b) {
+    int la;
+    int lb;
+    int c;
+    if (a == k || b == k) {
+        return a == k;
+    }
+    la = jh_occ_source_live(src, a);
+    lb = jh_occ_source_live(src, b);
+    if (!la || !lb) {
+        return la;
+    }
+    if (src->partials) {
+        c = jh_occurrence_cmp(&src->partials[a].current, &src->partials[b].current);
+    } else {
+        c = jh_term_cmp(&src->runs[a].buf[src->runs[a].pos], &src->runs[b].buf[src->runs[b].pos]);
+    }
+    return c < 0 || (c == 0 && a < b);
+}
+
+/* jh_occ_source_replay replays input s up the loser tree after its record changed; tree[0] is the overall winner. */
+static void jh_occ_source_replay(jh_occ_source *src, size_t k, size_t s) {
+    size_t t;
+    for (t = (s + k) / 2; t > 0; t /= 2) {
+        if (jh_occ_source_beats(src, k, src->tree[t], s)) {
+            size_t w = src->tree[t];
+            src->tree[t] = s;
+            s = w;
+        }
+    }
+    src->tree[0] = s;
+}
+
+/* jh_occ_source_advance moves merge input i to its next record. */
+static int jh_occ_source_advance(jh_occ_source *src, size_t i) {
+    if (src->partials) {
+        int rc = jh_partial_cursor_next(&src->partials[i]);
+        src->partials[i].has_current = rc > 0;
+        return rc < 0 ? -1 : 0;
+    }
+    if (++src->runs[i].pos < src->runs[i].count) {
+        return 0;
+    }
+    return jh_run_file_fill(&src->runs[i], src->read_records);
+}
+
+/* jh_occ_source_start_merge opens every run (or primes every partial cursor) and builds the loser tree. */
+static int jh_occ_source_start_merge(jh_occ_source *src) {
+    size_t k = src->partials ? src->partial_count : src->run_count;
+    size_t i;
+
+    src->primed = 1;
+    if (k == 0) {
+        return 0;
+    }
+    src->tree = (size_t *)malloc(sizeof(size_t) * k);
+    if (!src->tree) {
+        return -1;
+    }
+    for (i = 0; i < k; ++i) {
+        src->tree[i] = k;
+        if (src->partials) {
+            jh_partial_cursor *c = &src->partials[i];
+            int rc;
+            if (c->path && !c->fp) {
+                c->fp = fopen(c->path, "rb");
+                if (!c->fp) {
+                    return -1;
+                }
+                setvbuf(c->fp, NULL, _IOFBF, src->read_records * sizeof(jh_term_occurrence));
+            }
+            rc = jh_partial_cursor_next(c);
+            if (rc < 0) {
+                return -1;
+            }
+            src->partials[i].has_current = rc;
+            continue;
+        }
+        src->runs[i].fp = fopen(src->runs[i].path, "rb");
+        src->runs[i].buf = (jh_term_occurrence *)malloc(sizeof(jh_term_occurrence) * src->read_records);
+        if (!src->runs[i].fp || !src->runs[i].buf || jh_run_file_fill(&src->runs[i], src->read_records) != 0) {
+            return -1;
+        }
+    }
+    for (i = k; i > 0; --i) {
+        jh_occ_source_replay(src, k, i - 1);
+    }
+    return 0;
+}
+
+/* jh_occ_source_end_merge releases the inputs of a group merge (their files included) and its tree. */
+static void jh_occ_source_end_merge(jh_occ_source *src) {
+    size_t i;
+    for (i = 0; i < src->run_count; ++i) {
+        jh_run_file_release(&src->runs[i]);
+    }
+    for (i = 0; i < src->partial_count; ++i) {
+        jh_partial_cursor_release(&src->partials[i]);
+    }
+    free(src->tree);
+    src->tree = NULL;
+}
+
+/* jh_occ_source_pop returns the merge input holding the smallest current record, or -1 once every input is drained;
+   the caller copies that record and then calls jh_occ_source_step. */
+static long jh_occ_source_pop(jh_occ_source *src) {
+    size_t w;
+    if (!src->primed && jh_occ_source_start_merge(src) != 0) {
+        src->failed = 1;
+        return -1;
+    }
+    if (!src->tree || src->failed) {
+        return -1;
+    }
+    w = src->tree[0];
+    return jh_occ_source_live(src, w) ? (long)w : -1;
+}
+
+/* jh_occ_source_step advances the input jh_occ_source_pop returned and replays it up the tree. */
+static int jh_occ_source_step(jh_occ_source *src, size_t w) {
+    if (jh_occ_source_advance(src, w) != 0) {
+        src->failed = 1;
+        return 0;
+    }
+    jh_occ_source_replay(src, src->partials ? src->partial_count : src->run_count, w);
+    return 1;
+}
+
+/* jh_occ_source_next_term stores the next rank-keyed record of an in-memory run or a run merge in out and returns 1,
+   or 0 once every run is drained. */
+static int jh_occ_source_next_term(jh_occ_source *src, jh_term_occurrence *out) {
+    long w;
+    if (src->mem) {
+        if (src->mem_pos >= src->mem_count) {
+            return 0;
+        }
+        *out = src->mem[src->mem_pos++];
+        return 1;
+    }
+    w = jh_occ_source_pop(src);
+    if (w < 0) {
+        return 0;
+    }
+    *out = src->runs[w].buf[src->runs[w].pos];
+    return jh_occ_source_step(src, (size_t)w);
+}
+
+/* jh_occ_source_next stores the next record, resolved to its word hash, in out and returns 1, or 0 once the source
+   is drained. */
+static int jh_occ_source_next(jh_occ_source *src, jh_occurrence_record *out) {
+    jh_term_occurrence rec;
+    long w;
+
+    if (src->partials) {
+        w = jh_occ_source_pop(src);
+        if (w < 0) {
+            return 0;
+        }
+        *out = src->partials[w].current;
+        return jh_occ_source_step(src, (size_t)w);
+    }
+    if (src->fp) {
+        if (fread(&rec, sizeof(rec), 1, src->fp) != 1) {
+            return 0;
+        }
+        if (rec.term_id >= src->term_count) {
+            src->failed = 1;
+            return 0;
+        }
+        out->word_hash = src->term_hashes[rec.term_id];
+    } else {
+        if (!jh_occ_source_next_term(src, &rec)) {
+            return 0;
+        }
+        out->word_hash = src->term_hashes[src->id_of[rec.term_id]];
+    }
+    out->page_id = rec.page_id;
+    out->position = rec.position;
+    return 1;
+}
+
+int jh_sort_occurrences(const char *in_path, const char *out_path, const jh_sort_options *opts) {
+    jh_occ_source src;
+    jh_term_occurrence occ;
+    FILE *out_fp;
+    int rc = 0;
+
+    if (!in_path || !out_path) {
+        return -1;
+    }
+    if (jh_occ_source_open_runs(in_path, opts, &src, NULL) != 0) {
+        return -1;
+    }
+    out_fp = fopen(out_path, "wb");
+    if (!out_fp) {
+        jh_occ_source_close(&src);
+        return -1;
+    }
+    while (jh_occ_source_next_term(&src, &occ)) {
+        occ.term_id = src.id_of[occ.term_id];
+        if (fwrite(&occ, sizeof(jh_term_occurrence), 1, out_fp) != 1) {
+            rc = -1;
+            break;
+        }
+    }
+    if (fclose(out_fp) != 0 || src.failed) {
+        rc = -1;
+    }
+    if (rc == 0 && jh_write_term_table(out_path, src.term_hashes, src.term_count) != 0) {
+        rc = -1;
+    }
+    jh_occ_source_close(&src);
+    return rc;
+}
+
+/* jh_postings_writer appends length-prefixed lists to postings.bin and owns the reusable codec state. */
+typedef struct {
+    FILE *fp;
+    jh_u32 flags;
+    jh_u64 offset;
+    jh_u8 *cbuf;
+    size_t ccap;
+    jh_u64 codec_blocks[4];
+    jh_u8 *pack_data;
+    size_t pack_len;
+    size_t pack_cap;
+    jh_postings_block_member *pack_members;
+    jh_u32 pack_count;
+    jh_u32 pack_members_cap;
+    jh_u8 *pack_buf;
+    size_t pack_buf_cap;
+    jh_postings_block_index_entry *blocks;
+    size_t block_count;
+    size_t block_cap;
+#ifdef JH_HAVE_ZSTD
+    ZSTD_CCtx *cctx;
+    ZSTD_CDict *cdict;
+    jh_u8 *dict;
+    jh_u32 dict_size;
+    int dict_done;
+    jh_u8 *samples;
+    size_t samples_len;
+    size_t *sample_sizes;
+    unsigned sample_count;
+#endif
+} jh_postings_writer;
+
+#ifdef JH_HAVE_ZSTD
+/* jh_writer_sample keeps a copy of a small list for dictionary training and trains once the budget is reached. */
+static int jh_writer_sample(jh_postings_writer *w, const jh_u8 *data, size_t len) {
+    size_t dsize;
+
+    if (w->dict_done || len > JH_POSTINGS_DICT_LIST_MAX) {
+        return 0;
+    }
+    if (!w->samples) {
+        w->samples = (jh_u8 *)malloc(JH_POSTINGS_SAMPLE_BYTES);
+        w->sample_sizes = (size_t *)malloc(sizeof(size_t) * JH_POSTINGS_SAMPLE_MAX);
+        if (!w->samples || !w->sample_sizes) {
+            return -1;
+        }
+    }
+    if (w->samples_len + len <= JH_POSTINGS_SAMPLE_BYTES && w->sample_count < JH_POSTINGS_SAMPLE_MAX) {
+        memcpy(w->samples + w->samples_len, data, len);
+        w->samples_len += len;
+        w->sample_sizes[w->sample_count++] = len;
+        if (w->samples_len + JH_POSTINGS_DICT_LIST_MAX <= JH_POSTINGS_SAMPLE_BYTES && w->sample_count < JH_POSTINGS_SAMPLE_MAX) {
+            return 0;
+        }
+    }
+
+    w->dict_done = 1;
+    w->dict = (jh_u8 *)malloc(JH_POSTINGS_DICT_CAP);
+    if (!w->dict) {
+        return -1;
+    }
+    dsize = ZDICT_trainFromBuffer(w->dict, JH_POSTINGS_DICT_CAP, w->samples, w->sample_sizes, w->sample_count);
+    if (!ZDICT_isError(dsize) && dsize > 0) {
+        w->cdict = ZSTD_createCDict(w->dict, dsize, JH_POSTINGS_ZSTD_LEVEL);
+        if (w->cdict) {
+            w->dict_size = (jh_u32)dsize;
+        }
+    }
+    free(w->samples);
+    free(w->sample_sizes);
+    w->samples = NULL;
+    w->sample_sizes = NULL;
+    return 0;
+}
+#endif
+
+/* jh_writer_encode picks a codec by list size and leaves the stored block (codec byte included) in w->cbuf. */
+static int jh_writer_encode(jh_postings_writer *w, const jh_u8 *data, size_t len, size_t *out_size) {
+    size_t out_len = 0;
+    jh_u32 codec = JH_POSTINGS_CODEC_RAW;
+
+    if (!(w->flags & JH_POSTINGS_FLAG_BLOCK_CODEC)) {
+        if (jh_ensure_cap(&w->cbuf, &w->ccap, len) != 0) {
+            return -1;
+        }
+        memcpy(w->cbuf, data, len);
+        *out_size = len;
+        return 0;
+    }
+
+#ifdef JH_HAVE_ZSTD
+    if (jh_writer_sample(w, data, len) != 0) {
+        return -1;
+    }
+#endif
+
+#ifdef JH_POSTINGS_HAVE_CODEC
+    if (len >= JH_POSTINGS_RAW_MAX) {
+#ifdef JH_HAVE_ZSTD
+        size_t bound = ZSTD_compressBound(len);
+        size_t csize;
+        if (jh_ensure_cap(&w->cbuf, &w->ccap, 5 + bound) != 0) {
+            return -1;
+        }
+        if (w->cdict && len <= JH_POSTINGS_DICT_LIST_MAX) {
+            csize = ZSTD_compress_usingCDict(w->cctx, w->cbuf + 5, bound, data, len, w->cdict);
+            codec = JH_POSTINGS_CODEC_ZSTD_DICT;
+        } else {
+            csize = ZSTD_compressCCtx(w->cctx, w->cbuf + 5, bound, data, len, JH_POSTINGS_ZSTD_LEVEL);
+            codec = JH_POSTINGS_CODEC_ZSTD;
+        }
+        if (ZSTD_isError(csize)) {
+            return -1;
+        }
+        out_len = 5 + csize;
+#elif defined(JH_HAVE_LZ4)
+        int bound = LZ4_compressBound((int)len);
+        int csize;
+        if (jh_ensure_cap(&w->cbuf, &w->ccap, 5 + (size_t)bound) != 0) {
+            return -1;
+        }
+        csize = LZ4_compress_default((const char *)data, (char *)w->cbuf + 5, (int)len, bound);
+        if (csize <= 0) {
+            return -1;
+        }
+        codec = JH_POSTINGS_CODEC_LZ4;
+        out_len = 5 + (size_t)csize;
+#endif
+        if (out_len >= len + 1) {
+            codec = JH_POSTINGS_CODEC_RAW;
+        }
+    }
+#endif
+
+    if (codec == JH_POSTINGS_CODEC_RAW) {
+        if (jh_ensure_cap(&w->cbuf, &w->ccap, len + 1) != 0) {
+            return -1;
+        }
+        memcpy(w->cbuf + 1, data, len);
+        out_len = len + 1;
+    } else {
+        jh_write_u32_le(w->cbuf + 1, (jh_u32)len);
+    }
+    w->cbuf[0] = (jh_u8)codec;
+    w->codec_blocks[codec] += 1;
+    *out_size = out_len;
+    return 0;
+}
+
+/* jh_writer_frame encodes a buffer and appends it with its u32 length prefix, reporting the stored size. */
+static int jh_writer_frame(jh_postings_writer *w, const jh_u8 *data, size_t len, size_t *out_size) {
+    jh_u8 len_hdr[4];
+    size_t csize;
+
+    if (jh_writer_encode(w, data, len, &csize) != 0) {
+        return -1;
+    }
+    jh_write_u32_le(len_hdr, (jh_u32)csize);
+    if (fwrite(len_hdr, 1, 4, w->fp) != 4 || fwrite(w->cbuf, 1, csize, w->fp) != csize) {
+        return -1;
+    }
+    w->offset += 4 + (jh_u64)csize;
+    if (out_size) {
+        *out_size = csize;
+    }
+    return 0;
+}
+
+/* jh_writer_flush_pack writes the pending shared block (member table, then lists) and records its index entry. */
+static int jh_writer_flush_pack(jh_postings_writer *w) {
+    jh_postings_block_index_entry *be;
+    size_t table_len;
+    size_t total;
+    size_t csize;
+    jh_u32 i;
+
+    if (w->pack_count == 0) {
+        return 0;
+    }
+    table_len = 4 + (size_t)w->pack_count * sizeof(jh_postings_block_member);
+    total = table_len + w->pack_len;
+    if (jh_ensure_cap(&w->pack_buf, &w->pack_buf_cap, total) != 0) {
+        return -1;
+    }
+    jh_write_u32_le(w->pack_buf, w->pack_count);
+    for (i = 0; i < w->pack_count; i++) {
+        jh_postings_block_member m = w->pack_members[i];
+        m.offset += (jh_u32)table_len;
+        memcpy(w->pack_buf + 4 + (size_t)i * sizeof(m), &m, sizeof(m));
+    }
+    memcpy(w->pack_buf + table_len, w->pack_data, w->pack_len);
+
+    if (w->block_count == w->block_cap) {
+        size_t nc = w->block_cap ? w->block_cap * 2 : 256;
+        jh_postings_block_index_entry *nb = (jh_postings_block_index_entry *)realloc(w->blocks, nc * sizeof(*nb));
+        if (!nb) {
+            return -1;
+        }
+        w->blocks = nb;
+        w->block_cap = nc;
+    }
+    be = &w->blocks[w->block_count++];
+    be->first_word_id = w->pack_members[0].word_id;
+    be->last_word_id = w->pack_members[w->pack_count - 1].word_id;
+    be->uncompressed_size = total;
+    be->compressed_offset = w->offset;
+    if (jh_writer_frame(w, w->pack_buf, total, &csize) != 0) {
+        return -1;
+    }
+    be->compressed_size = csize;
+
+    w->pack_count = 0;
+    w->pack_len = 0;
+    return 0;
+}
+
+/* jh_writer_put stores one word's list, packing small lists into shared blocks and framing the rest on their own.
+   Packing only pays off when the shared block is compressed, so without a codec every list gets its own frame.
+   out_ref receives the words.idx reference of the list: its frame offset or its shared-block member. */
+static int jh_writer_put(jh_postings_writer *w, jh_u32 word_id, const jh_u8 *data, size_t len, jh_u64 *out_ref) {
+    jh_postings_block_member *m;
+
+    if (!(w->flags & JH_POSTINGS_FLAG_BLOCK_CODEC) || len > JH_POSTINGS_PACK_LIST_MAX) {
+        *out_ref = w->offset;
+        return jh_writer_frame(w, data, len, NULL);
+    }
+    if (w->pack_count > 0 &&
+        4 + ((size_t)w->pack_count + 1) * sizeof(jh_postings_block_member) + w->pack_len + len > JH_POSTINGS_PACK_TARGET) {
+        if (jh_writer_flush_pack(w) != 0) {
+            return -1;
+        }
+    }
+    if (w->pack_count == w->pack_members_cap) {
+        jh_u32 nc = w->pack_members_cap ? w->pack_members_cap * 2 : 256;
+        jh_postings_block_member *nm = (jh_postings_block_member *)realloc(w->pack_members, nc * sizeof(*nm));
+        if (!nm) {
+            return -1;
+        }
+        w->pack_members = nm;
+        w->pack_members_cap = nc;
+    }
+    if (jh_ensure_cap(&w->pack_data, &w->pack_cap, w->pack_len + len) != 0 || w->block_count >= JH_POSTINGS_REF_BLOCK_LIMIT) {
+        return -1;
+    }
+    *out_ref = JH_POSTINGS_REF_PACK(w->block_count, w->pack_count);
+    m = &w->pack_members[w->pack_count++];
+    m->word_id = word_id;
+    m->offset = (jh_u32)w->pack_len;
+    m->length = (jh_u32)len;
+    memcpy(w->pack_data + w->pack_len, data, len);
+    w->pack_len += len;
+    return 0;
+}
+
+/* jh_writer_header fills the postings.bin header for the layout this build writes. */
+static void jh_writer_header(const jh_postings_writer *w, jh_postings_file_header *hdr, jh_u64 total_postings) {
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, "PSTB", 4);
+    hdr->version = 1;
+    hdr->flags = w->flags;
+    hdr->total_postings = total_postings;
+    hdr->block_count = w->block_count;
+    hdr->block_index_offset = w->block_count ? w->offset : 0;
+    hdr->blocks_data_offset = (jh_u64)sizeof(jh_postings_file_header);
+#ifdef JH_HAVE_ZSTD
+    hdr->dict_size = w->dict_size;
+#endif
+}
+
+/* jh_writer_open creates postings.bin with a placeholder header ahead of the first list. */
+static int jh_writer_open(jh_postings_writer *w, const char *path) {
+    jh_postings_file_header hdr;
+
+    memset(w, 0, sizeof(*w));
+#ifdef JH_POSTINGS_HAVE_CODEC
+    w->flags = JH_POSTINGS_FLAG_BLOCK_CODEC;
+#endif
+#ifdef JH_HAVE_ZSTD
+    w->cctx = ZSTD_createCCtx();
+    if (!w->cctx) {
+        return -1;
+    }
+#endif
+    w->fp = fopen(path, "wb+");
+    if (!w->fp) {
+        return -1;
+    }
+    jh_writer_header(w, &hdr, 0);
+    if (fwrite(&hdr, 1, sizeof(hdr), w->fp) != sizeof(hdr)) {
+        return -1;
+    }
+    w->offset = hdr.blocks_data_offset;
+    return 0;
+}
+
+/* jh_writer_finish flushes the last shared block, appends the block index and the dictionary, then rewrites the
+   header. A file whose small lists never filled the sample budget has no dictionary and spends no space on one. */
+static int jh_writer_finish(jh_postings_writer *w, jh_u64 total_postings, jh_postings_file_header *out_hdr) {
+    if (jh_writer_flush_pack(w) != 0) {
+        return -1;
+    }
+    if (w->block_count > 0 &&
+        fwrite(w->blocks, sizeof(jh_postings_block_index_entry), w->block_count, w->fp) != w->block_count) {
+        return -1;
+    }
+#ifdef JH_HAVE_ZSTD
+    if (w->dict_size > 0 && fwrite(w->dict, 1, w->dict_size, w->fp) != w->dict_size) {
+        return -1;
+    }
+#endif
+    if (fseek(w->fp, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+    jh_writer_header(w, out_hdr, total_postings);
+    if (fwrite(out_hdr, 1, sizeof(*out_hdr), w->fp) != sizeof(*out_hdr)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int jh_writer_close(jh_postings_writer *w) {
+    int rc = 0;
+#ifdef JH_HAVE_ZSTD
+    ZSTD_freeCDict(w->cdict);
+    ZSTD_freeCCtx(w->cctx);
+    free(w->dict);
+    free(w->samples);
+    free(w->sample_sizes);
+#endif
+    free(w->cbuf);
+    free(w->pack_data);
+    free(w->pack_members);
+    free(w->pack_buf);
+    free(w->blocks);
+    if (w->fp && fclose(w->fp) != 0) {
+        rc = -1;
+    }
+    memset(w, 0, sizeof(*w));
+    return rc;
+}
+
+/* jh_words_writer emits words.idx entries as lists are written, inlining small lists after the entry table. */
+typedef struct {
+    FILE *fp;
+    jh_u64 entry_count;
+    jh_u8 *inline_buf;
+    size_t inline_len;
+    size_t inline_cap;
+} jh_words_writer;
+
+static int jh_words_writer_header(jh_words_writer *ww) {
+    jh_word_dict_header wh;
+    memset(&wh, 0, sizeof(wh));
+    memcpy(wh.magic, "WDIX", 4);
+    wh.version = 2;
+    wh.entry_count = ww->entry_count;
+    return fwrite(&wh, 1, sizeof(wh), ww->fp) == sizeof(wh) ? 0 : -1;
+}
+
+static int jh_words_writer_add(jh_words_writer *ww, jh_u64 word_hash, jh_u64 ref, jh_u64 postings_count, const jh_u8 *data, size_t len) {
+    jh_word_dict_entry e;
+    e.word_hash = word_hash;
+    e.postings_offset = ref;
+    e.postings_count = postings_count;
+    if (len <= JH_WORD_DICT_INLINE_MAX) {
+        if (ww->inline_len + len > ww->inline_cap) {
+            size_t nc = ww->inline_cap ? ww->inline_cap * 2 : 65536;
+            jh_u8 *nb = (jh_u8 *)realloc(ww->inline_buf, nc);
+            if (!nb) {
+                return -1;
+            }
+            ww->inline_buf = nb;
+            ww->inline_cap = nc;
+        }
+        memcpy(ww->inline_buf + ww->inline_len, data, len);
+        e.postings_offset = JH_POSTINGS_REF_INLINE_MAKE(ww->inline_len, len);
+        ww->inline_len += len;
+    }
+    if (fwrite(&e, 1, sizeof(e), ww->fp) != sizeof(e)) {
+        return -1;
+    }
+    ww->entry_count += 1;
+    return 0;
+}
+
+static int jh_words_writer_finish(jh_words_writer *ww) {
+    if (ww->inline_len > 0 && fwrite(ww->inline_buf, 1, ww->inline_len, ww->fp) != ww->inline_len) {
+        return -1;
+    }
+    if (fseek(ww->fp, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+    return jh_words_writer_header(ww);
+}
+
+/* jh_postings_encode_all encodes each word's list as the sorted records arrive and hands it to w and, if set, ww.
+   Lists small enough to inline into words.idx skip postings.bin and take no word id there. */
+static int jh_postings_encode_all(jh_occ_source *src, jh_postings_writer *w, jh_words_writer *ww, jh_u8 **wbuf, size_t *wcap, jh_u64 *out_total, jh_u32 *out_words) {
+    jh_occurrence_record occ;
+    int have_occ;
+    jh_u64 current_word_hash = 0;
+    jh_u64 total_postings = 0;
+    jh_u64 word_postings = 0;
+    size_t wlen = 0;
+    jh_u32 doc_count = 0;
+    jh_u32 last_page_id = 0;
+    jh_u32 term_freq = 0;
+    size_t term_freq_offset = 0;
+    jh_u32 last_position = 0;
+    int have_doc = 0;
+    int have_word = 0;
+    jh_u32 word_id = 0;
+    jh_u32 word_count = 0;
+
+    for (;;) {
+        have_occ = jh_occ_source_next(src, &occ);
+        if (have_word && (!have_occ || occ.word_hash != current_word_hash)) {
+            jh_u64 ref = 0;
+            if (have_doc) {
+                jh_write_u32_le(*wbuf + term_freq_offset, term_freq);
+            }
+            jh_write_u32_le(*wbuf, doc_count);
+            if (wlen > JH_WORD_DICT_INLINE_MAX && jh_writer_put(w, word_id++, *wbuf, wlen, &ref) != 0) {
+                return -1;
+            }
+            word_count += 1;
+            if (ww && jh_words_writer_add(ww, current_word_hash, ref, word_postings, *wbuf, wlen) != 0) {
+                return -1;
+            }
+            have_word = 0;
+        }
+        if (!have_occ) {
+            break;
+        }
+        if (!have_word) {
+            current_word_hash = occ.word_hash;
+            if (jh_ensure_cap(wbuf, wcap, 4) != 0) {
+                return -1;
+            }
+            jh_write_u32_le(*wbuf, 0);
+            wlen = 4;
+            doc_count = 0;
+            last_page_id = 0;
+            word_postings = 0;
+            have_doc = 0;
+            have_word = 1;
+        }
+        if (!have_doc || occ.page_id != last_page_id) {
+            if (have_doc) {
+                jh_write_u32_le(*wbuf + term_freq_offset, term_freq);
+            }
+            if (jh_ensure_cap(wbuf, wcap, wlen + 8) != 0) {
+                return -1;
+            }
+            doc_count += 1;
+            jh_write_u32_le(*wbuf + wlen, occ.page_id - last_page_id);
+            wlen += 4;
+            term_freq_offset = wlen;
+            jh_write_u32_le(*wbuf + wlen, 0);
+            wlen += 4;
+            term_freq = 0;
+            last_position = 0;
+            have_doc = 1;
+            last_page_id = occ.page_id;
+        }
+        if (jh_ensure_cap(wbuf, wcap, wlen + 4) != 0) {
+            return -1;
+        }
+        jh_write_u32_le(*wbuf + wlen, occ.position - last_position);
+        wlen += 4;
+        last_position = occ.position;
+        term_freq += 1;
+        word_postings += 1;
+        total_postings += 1;
+    }
+    *out_total = total_postings;
+    *out_words = word_count;
+    return 0;
+}
+
+/* jh_postings_from_source writes postings.bin, and words.idx when words_path is set, from a sorted record source. */
+static int jh_postings_from_source(jh_occ_source *src, const char *postings_path, const char *words_path, jh_build_index_stats *stats) {
+    jh_postings_writer w;
+    jh_words_writer ww;
+    jh_postings_file_header hdr;
+    jh_u8 *wbuf = NULL;
+    size_t wcap = 0;
+    jh_u64 total_postings = 0;
+    jh_u32 word_count = 0;
+    int rc = -1;
+
+    memset(&w, 0, sizeof(w));
+    memset(&ww, 0, sizeof(ww));
+    if (words_path) {
+        ww.fp = fopen(words_path, "wb+");
+    }
+    if ((!words_path || (ww.fp && jh_words_writer_header(&ww) == 0)) &&
+        jh_writer_open(&w, postings_path) == 0 &&
+        jh_postings_encode_all(src, &w, ww.fp ? &ww : NULL, &wbuf, &wcap, &total_postings, &word_count) == 0 &&
+        jh_writer_finish(&w, total_postings, &hdr) == 0 &&
+        (!ww.fp || jh_words_writer_finish(&ww) == 0)) {
+        rc = 0;
+        if (stats) {
+            memset(stats, 0, sizeof(*stats));
+            stats->word_count = word_count;
+            stats->total_postings = total_postings;
+            stats->shared_blocks = w.block_count;
+            memcpy(stats->codec_blocks, w.codec_blocks, sizeof(stats->codec_blocks));
+            stats->postings_flags = w.flags;
+            stats->dict_size = hdr.dict_size;
+        }
+    }
+    free(wbuf);
+    free(ww.inline_buf);
+    if (ww.fp && fclose(ww.fp) != 0) {
+        rc = -1;
+    }
+    if (jh_writer_close(&w) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+int jh_build_postings(const char *sorted_occ_path, const char *postings_path, const char *words_path, jh_build_index_stats *stats) {
+    jh_occ_source src;
+    int rc;
+
+    if (!sorted_occ_path || !postings_path) {
+        return -1;
+    }
+    memset(&src, 0, sizeof(src));
+    if (jh_read_term_table(sorted_occ_path, &src.term_hashes, &src.term_count) != 0) {
+        return -1;
+    }
+    src.fp = fopen(sorted_occ_path, "rb");
+    if (!src.fp) {
+        jh_occ_source_close(&src);
+        return -1;
+    }
+    rc = jh_postings_from_source(&src, postings_path, words_path, stats);
+    if (src.failed) {
+        rc = -1;
+    }
+    jh_occ_source_close(&src);
+    return rc;
+}
+
+int jh_index_paths_for(const char *occ_path, char *postings_path, char *words_path, size_t cap) {
+    const char *base;
+    const char *ext;
+    int dir_len;
+    int suffix_len;
+    int n;
+
+    if (!occ_path || !postings_path || !words_path) {
+        return -1;
+    }
+    base = strrchr(occ_path, '/');
+    base = base ? base + 1 : occ_path;
+    if (strncmp(base, "occurrences", 11) != 0) {
+        return -1;
+    }
+    ext = strrchr(base, '.');
+    dir_len = (int)(base - occ_path);
+    suffix_len = (int)((ext ? ext : base + strlen(base)) - (base + 11));
+    n = snprintf(postings_path, cap, "%.*spostings%.*s.bin", dir_len, occ_path, suffix_len, base + 11);
+    if (n < 0 || (size_t)n >= cap) {
+        return -1;
+    }
+    n = snprintf(words_path, cap, "%.*swords%.*s.idx", dir_len, occ_path, suffix_len, base + 11);
+    return n < 0 || (size_t)n >= cap ? -1 : 0;
+}
+
+int jh_build_index(const char *occ_path, const char *postings_path, const char *words_path, const jh_sort_options *opts, jh_build_index_stats *stats) {
+    jh_occ_source src;
+    jh_u64 run_count = 0;
+    int rc;
+
+    if (!occ_path || !postings_path || !words_path) {
+        return -1;
+    }
+    if (jh_occ_source_open_runs(occ_path, opts, &src, &run_count) != 0) {
+        return -1;
+    }
+    rc = jh_postings_from_source(&src, postings_path, words_path, stats);
+    if (src.failed) {
+        rc = -1;
+    }
+    jh_occ_source_close(&src);
+    if (rc == 0 && stats) {
+        stats->run_count = run_count;
+    }
+    return rc;
+}
+
+/* jh_inverter_part_reset drops a part's terms and leaves it with an empty table of JH_INVERT_MIN_TERMS slots;
+   bytes counts only what the part grows beyond that table. */
+static int jh_inverter_part_reset(jh_inverter_part *part) {
+    size_t i;
+    for (i = 0; i < part->term_cap; ++i) {
+        free(part->terms[i].data);
+    }
+    free(part->terms);
+    part->terms = (jh_inverter_term *)calloc(JH_INVERT_MIN_TERMS, sizeof(jh_inverter_term));
+    part->term_cap = part->terms ? JH_INVERT_MIN_TERMS : 0;
+    part->term_count = 0;
+    part->bytes = 0;
+    return part->terms ? 0 : -1;
+}
+
+static int jh_inverter_term_cmp(const void *a, const void *b) {
+    const jh_inverter_term *ta = *(const jh_inverter_term *const *)a;
+    const jh_inverter_term *tb = *(const jh_inverter_term *const *)b;
+    if (ta->word_hash != tb->word_hash) {
+        return ta->word_hash < tb->word_hash ? -1 : 1;
+    }
+    return 0;
+}
+
+/* jh_inverter_part_sorted returns the part's live terms ordered by word_hash. */
+static jh_inverter_term **jh_inverter_part_sorted(const jh_inverter_part *part) {
+    jh_inverter_term **order;
+    size_t n = 0;
+    size_t i;
+
+    order = (jh_inverter_term **)malloc(sizeof(jh_inverter_term *) * (part->term_count ? part->term_count : 1));
+    if (!order) {
+        return NULL;
+    }
+    for (i = 0; i < part->term_cap; ++i) {
+        if (part->terms[i].count > 0) {
+            order[n++] = &part->terms[i];
+        }
+    }
+    qsort(order, n, sizeof(jh_inverter_term *), jh_inverter_term_cmp);
+    return order;
+}
+
+/* jh_inverter_spill writes a part's terms as a sorted partial index file and empties the part. */
+static int jh_inverter_spill(jh_inverter *inv, unsigned int part_id) {
+    jh_inverter_part *part = &inv->parts[part_id];
+    jh_inverter_term **order;
+    char path[256];
+    FILE *fp;
+    size_t i;
+    int rc = 0;
+
+    if (part->spill_count == part->spill_cap) {
+        size_t nc = part->spill_cap ? part->spill_cap * 2 : 8;
+        char **np = (char **)realloc(part->spill_paths, sizeof(char *) * nc);
+        if (!np) {
+            return -1;
+        }
+        part->spill_paths = np;
+        part->spill_cap = nc;
+    }
+    snprintf(path, sizeof(path), "%s_%u_%06zu.tmp", inv->tmp_prefix, part_id, part->spill_count);
+    order = jh_inverter_part_sorted(part);
+    if (!order) {
+        return -1;
+    }
+    fp = fopen(path, "wb");
+    if (!fp) {
+        free(order);
+        return -1;
+    }
+    part->spill_paths[part->spill_count] = (char *)malloc(strlen(path) + 1);
+    if (!part->spill_paths[part->spill_count]) {
+        fclose(fp);
+        remove(path);
+        free(order);
+        return -1;
+    }
+    strcpy(part->spill_paths[part->spill_count], path);
+    part->spill_count += 1;
+    for (i = 0; i < part->term_count && rc == 0; ++i) {
+        jh_partial_header ph;
+        ph.word_hash = order[i]->word_hash;
+        ph.count = order[i]->count;
+        ph.length = order[i]->len;
+        if (fwrite(&ph, sizeof(ph), 1, fp) != 1 || fwrite(order[i]->data, 1, ph.length, fp) != ph.length) {
+            rc = -1;
+        }
+    }
+    if (fclose(fp) != 0) {
+        rc = -1;
+    }
+    free(order);
+    if (rc == 0) {
+        rc = jh_inverter_part_reset(part);
+    }
+    return rc;
+}
+
+int jh_inverter_init(jh_inverter *inv, unsigned int part_count, size_t budget_bytes, const char *tmp_prefix) {
+    unsigned int i;
+
+    if (!inv || part_count == 0 || !tmp_prefix) {
+        return -1;
+    }
+    memset(inv, 0, sizeof(*inv));
+    inv->parts = (jh_inverter_part *)calloc(part_count, sizeof(jh_inverter_part));
+    if (!inv->parts) {
+        return -1;
+    }
+    inv->part_count = part_count;
+    inv->part_budget = budget_bytes / part_count;
+    if (inv->part_budget < (size_t)JH_INVERT_MIN_PART_TABLES * JH_INVERT_MIN_TERMS * sizeof(jh_inverter_term)) {
+        inv->part_budget = (size_t)JH_INVERT_MIN_PART_TABLES * JH_INVERT_MIN_TERMS * sizeof(jh_inverter_term);
+    }
+    inv->tmp_prefix = tmp_prefix;
+    for (i = 0; i < part_count; ++i) {
+        if (jh_inverter_part_reset(&inv->parts[i]) != 0) {
+            jh_inverter_free(inv);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* jh_inverter_grow doubles a part's term table once it is half full. */
+static int jh_inverter_grow(jh_inverter_part *part) {
+    size_t nc = part->term_cap * 2;
+    jh_inverter_term *nt = (jh_inverter_term *)calloc(nc, sizeof(jh_inverter_term));
+    size_t i;
+
+    if (!nt) {
+        return -1;
+    }
+    for (i = 0; i < part->term_cap; ++i) {
+        size_t j;
+        if (part->terms[i].count == 0) {
+            continue;
+        }
+        j = (size_t)part->terms[i].word_hash & (nc - 1);
+        while (nt[j].count != 0) {
+            j = (j + 1) & (nc - 1);
+        }
+        nt[j] = part->terms[i];
+    }
+    free(part->terms);
+    part->bytes += (nc - part->term_cap) * sizeof(jh_inverter_term);
+    part->terms = nt;
+    part->term_cap = nc;
+    return 0;
+}
+
+int jh_inverter_add(jh_inverter *inv, unsigned int part_id, jh_u64 word_hash, jh_u32 page_id, jh_u32 position) {
+    jh_inverter_part *part;
+    jh_inverter_term *t;
+    jh_u32 gap;
+    size_t j;
+
+    if (!inv || part_id >= inv->part_count) {
+        return -1;
+    }
+    part = &inv->parts[part_id];
+    if ((part->term_count + 1) * 2 > part->term_cap && jh_inverter_grow(part) != 0) {
+        return -1;
+    }
+    j = (size_t)word_hash & (part->term_cap - 1);
+    while (part->terms[j].count != 0 && part->terms[j].word_hash != word_hash) {
+        j = (j + 1) & (part->term_cap - 1);
+    }
+    t = &part->terms[j];
+    if (t->count == 0) {
+        t->word_hash = word_hash;
+        part->term_count += 1;
+    } else if (page_id < t->last_page || (page_id == t->last_page && position < t->last_position)) {
+        return -1;
+    }
+    if (t->len + 10 > t->cap) {
+        jh_u32 nc = t->cap ? t->cap * 2 : JH_INVERT_LIST_MIN;
+        jh_u8 *nd = (jh_u8 *)realloc(t->data, nc);
+        if (!nd) {
+            return -1;
+        }
+        part->bytes += nc - t->cap;
+        t->data = nd;
+        t->cap = nc;
+    }
+    gap = page_id - t->last_page;
+    t->len += (jh_u32)jh_varint_put(t->data + t->len, gap);
+    t->len += (jh_u32)jh_varint_put(t->data + t->len, gap != 0 ? position : position - t->last_position);
+    t->count += 1;
+    t->last_page = page_id;
+    t->last_position = position;
+    if (part->bytes > inv->part_budget) {
+        return jh_inverter_spill(inv, part_id);
+    }
+    return 0;
+}
+
+int jh_inverter_finish(jh_inverter *inv, const char *postings_path, const char *words_path, jh_build_index_stats *stats) {
+    jh_occ_source src;
+    jh_sort_options opts;
+    jh_sort_plan plan;
+    size_t mem_count = 0;
+    size_t cap = 1;
+    size_t total;
+    unsigned int i;
+    size_t k;
+    int rc = 0;
+
+    if (!inv || !postings_path || !words_path) {
+        return -1;
+    }
+    memset(&opts, 0, sizeof(opts));
+    opts.memory_bytes = inv->part_budget * inv->part_count;
+    opts.fan_in = inv->fan_in;
+    jh_sort_resolve(&opts, &plan);
+    for (i = 0; i < inv->part_count; ++i) {
+        mem_count += inv->parts[i].term_count > 0;
+    }
+    /* Parts still in memory join the final merge directly unless they alone would exceed the fan-in. */
+    if (mem_count >= plan.fan_in) {
+        for (i = 0; i < inv->part_count; ++i) {
+            if (inv->parts[i].term_count > 0 && jh_inverter_spill(inv, i) != 0) {
+                return -1;
+            }
+        }
+        mem_count = 0;
+    }
+    for (i = 0; i < inv->part_count; ++i) {
+        cap += inv->parts[i].spill_count + 1;
+    }
+    memset(&src, 0, sizeof(src));
+    src.partials = (jh_partial_cursor *)calloc(cap, sizeof(jh_partial_cursor));
+    if (!src.partials) {
+        return -1;
+    }
+    src.partial_prefix = inv->tmp_prefix;
+    src.read_records = plan.read_records;
+    /* The spilled files now belong to src, which removes them as they are merged or closed. */
+    for (i = 0; i < inv->part_count; ++i) {
+        jh_inverter_part *part = &inv->parts[i];
+        for (k = 0; k < part->spill_count; ++k) {
+            src.partials[src.partial_count++].path = part->spill_paths[k];
+        }
+        part->spill_count = 0;
+    }
+    total = src.partial_count + mem_count;
+    rc = jh_occ_source_reduce(&src, plan.fan_in - mem_count, &plan);
+    for (i = 0; i < inv->part_count && rc == 0; ++i) {
+        jh_inverter_part *part = &inv->parts[i];
+        if (part->term_count > 0) {
+            jh_partial_cursor *c = &src.partials[src.partial_count++];
+            c->terms = jh_inverter_part_sorted(part);
+            c->term_count = part->term_count;
+            if (!c->terms) {
+                rc = -1;
+            }
+        }
+    }
+    if (rc == 0) {
+        rc = jh_postings_from_source(&src, postings_path, words_path, stats);
+    }
+    if (rc == 0 && src.failed) {
+        rc = -1;
+    }
+    if (rc == 0 && stats) {
+        stats->run_count = total;
+    }
+    jh_occ_source_close(&src);
+    return rc;
+}
+
+void jh_inverter_abort(jh_inverter *inv) {
+    unsigned int i;
+    size_t k;
+
+    if (!inv || !inv->parts) {
+        return;
+    }
+    for (i = 0; i < inv->part_count; ++i) {
+        for (k = 0; k < inv->parts[i].spill_count; ++k) {
+            remove(inv->parts[i].spill_paths[k]);
+        }
+    }
+}
+
+void jh_inverter_free(jh_inverter *inv) {
+    unsigned int i;
+    size_t k;
+
+    if (!inv) {
+        return;
+    }
+    for (i = 0; i < inv->part_count; ++i) {
+        jh_inverter_part *part = &inv->parts[i];
+        for (k = 0; k < part->term_cap; ++k) {
+            free(part->terms[k].data);
+        }
+        free(part->terms);
+        for (k = 0; k < part->spill_count; ++k) {
+            remove(part->spill_paths[k]);
+            free(part->spill_paths[k]);
+        }
+        free(part->spill_paths);
+    }
+    free(inv->parts);
+    memset(inv, 0, sizeof(*inv));
+}
@@ -1,5 +1,7 @@
+#include "jamharah/build_index.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 static void jh_die_pipeline(const char *msg, int rc) {
@@ -27,26 +29,46 @@ static double jh_run_cmd(const char *cmd, const char *label) {
     return end - start;
 }
 
+/* jh_run_index builds postings and words.idx from an unsorted occurrences file in-process. */
+static double jh_run_index(const char *occ_path, const char *postings_path, const char *words_path, const char *label) {
+    jh_build_index_stats stats;
+    jh_sort_options opts;
+    double start = jh_wall_seconds();
+    double end;
+    jh_sort_options_from_env(&opts);
+    if (jh_build_index(occ_path, postings_path, words_path, &opts, &stats) != 0) {
+        jh_die_pipeline(label, -1);
+    }
+    end = jh_wall_seconds();
+    printf("[indexer] %s completed in %.3f s (runs=%llu words=%llu postings=%llu)\n", label, end - start,
+           (unsigned long long)stats.run_count, (unsigned long long)stats.word_count, (unsigned long long)stats.total_postings);
+    return end - start;
+}
+
 int main(int argc, char **argv) {
     const char *books_dir = "../../books";
     char cmd[512];
     double t_build_from_sqlite;
     double t_build_occurrences;
-    double t_sort_occurrences;
-    double t_build_postings;
-    double t_build_words_index;
+    double t_build_bigrams;
     double total;
+    int stem = 0;
 
+    if (argc > 1 && strcmp(argv[1], "--stem") == 0) {
+        stem = 1;
+        argv++;
+        argc--;
+    }
     if (argc > 1) {
         books_dir = argv[1];
     }
     snprintf(cmd, sizeof(cmd), "./build_from_sqlite %s", books_dir);
     t_build_from_sqlite = jh_run_cmd(cmd, "build_from_sqlite");
-    t_build_occurrences = jh_run_cmd("./build_occurrences", "build_occurrences");
-    t_sort_occurrences = jh_run_cmd("./sort_occurrences", "sort_occurrences");
-    t_build_postings = jh_run_cmd("./build_postings", "build_postings");
-    t_build_words_index = jh_run_cmd("./build_words_index", "build_words_index");
-    total = t_build_from_sqlite + t_build_occurrences + t_sort_occurrences + t_build_postings + t_build_words_index;
+    /* --invert builds postings.bin and words.idx (and the stem pair) in the tokenizing pass itself. */
+    t_build_occurrences = jh_run_cmd(stem ? "./build_occurrences --invert --stem" : "./build_occurrences --invert", "build_occurrences");
+    t_build_bigrams = jh_run_cmd("./build_bigrams", "build_bigrams");
+    t_build_bigrams += jh_run_index("bigram_occurrences.tmp", "postings_bigram.bin", "words_bigram.idx", "build_index (bigrams)");
+    total = t_build_from_sqlite + t_build_occurrences + t_build_bigrams;
     printf("[indexer] total time %.3f s\n", total);
     return 0;
 }
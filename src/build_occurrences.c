@@ -1,34 +1,163 @@
 #include "jamharah/index_format.h"
+#include "jamharah/build_index.h"
 #include "jamharah/tokenize_arabic.h"
 #include "jamharah/hash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <unistd.h>
 
+/* Pages are scheduled in chunks of about total bytes / (threads * JH_OCC_CHUNKS_PER_THREAD), clamped to these bounds. */
+#define JH_OCC_CHUNKS_PER_THREAD 16
+#define JH_OCC_CHUNK_MIN_BYTES (64u * 1024)
+#define JH_OCC_CHUNK_MAX_BYTES (4u * 1024 * 1024)
+/* Workers stay at most this many chunks per thread ahead of the oldest uncommitted chunk. */
+#define JH_OCC_WINDOW_PER_THREAD 4
+/* Each worker interns its vocab words in arena chunks of this many bytes. */
+#define JH_WORD_CHUNK_BYTES (1u << 20)
+/* With --invert, the in-memory postings of all workers share this budget (JH_INVERT_MB overrides it). */
+#define JH_INVERT_DEFAULT_MB 256
+
+/* The vocab is split into shards by the top hash bits; a shard doubles once more than half its slots are used. */
+#define JH_VOCAB_SHARD_BITS 8
+#define JH_VOCAB_SHARDS (1u << JH_VOCAB_SHARD_BITS)
+#define JH_VOCAB_SHARD_MIN_SLOTS 256
+/* Distinct terms are estimated with Heaps' law as K * sqrt(tokens), with tokens taken as page bytes / JH_VOCAB_BYTES_PER_TOKEN. */
+#define JH_VOCAB_HEAPS_K 100
+#define JH_VOCAB_BYTES_PER_TOKEN 10
+
+/* Lock-free lookups probe at most this many slots before falling back to the shard mutex. */
+#define JH_VOCAB_MAX_PROBE 32
+/* A shard keeps the arrays it outgrew until the end so lock-free readers never touch freed memory. */
+#define JH_VOCAB_MAX_GROWS 48
+
+/* Vocab slot states: an empty slot is filled under the shard mutex and then published as ready. */
+#define JH_VOCAB_EMPTY 0u
+#define JH_VOCAB_READY 2u
+
 typedef struct {
+    _Atomic jh_u32 state;
+    jh_u32 word_length;
     jh_u64 hash1;
     jh_u64 hash2;
-    int used;
+    const char *word;
 } jh_vocab_entry;
 
+/* jh_vocab_shard is an open-addressing sub-table. Lookups read it without locking and validate slots and cap against
+   gen, which is odd while a resize swaps them; new terms and resizes take mutex. */
+typedef struct {
+    _Atomic jh_u64 gen;
+    _Atomic(jh_vocab_entry *) slots;
+    _Atomic size_t cap;
+    pthread_mutex_t mutex;
+    size_t count;
+    unsigned int grows;
+    jh_vocab_entry *retired[JH_VOCAB_MAX_GROWS];
+} jh_vocab_shard;
+
+typedef struct {
+    jh_vocab_shard shards[JH_VOCAB_SHARDS];
+} jh_vocab;
+
+/* jh_word_chunk is one block of a worker's term arena; chunks never move, so vocab entries point into them. */
+typedef struct jh_word_chunk {
+    struct jh_word_chunk *next;
+    size_t len;
+    size_t cap;
+    char data[];
+} jh_word_chunk;
+
+/* jh_word_arena holds the bytes of the distinct terms one worker inserted, referenced from the vocab for words.lex. */
+typedef struct {
+    jh_word_chunk *head;
+} jh_word_arena;
+
+/* jh_term_ids numbers word hashes densely in first-seen order; slots holds id + 1 by hash, 0 marking a free slot. */
+typedef struct {
+    jh_u64 *hashes;
+    jh_u32 count;
+    jh_u32 hashes_cap;
+    jh_u32 *slots;
+    size_t slot_cap;
+} jh_term_ids;
+
+/* jh_occ_buffer collects the occurrence records of one chunk until it is committed; their term ids are local to
+   the chunk and are renumbered into the file's term table on commit. */
+typedef struct {
+    jh_term_occurrence *recs;
+    size_t count;
+    size_t cap;
+    jh_term_ids terms;
+} jh_occ_buffer;
+
+/* jh_offsets_buf collects one chunk's varint-coded token spans; page_end[k] is len after its k-th page. */
+typedef struct {
+    jh_u8 *data;
+    size_t len;
+    size_t cap;
+    jh_u64 *page_end;
+} jh_offsets_buf;
+
+/* jh_occ_chunk is a run of consecutive pages tokenized by one worker and committed in sequence order. */
+typedef struct {
+    jh_u32 start_page;
+    jh_u32 end_page;
+    int done;
+    jh_occ_buffer occ;
+    jh_occ_buffer stem_occ;
+    jh_offsets_buf offsets;
+} jh_occ_chunk;
+
+/* jh_offsets_writer streams offsets.bin: span data is appended as chunks commit and the page_id-indexed table of
+   start offsets follows it at the end. */
+typedef struct {
+    FILE *fp;
+    jh_u64 *table;
+    jh_u64 base;
+    jh_u32 page_count;
+} jh_offsets_writer;
+
+/* jh_occ_queue hands out chunks in order and writes finished ones to the occurrence files and offsets.bin in the
+   same order. */
+typedef struct {
+    jh_occ_chunk *chunks;
+    size_t chunk_count;
+    size_t next;
+    size_t committed;
+    size_t window;
+    FILE *out_fp;
+    FILE *stem_fp;
+    const jh_page_index_entry *pages;
+    jh_offsets_writer offsets;
+    jh_term_ids terms;
+    jh_term_ids stem_terms;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} jh_occ_queue;
+
 typedef struct {
     const jh_books_file_header *books_hdr;
-    const jh_block_index_entry *blocks;
-    const jh_pages_index_header *pages_hdr;
     const jh_page_index_entry *pages;
     const char *books_path;
-    FILE *out_fp;
-    pthread_mutex_t *out_mutex;
-    jh_vocab_entry *vocab;
-    size_t vocab_cap;
-    pthread_mutex_t *vocab_mutex;
-    jh_u32 start_page;
-    jh_u32 end_page;
+    int stem;
+    jh_occ_queue *queue;
+    jh_inverter *inv;
+    jh_inverter *stem_inv;
+    unsigned int part;
+    jh_vocab *vocab;
+    jh_word_arena words;
 } jh_occ_worker_ctx;
 
+/* With --invert, the inverters whose spilled partial indexes jh_die_occ removes before exiting. */
+static jh_inverter *jh_occ_inverters[2];
+
 static void jh_die_occ(const char *msg) {
+    unsigned int i;
+    for (i = 0; i < 2; ++i) {
+        jh_inverter_abort(jh_occ_inverters[i]);
+    }
     fprintf(stderr, "[build_occurrences] %s\n", msg);
     fflush(stderr);
     exit(1);
@@ -72,156 +201,776 @@ static unsigned int jh_detect_thread_count(jh_u32 page_count) {
     return tc;
 }
 
+/* jh_offsets_put appends v to b as a LEB128 varint. */
+static void jh_offsets_put(jh_offsets_buf *b, jh_u32 v) {
+    if (b->len + 5 > b->cap) {
+        size_t nc = b->cap ? b->cap * 2 : (1u << 16);
+        jh_u8 *nd = (jh_u8 *)realloc(b->data, nc);
+        if (!nd) {
+            jh_die_occ("alloc offsets buffer failed");
+        }
+        b->data = nd;
+        b->cap = nc;
+    }
+    while (v >= 0x80) {
+        b->data[b->len++] = (jh_u8)(v | 0x80);
+        v >>= 7;
+    }
+    b->data[b->len++] = (jh_u8)v;
+}
+
+/* jh_word_arena_put copies a term into the arena and returns its stable address. */
+static const char *jh_word_arena_put(jh_word_arena *a, const char *word, size_t len) {
+    jh_word_chunk *c = a->head;
+    char *dst;
+    if (!c || c->len + len > c->cap) {
+        size_t cap = len > JH_WORD_CHUNK_BYTES ? len : JH_WORD_CHUNK_BYTES;
+        c = (jh_word_chunk *)malloc(sizeof(jh_word_chunk) + cap);
+        if (!c) {
+            jh_die_occ("alloc word arena failed");
+        }
+        c->next = a->head;
+        c->len = 0;
+        c->cap = cap;
+        a->head = c;
+    }
+    dst = c->data + c->len;
+    memcpy(dst, word, len);
+    c->len += len;
+    return dst;
+}
+
+static void jh_word_arena_free(jh_word_arena *a) {
+    while (a->head) {
+        jh_word_chunk *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/* jh_vocab_init sizes every shard for twice the estimated distinct terms of total_bytes of page text. */
+static void jh_vocab_init(jh_vocab *v, jh_u64 total_bytes) {
+    jh_u64 tokens = total_bytes / JH_VOCAB_BYTES_PER_TOKEN;
+    jh_u64 root = 0;
+    jh_u64 estimate;
+    size_t shard_cap = JH_VOCAB_SHARD_MIN_SLOTS;
+    unsigned int i;
+    while ((root + 1) * (root + 1) <= tokens) {
+        root++;
+    }
+    estimate = JH_VOCAB_HEAPS_K * root;
+    while ((jh_u64)shard_cap * JH_VOCAB_SHARDS < estimate * 2) {
+        shard_cap *= 2;
+    }
+    for (i = 0; i < JH_VOCAB_SHARDS; ++i) {
+        jh_vocab_shard *sh = &v->shards[i];
+        jh_vocab_entry *slots;
+        memset(sh, 0, sizeof(*sh));
+        if (pthread_mutex_init(&sh->mutex, NULL) != 0) {
+            jh_die_occ("init vocab shard mutex failed");
+        }
+        slots = (jh_vocab_entry *)calloc(shard_cap, sizeof(jh_vocab_entry));
+        if (!slots) {
+            jh_die_occ("alloc vocab failed");
+        }
+        atomic_init(&sh->gen, 0);
+        atomic_init(&sh->slots, slots);
+        atomic_init(&sh->cap, shard_cap);
+    }
+}
+
+static void jh_vocab_free(jh_vocab *v) {
+    unsigned int i;
+    unsigned int g;
+    for (i = 0; i < JH_VOCAB_SHARDS; ++i) {
+        jh_vocab_shard *sh = &v->shards[i];
+        free(atomic_load_explicit(&sh->slots, memory_order_relaxed));
+        for (g = 0; g < sh->grows; ++g) {
+            free(sh->retired[g]);
+        }
+        pthread_mutex_destroy(&sh->mutex);
+    }
+}
+
+/* jh_vocab_shard_grow doubles a shard's table; the caller holds the shard mutex. */
+static void jh_vocab_shard_grow(jh_vocab_shard *sh) {
+    jh_vocab_entry *old = atomic_load_explicit(&sh->slots, memory_order_relaxed);
+    size_t cap = atomic_load_explicit(&sh->cap, memory_order_relaxed);
+    jh_u64 gen = atomic_load_explicit(&sh->gen, memory_order_relaxed);
+    jh_vocab_entry *slots;
+    size_t nc = cap * 2;
+    size_t i;
+    if (sh->grows == JH_VOCAB_MAX_GROWS) {
+        jh_die_occ("vocab shard grew too often");
+    }
+    slots = (jh_vocab_entry *)calloc(nc, sizeof(jh_vocab_entry));
+    if (!slots) {
+        jh_die_occ("grow vocab shard failed");
+    }
+    for (i = 0; i < cap; ++i) {
+        const jh_vocab_entry *ve = &old[i];
+        size_t j;
+        if (atomic_load_explicit(&ve->state, memory_order_relaxed) != JH_VOCAB_READY) {
+            continue;
+        }
+        j = (size_t)(ve->hash1 & (jh_u64)(nc - 1));
+        while (atomic_load_explicit(&slots[j].state, memory_order_relaxed) != JH_VOCAB_EMPTY) {
+            j = (j + 1) & (nc - 1);
+        }
+        slots[j].word_length = ve->word_length;
+        slots[j].hash1 = ve->hash1;
+        slots[j].hash2 = ve->hash2;
+        slots[j].word = ve->word;
+        atomic_store_explicit(&slots[j].state, JH_VOCAB_READY, memory_order_relaxed);
+    }
+    atomic_store_explicit(&sh->gen, gen + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&sh->slots, slots, memory_order_relaxed);
+    atomic_store_explicit(&sh->cap, nc, memory_order_relaxed);
+    atomic_store_explicit(&sh->gen, gen + 2, memory_order_release);
+    sh->retired[sh->grows++] = old;
+}
+
+/* jh_vocab_probe looks h1 up in slots, returning 1 when present, 0 at an empty slot, and -1 once limit slots were
+   probed without reaching either. */
+static int jh_vocab_probe(const jh_vocab_entry *slots, size_t cap, jh_u64 h1, jh_u64 h2, size_t limit, size_t *out_idx) {
+    size_t idx = (size_t)(h1 & (jh_u64)(cap - 1));
+    size_t n;
+    for (n = 0; n < limit; ++n) {
+        const jh_vocab_entry *ve = &slots[idx];
+        if (atomic_load_explicit(&ve->state, memory_order_acquire) != JH_VOCAB_READY) {
+            *out_idx = idx;
+            return 0;
+        }
+        if (ve->hash1 == h1) {
+            if (ve->hash2 != h2) {
+                jh_die_occ("hash collision detected");
+            }
+            *out_idx = idx;
+            return 1;
+        }
+        idx = (idx + 1) & (cap - 1);
+    }
+    return -1;
+}
+
+/* jh_vocab_insert records a term in its shard. Known terms are found without any shared write; a miss, a long probe
+   or a concurrent resize retries under the shard mutex, which grows the shard when it is over half full or the probe
+   ran past JH_VOCAB_MAX_PROBE. */
+static void jh_vocab_insert(jh_occ_worker_ctx *ctx, const char *word, size_t len, jh_u64 h1, jh_u64 h2) {
+    jh_vocab_shard *sh = &ctx->vocab->shards[h1 >> (64 - JH_VOCAB_SHARD_BITS)];
+    jh_u64 gen = atomic_load_explicit(&sh->gen, memory_order_acquire);
+    jh_vocab_entry *slots;
+    size_t cap;
+    size_t idx;
+    int found;
+
+    if ((gen & 1) == 0) {
+        slots = atomic_load_explicit(&sh->slots, memory_order_relaxed);
+        cap = atomic_load_explicit(&sh->cap, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sh->gen, memory_order_relaxed) == gen &&
+            jh_vocab_probe(slots, cap, h1, h2, JH_VOCAB_MAX_PROBE, &idx) == 1) {
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&sh->mutex);
+    for (;;) {
+        slots = atomic_load_explicit(&sh->slots, memory_order_relaxed);
+        cap = atomic_load_explicit(&sh->cap, memory_order_relaxed);
+        found = jh_vocab_probe(slots, cap, h1, h2, JH_VOCAB_MAX_PROBE, &idx);
+        if (found >= 0) {
+            break;
+        }
+        jh_vocab_shard_grow(sh);
+    }
+    if (found == 0) {
+        jh_vocab_entry *ve = &slots[idx];
+        ve->hash1 = h1;
+        ve->hash2 = h2;
+        ve->word = jh_word_arena_put(&ctx->words, word, len);
+        ve->word_length = (jh_u32)len;
+        atomic_store_explicit(&ve->state, JH_VOCAB_READY, memory_order_release);
+        sh->count += 1;
+        if (sh->count * 2 > cap) {
+            jh_vocab_shard_grow(sh);
+        }
+    }
+    pthread_mutex_unlock(&sh->mutex);
+}
+
+/* jh_vocab_report prints the vocab size, overall and worst shard load factors, and how many shards grew. */
+static void jh_vocab_report(const jh_vocab *v) {
+    jh_u64 terms = 0;
+    jh_u64 slots = 0;
+    jh_u64 grows = 0;
+    double max_load = 0.0;
+    unsigned int i;
+    for (i = 0; i < JH_VOCAB_SHARDS; ++i) {
+        const jh_vocab_shard *sh = &v->shards[i];
+        size_t count = sh->count;
+        size_t cap = atomic_load_explicit(&sh->cap, memory_order_relaxed);
+        double load = (double)count / (double)cap;
+        terms += count;
+        slots += cap;
+        grows += sh->grows;
+        if (load > max_load) {
+            max_load = load;
+        }
+    }
+    fprintf(stderr, "[build_occurrences] vocab terms=%llu slots=%llu shards=%u load=%.3f max_shard_load=%.3f grows=%llu\n",
+            (unsigned long long)terms, (unsigned long long)slots, (unsigned)JH_VOCAB_SHARDS,
+            slots ? (double)terms / (double)slots : 0.0, max_load, (unsigned long long)grows);
+}
+
+static void jh_term_ids_free(jh_term_ids *t) {
+    free(t->hashes);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+/* jh_term_ids_get returns the id of word_hash, giving it the next id the first time it is seen. */
+static jh_u32 jh_term_ids_get(jh_term_ids *t, jh_u64 word_hash) {
+    size_t idx;
+    if (((size_t)t->count + 1) * 2 > t->slot_cap) {
+        size_t nc = t->slot_cap ? t->slot_cap * 2 : 1024;
+        jh_u32 *ns = (jh_u32 *)calloc(nc, sizeof(jh_u32));
+        jh_u32 i;
+        if (!ns) {
+            jh_die_occ("alloc term ids failed");
+        }
+        for (i = 0; i < t->count; ++i) {
+            idx = (size_t)t->hashes[i] & (nc - 1);
+            while (ns[idx] != 0) {
+                idx = (idx + 1) & (nc - 1);
+            }
+            ns[idx] = i + 1;
+        }
+        free(t->slots);
+        t->slots = ns;
+        t->slot_cap = nc;
+    }
+    idx = (size_t)word_hash & (t->slot_cap - 1);
+    while (t->slots[idx] != 0) {
+        if (t->hashes[t->slots[idx] - 1] == word_hash) {
+            return t->slots[idx] - 1;
+        }
+        idx = (idx + 1) & (t->slot_cap - 1);
+    }
+    if (t->count == t->hashes_cap) {
+        jh_u32 nc = t->hashes_cap ? t->hashes_cap * 2 : 512;
+        jh_u64 *nh = (jh_u64 *)realloc(t->hashes, sizeof(jh_u64) * nc);
+        if (!nh) {
+            jh_die_occ("alloc term ids failed");
+        }
+        t->hashes = nh;
+        t->hashes_cap = nc;
+    }
+    t->hashes[t->count] = word_hash;
+    t->slots[idx] = ++t->count;
+    return t->count - 1;
+}
+
+static void jh_occ_buffer_push(jh_occ_buffer *b, jh_u64 word_hash, jh_u32 page_id, jh_u32 position) {
+    jh_term_occurrence *rec;
+    if (b->count == b->cap) {
+        size_t nc = b->cap ? b->cap * 2 : 4096;
+        jh_term_occurrence *nr = (jh_term_occurrence *)realloc(b->recs, sizeof(jh_term_occurrence) * nc);
+        if (!nr) {
+            jh_die_occ("alloc occurrence buffer failed");
+        }
+        b->recs = nr;
+        b->cap = nc;
+    }
+    rec = &b->recs[b->count++];
+    rec->term_id = jh_term_ids_get(&b->terms, word_hash);
+    rec->page_id = page_id;
+    rec->position = position;
+}
+
+/* jh_occ_plan_chunks cuts the page list into consecutive chunks of roughly equal text bytes. */
+static jh_occ_chunk *jh_occ_plan_chunks(const jh_page_index_entry *pages, jh_u32 page_count, unsigned int thread_count, size_t *out_count) {
+    jh_u64 total = 0;
+    jh_u64 target;
+    jh_u64 acc = 0;
+    jh_occ_chunk *chunks;
+    size_t count = 0;
+    size_t cap = 64;
+    jh_u32 start = 0;
+    jh_u32 i;
+
+    for (i = 0; i < page_count; ++i) {
+        total += pages[i].length;
+    }
+    target = total / ((jh_u64)thread_count * JH_OCC_CHUNKS_PER_THREAD);
+    if (target < JH_OCC_CHUNK_MIN_BYTES) {
+        target = JH_OCC_CHUNK_MIN_BYTES;
+    } else if (target > JH_OCC_CHUNK_MAX_BYTES) {
+        target = JH_OCC_CHUNK_MAX_BYTES;
+    }
+    chunks = (jh_occ_chunk *)malloc(sizeof(jh_occ_chunk) * cap);
+    if (!chunks) {
+        jh_die_occ("alloc chunks failed");
+    }
+    for (i = 0; i < page_count; ++i) {
+        acc += pages[i].length;
+        if (acc >= target || i + 1 == page_count) {
+            if (count == cap) {
+                jh_occ_chunk *nc = (jh_occ_chunk *)realloc(chunks, sizeof(jh_occ_chunk) * cap * 2);
+                if (!nc) {
+                    jh_die_occ("alloc chunks failed");
+                }
+                chunks = nc;
+                cap *= 2;
+            }
+            memset(&chunks[count], 0, sizeof(jh_occ_chunk));
+            chunks[count].start_page = start;
+            chunks[count].end_page = i + 1;
+            count++;
+            start = i + 1;
+            acc = 0;
+        }
+    }
+    *out_count = count;
+    return chunks;
+}
+
+/* jh_occ_queue_claim returns the next chunk index, waiting while the commit window is full, or chunk_count when done. */
+static size_t jh_occ_queue_claim(jh_occ_queue *q) {
+    size_t idx;
+    pthread_mutex_lock(&q->mutex);
+    while (q->next < q->chunk_count && q->next >= q->committed + q->window) {
+        pthread_cond_wait(&q->cond, &q->mutex);
+    }
+    idx = q->next < q->chunk_count ? q->next++ : q->chunk_count;
+    pthread_mutex_unlock(&q->mutex);
+    return idx;
+}
+
+/* jh_occ_buffer_write renumbers a chunk's local term ids into the file's term table and appends its records; only
+   the chunk's distinct terms are looked up, so the serial part of a commit stays small. */
+static void jh_occ_buffer_write(jh_occ_buffer *b, jh_term_ids *file_terms, FILE *fp) {
+    jh_u32 *remap = (jh_u32 *)malloc(sizeof(jh_u32) * ((size_t)b->terms.count + 1));
+    jh_u32 i;
+    size_t k;
+    if (!remap) {
+        jh_die_occ("alloc term remap failed");
+    }
+    for (i = 0; i < b->terms.count; ++i) {
+        remap[i] = jh_term_ids_get(file_terms, b->terms.hashes[i]);
+    }
+    for (k = 0; k < b->count; ++k) {
+        b->recs[k].term_id = remap[b->recs[k].term_id];
+    }
+    if (b->count > 0 && fwrite(b->recs, sizeof(jh_term_occurrence), b->count, fp) != b->count) {
+        jh_die_occ("write occurrences failed");
+    }
+    free(remap);
+    free(b->recs);
+    jh_term_ids_free(&b->terms);
+    memset(b, 0, sizeof(*b));
+}
+
+static void jh_offsets_writer_open(jh_offsets_writer *w, const char *path, jh_u32 page_count) {
+    jh_token_offsets_header hdr;
+    memset(w, 0, sizeof(*w));
+    w->table = (jh_u64 *)malloc(sizeof(jh_u64) * ((size_t)page_count + 1));
+    if (!w->table) {
+        jh_die_occ("alloc offsets table failed");
+    }
+    w->fp = fopen(path, "wb");
+    if (!w->fp) {
+        jh_die_occ("open offsets.bin failed");
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    if (fwrite(&hdr, 1, sizeof(hdr), w->fp) != sizeof(hdr)) {
+        jh_die_occ("write offsets.bin header failed");
+    }
+    w->base = sizeof(jh_token_offsets_header);
+    w->page_count = page_count;
+}
+
+/* jh_offsets_writer_chunk appends a committed chunk's spans and releases its span buffers. */
+static void jh_offsets_writer_chunk(jh_offsets_writer *w, jh_occ_chunk *c, const jh_page_index_entry *pages) {
+    jh_u64 prev = 0;
+    jh_u32 i;
+    for (i = c->start_page; i < c->end_page; ++i) {
+        if (pages[i].page_id != i) {
+            jh_die_occ("pages.idx not in page_id order");
+        }
+        w->table[i] = w->base + prev;
+        prev = c->offsets.page_end[i - c->start_page];
+    }
+    if (c->offsets.len > 0 && fwrite(c->offsets.data, 1, c->offsets.len, w->fp) != c->offsets.len) {
+        jh_die_occ("write offsets.bin data failed");
+    }
+    w->base += c->offsets.len;
+    free(c->offsets.data);
+    free(c->offsets.page_end);
+    memset(&c->offsets, 0, sizeof(c->offsets));
+}
+
+/* jh_offsets_writer_finish writes the page table and the final header. */
+static void jh_offsets_writer_finish(jh_offsets_writer *w) {
+    jh_token_offsets_header hdr;
+    /* The table is u64-aligned so readers can use it in place. */
+    while (w->base % sizeof(jh_u64) != 0) {
+        if (fputc(0, w->fp) == EOF) {
+            jh_die_occ("write offsets.bin padding failed");
+        }
+        w->base++;
+    }
+    w->table[w->page_count] = w->base;
+    if (fwrite(w->table, sizeof(jh_u64), (size_t)w->page_count + 1, w->fp) != (size_t)w->page_count + 1) {
+        jh_die_occ("write offsets.bin table failed");
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "TOFS", 4);
+    hdr.version = 1;
+    hdr.page_count = w->page_count;
+    hdr.index_offset = w->base;
+    if (fseek(w->fp, 0, SEEK_SET) != 0 || fwrite(&hdr, 1, sizeof(hdr), w->fp) != sizeof(hdr)) {
+        jh_die_occ("rewrite offsets.bin header failed");
+    }
+    if (fclose(w->fp) != 0) {
+        jh_die_occ("close offsets.bin failed");
+    }
+    free(w->table);
+    memset(w, 0, sizeof(*w));
+}
+
+/* jh_occ_queue_finish marks a chunk done and writes every finished chunk at the head of the sequence. */
+static void jh_occ_queue_finish(jh_occ_queue *q, size_t idx) {
+    pthread_mutex_lock(&q->mutex);
+    q->chunks[idx].done = 1;
+    while (q->committed < q->chunk_count && q->chunks[q->committed].done) {
+        jh_occ_chunk *c = &q->chunks[q->committed];
+        if (q->out_fp) {
+            jh_occ_buffer_write(&c->occ, &q->terms, q->out_fp);
+        }
+        if (q->stem_fp) {
+            jh_occ_buffer_write(&c->stem_occ, &q->stem_terms, q->stem_fp);
+        }
+        jh_offsets_writer_chunk(&q->offsets, c, q->pages);
+        q->committed++;
+    }
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+}
+
 static void *jh_occ_worker(void *arg) {
     jh_occ_worker_ctx *ctx = (jh_occ_worker_ctx *)arg;
-    FILE *books_fp;
+    jh_books_reader books;
     jh_token *tokens = NULL;
     size_t tokens_cap = 0;
     char *page_buf = NULL;
     size_t page_cap = 0;
     char *workspace = NULL;
     size_t workspace_cap = 0;
+    jh_token *stems = NULL;
+    jh_u32 *span_starts = NULL;
+    jh_u32 *span_ends = NULL;
+    jh_occ_chunk *chunk;
+    size_t chunk_idx;
     jh_u32 i;
 
-    books_fp = fopen(ctx->books_path, "rb");
-    if (!books_fp) {
+    if (jh_books_reader_open(ctx->books_path, &books) != 0) {
         jh_die_occ("open books.bin failed in worker");
     }
 
-    for (i = ctx->start_page; i < ctx->end_page; ++i) {
-        jh_page_index_entry *pe = &ctx->pages[i];
-        jh_block_index_entry *blk;
-        jh_u64 file_offset;
-        size_t len;
-        size_t nread;
-        size_t tok_count;
-        size_t t;
-
-        if (pe->block_id >= ctx->books_hdr->block_count) {
-            fclose(books_fp);
-            jh_die_occ("page block_id out of range");
+    for (;;) {
+        chunk_idx = jh_occ_queue_claim(ctx->queue);
+        if (chunk_idx >= ctx->queue->chunk_count) {
+            break;
         }
-        if (pe->length == 0) {
-            continue;
+        chunk = &ctx->queue->chunks[chunk_idx];
+        /* Span buffers live only from claim to commit, bounded by the commit window. */
+        chunk->offsets.page_end = (jh_u64 *)malloc(sizeof(jh_u64) * ((size_t)(chunk->end_page - chunk->start_page) + 1));
+        if (!chunk->offsets.page_end) {
+            jh_books_reader_close(&books);
+            jh_die_occ("alloc offsets page table failed");
         }
+        for (i = chunk->start_page; i < chunk->end_page; ++i) {
+            const jh_page_index_entry *pe = &ctx->pages[i];
+            size_t len;
+            size_t tok_count;
+            size_t t;
 
-        len = pe->length;
-        if (len > page_cap) {
-            char *nb = (char *)realloc(page_buf, len);
-            if (!nb) {
-                fclose(books_fp);
-                jh_die_occ("alloc page buffer failed");
+            if (pe->block_id >= ctx->books_hdr->block_count) {
+                jh_books_reader_close(&books);
+                jh_die_occ("page block_id out of range");
             }
-            page_buf = nb;
-            page_cap = len;
-        }
-        if (len > tokens_cap) {
-            size_t new_cap = len;
-            jh_token *nt = (jh_token *)realloc(tokens, sizeof(jh_token) * new_cap);
-            if (!nt) {
-                fclose(books_fp);
-                jh_die_occ("alloc tokens failed");
+            if (pe->length == 0) {
+                jh_offsets_put(&chunk->offsets, 0);
+                chunk->offsets.page_end[i - chunk->start_page] = chunk->offsets.len;
+                continue;
             }
-            tokens = nt;
-            tokens_cap = new_cap;
-        }
-        if (len > workspace_cap) {
-            char *nw = (char *)realloc(workspace, len);
-            if (!nw) {
-                fclose(books_fp);
-                jh_die_occ("alloc workspace failed");
+
+            len = pe->length;
+            if (len > page_cap) {
+                char *nb = (char *)realloc(page_buf, len);
+                if (!nb) {
+                    jh_books_reader_close(&books);
+                    jh_die_occ("alloc page buffer failed");
+                }
+                page_buf = nb;
+                page_cap = len;
             }
-            workspace = nw;
-            workspace_cap = len;
-        }
-
-        blk = (jh_block_index_entry *)&ctx->blocks[pe->block_id];
-        file_offset = blk->compressed_offset + (jh_u64)pe->offset_in_block;
-        if (fseek(books_fp, (long)file_offset, SEEK_SET) != 0) {
-            fclose(books_fp);
-            jh_die_occ("seek page text failed");
-        }
-        nread = fread(page_buf, 1, len, books_fp);
-        if (nread != len) {
-            fclose(books_fp);
-            jh_die_occ("read page text failed");
-        }
-
-        tok_count = jh_normalize_and_tokenize_arabic_utf8(page_buf, len,
-                                                          tokens, tokens_cap,
-                                                          workspace, workspace_cap);
-        if (tok_count == (size_t)-1) {
-            fclose(books_fp);
-            jh_die_occ("tokenization failed");
-        }
-
-        for (t = 0; t < tok_count; ++t) {
-            jh_occurrence_record rec;
-            jh_u64 h1 = jh_hash_utf8_64(tokens[t].word, tokens[t].length, 0);
-            jh_u64 h2 = jh_hash_utf8_64(tokens[t].word, tokens[t].length, (jh_u64)0x9e3779b97f4a7c15ULL);
-            size_t idx = (size_t)(h1 & (jh_u64)(ctx->vocab_cap - 1));
-            size_t probed = 0;
-
-            pthread_mutex_lock(ctx->vocab_mutex);
-            for (;;) {
-                jh_vocab_entry *ve = &ctx->vocab[idx];
-                if (!ve->used) {
-                    ve->hash1 = h1;
-                    ve->hash2 = h2;
-                    ve->used = 1;
-                    break;
+            if (len > tokens_cap) {
+                size_t new_cap = len;
+                jh_token *nt = (jh_token *)realloc(tokens, sizeof(jh_token) * new_cap);
+                if (!nt) {
+                    jh_books_reader_close(&books);
+                    jh_die_occ("alloc tokens failed");
                 }
-                if (ve->hash1 == h1) {
-                    if (ve->hash2 == h2) {
-                        break;
+                tokens = nt;
+                tokens_cap = new_cap;
+                span_starts = (jh_u32 *)realloc(span_starts, sizeof(jh_u32) * new_cap);
+                span_ends = (jh_u32 *)realloc(span_ends, sizeof(jh_u32) * new_cap);
+                if (!span_starts || !span_ends) {
+                    jh_books_reader_close(&books);
+                    jh_die_occ("alloc token spans failed");
+                }
+                if (ctx->stem) {
+                    jh_token *ns = (jh_token *)realloc(stems, sizeof(jh_token) * new_cap);
+                    if (!ns) {
+                        jh_books_reader_close(&books);
+                        jh_die_occ("alloc stem tokens failed");
                     }
-                    pthread_mutex_unlock(ctx->vocab_mutex);
-                    fclose(books_fp);
-                    jh_die_occ("hash collision detected");
+                    stems = ns;
                 }
-                idx = (idx + 1) & (ctx->vocab_cap - 1);
-                probed += 1;
-                if (probed >= ctx->vocab_cap) {
-                    pthread_mutex_unlock(ctx->vocab_mutex);
-                    fclose(books_fp);
-                    jh_die_occ("vocab table full");
+            }
+            if (len > workspace_cap) {
+                char *nw = (char *)realloc(workspace, len);
+                if (!nw) {
+                    jh_books_reader_close(&books);
+                    jh_die_occ("alloc workspace failed");
                 }
+                workspace = nw;
+                workspace_cap = len;
             }
-            pthread_mutex_unlock(ctx->vocab_mutex);
 
-            rec.word_hash = h1;
-            rec.page_id = pe->page_id;
-            rec.position = tokens[t].position;
+            if (jh_books_reader_read(&books, pe->block_id, pe->offset_in_block, (jh_u32)len, page_buf) != 0) {
+                jh_books_reader_close(&books);
+                jh_die_occ("read page text failed");
+            }
 
-            pthread_mutex_lock(ctx->out_mutex);
-            if (fwrite(&rec, 1, sizeof(rec), ctx->out_fp) != sizeof(rec)) {
-                pthread_mutex_unlock(ctx->out_mutex);
-                fclose(books_fp);
-                jh_die_occ("write occurrence failed");
+            tok_count = jh_normalize_and_tokenize_arabic_utf8(page_buf, len,
+                                                              tokens, tokens_cap,
+                                                              workspace, workspace_cap);
+            if (tok_count == (size_t)-1) {
+                jh_books_reader_close(&books);
+                jh_die_occ("tokenization failed");
+            }
+            if (jh_token_raw_spans_utf8(page_buf, len, span_starts, span_ends, tokens_cap) != tok_count) {
+                jh_books_reader_close(&books);
+                jh_die_occ("token spans disagree with tokenizer");
+            }
+            jh_offsets_put(&chunk->offsets, (jh_u32)tok_count);
+            {
+                jh_u32 prev_end = 0;
+                for (t = 0; t < tok_count; ++t) {
+                    jh_offsets_put(&chunk->offsets, span_starts[t] - prev_end);
+                    jh_offsets_put(&chunk->offsets, span_ends[t] - span_starts[t]);
+                    prev_end = span_ends[t];
+                }
+            }
+            chunk->offsets.page_end[i - chunk->start_page] = chunk->offsets.len;
+
+            for (t = 0; t < tok_count; ++t) {
+                jh_u64 h1 = jh_hash_utf8_64(tokens[t].word, tokens[t].length, 0);
+                jh_u64 h2 = jh_hash_utf8_64(tokens[t].word, tokens[t].length, (jh_u64)0x9e3779b97f4a7c15ULL);
+                jh_vocab_insert(ctx, tokens[t].word, tokens[t].length, h1, h2);
+                if (!ctx->inv) {
+                    jh_occ_buffer_push(&chunk->occ, h1, pe->page_id, tokens[t].position);
+                } else if (jh_inverter_add(ctx->inv, ctx->part, h1, pe->page_id, tokens[t].position) != 0) {
+                    jh_die_occ("invert occurrence failed");
+                }
+            }
+
+            if (ctx->stem) {
+                memcpy(stems, tokens, sizeof(jh_token) * tok_count);
+                jh_light_stem_arabic_tokens(stems, tok_count);
+                for (t = 0; t < tok_count; ++t) {
+                    jh_u64 sh = jh_hash_utf8_64(stems[t].word, stems[t].length, 0);
+                    if (!ctx->stem_inv) {
+                        jh_occ_buffer_push(&chunk->stem_occ, sh, pe->page_id, stems[t].position);
+                    } else if (jh_inverter_add(ctx->stem_inv, ctx->part, sh, pe->page_id, stems[t].position) != 0) {
+                        jh_die_occ("invert stem occurrence failed");
+                    }
+                }
             }
-            pthread_mutex_unlock(ctx->out_mutex);
         }
+        jh_occ_queue_finish(ctx->queue, chunk_idx);
     }
 
     free(tokens);
+    free(stems);
+    free(span_starts);
+    free(span_ends);
     free(page_buf);
     free(workspace);
-    fclose(books_fp);
+    jh_books_reader_close(&books);
     return NULL;
 }
 
-static void jh_build_occurrences(const char *books_path, const char *pages_idx_path, const char *out_path) {
+static int jh_lexicon_term_cmp(const void *a, const void *b) {
+    const jh_vocab_entry *va = *(const jh_vocab_entry *const *)a;
+    const jh_vocab_entry *vb = *(const jh_vocab_entry *const *)b;
+    jh_u32 n = va->word_length < vb->word_length ? va->word_length : vb->word_length;
+    int c = memcmp(va->word, vb->word, n);
+    if (c != 0) {
+        return c;
+    }
+    if (va->word_length != vb->word_length) {
+        return va->word_length < vb->word_length ? -1 : 1;
+    }
+    return 0;
+}
+
+/* jh_write_lexicon sorts the distinct terms by bytes and writes them front-coded to words.lex. */
+static void jh_write_lexicon(const jh_vocab *vocab, const char *lex_path) {
+    const jh_vocab_entry **terms;
+    jh_u64 *block_offsets;
+    size_t term_count = 0;
+    size_t block_count;
+    size_t vocab_count = 0;
+    size_t i;
+    unsigned int si;
+    size_t b = 0;
+    jh_u64 offset = sizeof(jh_lexicon_header);
+    jh_lexicon_header hdr;
+    const jh_vocab_entry *prev = NULL;
+    FILE *f;
+
+    for (si = 0; si < JH_VOCAB_SHARDS; ++si) {
+        vocab_count += vocab->shards[si].count;
+    }
+    terms = (const jh_vocab_entry **)malloc(sizeof(*terms) * (vocab_count ? vocab_count : 1));
+    if (!terms) {
+        jh_die_occ("alloc lexicon terms failed");
+    }
+    for (si = 0; si < JH_VOCAB_SHARDS; ++si) {
+        const jh_vocab_shard *sh = &vocab->shards[si];
+        const jh_vocab_entry *slots = atomic_load_explicit(&sh->slots, memory_order_relaxed);
+        size_t cap = atomic_load_explicit(&sh->cap, memory_order_relaxed);
+        for (i = 0; i < cap; ++i) {
+            const jh_vocab_entry *ve = &slots[i];
+            if (atomic_load_explicit(&ve->state, memory_order_relaxed) == JH_VOCAB_READY &&
+                ve->word_length <= JH_LEXICON_TERM_MAX) {
+                terms[term_count++] = ve;
+            }
+        }
+    }
+    qsort(terms, term_count, sizeof(*terms), jh_lexicon_term_cmp);
+
+    block_count = (term_count + JH_LEXICON_BLOCK_TERMS - 1) / JH_LEXICON_BLOCK_TERMS;
+    block_offsets = (jh_u64 *)malloc(sizeof(jh_u64) * (block_count ? block_count : 1));
+    if (!block_offsets) {
+        free(terms);
+        jh_die_occ("alloc lexicon block index failed");
+    }
+
+    f = fopen(lex_path, "wb");
+    if (!f) {
+        free(block_offsets);
+        free(terms);
+        jh_die_occ("open words.lex failed");
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr)) {
+        jh_die_occ("write words.lex header failed");
+    }
+    for (i = 0; i < term_count; ++i) {
+        const jh_vocab_entry *te = terms[i];
+        const char *word = te->word;
+        jh_u8 lens[2];
+        jh_u32 shared = 0;
+        if (i % JH_LEXICON_BLOCK_TERMS == 0) {
+            block_offsets[b++] = offset;
+        } else {
+            const char *pw = prev->word;
+            while (shared < te->word_length && shared < prev->word_length && pw[shared] == word[shared]) {
+                shared++;
+            }
+        }
+        lens[0] = (jh_u8)shared;
+        lens[1] = (jh_u8)(te->word_length - shared);
+        if (fwrite(lens, 1, 2, f) != 2 ||
+            fwrite(word + shared, 1, lens[1], f) != lens[1] ||
+            fwrite(&te->hash1, 1, sizeof(te->hash1), f) != sizeof(te->hash1)) {
+            jh_die_occ("write words.lex term failed");
+        }
+        offset += 2 + (jh_u64)lens[1] + sizeof(te->hash1);
+        prev = te;
+    }
+    if (block_count > 0 && fwrite(block_offsets, sizeof(jh_u64), block_count, f) != block_count) {
+        jh_die_occ("write words.lex block index failed");
+    }
+
+    memcpy(hdr.magic, "WLEX", 4);
+    hdr.version = 1;
+    hdr.term_count = (jh_u32)term_count;
+    hdr.block_terms = JH_LEXICON_BLOCK_TERMS;
+    hdr.block_count = block_count;
+    hdr.block_index_offset = offset;
+    if (fseek(f, 0, SEEK_SET) != 0 || fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr)) {
+        jh_die_occ("rewrite words.lex header failed");
+    }
+    fclose(f);
+    free(block_offsets);
+    free(terms);
+}
+
+/* jh_invert_budget returns the --invert memory budget in bytes, from JH_INVERT_MB or the default. */
+static size_t jh_invert_budget(void) {
+    const char *env = getenv("JH_INVERT_MB");
+    unsigned long mb = JH_INVERT_DEFAULT_MB;
+    if (env && *env) {
+        char *endp = NULL;
+        unsigned long v = strtoul(env, &endp, 10);
+        if (endp && *endp == 0 && v > 0) {
+            mb = v;
+        }
+    }
+    return (size_t)mb * 1024 * 1024;
+}
+
+/* jh_finish_inverted merges an inverter's partial indexes into postings_path and words_path. */
+static void jh_finish_inverted(jh_inverter *inv, const char *postings_path, const char *words_path) {
+    jh_build_index_stats stats;
+    if (jh_inverter_finish(inv, postings_path, words_path, &stats) != 0) {
+        jh_die_occ("merge partial indexes failed");
+    }
+    printf("[build_occurrences] %s: partials=%llu words=%llu postings=%llu\n", postings_path,
+           (unsigned long long)stats.run_count, (unsigned long long)stats.word_count, (unsigned long long)stats.total_postings);
+    jh_inverter_free(inv);
+}
+
+/* jh_build_occurrences tokenizes every page; with invert set it writes the postings and words files that
+   jh_index_paths_for names after out_path (and stem_path) directly instead of the occurrence files. */
+static void jh_build_occurrences(const char *books_path, const char *pages_idx_path, const char *out_path, const char *lex_path, const char *stem_path, const char *offsets_path, int invert) {
     jh_books_file_header books_hdr;
     FILE *books_fp;
     jh_block_index_entry *blocks;
     jh_pages_index_header pages_hdr;
     FILE *pages_fp;
     jh_page_index_entry *pages;
-    FILE *out_fp;
-    jh_vocab_entry *vocab = NULL;
-    size_t vocab_cap = 0;
-    pthread_mutex_t out_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t vocab_mutex = PTHREAD_MUTEX_INITIALIZER;
+    FILE *out_fp = NULL;
+    FILE *stem_fp = NULL;
+    jh_inverter inv;
+    jh_inverter stem_inv;
+    char inv_prefix[1024];
+    char stem_inv_prefix[1024];
+    char postings_path[1024];
+    char words_path[1024];
+    char stem_postings_path[1024];
+    char stem_words_path[1024];
+    jh_vocab *vocab = NULL;
+    jh_u64 total_bytes = 0;
+    jh_u32 pi;
+    jh_occ_queue queue;
     unsigned int thread_count;
     pthread_t *threads = NULL;
     jh_occ_worker_ctx *ctxs = NULL;
@@ -302,28 +1051,21 @@ static void jh_build_occurrences(const char *books_path, const char *pages_idx_p
     }
     fclose(pages_fp);
 
-    out_fp = fopen(out_path, "wb");
-    if (!out_fp) {
-        free(pages);
-        free(blocks);
-        fclose(books_fp);
-        jh_die_occ("open occurrences.tmp failed");
-    }
-
-    vocab_cap = 1u << 20;
-    vocab = (jh_vocab_entry *)calloc(vocab_cap, sizeof(jh_vocab_entry));
+    vocab = (jh_vocab *)malloc(sizeof(jh_vocab));
     if (!vocab) {
-        fclose(out_fp);
         free(pages);
         free(blocks);
         fclose(books_fp);
         jh_die_occ("alloc vocab failed");
     }
+    for (pi = 0; pi < pages_hdr.page_count; ++pi) {
+        total_bytes += pages[pi].length;
+    }
+    jh_vocab_init(vocab, total_bytes);
 
     thread_count = jh_detect_thread_count(pages_hdr.page_count);
     if (thread_count == 0) {
         free(vocab);
-        fclose(out_fp);
         free(pages);
         free(blocks);
         fclose(books_fp);
@@ -336,28 +1078,68 @@ static void jh_build_occurrences(const char *books_path, const char *pages_idx_p
         free(threads);
         free(ctxs);
         free(vocab);
-        fclose(out_fp);
         free(pages);
         free(blocks);
         fclose(books_fp);
         jh_die_occ("alloc threads failed");
     }
 
+    if (invert) {
+        /* Partial indexes spill next to the sort runs, under JH_SORT_TMPDIR when it is set. */
+        jh_sort_options sort_opts;
+        if (jh_index_paths_for(out_path, postings_path, words_path, sizeof(postings_path)) != 0 ||
+            (stem_path && jh_index_paths_for(stem_path, stem_postings_path, stem_words_path, sizeof(stem_postings_path)) != 0)) {
+            jh_die_occ("cannot name postings and words files after the occurrences path");
+        }
+        jh_sort_options_from_env(&sort_opts);
+        snprintf(inv_prefix, sizeof(inv_prefix), "%s%sinv_words_%ld", sort_opts.tmp_dir ? sort_opts.tmp_dir : "",
+                 sort_opts.tmp_dir ? "/" : "", (long)getpid());
+        snprintf(stem_inv_prefix, sizeof(stem_inv_prefix), "%s%sinv_stem_%ld", sort_opts.tmp_dir ? sort_opts.tmp_dir : "",
+                 sort_opts.tmp_dir ? "/" : "", (long)getpid());
+        if (jh_inverter_init(&inv, thread_count, jh_invert_budget(), inv_prefix) != 0 ||
+            (stem_path && jh_inverter_init(&stem_inv, thread_count, jh_invert_budget(), stem_inv_prefix) != 0)) {
+            jh_die_occ("alloc inverter failed");
+        }
+        inv.fan_in = sort_opts.fan_in;
+        jh_occ_inverters[0] = &inv;
+        if (stem_path) {
+            stem_inv.fan_in = sort_opts.fan_in;
+            jh_occ_inverters[1] = &stem_inv;
+        }
+    } else {
+        out_fp = fopen(out_path, "wb");
+        if (!out_fp) {
+            jh_die_occ("open occurrences.tmp failed");
+        }
+        if (stem_path) {
+            stem_fp = fopen(stem_path, "wb");
+            if (!stem_fp) {
+                jh_die_occ("open occurrences_stem.tmp failed");
+            }
+        }
+    }
+
+    memset(&queue, 0, sizeof(queue));
+    queue.chunks = jh_occ_plan_chunks(pages, pages_hdr.page_count, thread_count, &queue.chunk_count);
+    queue.window = (size_t)thread_count * JH_OCC_WINDOW_PER_THREAD;
+    queue.out_fp = out_fp;
+    queue.stem_fp = stem_fp;
+    queue.pages = pages;
+    jh_offsets_writer_open(&queue.offsets, offsets_path, pages_hdr.page_count);
+    pthread_mutex_init(&queue.mutex, NULL);
+    pthread_cond_init(&queue.cond, NULL);
+
     for (ti = 0; ti < thread_count; ++ti) {
-        jh_u32 start = (jh_u32)((pages_hdr.page_count * ti) / thread_count);
-        jh_u32 end = (jh_u32)((pages_hdr.page_count * (ti + 1)) / thread_count);
         ctxs[ti].books_hdr = &books_hdr;
-        ctxs[ti].blocks = blocks;
-        ctxs[ti].pages_hdr = &pages_hdr;
         ctxs[ti].pages = pages;
         ctxs[ti].books_path = books_path;
-        ctxs[ti].out_fp = out_fp;
-        ctxs[ti].out_mutex = &out_mutex;
+        ctxs[ti].stem = stem_path != NULL;
+        ctxs[ti].queue = &queue;
+        ctxs[ti].inv = invert ? &inv : NULL;
+        ctxs[ti].stem_inv = invert && stem_path ? &stem_inv : NULL;
+        ctxs[ti].part = ti;
         ctxs[ti].vocab = vocab;
-        ctxs[ti].vocab_cap = vocab_cap;
-        ctxs[ti].vocab_mutex = &vocab_mutex;
-        ctxs[ti].start_page = start;
-        ctxs[ti].end_page = end;
+        memset(&ctxs[ti].words, 0, sizeof(ctxs[ti].words));
         if (pthread_create(&threads[ti], NULL, jh_occ_worker, &ctxs[ti]) != 0) {
             jh_die_occ("pthread_create failed");
         }
@@ -369,10 +1151,41 @@ static void jh_build_occurrences(const char *books_path, const char *pages_idx_p
         }
     }
 
+    if (queue.committed != queue.chunk_count) {
+        jh_die_occ("chunks left uncommitted");
+    }
+
+    if (!invert && (jh_write_term_table(out_path, queue.terms.hashes, queue.terms.count) != 0 ||
+                    (stem_path && jh_write_term_table(stem_path, queue.stem_terms.hashes, queue.stem_terms.count) != 0))) {
+        jh_die_occ("write term table failed");
+    }
+    jh_offsets_writer_finish(&queue.offsets);
+    jh_vocab_report(vocab);
+    jh_write_lexicon(vocab, lex_path);
+    if (invert) {
+        jh_finish_inverted(&inv, postings_path, words_path);
+        if (stem_path) {
+            jh_finish_inverted(&stem_inv, stem_postings_path, stem_words_path);
+        }
+    }
+    for (ti = 0; ti < thread_count; ++ti) {
+        jh_word_arena_free(&ctxs[ti].words);
+    }
+    free(queue.chunks);
+    jh_term_ids_free(&queue.terms);
+    jh_term_ids_free(&queue.stem_terms);
+    pthread_mutex_destroy(&queue.mutex);
+    pthread_cond_destroy(&queue.cond);
     free(threads);
     free(ctxs);
+    jh_vocab_free(vocab);
     free(vocab);
-    fclose(out_fp);
+    if (out_fp) {
+        fclose(out_fp);
+    }
+    if (stem_fp) {
+        fclose(stem_fp);
+    }
     free(pages);
     free(blocks);
     fclose(books_fp);
@@ -382,6 +1195,19 @@ int main(int argc, char **argv) {
     const char *books_path = "books.bin";
     const char *pages_idx_path = "pages.idx";
     const char *out_path = "occurrences.tmp";
+    const char *lex_path = "words.lex";
+    const char *offsets_path = "offsets.bin";
+    const char *stem_path = NULL;
+    int invert = 0;
+    while (argc > 1 && (strcmp(argv[1], "--stem") == 0 || strcmp(argv[1], "--invert") == 0)) {
+        if (strcmp(argv[1], "--stem") == 0) {
+            stem_path = "occurrences_stem.tmp";
+        } else {
+            invert = 1;
+        }
+        argv++;
+        argc--;
+    }
     if (argc > 1) {
         books_path = argv[1];
     }
@@ -391,6 +1217,12 @@ int main(int argc, char **argv) {
     if (argc > 3) {
         out_path = argv[3];
     }
-    jh_build_occurrences(books_path, pages_idx_path, out_path);
+    if (argc > 4) {
+        lex_path = argv[4];
+    }
+    if (argc > 5) {
+        offsets_path = argv[5];
+    }
+    jh_build_occurrences(books_path, pages_idx_path, out_path, lex_path, stem_path, offsets_path, invert);
     return 0;
 }
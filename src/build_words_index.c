@@ -16,47 +16,196 @@ static jh_u32 jh_read_u32_le(const jh_u8 *p) {
         | ((jh_u32)p[3] << 24);
 }
 
+#define JH_WORD_REF_UNSET (~(jh_u64)0)
+
+/* jh_refs_set records the postings reference for word_id, growing the table as needed. */
+static void jh_refs_set(jh_u64 **refs, size_t *cap, size_t word_id, jh_u64 ref) {
+    if (word_id >= *cap) {
+        size_t nc = *cap ? *cap : 4096;
+        size_t i;
+        jh_u64 *nr;
+        while (nc <= word_id) {
+            nc *= 2;
+        }
+        nr = (jh_u64 *)realloc(*refs, nc * sizeof(jh_u64));
+        if (!nr) {
+            jh_die_words("out of memory for word refs");
+        }
+        for (i = *cap; i < nc; i++) {
+            nr[i] = JH_WORD_REF_UNSET;
+        }
+        *refs = nr;
+        *cap = nc;
+    }
+    (*refs)[word_id] = ref;
+}
+
+/* jh_collect_postings_refs maps each word id (postings order) to its frame offset or packed shared-block ref. */
+static size_t jh_collect_postings_refs(const jh_postings_file_view *view, jh_u64 **out_refs) {
+    jh_u64 *refs = NULL;
+    size_t cap = 0;
+    size_t word_count = 0;
+    size_t next_word = 0;
+    jh_u64 offset;
+    jh_u64 data_end;
+    jh_u64 next_block = 0;
+    jh_u8 *scratch = NULL;
+    size_t scratch_cap = 0;
+    jh_u64 b;
+
+    for (b = 0; b < view->header.block_count; b++) {
+        const jh_u8 *block;
+        size_t block_size;
+        jh_u32 member_count;
+        jh_u32 i;
+        if (jh_postings_file_shared_block(view, (jh_u32)b, &block, &block_size, &scratch, &scratch_cap) != 0) {
+            jh_die_words("decode shared postings block failed");
+        }
+        member_count = jh_read_u32_le(block);
+        if ((jh_u64)member_count * sizeof(jh_postings_block_member) > block_size - 4) {
+            jh_die_words("shared postings block member table truncated");
+        }
+        for (i = 0; i < member_count; i++) {
+            jh_postings_block_member m;
+            memcpy(&m, block + 4 + (size_t)i * sizeof(m), sizeof(m));
+            jh_refs_set(&refs, &cap, m.word_id, JH_POSTINGS_REF_PACK(b, i));
+            if ((size_t)m.word_id + 1 > word_count) {
+                word_count = (size_t)m.word_id + 1;
+            }
+        }
+    }
+    free(scratch);
+
+    offset = view->header.blocks_data_offset;
+    data_end = view->header.block_count ? view->header.block_index_offset : (jh_u64)view->size - view->header.dict_size;
+    while (offset + 4 <= data_end) {
+        jh_u32 block_size = jh_read_u32_le(view->data + offset);
+        if (block_size == 0 || offset + 4 + block_size > data_end) {
+            jh_die_words("postings frame overruns data section");
+        }
+        if (next_block < view->header.block_count) {
+            jh_postings_block_index_entry be;
+            memcpy(&be, view->data + view->header.block_index_offset + next_block * sizeof(be), sizeof(be));
+            if (be.compressed_offset == offset) {
+                next_block += 1;
+                offset += 4 + (jh_u64)block_size;
+                continue;
+            }
+        }
+        while (next_word < cap && refs[next_word] != JH_WORD_REF_UNSET) {
+            next_word += 1;
+        }
+        jh_refs_set(&refs, &cap, next_word, offset);
+        next_word += 1;
+        if (next_word > word_count) {
+            word_count = next_word;
+        }
+        offset += 4 + (jh_u64)block_size;
+    }
+
+    *out_refs = refs;
+    return word_count;
+}
+
+static void jh_write_u32_le(jh_u8 *p, jh_u32 v) {
+    p[0] = (jh_u8)(v & 0xffu);
+    p[1] = (jh_u8)((v >> 8) & 0xffu);
+    p[2] = (jh_u8)((v >> 16) & 0xffu);
+    p[3] = (jh_u8)((v >> 24) & 0xffu);
+}
+
+/* jh_small_list encodes a word's list from its occurrences while it still fits the inline limit; len keeps counting
+   past it so the caller knows the list went to postings.bin instead. */
+typedef struct {
+    jh_u8 data[JH_WORD_DICT_INLINE_MAX];
+    size_t len;
+    jh_u32 doc_count;
+    jh_u32 last_page_id;
+    jh_u32 last_position;
+    size_t term_freq_offset;
+    jh_u32 term_freq;
+} jh_small_list;
+
+static void jh_small_list_reset(jh_small_list *l) {
+    l->len = 4;
+    l->doc_count = 0;
+    l->last_page_id = 0;
+    l->term_freq = 0;
+}
+
+/* jh_small_list_put appends a u32 if it still fits. */
+static void jh_small_list_put(jh_small_list *l, jh_u32 v) {
+    if (l->len + 4 <= JH_WORD_DICT_INLINE_MAX) {
+        jh_write_u32_le(l->data + l->len, v);
+    }
+    l->len += 4;
+}
+
+static void jh_small_list_end_doc(jh_small_list *l) {
+    if (l->doc_count > 0 && l->term_freq_offset + 4 <= JH_WORD_DICT_INLINE_MAX) {
+        jh_write_u32_le(l->data + l->term_freq_offset, l->term_freq);
+    }
+}
+
+static void jh_small_list_add(jh_small_list *l, const jh_term_occurrence *occ) {
+    if (l->doc_count == 0 || occ->page_id != l->last_page_id) {
+        jh_small_list_end_doc(l);
+        jh_small_list_put(l, occ->page_id - l->last_page_id);
+        l->term_freq_offset = l->len;
+        jh_small_list_put(l, 0);
+        l->doc_count += 1;
+        l->last_page_id = occ->page_id;
+        l->last_position = 0;
+        l->term_freq = 0;
+    }
+    jh_small_list_put(l, occ->position - l->last_position);
+    l->last_position = occ->position;
+    l->term_freq += 1;
+}
+
+/* jh_small_list_finish completes the list and returns its length. */
+static size_t jh_small_list_finish(jh_small_list *l) {
+    jh_small_list_end_doc(l);
+    jh_write_u32_le(l->data, l->doc_count);
+    return l->len;
+}
+
 static void jh_build_words_index(const char *occ_path, const char *postings_path, const char *out_path) {
     FILE *occ_fp = fopen(occ_path, "rb");
     FILE *out_fp;
-    FILE *pf;
-    jh_postings_file_header ph;
     jh_word_dict_header wh;
-    jh_occurrence_record occ;
+    jh_term_occurrence occ;
+    jh_u64 *term_hashes = NULL;
+    jh_u32 term_count = 0;
     int have_occ = 0;
     int have_word = 0;
+    jh_u32 current_term = 0;
     jh_u64 current_word_hash = 0;
     jh_u64 postings_count = 0;
-    jh_u32 doc_count = 0;
-    jh_u32 prev_page_id = 0;
-    int have_doc = 0;
-    jh_u64 base_offset;
-    jh_u64 current_offset = 0;
     jh_u64 entry_count = 0;
-    jh_u8 len_buf[4];
-    jh_u32 block_size = 0;
-
-    if (jh_read_postings_file_header(postings_path, &ph) != 0) {
-        jh_die_words("jh_read_postings_file_header failed");
-    }
-
-    base_offset = ph.blocks_data_offset;
+    jh_u64 *refs = NULL;
+    size_t ref_count;
+    jh_u64 stored_count = 0;
+    jh_postings_file_view view;
+    jh_small_list list;
+    jh_u8 *inline_buf = NULL;
+    size_t inline_len = 0;
+    size_t inline_cap = 0;
 
     if (!occ_fp) {
         jh_die_words("open occurrences.sorted.tmp failed");
     }
-
-    pf = fopen(postings_path, "rb");
-    if (!pf) {
+    if (jh_read_term_table(occ_path, &term_hashes, &term_count) != 0) {
         fclose(occ_fp);
-        jh_die_words("open postings.bin failed");
+        jh_die_words("read occurrences term table failed");
     }
-    if (fseek(pf, (long)base_offset, SEEK_SET) != 0) {
+
+    if (jh_postings_file_open(postings_path, &view) != 0) {
         fclose(occ_fp);
-        fclose(pf);
-        jh_die_words("seek postings.bin to data offset failed");
+        jh_die_words("open postings.bin failed");
     }
-    current_offset = base_offset;
+    memset(&list, 0, sizeof(list));
+    ref_count = jh_collect_postings_refs(&view, &refs);
 
     out_fp = fopen(out_path, "wb+");
     if (!out_fp) {
@@ -66,106 +215,89 @@ static void jh_build_words_index(const char *occ_path, const char *postings_path
 
     memset(&wh, 0, sizeof(wh));
     memcpy(wh.magic, "WDIX", 4);
-    wh.version = 1;
+    wh.version = 2;
     wh.reserved = 0;
     wh.entry_count = 0;
 
     if (fwrite(&wh, 1, sizeof(wh), out_fp) != sizeof(wh)) {
         fclose(occ_fp);
-        fclose(pf);
         fclose(out_fp);
         jh_die_words("write words.idx header failed");
     }
 
     while (1) {
+        int have_next = 0;
         if (!have_occ) {
-            size_t n = fread(&occ, sizeof(jh_occurrence_record), 1, occ_fp);
-            if (n != 1) {
-                break;
+            size_t n = fread(&occ, sizeof(jh_term_occurrence), 1, occ_fp);
+            have_occ = n == 1;
+            if (have_occ && occ.term_id >= term_count) {
+                fclose(occ_fp);
+                jh_die_words("occurrence term id out of range");
             }
-            have_occ = 1;
         }
+        have_next = have_occ;
 
-        if (!have_word) {
-            current_word_hash = occ.word_hash;
-            postings_count = 0;
-            doc_count = 0;
-            have_doc = 0;
-            prev_page_id = 0;
-            have_word = 1;
-        }
-
-        if (occ.word_hash != current_word_hash) {
+        if (have_word && (!have_next || occ.term_id != current_term)) {
             jh_word_dict_entry e;
+            size_t size = jh_small_list_finish(&list);
             e.word_hash = current_word_hash;
-            e.postings_offset = current_offset;
             e.postings_count = postings_count;
+            if (size <= JH_WORD_DICT_INLINE_MAX) {
+                if (inline_len + size > inline_cap) {
+                    size_t nc = inline_cap ? inline_cap * 2 : 65536;
+                    jh_u8 *nb = (jh_u8 *)realloc(inline_buf, nc);
+                    if (!nb) {
+                        jh_die_words("out of memory for inline postings");
+                    }
+                    inline_buf = nb;
+                    inline_cap = nc;
+                }
+                memcpy(inline_buf + inline_len, list.data, size);
+                e.postings_offset = JH_POSTINGS_REF_INLINE_MAKE(inline_len, size);
+                inline_len += size;
+            } else {
+                if (stored_count >= ref_count || refs[stored_count] == JH_WORD_REF_UNSET) {
+                    fclose(occ_fp);
+                    fclose(out_fp);
+                    jh_die_words("postings.bin has fewer lists than words");
+                }
+                e.postings_offset = refs[stored_count++];
+            }
             if (fwrite(&e, 1, sizeof(e), out_fp) != sizeof(e)) {
                 fclose(occ_fp);
-                fclose(pf);
                 fclose(out_fp);
                 jh_die_words("write words.idx entry failed");
             }
             entry_count += 1;
-            if (fread(len_buf, 1, 4, pf) != 4) {
-                fclose(occ_fp);
-                fclose(pf);
-                fclose(out_fp);
-                jh_die_words("read postings block length failed");
-            }
-            block_size = jh_read_u32_le(len_buf);
-            current_offset += 4 + (jh_u64)block_size;
-            if (fseek(pf, (long)block_size, SEEK_CUR) != 0) {
-                fclose(occ_fp);
-                fclose(pf);
-                fclose(out_fp);
-                jh_die_words("seek postings block data failed");
-            }
             have_word = 0;
-            have_doc = 0;
-            continue;
+        }
+        if (!have_next) {
+            break;
         }
 
-        if (!have_doc || occ.page_id != prev_page_id) {
-            doc_count += 1;
-            prev_page_id = occ.page_id;
-            have_doc = 1;
+        if (!have_word) {
+            current_term = occ.term_id;
+            current_word_hash = term_hashes[occ.term_id];
+            postings_count = 0;
+            jh_small_list_reset(&list);
+            have_word = 1;
         }
 
+        jh_small_list_add(&list, &occ);
         postings_count += 1;
         have_occ = 0;
     }
 
-    if (have_word) {
-        jh_word_dict_entry e;
-        e.word_hash = current_word_hash;
-        e.postings_offset = current_offset;
-        e.postings_count = postings_count;
-        if (fwrite(&e, 1, sizeof(e), out_fp) != sizeof(e)) {
-            fclose(occ_fp);
-            fclose(pf);
-            fclose(out_fp);
-            jh_die_words("write words.idx entry failed (final word)");
-        }
-        entry_count += 1;
-        if (fread(len_buf, 1, 4, pf) != 4) {
-            fclose(occ_fp);
-            fclose(pf);
-            fclose(out_fp);
-            jh_die_words("read final postings block length failed");
-        }
-        block_size = jh_read_u32_le(len_buf);
-        current_offset += 4 + (jh_u64)block_size;
-        if (fseek(pf, (long)block_size, SEEK_CUR) != 0) {
-            fclose(occ_fp);
-            fclose(pf);
-            fclose(out_fp);
-            jh_die_words("seek final postings block data failed");
-        }
-    }
-
+    free(refs);
+    free(term_hashes);
+    jh_postings_file_close(&view);
     fclose(occ_fp);
-    fclose(pf);
+
+    if (inline_len > 0 && fwrite(inline_buf, 1, inline_len, out_fp) != inline_len) {
+        fclose(out_fp);
+        jh_die_words("write words.idx inline postings failed");
+    }
+    free(inline_buf);
 
     if (fseek(out_fp, 0, SEEK_SET) != 0) {
         fclose(out_fp);
@@ -174,7 +306,7 @@ static void jh_build_words_index(const char *occ_path, const char *postings_path
 
     memset(&wh, 0, sizeof(wh));
     memcpy(wh.magic, "WDIX", 4);
-    wh.version = 1;
+    wh.version = 2;
     wh.reserved = 0;
     wh.entry_count = entry_count;
 
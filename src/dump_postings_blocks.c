@@ -52,6 +52,7 @@ int main(int argc, char **argv) {
     }
     {
         jh_u64 file_size = (jh_u64)ftell(f);
+        jh_u64 data_end;
         if (file_size < hdr.blocks_data_offset) {
             fclose(f);
             jh_die_dump("file too small for blocks_data_offset");
@@ -69,13 +70,25 @@ int main(int argc, char **argv) {
         printf("blocks_data_offset: %llu file_size: %llu\n",
                (unsigned long long)hdr.blocks_data_offset,
                (unsigned long long)file_size);
-        if (compressed_flag) {
+        if (hdr.flags & JH_POSTINGS_FLAG_BLOCK_CODEC) {
+            printf("compression: per-block codec (flag bit 1 set) dict_size: %u\n", (unsigned)hdr.dict_size);
+        } else if (compressed_flag) {
             printf("compression: ZSTD (flag bit 0 set)\n");
         } else {
             printf("compression: none (flag bit 0 clear)\n");
         }
+        printf("shared blocks: %llu block_index_offset: %llu\n",
+               (unsigned long long)hdr.block_count,
+               (unsigned long long)hdr.block_index_offset);
+        if (hdr.block_count > 0 && hdr.block_index_offset <= file_size) {
+            data_end = hdr.block_index_offset;
+        } else if (hdr.dict_size <= file_size - hdr.blocks_data_offset) {
+            data_end = file_size - hdr.dict_size;
+        } else {
+            data_end = file_size;
+        }
         printf("index  offset  comp_bytes  uncomp_bytes  ratio\n");
-        while (offset + 4 <= file_size) {
+        while (offset + 4 <= data_end) {
             jh_u8 len_buf[4];
             jh_u32 block_size;
             size_t n = fread(len_buf, 1, 4, f);
@@ -83,13 +96,29 @@ int main(int argc, char **argv) {
                 break;
             }
             block_size = jh_read_u32_le_local(len_buf);
-            if (block_size == 0 || offset + 4 + block_size > file_size) {
+            if (block_size == 0 || offset + 4 + block_size > data_end) {
                 break;
             }
             total_comp += block_size;
             {
                 double ratio_value = 1.0;
                 jh_u64 uncomp_bytes = 0;
+                if (hdr.flags & JH_POSTINGS_FLAG_BLOCK_CODEC) {
+                    jh_u8 frame[5];
+                    size_t want = block_size < 5 ? block_size : 5;
+                    if (fread(frame, 1, want, f) != want) {
+                        fclose(f);
+                        jh_die_dump("read block codec failed");
+                    }
+                    if (frame[0] == JH_POSTINGS_CODEC_RAW) {
+                        uncomp_bytes = (jh_u64)block_size - 1;
+                    } else if (want == 5) {
+                        uncomp_bytes = jh_read_u32_le_local(frame + 1);
+                    }
+                    total_uncomp += uncomp_bytes;
+                    ratio_value = uncomp_bytes ? (double)block_size / (double)uncomp_bytes : 0.0;
+                    printf("codec %u  ", (unsigned)frame[0]);
+                } else
 #ifdef JH_HAVE_ZSTD
                 if (compressed_flag) {
                     jh_u8 *buf = (jh_u8 *)malloc(block_size);
@@ -16,3 +16,13 @@ uint64_t jh_hash_utf8_64(const char *data, size_t len, uint64_t seed) {
     return h;
 }
 
+uint64_t jh_hash_pair_64(uint64_t first, uint64_t second) {
+    uint64_t h = first * 0x9e3779b97f4a7c15ULL;
+    h ^= second + 0x632be59bd9b4e019ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
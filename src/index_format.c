@@ -3,49 +3,51 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #ifdef JH_HAVE_ZSTD
 #include <zstd.h>
 #endif
 
-static int jh_decompress_block_if_needed(const jh_postings_file_header *hdr,
-                                         const jh_u8 *comp_buf,
-                                         size_t comp_size,
-                                         jh_u8 **out_plain,
-                                         size_t *out_size) {
+#ifdef JH_HAVE_LZ4
+#include <lz4.h>
+#endif
+
 #ifdef JH_HAVE_ZSTD
-    if (hdr->flags & 1u) {
-        unsigned long long content_size = ZSTD_getFrameContentSize(comp_buf, comp_size);
-        if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
-            return -1;
-        }
-        if (content_size > SIZE_MAX) {
-            return -2;
-        }
-        *out_plain = (jh_u8 *)malloc((size_t)content_size);
-        if (!*out_plain) {
-            return -3;
+/* jh_tls_dctx is the per-thread ZSTD decompression context reused across every block decode; it is also stored
+   under jh_dctx_key so the key's destructor frees it when the thread exits. */
+static _Thread_local ZSTD_DCtx *jh_tls_dctx;
+static pthread_key_t jh_dctx_key;
+static pthread_once_t jh_dctx_once = PTHREAD_ONCE_INIT;
+static int jh_dctx_key_ok;
+
+static void jh_dctx_destroy(void *dctx) {
+    ZSTD_freeDCtx((ZSTD_DCtx *)dctx);
+}
+
+static void jh_dctx_key_init(void) {
+    jh_dctx_key_ok = pthread_key_create(&jh_dctx_key, jh_dctx_destroy) == 0;
+}
+
+static ZSTD_DCtx *jh_thread_dctx(void) {
+    if (!jh_tls_dctx) {
+        pthread_once(&jh_dctx_once, jh_dctx_key_init);
+        if (!jh_dctx_key_ok) {
+            return NULL;
         }
-        size_t dsize = ZSTD_decompress(*out_plain, (size_t)content_size, comp_buf, comp_size);
-        if (ZSTD_isError(dsize) || dsize != content_size) {
-            free(*out_plain);
-            *out_plain = NULL;
-            return -4;
+        jh_tls_dctx = ZSTD_createDCtx();
+        if (jh_tls_dctx && pthread_setspecific(jh_dctx_key, jh_tls_dctx) != 0) {
+            ZSTD_freeDCtx(jh_tls_dctx);
+            jh_tls_dctx = NULL;
         }
-        *out_size = (size_t)content_size;
-        return 0;
-    }
-#else
-    (void)hdr;
-#endif
-    *out_plain = (jh_u8 *)malloc(comp_size);
-    if (!*out_plain) {
-        return -5;
     }
-    memcpy(*out_plain, comp_buf, comp_size);
-    *out_size = comp_size;
-    return 0;
+    return jh_tls_dctx;
 }
+#endif
 
 /* jh_read_header loads a fixed-size header from a file and validates its magic tag. */
 static int jh_read_header(const char *path, void *header, size_t header_size, const char expected_magic[4]) {
@@ -108,6 +110,93 @@ int jh_read_postings_file_header(const char *path, jh_postings_file_header *out)
     return jh_read_header(path, out, sizeof(jh_postings_file_header), magic);
 }
 
+/* jh_term_table_path appends JH_TERM_TABLE_SUFFIX to occ_path. */
+static int jh_term_table_path(const char *occ_path, char *out, size_t cap) {
+    int n = snprintf(out, cap, "%s%s", occ_path, JH_TERM_TABLE_SUFFIX);
+    return n > 0 && (size_t)n < cap ? 0 : -1;
+}
+
+int jh_write_term_table(const char *occ_path, const jh_u64 *hashes, jh_u32 term_count) {
+    jh_term_table_header hdr;
+    char path[1024];
+    FILE *f;
+    int rc = 0;
+
+    if (!occ_path || (!hashes && term_count > 0) || jh_term_table_path(occ_path, path, sizeof(path)) != 0) {
+        return -1;
+    }
+    f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "TRMS", 4);
+    hdr.version = 1;
+    hdr.term_count = term_count;
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        (term_count > 0 && fwrite(hashes, sizeof(jh_u64), term_count, f) != term_count)) {
+        rc = -1;
+    }
+    if (fclose(f) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+int jh_read_term_table(const char *occ_path, jh_u64 **out_hashes, jh_u32 *out_count) {
+    static const char magic[4] = { 'T', 'R', 'M', 'S' };
+    jh_term_table_header hdr;
+    char path[1024];
+    jh_u64 *hashes;
+    FILE *f;
+
+    if (!occ_path || !out_hashes || !out_count || jh_term_table_path(occ_path, path, sizeof(path)) != 0) {
+        return -1;
+    }
+    if (jh_read_header(path, &hdr, sizeof(hdr), magic) != 0) {
+        return -2;
+    }
+    hashes = (jh_u64 *)malloc(sizeof(jh_u64) * ((size_t)hdr.term_count + 1));
+    f = fopen(path, "rb");
+    if (!hashes || !f || fseek(f, (long)sizeof(hdr), SEEK_SET) != 0 ||
+        fread(hashes, sizeof(jh_u64), hdr.term_count, f) != hdr.term_count) {
+        free(hashes);
+        if (f) {
+            fclose(f);
+        }
+        return -3;
+    }
+    fclose(f);
+    *out_hashes = hashes;
+    *out_count = hdr.term_count;
+    return 0;
+}
+
+/* jh_pages_index_find reads the pages.idx entry for page_id, probing slot page_id first and binary searching otherwise. */
+static int jh_pages_index_find(FILE *pages_fp, const jh_pages_index_header *hdr, jh_u32 page_id, jh_page_index_entry *out) {
+    jh_u64 lo = 0;
+    jh_u64 hi = hdr->page_count;
+    jh_u64 mid = page_id < hdr->page_count ? page_id : hdr->page_count / 2;
+    while (lo < hi) {
+        long offset = (long)(sizeof(jh_pages_index_header) + mid * (jh_u64)sizeof(jh_page_index_entry));
+        if (fseek(pages_fp, offset, SEEK_SET) != 0) {
+            return -13;
+        }
+        if (fread(out, 1, sizeof(*out), pages_fp) != sizeof(*out)) {
+            return -14;
+        }
+        if (out->page_id == page_id) {
+            return 0;
+        } else if (out->page_id < page_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+        mid = lo + (hi - lo) / 2;
+    }
+    return -16;
+}
+
 int jh_load_page_text(const char *books_path, const char *pages_idx_path, jh_u32 page_id, char **out_text, jh_u32 *out_len) {
     jh_books_file_header books_hdr;
     jh_pages_index_header pages_hdr;
@@ -119,8 +208,7 @@ int jh_load_page_text(const char *books_path, const char *pages_idx_path, jh_u32
     size_t len;
     jh_u64 file_offset;
     size_t nread;
-    jh_u64 lo;
-    jh_u64 hi;
+    int rc;
 
     if (!books_path || !pages_idx_path || !out_text || !out_len) {
         return -1;
@@ -152,33 +240,11 @@ int jh_load_page_text(const char *books_path, const char *pages_idx_path, jh_u32
         fclose(books_fp);
         return -12;
     }
-    lo = 0;
-    hi = pages_hdr.page_count;
-    while (lo < hi) {
-        jh_u64 mid = lo + (hi - lo) / 2;
-        long offset = (long)(sizeof(jh_pages_index_header) + mid * (jh_u64)sizeof(jh_page_index_entry));
-        if (fseek(pages_fp, offset, SEEK_SET) != 0) {
-            fclose(pages_fp);
-            fclose(books_fp);
-            return -13;
-        }
-        if (fread(&pe, 1, sizeof(pe), pages_fp) != sizeof(pe)) {
-            fclose(pages_fp);
-            fclose(books_fp);
-            return -14;
-        }
-        if (pe.page_id == page_id) {
-            break;
-        } else if (pe.page_id < page_id) {
-            lo = mid + 1;
-        } else {
-            hi = mid;
-        }
-    }
+    rc = jh_pages_index_find(pages_fp, &pages_hdr, page_id, &pe);
     fclose(pages_fp);
-    if (lo >= pages_hdr.page_count || pe.page_id != page_id) {
+    if (rc != 0) {
         fclose(books_fp);
-        return -16;
+        return rc;
     }
     if (pe.block_id >= books_hdr.block_count || pe.length == 0) {
         fclose(books_fp);
@@ -192,6 +258,24 @@ int jh_load_page_text(const char *books_path, const char *pages_idx_path, jh_u32
         return -18;
     }
 
+    if (books_hdr.compression != JH_BOOKS_COMPRESSION_NONE) {
+        jh_books_reader reader;
+        fclose(books_fp);
+        rc = jh_books_reader_open(books_path, &reader);
+        if (rc == 0) {
+            rc = jh_books_reader_read(&reader, pe.block_id, pe.offset_in_block, pe.length, buf);
+            jh_books_reader_close(&reader);
+        }
+        if (rc != 0) {
+            free(buf);
+            return -22;
+        }
+        buf[len] = 0;
+        *out_text = buf;
+        *out_len = (jh_u32)len;
+        return 0;
+    }
+
     file_offset = books_hdr.index_offset + (jh_u64)pe.block_id * (jh_u64)sizeof(jh_block_index_entry);
     if (fseek(books_fp, (long)file_offset, SEEK_SET) != 0) {
         free(buf);
@@ -223,12 +307,218 @@ int jh_load_page_text(const char *books_path, const char *pages_idx_path, jh_u32
     return 0;
 }
 
+void jh_page_arena_free(jh_page_arena *arena) {
+    if (!arena) {
+        return;
+    }
+    free(arena->data);
+    memset(arena, 0, sizeof(*arena));
+}
+
+/* jh_page_arena_reserve makes room for extra more bytes after arena->len. */
+static int jh_page_arena_reserve(jh_page_arena *arena, size_t extra) {
+    size_t need = arena->len + extra;
+    size_t nc;
+    char *nd;
+    if (need <= arena->cap) {
+        return 0;
+    }
+    nc = arena->cap ? arena->cap : 65536;
+    while (nc < need) {
+        nc *= 2;
+    }
+    nd = (char *)realloc(arena->data, nc);
+    if (!nd) {
+        return -1;
+    }
+    arena->data = nd;
+    arena->cap = nc;
+    return 0;
+}
+
+/* jh_page_batch_read is one requested page located in books.bin. */
+typedef struct {
+    jh_u64 file_offset;
+    jh_u32 block_id;
+    jh_u32 offset_in_block;
+    jh_u32 length;
+    size_t slot;
+} jh_page_batch_read;
+
+static int jh_page_batch_read_cmp(const void *a, const void *b) {
+    const jh_page_batch_read *x = (const jh_page_batch_read *)a;
+    const jh_page_batch_read *y = (const jh_page_batch_read *)b;
+    if (x->block_id != y->block_id) {
+        return x->block_id < y->block_id ? -1 : 1;
+    }
+    if (x->offset_in_block != y->offset_in_block) {
+        return x->offset_in_block < y->offset_in_block ? -1 : 1;
+    }
+    return x->slot < y->slot ? -1 : (x->slot > y->slot ? 1 : 0);
+}
+
+int jh_load_pages_batch(const char *books_path, const char *pages_idx_path, const jh_u32 *page_ids, size_t count, jh_page_arena *arena, jh_page_slice *out) {
+    jh_books_file_header books_hdr;
+    jh_pages_index_header pages_hdr;
+    jh_page_batch_read *reads;
+    size_t read_count = 0;
+    FILE *books_fp;
+    FILE *pages_fp;
+    jh_u32 cached_block = 0xffffffffu;
+    jh_block_index_entry block_entry;
+    size_t i;
+    size_t r;
+
+    if (!books_path || !pages_idx_path || (count && (!page_ids || !out)) || !arena) {
+        return -1;
+    }
+    arena->len = 0;
+    for (i = 0; i < count; ++i) {
+        out[i].text = NULL;
+        out[i].length = 0;
+        out[i].status = -16;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (jh_read_books_file_header(books_path, &books_hdr) != 0 || books_hdr.block_count == 0) {
+        return -2;
+    }
+    if (jh_read_pages_index_header(pages_idx_path, &pages_hdr) != 0 || pages_hdr.page_count == 0) {
+        return -9;
+    }
+    reads = (jh_page_batch_read *)malloc(sizeof(jh_page_batch_read) * count);
+    if (!reads) {
+        return -18;
+    }
+    books_fp = fopen(books_path, "rb");
+    pages_fp = fopen(pages_idx_path, "rb");
+    if (!books_fp || !pages_fp) {
+        if (books_fp) {
+            fclose(books_fp);
+        }
+        if (pages_fp) {
+            fclose(pages_fp);
+        }
+        free(reads);
+        return -3;
+    }
+
+    /* Resolve every page to its absolute offset in books.bin, re-reading a block entry only when the block changes. */
+    for (i = 0; i < count; ++i) {
+        jh_page_index_entry pe;
+        int rc = jh_pages_index_find(pages_fp, &pages_hdr, page_ids[i], &pe);
+        if (rc != 0) {
+            out[i].status = rc;
+            continue;
+        }
+        if (pe.block_id >= books_hdr.block_count || pe.length == 0) {
+            out[i].status = -17;
+            continue;
+        }
+        if (pe.block_id != cached_block) {
+            jh_u64 entry_offset = books_hdr.index_offset + (jh_u64)pe.block_id * (jh_u64)sizeof(jh_block_index_entry);
+            if (fseek(books_fp, (long)entry_offset, SEEK_SET) != 0 ||
+                fread(&block_entry, 1, sizeof(block_entry), books_fp) != sizeof(block_entry)) {
+                out[i].status = -20;
+                continue;
+            }
+            cached_block = pe.block_id;
+        }
+        reads[read_count].file_offset = block_entry.compressed_offset + (jh_u64)pe.offset_in_block;
+        reads[read_count].block_id = pe.block_id;
+        reads[read_count].offset_in_block = pe.offset_in_block;
+        reads[read_count].length = pe.length;
+        reads[read_count].slot = i;
+        read_count++;
+    }
+    fclose(pages_fp);
+    qsort(reads, read_count, sizeof(jh_page_batch_read), jh_page_batch_read_cmp);
+
+    if (books_hdr.compression != JH_BOOKS_COMPRESSION_NONE) {
+        /* Compressed blocks go through one reader; offset order makes pages of a block hit its cache slot. */
+        jh_books_reader reader;
+        fclose(books_fp);
+        if (jh_books_reader_open(books_path, &reader) != 0) {
+            free(reads);
+            return -3;
+        }
+        for (r = 0; r < read_count; ++r) {
+            if (jh_page_arena_reserve(arena, reads[r].length) != 0) {
+                jh_books_reader_close(&reader);
+                free(reads);
+                return -18;
+            }
+            if (jh_books_reader_read(&reader, reads[r].block_id, reads[r].offset_in_block, reads[r].length, arena->data + arena->len) != 0) {
+                out[reads[r].slot].status = -22;
+                continue;
+            }
+            out[reads[r].slot].length = reads[r].length;
+            out[reads[r].slot].status = 0;
+            reads[r].file_offset = arena->len;
+            arena->len += reads[r].length;
+        }
+        jh_books_reader_close(&reader);
+        books_fp = NULL;
+    }
+
+    /* Coalesce pages whose byte ranges sit within JH_PAGE_BATCH_GAP of each other into one read. */
+    r = books_fp ? 0 : read_count;
+    while (r < read_count) {
+        jh_u64 run_start = reads[r].file_offset;
+        jh_u64 run_end = run_start + reads[r].length;
+        size_t run_first = r;
+        size_t need;
+        size_t k;
+        for (++r; r < read_count && reads[r].file_offset <= run_end + JH_PAGE_BATCH_GAP; ++r) {
+            jh_u64 e = reads[r].file_offset + reads[r].length;
+            if (e > run_end) {
+                run_end = e;
+            }
+        }
+        need = arena->len + (size_t)(run_end - run_start);
+        if (jh_page_arena_reserve(arena, (size_t)(run_end - run_start)) != 0) {
+            fclose(books_fp);
+            free(reads);
+            return -18;
+        }
+        if (fseek(books_fp, (long)run_start, SEEK_SET) != 0 ||
+            fread(arena->data + arena->len, 1, (size_t)(run_end - run_start), books_fp) != (size_t)(run_end - run_start)) {
+            for (k = run_first; k < r; ++k) {
+                out[reads[k].slot].status = -22;
+            }
+            continue;
+        }
+        for (k = run_first; k < r; ++k) {
+            jh_page_slice *ps = &out[reads[k].slot];
+            /* text is fixed up to a pointer once the arena stops growing. */
+            ps->text = NULL;
+            ps->length = reads[k].length;
+            ps->status = 0;
+            reads[k].file_offset = arena->len + (reads[k].file_offset - run_start);
+        }
+        arena->len = need;
+    }
+    if (books_fp) {
+        fclose(books_fp);
+    }
+    for (r = 0; r < read_count; ++r) {
+        if (out[reads[r].slot].status == 0) {
+            out[reads[r].slot].text = arena->data + reads[r].file_offset;
+        }
+    }
+    free(reads);
+    return 0;
+}
+
 typedef struct {
     jh_u64 path_hash;
     jh_u64 word_hash;
     jh_word_dict_entry entry;
     int valid;
     jh_u64 age;
+    jh_u32 inline_len;
+    jh_u8 inline_data[JH_WORD_DICT_INLINE_MAX];
 } jh_word_dict_cache_entry;
 
 #define JH_WORD_DICT_CACHE_CAP 64
@@ -292,7 +582,7 @@ int jh_word_dict_lookup(const char *path, jh_u64 word_hash, jh_word_dict_entry *
         fclose(f);
         return -3;
     }
-    if (memcmp(hdr.magic, "WDIX", 4) != 0 || hdr.version != 1) {
+    if (memcmp(hdr.magic, "WDIX", 4) != 0 || (hdr.version != 1 && hdr.version != 2)) {
         fclose(f);
         return -4;
     }
@@ -311,16 +601,27 @@ int jh_word_dict_lookup(const char *path, jh_u64 word_hash, jh_word_dict_entry *
             return -6;
         }
         if (entry.word_hash == word_hash) {
+            jh_word_dict_cache_entry *ce = &jh_word_dict_cache[victim];
+            ce->inline_len = 0;
+            if (entry.postings_offset & JH_POSTINGS_REF_INLINE) {
+                jh_u32 len = JH_POSTINGS_REF_INLINE_LENGTH(entry.postings_offset);
+                long inline_offset = (long)(sizeof(hdr) + hdr.entry_count * (jh_u64)sizeof(entry) +
+                                            JH_POSTINGS_REF_INLINE_OFFSET(entry.postings_offset));
+                if (len > JH_WORD_DICT_INLINE_MAX || fseek(f, inline_offset, SEEK_SET) != 0 ||
+                    fread(ce->inline_data, 1, len, f) != len) {
+                    fclose(f);
+                    ce->valid = 0;
+                    return -7;
+                }
+                ce->inline_len = len;
+            }
             *out = entry;
             fclose(f);
-            {
-                jh_word_dict_cache_entry *ce = &jh_word_dict_cache[victim];
-                ce->path_hash = path_hash;
-                ce->word_hash = word_hash;
-                ce->entry = entry;
-                ce->valid = 1;
-                ce->age = jh_word_dict_cache_clock++;
-            }
+            ce->path_hash = path_hash;
+            ce->word_hash = word_hash;
+            ce->entry = entry;
+            ce->valid = 1;
+            ce->age = jh_word_dict_cache_clock++;
             return 0;
         } else if (entry.word_hash < word_hash) {
             lo = mid + 1;
@@ -333,97 +634,572 @@ int jh_word_dict_lookup(const char *path, jh_u64 word_hash, jh_word_dict_entry *
     return 1;
 }
 
-int jh_anno_open(const char *path, jh_anno_file_view *out) {
+/* jh_word_dict_inline_read copies an inline list out of the lookup cache, or from words.idx if it was evicted. */
+static int jh_word_dict_inline_read(const char *path, const jh_word_dict_entry *entry, jh_u8 *buf, jh_u32 *out_len) {
+    jh_u64 path_hash = jh_word_dict_path_hash(path);
+    jh_u32 len = JH_POSTINGS_REF_INLINE_LENGTH(entry->postings_offset);
+    jh_word_dict_header hdr;
     FILE *f;
-    long len;
-    jh_u8 *buf;
-    jh_anno_header hdr;
+    size_t i;
 
-    if (!path || !out) {
+    if (len == 0 || len > JH_WORD_DICT_INLINE_MAX) {
         return -1;
     }
+    for (i = 0; i < JH_WORD_DICT_CACHE_CAP; ++i) {
+        const jh_word_dict_cache_entry *ce = &jh_word_dict_cache[i];
+        if (ce->valid && ce->path_hash == path_hash && ce->word_hash == entry->word_hash &&
+            ce->entry.postings_offset == entry->postings_offset) {
+            memcpy(buf, ce->inline_data, len);
+            *out_len = len;
+            return 0;
+        }
+    }
+
     f = fopen(path, "rb");
     if (!f) {
         return -2;
     }
-    if (fseek(f, 0, SEEK_END) != 0) {
+    if (fread(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        fseek(f, (long)(sizeof(hdr) + hdr.entry_count * (jh_u64)sizeof(jh_word_dict_entry) +
+                        JH_POSTINGS_REF_INLINE_OFFSET(entry->postings_offset)), SEEK_SET) != 0 ||
+        fread(buf, 1, len, f) != len) {
         fclose(f);
         return -3;
     }
-    len = ftell(f);
-    if (len <= 0) {
-        fclose(f);
-        return -4;
-    }
-    if (fseek(f, 0, SEEK_SET) != 0) {
-        fclose(f);
-        return -5;
-    }
-    buf = (jh_u8 *)malloc((size_t)len);
-    if (!buf) {
-        fclose(f);
-        return -6;
-    }
-    if (fread(buf, 1, (size_t)len, f) != (size_t)len) {
-        free(buf);
-        fclose(f);
-        return -7;
-    }
     fclose(f);
+    *out_len = len;
+    return 0;
+}
 
-    if ((size_t)len < sizeof(jh_anno_header)) {
-        free(buf);
-        return -8;
+/* jh_word_postings_read resolves a dictionary entry to its list; inline lists never touch postings.bin. */
+int jh_word_postings_read(const char *words_idx_path, const jh_postings_file_view *view, const jh_word_dict_entry *entry, jh_postings_list *out) {
+    jh_u8 buf[JH_WORD_DICT_INLINE_MAX];
+    jh_u32 len = 0;
+
+    if (!entry || !out) {
+        return -1;
     }
-    memcpy(&hdr, buf, sizeof(jh_anno_header));
-    if (memcmp(hdr.magic, JH_ANNO_MAGIC, 4) != 0) {
-        free(buf);
-        return -9;
+    if (!(entry->postings_offset & JH_POSTINGS_REF_INLINE)) {
+        return jh_postings_file_list_read(view, entry->postings_offset, out);
     }
-    if (hdr.version != JH_ANNO_VERSION) {
-        free(buf);
-        return -10;
+    if (!words_idx_path || jh_word_dict_inline_read(words_idx_path, entry, buf, &len) != 0) {
+        return -2;
     }
+    return jh_postings_list_parse(buf, len, out);
+}
 
-    out->data = buf;
-    out->size = (size_t)len;
-    out->header = hdr;
-    out->comments = NULL;
-    out->formatting = NULL;
-    out->highlights = NULL;
-
-    if (hdr.comments_count && hdr.comments_offset) {
-        jh_u64 end = hdr.comments_offset + hdr.comments_count * (jh_u64)sizeof(jh_anno_comment_disk);
-        if (end <= (jh_u64)out->size) {
-            out->comments = (const jh_anno_comment_disk *)(buf + (size_t)hdr.comments_offset);
-        }
-    }
-    if (hdr.formatting_count && hdr.formatting_offset) {
-        jh_u64 end = hdr.formatting_offset + hdr.formatting_count * (jh_u64)sizeof(jh_anno_formatting_disk);
-        if (end <= (jh_u64)out->size) {
-            out->formatting = (const jh_anno_formatting_disk *)(buf + (size_t)hdr.formatting_offset);
-        }
+int jh_index_sibling_path(const char *path, const char *name, char *out, size_t cap) {
+    const char *slash;
+    size_t dir_len;
+    size_t name_len;
+    if (!path || !name || !out) {
+        return -1;
     }
-    if (hdr.highlights_count && hdr.highlights_offset) {
-        jh_u64 end = hdr.highlights_offset + hdr.highlights_count * (jh_u64)sizeof(jh_anno_highlight_disk);
-        if (end <= (jh_u64)out->size) {
-            out->highlights = (const jh_anno_highlight_disk *)(buf + (size_t)hdr.highlights_offset);
-        }
+    slash = strrchr(path, '/');
+    dir_len = slash ? (size_t)(slash - path + 1) : 0;
+    name_len = strlen(name);
+    if (dir_len + name_len + 1 > cap) {
+        return -2;
     }
-
+    memcpy(out, path, dir_len);
+    memcpy(out + dir_len, name, name_len + 1);
     return 0;
 }
 
-void jh_anno_close(jh_anno_file_view *view) {
-    if (!view) {
-        return;
+int jh_index_variant_path(const char *path, const char *suffix, char *out, size_t cap) {
+    const char *slash;
+    const char *dot;
+    size_t stem_len;
+    size_t suffix_len;
+    size_t ext_len;
+    if (!path || !suffix || !out) {
+        return -1;
     }
-    if (view->data) {
-        free((void *)view->data);
+    slash = strrchr(path, '/');
+    dot = strrchr(path, '.');
+    if (!dot || (slash && dot < slash)) {
+        dot = path + strlen(path);
     }
-    memset(view, 0, sizeof(*view));
-}
-
+    stem_len = (size_t)(dot - path);
+    suffix_len = strlen(suffix);
+    ext_len = strlen(dot);
+    if (stem_len + suffix_len + ext_len + 1 > cap) {
+        return -2;
+    }
+    memcpy(out, path, stem_len);
+    memcpy(out + stem_len, suffix, suffix_len);
+    memcpy(out + stem_len + suffix_len, dot, ext_len + 1);
+    return 0;
+}
+
+int jh_lexicon_open(const char *path, jh_lexicon_view *out) {
+    int fd;
+    struct stat st;
+    void *map;
+    jh_u64 index_bytes;
+
+    if (!path || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -2;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -3;
+    }
+    if ((size_t)st.st_size < sizeof(jh_lexicon_header)) {
+        close(fd);
+        return -4;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -5;
+    }
+    out->data = (const jh_u8 *)map;
+    out->size = (size_t)st.st_size;
+    memcpy(&out->header, map, sizeof(jh_lexicon_header));
+    index_bytes = out->header.block_count * (jh_u64)sizeof(jh_u64);
+    if (memcmp(out->header.magic, "WLEX", 4) != 0 || out->header.version != 1 ||
+        (out->header.block_count > 0 && out->header.block_terms == 0) ||
+        out->header.block_count > (jh_u64)out->size / sizeof(jh_u64) ||
+        out->header.block_index_offset > (jh_u64)out->size ||
+        (jh_u64)out->size - out->header.block_index_offset < index_bytes) {
+        jh_lexicon_close(out);
+        return -6;
+    }
+    return 0;
+}
+
+void jh_lexicon_close(jh_lexicon_view *view) {
+    if (!view) {
+        return;
+    }
+    if (view->data) {
+        munmap((void *)view->data, view->size);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+/* jh_lexicon_block_offset returns where block b starts, or 0 if the index entry points outside the blocks. */
+static jh_u64 jh_lexicon_block_offset(const jh_lexicon_view *view, jh_u64 b) {
+    jh_u64 offset;
+    memcpy(&offset, view->data + view->header.block_index_offset + b * sizeof(jh_u64), sizeof(offset));
+    if (offset < sizeof(jh_lexicon_header) || offset >= view->header.block_index_offset) {
+        return 0;
+    }
+    return offset;
+}
+
+/* jh_lexicon_term_cmp orders a term against prefix by bytes, treating any term that starts with prefix as equal. */
+static int jh_lexicon_term_cmp(const jh_u8 *term, size_t term_len, const char *prefix, size_t prefix_len) {
+    size_t n = term_len < prefix_len ? term_len : prefix_len;
+    int c = memcmp(term, prefix, n);
+    if (c != 0) {
+        return c;
+    }
+    return term_len < prefix_len ? -1 : 0;
+}
+
+/* jh_lexicon_iter decodes words.lex terms in order; term holds the current term's bytes. */
+typedef struct {
+    const jh_lexicon_view *view;
+    jh_u64 block;
+    jh_u64 offset;
+    jh_u64 term_index;
+    jh_u32 index_in_block;
+    jh_u8 term[JH_LEXICON_TERM_MAX];
+    size_t term_len;
+    jh_u64 hash;
+} jh_lexicon_iter;
+
+/* jh_lexicon_iter_block positions it before the first term of block b. */
+static int jh_lexicon_iter_block(jh_lexicon_iter *it, jh_u64 b) {
+    it->block = b;
+    it->term_index = b * it->view->header.block_terms;
+    it->index_in_block = 0;
+    it->term_len = 0;
+    it->offset = jh_lexicon_block_offset(it->view, b);
+    return it->offset == 0 ? -2 : 0;
+}
+
+/* jh_lexicon_iter_next decodes the next term; returns 1 on a term, 0 at the end and negative on corrupt data. */
+static int jh_lexicon_iter_next(jh_lexicon_iter *it) {
+    const jh_lexicon_view *view = it->view;
+    jh_u8 shared;
+    jh_u8 suffix;
+
+    if (it->term_index >= view->header.term_count) {
+        return 0;
+    }
+    if (it->index_in_block == view->header.block_terms) {
+        if (it->block + 1 >= view->header.block_count) {
+            return 0;
+        }
+        if (jh_lexicon_iter_block(it, it->block + 1) != 0) {
+            return -2;
+        }
+    }
+    if (it->offset + 2 > view->header.block_index_offset) {
+        return -3;
+    }
+    shared = view->data[it->offset];
+    suffix = view->data[it->offset + 1];
+    if (shared > it->term_len || (it->index_in_block == 0 && shared != 0) ||
+        (size_t)shared + suffix > sizeof(it->term) ||
+        it->offset + 2 + suffix + sizeof(jh_u64) > view->header.block_index_offset) {
+        return -3;
+    }
+    memcpy(it->term + shared, view->data + it->offset + 2, suffix);
+    it->term_len = (size_t)shared + suffix;
+    memcpy(&it->hash, view->data + it->offset + 2 + suffix, sizeof(it->hash));
+    it->offset += 2 + (jh_u64)suffix + sizeof(jh_u64);
+    it->index_in_block += 1;
+    it->term_index += 1;
+    return 1;
+}
+
+/* jh_lexicon_iter_seek positions it on the block where terms sorting at or after key begin. */
+static int jh_lexicon_iter_seek(jh_lexicon_iter *it, const jh_lexicon_view *view, const char *key, size_t key_len) {
+    jh_u64 lo = 0;
+    jh_u64 hi = view->header.block_count;
+
+    it->view = view;
+    /* Find the last block whose first term sorts before the key; matches start there or in the next block. */
+    while (hi - lo > 1) {
+        jh_u64 mid = lo + (hi - lo) / 2;
+        jh_u64 mo = jh_lexicon_block_offset(view, mid);
+        const jh_u8 *p;
+        if (mo == 0 || mo + 2 > view->header.block_index_offset) {
+            return -2;
+        }
+        p = view->data + mo;
+        if (jh_lexicon_term_cmp(p + 2, p[1], key, key_len) < 0) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return jh_lexicon_iter_block(it, lo);
+}
+
+int jh_lexicon_expand_prefix(const jh_lexicon_view *view, const char *prefix, size_t prefix_len, size_t max_terms, jh_u64 *out_hashes, size_t *out_count) {
+    jh_lexicon_iter it;
+    size_t count = 0;
+    int rc;
+
+    if (!view || !view->data || !prefix || !out_count || (max_terms > 0 && !out_hashes)) {
+        return -1;
+    }
+    *out_count = 0;
+    if (view->header.block_count == 0) {
+        return 0;
+    }
+    if (jh_lexicon_iter_seek(&it, view, prefix, prefix_len) != 0) {
+        return -2;
+    }
+    while ((rc = jh_lexicon_iter_next(&it)) == 1) {
+        int c = jh_lexicon_term_cmp(it.term, it.term_len, prefix, prefix_len);
+        if (c < 0) {
+            continue;
+        }
+        if (c > 0) {
+            break;
+        }
+        if (count == max_terms) {
+            *out_count = count;
+            return 1;
+        }
+        out_hashes[count++] = it.hash;
+    }
+    *out_count = count;
+    return rc < 0 ? rc : 0;
+}
+
+/* jh_utf8_next decodes one codepoint from s and returns its byte length (1 for malformed bytes). */
+static size_t jh_utf8_next(const jh_u8 *s, size_t len, jh_u32 *out_cp) {
+    jh_u8 c = s[0];
+    size_t n;
+    size_t i;
+    jh_u32 cp;
+    if (c < 0x80) {
+        *out_cp = c;
+        return 1;
+    } else if ((c & 0xe0) == 0xc0) {
+        n = 2;
+        cp = c & 0x1f;
+    } else if ((c & 0xf0) == 0xe0) {
+        n = 3;
+        cp = c & 0x0f;
+    } else if ((c & 0xf8) == 0xf0) {
+        n = 4;
+        cp = c & 0x07;
+    } else {
+        *out_cp = c;
+        return 1;
+    }
+    if (n > len) {
+        *out_cp = c;
+        return 1;
+    }
+    for (i = 1; i < n; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {
+            *out_cp = c;
+            return 1;
+        }
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+    *out_cp = cp;
+    return n;
+}
+
+int jh_lexicon_expand_fuzzy(const jh_lexicon_view *view, const char *term, size_t term_len, jh_u32 max_dist, size_t max_terms, jh_u64 *out_hashes, jh_u8 *out_dists, size_t *out_count) {
+    jh_u32 query[JH_LEXICON_FUZZY_MAX_CODEPOINTS];
+    size_t m = 0;
+    size_t pos = 0;
+    /* rows[d] is the edit-distance row after the first d codepoints of the current term. */
+    jh_u8 rows[JH_LEXICON_FUZZY_MAX_CODEPOINTS + 4][JH_LEXICON_FUZZY_MAX_CODEPOINTS + 1];
+    size_t depth_end[JH_LEXICON_FUZZY_MAX_CODEPOINTS + 4];
+    jh_u8 prev[JH_LEXICON_TERM_MAX];
+    size_t prev_len = 0;
+    size_t depth = 0;
+    size_t max_depth;
+    size_t count = 0;
+    size_t truncated = 0;
+    jh_lexicon_iter it;
+    int rc;
+    size_t j;
+
+    if (!view || !view->data || !term || !out_count || max_dist > 2 || (max_terms > 0 && (!out_hashes || !out_dists))) {
+        return -1;
+    }
+    *out_count = 0;
+    while (pos < term_len) {
+        if (m == JH_LEXICON_FUZZY_MAX_CODEPOINTS) {
+            return -1;
+        }
+        pos += jh_utf8_next((const jh_u8 *)term + pos, term_len - pos, &query[m]);
+        m++;
+    }
+    if (view->header.block_count == 0) {
+        return 0;
+    }
+    max_depth = m + max_dist;
+    for (j = 0; j <= m; ++j) {
+        rows[0][j] = (jh_u8)j;
+    }
+    depth_end[0] = 0;
+
+    if (jh_lexicon_iter_seek(&it, view, "", 0) != 0) {
+        return -2;
+    }
+    rc = jh_lexicon_iter_next(&it);
+    while (rc == 1) {
+        size_t shared = 0;
+        size_t dead_depth = 0;
+        jh_u8 dist;
+
+        /* Keep the rows of the codepoints this term shares with the previous one. */
+        while (shared < prev_len && shared < it.term_len && prev[shared] == it.term[shared]) {
+            shared++;
+        }
+        while (depth > 0 && depth_end[depth] > shared) {
+            depth--;
+        }
+        while (depth_end[depth] < it.term_len && !dead_depth) {
+            jh_u32 cp;
+            size_t n = jh_utf8_next(it.term + depth_end[depth], it.term_len - depth_end[depth], &cp);
+            const jh_u8 *up = rows[depth];
+            jh_u8 *row = rows[depth + 1];
+            jh_u8 row_min;
+            row[0] = (jh_u8)(depth + 1 < 255 ? depth + 1 : 255);
+            row_min = row[0];
+            for (j = 1; j <= m; ++j) {
+                jh_u32 best = (jh_u32)up[j - 1] + (query[j - 1] != cp);
+                if ((jh_u32)up[j] + 1 < best) {
+                    best = (jh_u32)up[j] + 1;
+                }
+                if ((jh_u32)row[j - 1] + 1 < best) {
+                    best = (jh_u32)row[j - 1] + 1;
+                }
+                row[j] = (jh_u8)(best < 255 ? best : 255);
+                if (row[j] < row_min) {
+                    row_min = row[j];
+                }
+            }
+            depth_end[depth + 1] = depth_end[depth] + n;
+            depth++;
+            if (row_min > max_dist || depth > max_depth) {
+                dead_depth = depth;
+            }
+        }
+        memcpy(prev, it.term, it.term_len);
+        prev_len = it.term_len;
+
+        if (dead_depth) {
+            /* No term with this prefix can match: jump past all of them. */
+            char key[JH_LEXICON_TERM_MAX];
+            size_t key_len = depth_end[dead_depth];
+            memcpy(key, it.term, key_len);
+            while (key_len > 0 && (jh_u8)key[key_len - 1] == 0xff) {
+                key_len--;
+            }
+            if (key_len == 0) {
+                rc = 0;
+                break;
+            }
+            key[key_len - 1] = (char)((jh_u8)key[key_len - 1] + 1);
+            if (jh_lexicon_iter_seek(&it, view, key, key_len) != 0) {
+                return -2;
+            }
+            while ((rc = jh_lexicon_iter_next(&it)) == 1 && jh_lexicon_term_cmp(it.term, it.term_len, key, key_len) < 0) {
+            }
+            prev_len = 0;
+            depth = 0;
+            continue;
+        }
+        dist = rows[depth][m];
+        if (dist <= max_dist) {
+            if (count == max_terms) {
+                truncated = 1;
+                break;
+            }
+            out_hashes[count] = it.hash;
+            out_dists[count] = dist;
+            count++;
+        }
+        rc = jh_lexicon_iter_next(&it);
+    }
+    *out_count = count;
+    if (rc < 0) {
+        return rc;
+    }
+    return truncated ? 1 : 0;
+}
+
+int jh_word_postings_read_filtered(const char *words_idx_path, const jh_postings_file_view *view, const jh_word_dict_entry *entry, const jh_page_filter *filter, jh_postings_list *out) {
+    jh_u8 buf[JH_WORD_DICT_INLINE_MAX];
+    jh_u32 len = 0;
+    const jh_u8 *data;
+    size_t size;
+    jh_u8 *scratch = NULL;
+    size_t scratch_cap = 0;
+    int rc;
+
+    if (!filter || !filter->active) {
+        return jh_word_postings_read(words_idx_path, view, entry, out);
+    }
+    if (!entry || !out) {
+        return -1;
+    }
+    if (entry->postings_offset & JH_POSTINGS_REF_INLINE) {
+        if (!words_idx_path || jh_word_dict_inline_read(words_idx_path, entry, buf, &len) != 0) {
+            return -2;
+        }
+        return jh_postings_list_parse_filtered(buf, len, filter, out);
+    }
+    rc = jh_postings_file_block(view, entry->postings_offset, &data, &size, &scratch, &scratch_cap);
+    if (rc == 0) {
+        rc = jh_postings_list_parse_filtered(data, size, filter, out);
+    }
+    free(scratch);
+    return rc;
+}
+
+int jh_anno_open(const char *path, jh_anno_file_view *out) {
+    FILE *f;
+    long len;
+    jh_u8 *buf;
+    jh_anno_header hdr;
+
+    if (!path || !out) {
+        return -1;
+    }
+    f = fopen(path, "rb");
+    if (!f) {
+        return -2;
+    }
+    if (fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return -3;
+    }
+    len = ftell(f);
+    if (len <= 0) {
+        fclose(f);
+        return -4;
+    }
+    if (fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return -5;
+    }
+    buf = (jh_u8 *)malloc((size_t)len);
+    if (!buf) {
+        fclose(f);
+        return -6;
+    }
+    if (fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        free(buf);
+        fclose(f);
+        return -7;
+    }
+    fclose(f);
+
+    if ((size_t)len < sizeof(jh_anno_header)) {
+        free(buf);
+        return -8;
+    }
+    memcpy(&hdr, buf, sizeof(jh_anno_header));
+    if (memcmp(hdr.magic, JH_ANNO_MAGIC, 4) != 0) {
+        free(buf);
+        return -9;
+    }
+    if (hdr.version != JH_ANNO_VERSION) {
+        free(buf);
+        return -10;
+    }
+
+    out->data = buf;
+    out->size = (size_t)len;
+    out->header = hdr;
+    out->comments = NULL;
+    out->formatting = NULL;
+    out->highlights = NULL;
+
+    if (hdr.comments_count && hdr.comments_offset) {
+        jh_u64 end = hdr.comments_offset + hdr.comments_count * (jh_u64)sizeof(jh_anno_comment_disk);
+        if (end <= (jh_u64)out->size) {
+            out->comments = (const jh_anno_comment_disk *)(buf + (size_t)hdr.comments_offset);
+        }
+    }
+    if (hdr.formatting_count && hdr.formatting_offset) {
+        jh_u64 end = hdr.formatting_offset + hdr.formatting_count * (jh_u64)sizeof(jh_anno_formatting_disk);
+        if (end <= (jh_u64)out->size) {
+            out->formatting = (const jh_anno_formatting_disk *)(buf + (size_t)hdr.formatting_offset);
+        }
+    }
+    if (hdr.highlights_count && hdr.highlights_offset) {
+        jh_u64 end = hdr.highlights_offset + hdr.highlights_count * (jh_u64)sizeof(jh_anno_highlight_disk);
+        if (end <= (jh_u64)out->size) {
+            out->highlights = (const jh_anno_highlight_disk *)(buf + (size_t)hdr.highlights_offset);
+        }
+    }
+
+    return 0;
+}
+
+void jh_anno_close(jh_anno_file_view *view) {
+    if (!view) {
+        return;
+    }
+    if (view->data) {
+        free((void *)view->data);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
 static void jh_anno_find_page_range_comments(const jh_anno_comment_disk *arr, size_t n, jh_u32 page_id, size_t *first_index, size_t *count) {
     size_t lo = 0;
     size_t hi = n;
@@ -671,243 +1447,1268 @@ void jh_postings_list_free(jh_postings_list *list) {
 }
 
 int jh_postings_list_read(const char *path, jh_u64 offset, jh_postings_list *out) {
-    FILE *f;
-    jh_postings_file_header hdr;
-    jh_u8 len_buf[4];
-    jh_u32 block_size;
-    jh_u8 *comp_buf = NULL;
-    jh_u8 *plain_buf = NULL;
-    size_t plain_size = 0;
+    jh_postings_file_view view;
     int rc;
 
     if (!path || !out) {
         return -1;
     }
-
-    if (jh_read_postings_file_header(path, &hdr) != 0) {
+    if (jh_postings_file_open(path, &view) != 0) {
         return -2;
     }
+    rc = jh_postings_file_list_read(&view, offset, out);
+    jh_postings_file_close(&view);
+    return rc != 0 ? -10 : 0;
+}
 
-    f = fopen(path, "rb");
-    if (!f) {
-        return -3;
+int jh_postings_block_read(const char *path, jh_u64 offset, jh_u8 **out_buf, size_t *out_size) {
+    jh_postings_file_view view;
+    const jh_u8 *data;
+    size_t size;
+    jh_u8 *scratch = NULL;
+    size_t scratch_cap = 0;
+    jh_u8 *copy;
+
+    if (!path || !out_buf || !out_size) {
+        return -1;
     }
-    if (fseek(f, (long)offset, SEEK_SET) != 0) {
-        fclose(f);
-        return -4;
+    if (jh_postings_file_open(path, &view) != 0) {
+        return -2;
     }
-    if (fread(len_buf, 1, 4, f) != 4) {
-        fclose(f);
-        return -5;
+    if (jh_postings_file_block(&view, offset, &data, &size, &scratch, &scratch_cap) != 0) {
+        free(scratch);
+        jh_postings_file_close(&view);
+        return -9;
     }
-    block_size = jh_read_u32_le(len_buf);
-    if (block_size == 0) {
-        fclose(f);
-        return -6;
+    if (data == scratch) {
+        *out_buf = scratch;
+        *out_size = size;
+        jh_postings_file_close(&view);
+        return 0;
     }
-
-    comp_buf = (jh_u8 *)malloc(block_size);
-    if (!comp_buf) {
-        fclose(f);
+    copy = (jh_u8 *)malloc(size ? size : 1);
+    if (!copy) {
+        free(scratch);
+        jh_postings_file_close(&view);
         return -7;
     }
-    if (fread(comp_buf, 1, block_size, f) != block_size) {
-        free(comp_buf);
-        fclose(f);
-        return -8;
+    memcpy(copy, data, size);
+    free(scratch);
+    jh_postings_file_close(&view);
+    *out_buf = copy;
+    *out_size = size;
+    return 0;
+}
+
+/* jh_postings_list_intersect computes the document-level AND of two postings lists. */
+int jh_postings_list_intersect(const jh_postings_list *a, const jh_postings_list *b, jh_postings_list *out) {
+    jh_u32 i;
+    jh_u32 j;
+    jh_u32 k;
+    jh_posting_entry *entries;
+    jh_u32 max_entries;
+
+    if (!a || !b || !out) {
+        return -1;
     }
-    fclose(f);
 
-    rc = jh_decompress_block_if_needed(&hdr, comp_buf, block_size, &plain_buf, &plain_size);
-    free(comp_buf);
+    memset(out, 0, sizeof(*out));
+
+    if (!a->entries || !b->entries) {
+        return 0;
+    }
+
+    max_entries = a->entry_count < b->entry_count ? a->entry_count : b->entry_count;
+    entries = (jh_posting_entry *)malloc(sizeof(jh_posting_entry) * max_entries);
+    if (!entries) {
+        return -2;
+    }
+
+    i = 0;
+    j = 0;
+    k = 0;
+
+    while (i < a->entry_count && j < b->entry_count) {
+        jh_u32 da = a->entries[i].page_id;
+        jh_u32 db = b->entries[j].page_id;
+        if (da == db) {
+            entries[k].page_id = da;
+            entries[k].term_freq = a->entries[i].term_freq + b->entries[j].term_freq;
+            entries[k].positions = NULL;
+            k += 1;
+            i += 1;
+            j += 1;
+        } else if (da < db) {
+            i += 1;
+        } else {
+            j += 1;
+        }
+    }
+
+    out->entries = entries;
+    out->entry_count = k;
+    out->positions_storage = NULL;
+    out->positions_count = 0;
+
+    return 0;
+}
+
+static int jh_u32_cmp(const void *a, const void *b) {
+    jh_u32 va = *(const jh_u32 *)a;
+    jh_u32 vb = *(const jh_u32 *)b;
+    if (va < vb) return -1;
+    if (va > vb) return 1;
+    return 0;
+}
+
+int jh_postings_list_union(const jh_postings_list *lists, size_t count, jh_postings_list *out) {
+    return jh_postings_list_union_weighted(lists, NULL, count, out, NULL);
+}
+
+int jh_postings_list_union_weighted(const jh_postings_list *lists, const double *weights, size_t count, jh_postings_list *out, double **out_hit_weights) {
+    size_t total_entries = 0;
+    size_t total_positions = 0;
+    size_t *heads;
+    jh_posting_entry *entries;
+    jh_u32 *positions;
+    double *hit_weights = NULL;
+    size_t i;
+    jh_u32 k = 0;
+    size_t p = 0;
+
+    if (!lists || !out || (out_hit_weights && !weights)) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    if (out_hit_weights) {
+        *out_hit_weights = NULL;
+    }
+    for (i = 0; i < count; ++i) {
+        jh_u32 j;
+        total_entries += lists[i].entry_count;
+        for (j = 0; j < lists[i].entry_count; ++j) {
+            total_positions += lists[i].entries[j].term_freq;
+        }
+    }
+    if (total_entries == 0) {
+        return 0;
+    }
+
+    heads = (size_t *)calloc(count, sizeof(size_t));
+    entries = (jh_posting_entry *)malloc(sizeof(jh_posting_entry) * total_entries);
+    positions = (jh_u32 *)malloc(sizeof(jh_u32) * (total_positions ? total_positions : 1));
+    if (out_hit_weights) {
+        hit_weights = (double *)malloc(sizeof(double) * total_entries);
+    }
+    if (!heads || !entries || !positions || (out_hit_weights && !hit_weights)) {
+        free(heads);
+        free(entries);
+        free(positions);
+        free(hit_weights);
+        return -2;
+    }
+
+    for (;;) {
+        jh_u32 page_id = 0;
+        jh_u32 tf = 0;
+        double weighted_tf = 0.0;
+        double max_weight = 0.0;
+        int found = 0;
+        int sources = 0;
+        for (i = 0; i < count; ++i) {
+            if (heads[i] < lists[i].entry_count &&
+                (!found || lists[i].entries[heads[i]].page_id < page_id)) {
+                page_id = lists[i].entries[heads[i]].page_id;
+                found = 1;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        for (i = 0; i < count; ++i) {
+            const jh_posting_entry *e;
+            if (heads[i] >= lists[i].entry_count || lists[i].entries[heads[i]].page_id != page_id) {
+                continue;
+            }
+            e = &lists[i].entries[heads[i]];
+            if (e->term_freq > 0) {
+                memcpy(positions + p + tf, e->positions, sizeof(jh_u32) * e->term_freq);
+            }
+            tf += e->term_freq;
+            if (hit_weights) {
+                weighted_tf += weights[i] * (double)e->term_freq;
+                max_weight = weights[i] > max_weight ? weights[i] : max_weight;
+            }
+            sources += 1;
+            heads[i] += 1;
+        }
+        if (sources > 1) {
+            qsort(positions + p, tf, sizeof(jh_u32), jh_u32_cmp);
+        }
+        entries[k].page_id = page_id;
+        entries[k].term_freq = tf;
+        entries[k].positions = positions + p;
+        if (hit_weights) {
+            hit_weights[k] = tf ? weighted_tf / (double)tf : max_weight;
+        }
+        p += tf;
+        k += 1;
+    }
+    free(heads);
+
+    out->entries = entries;
+    out->entry_count = k;
+    out->positions_storage = positions;
+    out->positions_count = (jh_u32)p;
+    if (out_hit_weights) {
+        *out_hit_weights = hit_weights;
+    }
+    return 0;
+}
+
+/* jh_postings_cursor_init prepares a streaming cursor over an encoded postings buffer. */
+int jh_postings_cursor_init(jh_postings_cursor *cur, const jh_u8 *data, size_t size) {
+    if (!cur || !data) {
+        return -1;
+    }
+    if (size < 4) {
+        return -2;
+    }
+    cur->data = data;
+    cur->size = size;
+    cur->offset = 4;
+    cur->doc_count = jh_read_u32_le(data);
+    cur->index = 0;
+    cur->current_page_id = 0;
+    return 0;
+}
+
+/* jh_postings_cursor_next decodes the next posting into caller-provided buffers. */
+int jh_postings_cursor_next(jh_postings_cursor *cur, jh_posting_entry *out, jh_u32 *pos_buf, jh_u32 pos_buf_cap) {
+    jh_u32 doc_delta;
+    jh_u32 term_freq;
+    jh_u32 j;
+    jh_u32 pos;
+
+    if (!cur || !out || !pos_buf) {
+        return -1;
+    }
+
+    if (cur->index >= cur->doc_count) {
+        return 1;
+    }
+
+    if (cur->size - cur->offset < 8) {
+        return -2;
+    }
+
+    doc_delta = jh_read_u32_le(cur->data + cur->offset);
+    cur->offset += 4;
+    term_freq = jh_read_u32_le(cur->data + cur->offset);
+    cur->offset += 4;
+
+    if (term_freq > pos_buf_cap) {
+        return -3;
+    }
+    if (cur->size - cur->offset < (size_t)term_freq * 4) {
+        return -2;
+    }
+
+    cur->current_page_id += doc_delta;
+    out->page_id = cur->current_page_id;
+    out->term_freq = term_freq;
+    out->positions = pos_buf;
+
+    pos = 0;
+    for (j = 0; j < term_freq; ++j) {
+        jh_u32 d = jh_read_u32_le(cur->data + cur->offset);
+        cur->offset += 4;
+        pos += d;
+        pos_buf[j] = pos;
+    }
+
+    cur->index += 1;
+
+    return 0;
+}
+
+/* jh_postings_cursor_skip_to moves past every posting below target without decoding positions; 1 at end of list. */
+static int jh_postings_cursor_skip_to(jh_postings_cursor *cur, jh_u32 target) {
+    while (cur->index < cur->doc_count) {
+        jh_u32 doc_delta;
+        jh_u32 term_freq;
+        if (cur->size - cur->offset < 8) {
+            return -2;
+        }
+        doc_delta = jh_read_u32_le(cur->data + cur->offset);
+        if (cur->current_page_id + doc_delta >= target) {
+            return 0;
+        }
+        term_freq = jh_read_u32_le(cur->data + cur->offset + 4);
+        if (cur->size - cur->offset - 8 < (size_t)term_freq * 4) {
+            return -2;
+        }
+        cur->offset += 8 + (size_t)term_freq * 4;
+        cur->current_page_id += doc_delta;
+        cur->index += 1;
+    }
+    return 1;
+}
+
+/* jh_postings_cursor_advance_to yields the first posting with page_id >= target, skipping the rest unread. */
+int jh_postings_cursor_advance_to(jh_postings_cursor *cur, jh_u32 target, jh_posting_entry *out, jh_u32 *pos_buf, jh_u32 pos_buf_cap) {
+    int rc;
+    if (!cur || !out || !pos_buf) {
+        return -1;
+    }
+    rc = jh_postings_cursor_skip_to(cur, target);
+    if (rc != 0) {
+        return rc;
+    }
+    return jh_postings_cursor_next(cur, out, pos_buf, pos_buf_cap);
+}
+
+/* jh_scratch_reserve grows a caller-owned decode buffer to at least need bytes. */
+static int jh_scratch_reserve(jh_u8 **scratch, size_t *scratch_cap, size_t need) {
+    jh_u8 *nb;
+    if (!scratch || !scratch_cap) {
+        return -1;
+    }
+    if (need <= *scratch_cap && *scratch) {
+        return 0;
+    }
+    nb = (jh_u8 *)realloc(*scratch, need ? need : 1);
+    if (!nb) {
+        return -1;
+    }
+    *scratch = nb;
+    *scratch_cap = need ? need : 1;
+    return 0;
+}
+
+/* jh_postings_block_decode turns one stored block into plain list bytes, decoding into scratch only when needed. */
+int jh_postings_block_decode(const jh_postings_file_header *hdr, const void *codec_dict, const jh_u8 *block, size_t block_size, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap) {
+    jh_u32 codec;
+    jh_u32 plain_size;
+    const jh_u8 *payload;
+    size_t payload_size;
+
+    if (!hdr || !block || !out_data || !out_size) {
+        return -1;
+    }
+    if (!(hdr->flags & JH_POSTINGS_FLAG_BLOCK_CODEC)) {
+        if (!(hdr->flags & JH_POSTINGS_FLAG_ZSTD)) {
+            *out_data = block;
+            *out_size = block_size;
+            return 0;
+        }
+#ifdef JH_HAVE_ZSTD
+        {
+            unsigned long long content_size = ZSTD_getFrameContentSize(block, block_size);
+            ZSTD_DCtx *dctx = jh_thread_dctx();
+            size_t dsize;
+            if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size > SIZE_MAX) {
+                return -5;
+            }
+            if (!dctx || jh_scratch_reserve(scratch, scratch_cap, (size_t)content_size) != 0) {
+                return -6;
+            }
+            dsize = ZSTD_decompressDCtx(dctx, *scratch, *scratch_cap, block, block_size);
+            if (ZSTD_isError(dsize) || dsize != content_size) {
+                return -7;
+            }
+            *out_data = *scratch;
+            *out_size = dsize;
+            return 0;
+        }
+#else
+        return -4;
+#endif
+    }
+
+    if (block_size < 1) {
+        return -2;
+    }
+    codec = block[0];
+    if (codec == JH_POSTINGS_CODEC_RAW) {
+        *out_data = block + 1;
+        *out_size = block_size - 1;
+        return 0;
+    }
+    if (block_size < 5) {
+        return -2;
+    }
+    plain_size = jh_read_u32_le(block + 1);
+    payload = block + 5;
+    payload_size = block_size - 5;
+    if (jh_scratch_reserve(scratch, scratch_cap, plain_size) != 0) {
+        return -6;
+    }
+
+    switch (codec) {
+#ifdef JH_HAVE_ZSTD
+    case JH_POSTINGS_CODEC_ZSTD:
+    case JH_POSTINGS_CODEC_ZSTD_DICT: {
+        ZSTD_DCtx *dctx = jh_thread_dctx();
+        size_t dsize;
+        if (!dctx) {
+            return -6;
+        }
+        if (codec == JH_POSTINGS_CODEC_ZSTD_DICT) {
+            if (!codec_dict) {
+                return -4;
+            }
+            dsize = ZSTD_decompress_usingDDict(dctx, *scratch, plain_size, payload, payload_size, (const ZSTD_DDict *)codec_dict);
+        } else {
+            dsize = ZSTD_decompressDCtx(dctx, *scratch, plain_size, payload, payload_size);
+        }
+        if (ZSTD_isError(dsize) || dsize != plain_size) {
+            return -7;
+        }
+        break;
+    }
+#endif
+#ifdef JH_HAVE_LZ4
+    case JH_POSTINGS_CODEC_LZ4: {
+        int dsize;
+        if (plain_size > (jh_u32)LZ4_MAX_INPUT_SIZE || payload_size > (size_t)LZ4_MAX_INPUT_SIZE) {
+            return -5;
+        }
+        dsize = LZ4_decompress_safe((const char *)payload, (char *)*scratch, (int)payload_size, (int)plain_size);
+        if (dsize < 0 || (jh_u32)dsize != plain_size) {
+            return -7;
+        }
+        break;
+    }
+#endif
+    default:
+        (void)codec_dict;
+        (void)payload;
+        (void)payload_size;
+        return -4;
+    }
+    *out_data = *scratch;
+    *out_size = plain_size;
+    return 0;
+}
+
+/* jh_postings_file_open maps postings.bin read-only and validates its header. */
+int jh_postings_file_open(const char *path, jh_postings_file_view *out) {
+    int fd;
+    struct stat st;
+    void *map;
+
+    if (!path || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -2;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -3;
+    }
+    if ((size_t)st.st_size < sizeof(jh_postings_file_header)) {
+        close(fd);
+        return -4;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -5;
+    }
+    memcpy(&out->header, map, sizeof(jh_postings_file_header));
+    if (memcmp(out->header.magic, "PSTB", 4) != 0) {
+        munmap(map, (size_t)st.st_size);
+        memset(out, 0, sizeof(*out));
+        return -6;
+    }
+    out->data = (const jh_u8 *)map;
+    out->size = (size_t)st.st_size;
+    if (out->header.flags & JH_POSTINGS_FLAG_BLOCK_CODEC) {
+        if (out->header.blocks_data_offset < (jh_u64)sizeof(jh_postings_file_header) ||
+            out->header.blocks_data_offset > (jh_u64)out->size ||
+            (jh_u64)out->size - out->header.blocks_data_offset < out->header.dict_size) {
+            jh_postings_file_close(out);
+            return -7;
+        }
+    }
+    if (out->header.block_count > 0) {
+        jh_u64 index_bytes = out->header.block_count * (jh_u64)sizeof(jh_postings_block_index_entry);
+        if (out->header.block_count > (jh_u64)out->size / sizeof(jh_postings_block_index_entry) ||
+            out->header.block_index_offset > (jh_u64)out->size ||
+            (jh_u64)out->size - out->header.block_index_offset < index_bytes) {
+            jh_postings_file_close(out);
+            return -9;
+        }
+    }
+    if (out->header.flags & JH_POSTINGS_FLAG_BLOCK_CODEC) {
+#ifdef JH_HAVE_ZSTD
+        if (out->header.dict_size > 0) {
+            out->codec_dict = ZSTD_createDDict(out->data + out->size - out->header.dict_size, out->header.dict_size);
+            if (!out->codec_dict) {
+                jh_postings_file_close(out);
+                return -8;
+            }
+        }
+#endif
+        if (out->header.block_count > 0) {
+            size_t i;
+            out->block_cache = (jh_postings_block_cache *)calloc(1, sizeof(jh_postings_block_cache));
+            if (!out->block_cache) {
+                jh_postings_file_close(out);
+                return -10;
+            }
+            for (i = 0; i < JH_POSTINGS_CACHE_BLOCKS; ++i) {
+                out->block_cache->slots[i].block_id = 0xffffffffu;
+            }
+        }
+    }
+    return 0;
+}
+
+/* jh_postings_file_close unmaps a postings file view. */
+void jh_postings_file_close(jh_postings_file_view *view) {
+    if (!view) {
+        return;
+    }
+#ifdef JH_HAVE_ZSTD
+    if (view->codec_dict) {
+        ZSTD_freeDDict((ZSTD_DDict *)view->codec_dict);
+    }
+#endif
+    if (view->block_cache) {
+        size_t i;
+        for (i = 0; i < JH_POSTINGS_CACHE_BLOCKS; ++i) {
+            free(view->block_cache->slots[i].buf);
+        }
+        free(view->block_cache);
+    }
+    if (view->data) {
+        munmap((void *)view->data, view->size);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+/* jh_postings_file_frame decodes the length-prefixed frame at offset, pointing into the mapping for raw frames. */
+static int jh_postings_file_frame(const jh_postings_file_view *view, jh_u64 offset, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap) {
+    jh_u32 block_size;
+    const jh_u8 *comp;
+
+    if (offset < view->header.blocks_data_offset || offset > (jh_u64)view->size || (jh_u64)view->size - offset < 4) {
+        return -2;
+    }
+    block_size = jh_read_u32_le(view->data + offset);
+    if (block_size == 0 || (jh_u64)view->size - offset - 4 < (jh_u64)block_size) {
+        return -3;
+    }
+    comp = view->data + offset + 4;
+    return jh_postings_block_decode(&view->header, view->codec_dict, comp, block_size, out_data, out_size, scratch, scratch_cap);
+}
+
+/* jh_postings_file_shared_block decodes one shared block located through the block index, going through the view's
+   block cache when it has one. */
+int jh_postings_file_shared_block(const jh_postings_file_view *view, jh_u32 block_id, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap) {
+    jh_postings_block_index_entry be;
+    jh_u64 entry_offset;
+    jh_postings_cache_slot *victim = NULL;
+    int rc;
+
+    if (!view || !view->data || !out_data || !out_size) {
+        return -1;
+    }
+    if ((jh_u64)block_id >= view->header.block_count) {
+        return -2;
+    }
+    entry_offset = view->header.block_index_offset + (jh_u64)block_id * sizeof(be);
+    memcpy(&be, view->data + entry_offset, sizeof(be));
+    if (view->block_cache) {
+        jh_postings_block_cache *bc = view->block_cache;
+        size_t i;
+        victim = &bc->slots[0];
+        for (i = 0; i < JH_POSTINGS_CACHE_BLOCKS; ++i) {
+            jh_postings_cache_slot *cs = &bc->slots[i];
+            if (cs->block_id == block_id) {
+                cs->age = ++bc->clock;
+                *out_data = cs->data;
+                *out_size = cs->size;
+                return 0;
+            }
+            if (cs->age < victim->age) {
+                victim = cs;
+            }
+        }
+        victim->block_id = 0xffffffffu;
+        scratch = &victim->buf;
+        scratch_cap = &victim->buf_cap;
+    }
+    rc = jh_postings_file_frame(view, be.compressed_offset, out_data, out_size, scratch, scratch_cap);
+    if (rc != 0) {
+        return rc;
+    }
+    if (*out_size != be.uncompressed_size || *out_size < 4) {
+        return -3;
+    }
+    if (victim) {
+        victim->block_id = block_id;
+        victim->age = ++view->block_cache->clock;
+        victim->data = *out_data;
+        victim->size = *out_size;
+    }
+    return 0;
+}
+
+/* jh_postings_file_block resolves a list to plain bytes, either its own frame or a member of a shared block. */
+int jh_postings_file_block(const jh_postings_file_view *view, jh_u64 offset, const jh_u8 **out_data, size_t *out_size, jh_u8 **scratch, size_t *scratch_cap) {
+    const jh_u8 *block;
+    size_t block_size;
+    jh_u32 member;
+    jh_u32 member_count;
+    jh_postings_block_member m;
+    int rc;
+
+    if (!view || !view->data || !out_data || !out_size) {
+        return -1;
+    }
+    if (!(offset & JH_POSTINGS_REF_PACKED)) {
+        return jh_postings_file_frame(view, offset, out_data, out_size, scratch, scratch_cap);
+    }
+
+    rc = jh_postings_file_shared_block(view, JH_POSTINGS_REF_BLOCK(offset), &block, &block_size, scratch, scratch_cap);
     if (rc != 0) {
+        return rc;
+    }
+    member = JH_POSTINGS_REF_MEMBER(offset);
+    member_count = jh_read_u32_le(block);
+    if (member >= member_count || (jh_u64)member_count * sizeof(m) > (jh_u64)block_size - 4) {
+        return -8;
+    }
+    memcpy(&m, block + 4 + (size_t)member * sizeof(m), sizeof(m));
+    if (m.length == 0 || (jh_u64)m.offset + m.length > (jh_u64)block_size) {
         return -9;
     }
+    *out_data = block + m.offset;
+    *out_size = m.length;
+    return 0;
+}
+
+/* jh_postings_file_cursor starts a cursor over the list at offset, reading the mapped bytes directly. */
+int jh_postings_file_cursor(const jh_postings_file_view *view, jh_u64 offset, jh_postings_cursor *cur, jh_u8 **scratch, size_t *scratch_cap) {
+    const jh_u8 *data;
+    size_t size;
+    int rc;
 
-    rc = jh_postings_list_parse(plain_buf, plain_size, out);
-    free(plain_buf);
+    if (!cur) {
+        return -1;
+    }
+    rc = jh_postings_file_block(view, offset, &data, &size, scratch, scratch_cap);
     if (rc != 0) {
-        return -10;
+        return rc;
+    }
+    return jh_postings_cursor_init(cur, data, size);
+}
+
+/* jh_postings_file_list_read materializes a list from the mapping without an intermediate copy. */
+int jh_postings_file_list_read(const jh_postings_file_view *view, jh_u64 offset, jh_postings_list *out) {
+    const jh_u8 *data;
+    size_t size;
+    jh_u8 *scratch = NULL;
+    size_t scratch_cap = 0;
+    int rc;
+
+    if (!out) {
+        return -1;
+    }
+    rc = jh_postings_file_block(view, offset, &data, &size, &scratch, &scratch_cap);
+    if (rc != 0) {
+        free(scratch);
+        return rc;
+    }
+    rc = jh_postings_list_parse(data, size, out);
+    free(scratch);
+    return rc;
+}
+
+/* jh_page_filter_add appends [first, end) to the filter; jh_page_filter_normalize sorts and merges afterwards. */
+static int jh_page_filter_add(jh_page_filter *f, jh_u32 first, jh_u32 end) {
+    if (first >= end) {
+        return 0;
+    }
+    if (f->count == f->cap) {
+        size_t nc = f->cap ? f->cap * 2 : 64;
+        jh_page_range *nr = (jh_page_range *)realloc(f->ranges, nc * sizeof(jh_page_range));
+        if (!nr) {
+            return -1;
+        }
+        f->ranges = nr;
+        f->cap = nc;
     }
+    f->ranges[f->count].first = first;
+    f->ranges[f->count].end = end;
+    f->count += 1;
     return 0;
 }
 
-int jh_postings_block_read(const char *path, jh_u64 offset, jh_u8 **out_buf, size_t *out_size) {
+static int jh_page_range_cmp(const void *a, const void *b) {
+    const jh_page_range *ra = (const jh_page_range *)a;
+    const jh_page_range *rb = (const jh_page_range *)b;
+    if (ra->first != rb->first) {
+        return ra->first < rb->first ? -1 : 1;
+    }
+    return 0;
+}
+
+static void jh_page_filter_normalize(jh_page_filter *f) {
+    size_t i;
+    size_t k = 0;
+    if (f->count == 0) {
+        return;
+    }
+    qsort(f->ranges, f->count, sizeof(jh_page_range), jh_page_range_cmp);
+    for (i = 1; i < f->count; ++i) {
+        if (f->ranges[i].first <= f->ranges[k].end) {
+            if (f->ranges[i].end > f->ranges[k].end) {
+                f->ranges[k].end = f->ranges[i].end;
+            }
+        } else {
+            f->ranges[++k] = f->ranges[i];
+        }
+    }
+    f->count = k + 1;
+}
+
+/* jh_read_index_entries loads the entry table of a books.idx-style file (24-byte header, count at offset 8). */
+static int jh_read_index_entries(const char *path, const char magic[4], size_t entry_size, void **out_entries, jh_u32 *out_count) {
+    jh_books_index_header hdr;
     FILE *f;
-    jh_postings_file_header hdr;
-    jh_u8 len_buf[4];
-    jh_u32 block_size;
-    jh_u8 *comp_buf = NULL;
-    jh_u8 *plain_buf = NULL;
-    size_t plain_size = 0;
+    void *entries;
+
+    *out_entries = NULL;
+    *out_count = 0;
+    if (jh_read_header(path, &hdr, sizeof(hdr), magic) != 0) {
+        return -2;
+    }
+    f = fopen(path, "rb");
+    if (!f) {
+        return -2;
+    }
+    entries = malloc(entry_size * (hdr.book_count ? hdr.book_count : 1));
+    if (!entries) {
+        fclose(f);
+        return -3;
+    }
+    if (fseek(f, (long)sizeof(hdr), SEEK_SET) != 0 ||
+        fread(entries, entry_size, hdr.book_count, f) != hdr.book_count) {
+        free(entries);
+        fclose(f);
+        return -4;
+    }
+    fclose(f);
+    *out_entries = entries;
+    *out_count = hdr.book_count;
+    return 0;
+}
+
+/* jh_u32_in binary-searches an ascending id array. */
+static int jh_u32_in(const jh_u32 *ids, size_t count, jh_u32 id) {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ids[mid] == id) {
+            return 1;
+        } else if (ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0;
+}
+
+static int jh_book_meta_cmp(const void *a, const void *b) {
+    jh_u32 x = ((const jh_book_meta_entry *)a)->book_id;
+    jh_u32 y = ((const jh_book_meta_entry *)b)->book_id;
+    if (x != y) {
+        return x < y ? -1 : 1;
+    }
+    return 0;
+}
+
+/* jh_sort_ids copies count ids to out and sorts them so jh_u32_in can search them. */
+static void jh_sort_ids(const jh_u32 *ids, size_t count, jh_u32 *out) {
+    if (count == 0) {
+        return;
+    }
+    memcpy(out, ids, sizeof(jh_u32) * count);
+    qsort(out, count, sizeof(jh_u32), jh_u32_cmp);
+}
+
+/* jh_page_filter_compile sorts the spec's id lists and books_meta.idx by book id once, so each book and chapter is
+   matched with binary searches. */
+int jh_page_filter_compile(const jh_page_filter_spec *spec, const char *books_idx_path, const char *books_meta_path, const char *chapters_idx_path, jh_page_filter *out) {
+    static const char books_magic[4] = { 'B', 'K', 'I', 'X' };
+    static const char meta_magic[4] = { 'B', 'K', 'M', 'T' };
+    static const char chapters_magic[4] = { 'C', 'H', 'I', 'X' };
+    jh_book_index_entry *books = NULL;
+    jh_book_meta_entry *meta = NULL;
+    jh_u32 book_count = 0;
+    jh_u32 meta_count = 0;
+    jh_u32 *ids;
+    jh_u32 *book_ids;
+    jh_u32 *category_ids;
+    jh_u32 *author_ids;
+    jh_u32 *chapter_ids;
+    jh_u32 i;
+    int book_level;
+    int rc = 0;
+
+    if (!spec || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    book_level = spec->book_count > 0 || spec->category_count > 0 || spec->author_count > 0;
+    ids = (jh_u32 *)malloc(sizeof(jh_u32) * (spec->book_count + spec->category_count + spec->author_count + spec->chapter_count + 1));
+    if (!ids) {
+        return -4;
+    }
+    book_ids = ids;
+    category_ids = book_ids + spec->book_count;
+    author_ids = category_ids + spec->category_count;
+    chapter_ids = author_ids + spec->author_count;
+    jh_sort_ids(spec->book_ids, spec->book_count, book_ids);
+    jh_sort_ids(spec->category_ids, spec->category_count, category_ids);
+    jh_sort_ids(spec->author_ids, spec->author_count, author_ids);
+    jh_sort_ids(spec->chapter_ids, spec->chapter_count, chapter_ids);
+
+    if (book_level) {
+        if (!books_idx_path || jh_read_index_entries(books_idx_path, books_magic, sizeof(jh_book_index_entry), (void **)&books, &book_count) != 0) {
+            free(ids);
+            return -2;
+        }
+        if ((spec->category_count > 0 || spec->author_count > 0) &&
+            (!books_meta_path || jh_read_index_entries(books_meta_path, meta_magic, sizeof(jh_book_meta_entry), (void **)&meta, &meta_count) != 0)) {
+            free(books);
+            free(ids);
+            return -3;
+        }
+        if (meta_count > 0) {
+            qsort(meta, meta_count, sizeof(jh_book_meta_entry), jh_book_meta_cmp);
+        }
+        for (i = 0; i < book_count && rc == 0; ++i) {
+            const jh_book_index_entry *be = &books[i];
+            if (spec->book_count > 0 && !jh_u32_in(book_ids, spec->book_count, be->book_id)) {
+                continue;
+            }
+            if (spec->category_count > 0 || spec->author_count > 0) {
+                jh_book_meta_entry key;
+                const jh_book_meta_entry *me;
+                key.book_id = be->book_id;
+                me = meta_count > 0 ? (const jh_book_meta_entry *)bsearch(&key, meta, meta_count, sizeof(jh_book_meta_entry), jh_book_meta_cmp) : NULL;
+                if (!me ||
+                    (spec->category_count > 0 && !jh_u32_in(category_ids, spec->category_count, me->category_id)) ||
+                    (spec->author_count > 0 && !jh_u32_in(author_ids, spec->author_count, me->author_id))) {
+                    continue;
+                }
+            }
+            rc = jh_page_filter_add(out, be->first_page_id, be->first_page_id + be->page_count);
+        }
+        free(books);
+        free(meta);
+        if (rc != 0) {
+            free(ids);
+            jh_page_filter_free(out);
+            return -4;
+        }
+        jh_page_filter_normalize(out);
+    }
+
+    if (spec->chapter_count > 0) {
+        jh_chapter_index_entry *chapters = NULL;
+        jh_u32 chapter_count = 0;
+        jh_page_filter chap;
+        memset(&chap, 0, sizeof(chap));
+        if (!chapters_idx_path || jh_read_index_entries(chapters_idx_path, chapters_magic, sizeof(jh_chapter_index_entry), (void **)&chapters, &chapter_count) != 0) {
+            free(ids);
+            jh_page_filter_free(out);
+            return -5;
+        }
+        for (i = 0; i < chapter_count && rc == 0; ++i) {
+            if (jh_u32_in(chapter_ids, spec->chapter_count, chapters[i].chapter_id)) {
+                rc = jh_page_filter_add(&chap, chapters[i].first_page_id, chapters[i].first_page_id + chapters[i].page_count);
+            }
+        }
+        free(chapters);
+        if (rc != 0) {
+            free(ids);
+            jh_page_filter_free(&chap);
+            jh_page_filter_free(out);
+            return -4;
+        }
+        jh_page_filter_normalize(&chap);
+        if (book_level) {
+            /* Both kinds given: keep the pages inside a selected book and a selected chapter. */
+            jh_page_filter both;
+            size_t a = 0;
+            size_t b = 0;
+            memset(&both, 0, sizeof(both));
+            while (a < out->count && b < chap.count && rc == 0) {
+                jh_u32 first = out->ranges[a].first > chap.ranges[b].first ? out->ranges[a].first : chap.ranges[b].first;
+                jh_u32 end = out->ranges[a].end < chap.ranges[b].end ? out->ranges[a].end : chap.ranges[b].end;
+                rc = jh_page_filter_add(&both, first, end);
+                if (out->ranges[a].end < chap.ranges[b].end) {
+                    a++;
+                } else {
+                    b++;
+                }
+            }
+            jh_page_filter_free(&chap);
+            jh_page_filter_free(out);
+            if (rc != 0) {
+                free(ids);
+                jh_page_filter_free(&both);
+                return -4;
+            }
+            *out = both;
+        } else {
+            *out = chap;
+        }
+    }
+    free(ids);
+    out->active = book_level || spec->chapter_count > 0;
+    return 0;
+}
+
+void jh_page_filter_free(jh_page_filter *f) {
+    if (!f) {
+        return;
+    }
+    free(f->ranges);
+    memset(f, 0, sizeof(*f));
+}
+
+int jh_page_filter_contains(const jh_page_filter *f, jh_u32 page_id) {
+    size_t lo = 0;
+    size_t hi;
+    if (!f || !f->active) {
+        return 1;
+    }
+    hi = f->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (page_id < f->ranges[mid].first) {
+            hi = mid;
+        } else if (page_id >= f->ranges[mid].end) {
+            lo = mid + 1;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* jh_postings_filtered_walk visits the postings inside the filter's ranges, seeking the cursor past each gap.
+   It decodes them into entries/positions, or into soa when entries is NULL; with both NULL it only counts docs and
+   positions. */
+static int jh_postings_filtered_walk(const jh_u8 *data, size_t size, const jh_page_filter *filter, jh_posting_entry *entries, jh_u32 *positions, jh_postings_soa *soa, jh_u32 *out_docs, jh_u32 *out_positions) {
+    jh_postings_cursor cur;
+    jh_u32 docs = 0;
+    jh_u32 pos = 0;
+    size_t r;
+    int rc;
+
+    if (jh_postings_cursor_init(&cur, data, size) != 0) {
+        return -2;
+    }
+    for (r = 0; r < filter->count; ++r) {
+        rc = jh_postings_cursor_skip_to(&cur, filter->ranges[r].first);
+        if (rc == 1) {
+            break;
+        }
+        if (rc != 0) {
+            return rc;
+        }
+        while (cur.index < cur.doc_count) {
+            jh_u32 page_id;
+            jh_u32 term_freq;
+            if (cur.size - cur.offset < 8) {
+                return -2;
+            }
+            page_id = cur.current_page_id + jh_read_u32_le(cur.data + cur.offset);
+            if (page_id >= filter->ranges[r].end) {
+                break;
+            }
+            term_freq = jh_read_u32_le(cur.data + cur.offset + 4);
+            if (entries) {
+                rc = jh_postings_cursor_next(&cur, &entries[docs], positions + pos, term_freq);
+                if (rc != 0) {
+                    return -2;
+                }
+            } else if (soa) {
+                jh_posting_entry e;
+                rc = jh_postings_cursor_next(&cur, &e, soa->positions + pos, term_freq);
+                if (rc != 0) {
+                    return -2;
+                }
+                soa->page_ids[docs] = e.page_id;
+                soa->term_freqs[docs] = term_freq;
+                soa->position_starts[docs] = pos;
+            } else {
+                if (cur.size - cur.offset - 8 < (size_t)term_freq * 4) {
+                    return -2;
+                }
+                cur.offset += 8 + (size_t)term_freq * 4;
+                cur.current_page_id = page_id;
+                cur.index += 1;
+            }
+            docs += 1;
+            pos += term_freq;
+        }
+    }
+    *out_docs = docs;
+    *out_positions = pos;
+    return 0;
+}
+
+int jh_postings_list_parse_filtered(const jh_u8 *data, size_t data_size, const jh_page_filter *filter, jh_postings_list *out) {
+    jh_u32 docs = 0;
+    jh_u32 positions = 0;
     int rc;
 
-    if (!path || !out_buf || !out_size) {
+    if (!data || !out) {
         return -1;
     }
-
-    if (jh_read_postings_file_header(path, &hdr) != 0) {
-        return -2;
-    }
-
-    f = fopen(path, "rb");
-    if (!f) {
-        return -3;
+    if (!filter || !filter->active) {
+        return jh_postings_list_parse(data, data_size, out);
     }
-    if (fseek(f, (long)offset, SEEK_SET) != 0) {
-        fclose(f);
-        return -4;
+    memset(out, 0, sizeof(*out));
+    rc = jh_postings_filtered_walk(data, data_size, filter, NULL, NULL, NULL, &docs, &positions);
+    if (rc != 0 || docs == 0) {
+        return rc;
     }
-    if (fread(len_buf, 1, 4, f) != 4) {
-        fclose(f);
-        return -5;
+    out->entries = (jh_posting_entry *)malloc(sizeof(jh_posting_entry) * docs);
+    out->positions_storage = (jh_u32 *)malloc(sizeof(jh_u32) * (positions ? positions : 1));
+    if (!out->entries || !out->positions_storage) {
+        jh_postings_list_free(out);
+        return -3;
     }
-    block_size = jh_read_u32_le(len_buf);
-    if (block_size == 0) {
-        fclose(f);
-        return -6;
+    rc = jh_postings_filtered_walk(data, data_size, filter, out->entries, out->positions_storage, NULL, &docs, &positions);
+    if (rc != 0) {
+        jh_postings_list_free(out);
+        return rc;
     }
+    out->entry_count = docs;
+    out->positions_count = positions;
+    return 0;
+}
 
-    comp_buf = (jh_u8 *)malloc(block_size);
-    if (!comp_buf) {
-        fclose(f);
-        return -7;
+/* jh_soa_reserve grows one SoA column to at least need elements. */
+static int jh_soa_reserve(jh_u32 **col, jh_u32 need, jh_u32 old_cap) {
+    jh_u32 *nc;
+    if (need <= old_cap && *col) {
+        return 0;
     }
-    if (fread(comp_buf, 1, block_size, f) != block_size) {
-        free(comp_buf);
-        fclose(f);
-        return -8;
+    nc = (jh_u32 *)realloc(*col, sizeof(jh_u32) * (size_t)(need ? need : 1));
+    if (!nc) {
+        return -1;
     }
-    fclose(f);
+    *col = nc;
+    return 0;
+}
 
-    rc = jh_decompress_block_if_needed(&hdr, comp_buf, block_size, &plain_buf, &plain_size);
-    free(comp_buf);
-    if (rc != 0) {
-        return -9;
+/* jh_postings_soa_reserve makes room for doc_count docs and position_count positions in soa. */
+static int jh_postings_soa_reserve(jh_postings_soa *soa, jh_u32 doc_count, jh_u32 position_count) {
+    if (doc_count > soa->doc_cap || !soa->page_ids) {
+        if (jh_soa_reserve(&soa->page_ids, doc_count, soa->doc_cap) != 0 ||
+            jh_soa_reserve(&soa->term_freqs, doc_count, soa->doc_cap) != 0 ||
+            jh_soa_reserve(&soa->position_starts, doc_count, soa->doc_cap) != 0) {
+            return -3;
+        }
+        soa->doc_cap = doc_count ? doc_count : 1;
+    }
+    if (position_count > soa->positions_cap || !soa->positions) {
+        if (jh_soa_reserve(&soa->positions, position_count, soa->positions_cap) != 0) {
+            return -3;
+        }
+        soa->positions_cap = position_count ? position_count : 1;
     }
-
-    *out_buf = plain_buf;
-    *out_size = plain_size;
     return 0;
 }
 
-/* jh_postings_list_intersect computes the document-level AND of two postings lists. */
-int jh_postings_list_intersect(const jh_postings_list *a, const jh_postings_list *b, jh_postings_list *out) {
+/* jh_postings_soa_decode decodes a postings buffer into parallel page/tf/position arrays in one pass. */
+int jh_postings_soa_decode(const jh_u8 *data, size_t data_size, jh_postings_soa *soa) {
+    jh_u32 doc_count;
+    size_t offset;
+    size_t pos_bound;
     jh_u32 i;
-    jh_u32 j;
-    jh_u32 k;
-    jh_posting_entry *entries;
-    jh_u32 max_entries;
+    jh_u32 page_id = 0;
+    jh_u32 pos_out = 0;
 
-    if (!a || !b || !out) {
+    if (!data || !soa) {
         return -1;
     }
-
-    memset(out, 0, sizeof(*out));
-
-    if (!a->entries || !b->entries) {
-        return 0;
+    if (data_size < 4) {
+        return -2;
     }
-
-    max_entries = a->entry_count < b->entry_count ? a->entry_count : b->entry_count;
-    entries = (jh_posting_entry *)malloc(sizeof(jh_posting_entry) * max_entries);
-    if (!entries) {
+    doc_count = jh_read_u32_le(data);
+    if ((data_size - 4) / 8 < (size_t)doc_count) {
+        return -2;
+    }
+    pos_bound = (data_size - 4 - (size_t)doc_count * 8) / 4;
+    if (pos_bound > 0xffffffffu) {
         return -2;
     }
 
-    i = 0;
-    j = 0;
-    k = 0;
+    if (jh_postings_soa_reserve(soa, doc_count, (jh_u32)pos_bound) != 0) {
+        return -3;
+    }
 
-    while (i < a->entry_count && j < b->entry_count) {
-        jh_u32 da = a->entries[i].page_id;
-        jh_u32 db = b->entries[j].page_id;
-        if (da == db) {
-            entries[k].page_id = da;
-            entries[k].term_freq = a->entries[i].term_freq + b->entries[j].term_freq;
-            entries[k].positions = NULL;
-            k += 1;
-            i += 1;
-            j += 1;
-        } else if (da < db) {
-            i += 1;
-        } else {
-            j += 1;
+    offset = 4;
+    for (i = 0; i < doc_count; ++i) {
+        jh_u32 term_freq;
+        jh_u32 j;
+        jh_u32 pos = 0;
+
+        page_id += jh_read_u32_le(data + offset);
+        term_freq = jh_read_u32_le(data + offset + 4);
+        offset += 8;
+        if ((data_size - offset) / 4 < (size_t)term_freq) {
+            return -2;
+        }
+        soa->page_ids[i] = page_id;
+        soa->term_freqs[i] = term_freq;
+        soa->position_starts[i] = pos_out;
+        for (j = 0; j < term_freq; ++j) {
+            pos += jh_read_u32_le(data + offset);
+            offset += 4;
+            soa->positions[pos_out++] = pos;
         }
     }
 
-    out->entries = entries;
-    out->entry_count = k;
-    out->positions_storage = NULL;
-    out->positions_count = 0;
-
+    soa->doc_count = doc_count;
+    soa->positions_count = pos_out;
     return 0;
 }
 
-/* jh_postings_cursor_init prepares a streaming cursor over an encoded postings buffer. */
-int jh_postings_cursor_init(jh_postings_cursor *cur, const jh_u8 *data, size_t size) {
-    if (!cur || !data) {
+/* jh_postings_soa_decode_filtered counts the postings inside filter, then decodes them into soa in a second walk. */
+int jh_postings_soa_decode_filtered(const jh_u8 *data, size_t data_size, const jh_page_filter *filter, jh_postings_soa *soa) {
+    jh_u32 docs = 0;
+    jh_u32 positions = 0;
+    int rc;
+
+    if (!data || !soa) {
         return -1;
     }
-    if (size < 4) {
-        return -2;
+    if (!filter || !filter->active) {
+        return jh_postings_soa_decode(data, data_size, soa);
     }
-    cur->data = data;
-    cur->size = size;
-    cur->offset = 4;
-    cur->doc_count = jh_read_u32_le(data);
-    cur->index = 0;
-    cur->current_page_id = 0;
+    rc = jh_postings_filtered_walk(data, data_size, filter, NULL, NULL, NULL, &docs, &positions);
+    if (rc != 0) {
+        return rc;
+    }
+    if (jh_postings_soa_reserve(soa, docs, positions) != 0) {
+        return -3;
+    }
+    rc = jh_postings_filtered_walk(data, data_size, filter, NULL, NULL, soa, &docs, &positions);
+    if (rc != 0) {
+        return rc;
+    }
+    soa->doc_count = docs;
+    soa->positions_count = positions;
     return 0;
 }
 
-/* jh_postings_cursor_next decodes the next posting into caller-provided buffers. */
-int jh_postings_cursor_next(jh_postings_cursor *cur, jh_posting_entry *out, jh_u32 *pos_buf, jh_u32 pos_buf_cap) {
-    jh_u32 doc_delta;
-    jh_u32 term_freq;
-    jh_u32 j;
-    jh_u32 pos;
+/* jh_postings_soa_from_list copies an in-memory list column by column into soa. */
+int jh_postings_soa_from_list(const jh_postings_list *list, jh_postings_soa *soa) {
+    jh_u64 total = 0;
+    jh_u32 pos = 0;
+    jh_u32 i;
 
-    if (!cur || !out || !pos_buf) {
+    if (!list || !soa) {
         return -1;
     }
-
-    if (cur->index >= cur->doc_count) {
-        return 1;
+    for (i = 0; i < list->entry_count; ++i) {
+        total += list->entries[i].term_freq;
     }
-
-    if (cur->size - cur->offset < 8) {
+    if (total > 0xffffffffu) {
         return -2;
     }
-
-    doc_delta = jh_read_u32_le(cur->data + cur->offset);
-    cur->offset += 4;
-    term_freq = jh_read_u32_le(cur->data + cur->offset);
-    cur->offset += 4;
-
-    if (term_freq > pos_buf_cap) {
+    if (jh_postings_soa_reserve(soa, list->entry_count, (jh_u32)total) != 0) {
         return -3;
     }
-    if (cur->size - cur->offset < (size_t)term_freq * 4) {
-        return -2;
+    for (i = 0; i < list->entry_count; ++i) {
+        const jh_posting_entry *pe = &list->entries[i];
+        soa->page_ids[i] = pe->page_id;
+        soa->term_freqs[i] = pe->term_freq;
+        soa->position_starts[i] = pos;
+        if (pe->term_freq > 0) {
+            memcpy(soa->positions + pos, pe->positions, sizeof(jh_u32) * pe->term_freq);
+        }
+        pos += pe->term_freq;
     }
+    soa->doc_count = list->entry_count;
+    soa->positions_count = pos;
+    return 0;
+}
 
-    cur->current_page_id += doc_delta;
-    out->page_id = cur->current_page_id;
-    out->term_freq = term_freq;
-    out->positions = pos_buf;
+/* jh_postings_soa_free releases the arrays owned by a SoA postings decode. */
+void jh_postings_soa_free(jh_postings_soa *soa) {
+    if (!soa) {
+        return;
+    }
+    free(soa->page_ids);
+    free(soa->term_freqs);
+    free(soa->position_starts);
+    free(soa->positions);
+    memset(soa, 0, sizeof(*soa));
+}
 
-    pos = 0;
-    for (j = 0; j < term_freq; ++j) {
-        jh_u32 d = jh_read_u32_le(cur->data + cur->offset);
-        cur->offset += 4;
-        pos += d;
-        pos_buf[j] = pos;
+/* jh_u32_sorted_intersect merges two ascending arrays without data-dependent branches in the loop body; out may be a,
+   since each write lands at or behind the read position. */
+size_t jh_u32_sorted_intersect(const jh_u32 *a, size_t a_count, const jh_u32 *b, size_t b_count, jh_u32 *out) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    if (!a || !b || !out) {
+        return 0;
+    }
+    while (i < a_count && j < b_count) {
+        jh_u32 va = a[i];
+        jh_u32 vb = b[j];
+        out[k] = va;
+        k += (size_t)(va == vb);
+        i += (size_t)(va <= vb);
+        j += (size_t)(vb <= va);
     }
+    return k;
+}
 
-    cur->index += 1;
+/* jh_word_postings_read_soa decodes the pages of a dictionary entry's list admitted by filter into soa; mapped
+   uncompressed lists are decoded in place, and soa and scratch are reused across calls. */
+int jh_word_postings_read_soa(const char *words_idx_path, const jh_postings_file_view *view, const jh_word_dict_entry *entry, const jh_page_filter *filter, jh_postings_soa *soa, jh_u8 **scratch, size_t *scratch_cap) {
+    jh_u8 buf[JH_WORD_DICT_INLINE_MAX];
+    jh_u32 len = 0;
+    const jh_u8 *data;
+    size_t size;
+    int rc;
 
-    return 0;
+    if (!entry || !soa) {
+        return -1;
+    }
+    if (entry->postings_offset & JH_POSTINGS_REF_INLINE) {
+        if (!words_idx_path || jh_word_dict_inline_read(words_idx_path, entry, buf, &len) != 0) {
+            return -2;
+        }
+        return jh_postings_soa_decode_filtered(buf, len, filter, soa);
+    }
+    rc = jh_postings_file_block(view, entry->postings_offset, &data, &size, scratch, scratch_cap);
+    if (rc != 0) {
+        return rc;
+    }
+    return jh_postings_soa_decode_filtered(data, size, filter, soa);
 }
 
 /* jh_postings_and_cursor_init creates a streaming AND view over two postings cursors. */
@@ -1297,25 +3098,33 @@ static jh_posting_entry *jh_find_posting_in_list(const jh_postings_list *pl, jh_
     return NULL;
 }
 
-static int jh_phrase_matches_doc(const jh_posting_entry **entries, size_t term_count) {
+/* jh_phrase_matches_doc checks for a start position p with every component at p + offsets[i]. */
+static int jh_phrase_matches_doc(const jh_posting_entry **entries, const jh_u32 *offsets, size_t count, size_t base_idx) {
     const jh_posting_entry *base;
     jh_u32 i;
-    if (!entries || term_count == 0) {
+    if (!entries || count == 0) {
         return 0;
     }
-    base = entries[0];
+    base = entries[base_idx];
     for (i = 0; i < base->term_freq; ++i) {
-        jh_u32 pos0 = base->positions[i];
+        jh_u32 pos0;
         size_t t;
         int ok = 1;
-        for (t = 1; t < term_count; ++t) {
+        if (base->positions[i] < offsets[base_idx]) {
+            continue;
+        }
+        pos0 = base->positions[i] - offsets[base_idx];
+        for (t = 0; t < count; ++t) {
             const jh_posting_entry *pe = entries[t];
             const jh_u32 *pb = pe->positions;
             jh_u32 nb = pe->term_freq;
-            jh_u32 want = pos0 + (jh_u32)t;
+            jh_u32 want = pos0 + offsets[t];
             jh_u32 lo = 0;
             jh_u32 hi = nb;
             int found = 0;
+            if (t == base_idx) {
+                continue;
+            }
             while (lo < hi) {
                 jh_u32 mid = lo + (hi - lo) / 2;
                 jh_u32 v = pb[mid];
@@ -1341,11 +3150,141 @@ static int jh_phrase_matches_doc(const jh_posting_entry **entries, size_t term_c
 }
 
 int jh_phrase_search(const char *words_idx_path, const char *postings_path, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, size_t *out_page_count) {
-    jh_postings_list *lists = NULL;
+    return jh_phrase_search_filtered(NULL, words_idx_path, postings_path, NULL, hashes, hash_count, out_pages, out_page_count);
+}
+
+int jh_phrase_search_filtered(jh_search_workspace *ws, const char *words_idx_path, const char *postings_path, const jh_page_filter *filter, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, size_t *out_page_count) {
+    char bigram_words[1024];
+    char bigram_postings[1024];
+
+    if (!words_idx_path || !postings_path) {
+        return -1;
+    }
+    if (jh_index_variant_path(words_idx_path, "_bigram", bigram_words, sizeof(bigram_words)) != 0 ||
+        jh_index_variant_path(postings_path, "_bigram", bigram_postings, sizeof(bigram_postings)) != 0) {
+        return jh_phrase_search_bigram(ws, words_idx_path, postings_path, NULL, NULL, filter, hashes, hash_count, out_pages, out_page_count);
+    }
+    return jh_phrase_search_bigram(ws, words_idx_path, postings_path, bigram_words, bigram_postings, filter, hashes, hash_count, out_pages, out_page_count);
+}
+
+/* jh_search_workspace_reserve grows the per-component arrays of ws to hold count components. */
+static int jh_search_workspace_reserve(jh_search_workspace *ws, size_t count) {
+    jh_postings_soa *nl;
+    void *p;
+
+    if (count <= ws->component_cap) {
+        return 0;
+    }
+    nl = (jh_postings_soa *)realloc(ws->components, sizeof(jh_postings_soa) * count);
+    if (!nl) {
+        return -1;
+    }
+    memset(nl + ws->component_cap, 0, sizeof(jh_postings_soa) * (count - ws->component_cap));
+    ws->components = nl;
+    if (!(p = realloc(ws->offsets, sizeof(jh_u32) * count))) {
+        return -1;
+    }
+    ws->offsets = (jh_u32 *)p;
+    if (!(p = realloc(ws->heads, sizeof(jh_u32) * count))) {
+        return -1;
+    }
+    ws->heads = (jh_u32 *)p;
+    if (!(p = realloc(ws->covered, count))) {
+        return -1;
+    }
+    ws->covered = (unsigned char *)p;
+    if (!(p = realloc(ws->docs, sizeof(jh_posting_entry) * count))) {
+        return -1;
+    }
+    ws->docs = (jh_posting_entry *)p;
+    if (!(p = realloc(ws->entries, sizeof(const jh_posting_entry *) * count))) {
+        return -1;
+    }
+    ws->entries = (const jh_posting_entry **)p;
+    if (!(p = realloc(ws->term_weights, sizeof(double) * count))) {
+        return -1;
+    }
+    ws->term_weights = (double *)p;
+    ws->component_cap = count;
+    return 0;
+}
+
+/* jh_u32_buf_reserve grows a workspace array to at least need values. */
+static int jh_u32_buf_reserve(jh_u32 **buf, size_t *cap, size_t need) {
+    jh_u32 *nb;
+    if (need <= *cap && *buf) {
+        return 0;
+    }
+    nb = (jh_u32 *)realloc(*buf, sizeof(jh_u32) * (need ? need : 1));
+    if (!nb) {
+        return -1;
+    }
+    *buf = nb;
+    *cap = need ? need : 1;
+    return 0;
+}
+
+jh_postings_soa *jh_search_workspace_terms(jh_search_workspace *ws, size_t count) {
+    jh_postings_soa *nt;
+    if (!ws) {
+        return NULL;
+    }
+    if (count > ws->term_cap) {
+        nt = (jh_postings_soa *)realloc(ws->terms, sizeof(jh_postings_soa) * count);
+        if (!nt) {
+            return NULL;
+        }
+        memset(nt + ws->term_cap, 0, sizeof(jh_postings_soa) * (count - ws->term_cap));
+        ws->terms = nt;
+        ws->term_cap = count;
+    }
+    return ws->terms;
+}
+
+void jh_search_workspace_free(jh_search_workspace *ws) {
+    size_t i;
+    if (!ws) {
+        return;
+    }
+    for (i = 0; i < ws->term_cap; ++i) {
+        jh_postings_soa_free(&ws->terms[i]);
+    }
+    for (i = 0; i < ws->component_cap; ++i) {
+        jh_postings_soa_free(&ws->components[i]);
+    }
+    free(ws->terms);
+    free(ws->components);
+    free(ws->offsets);
+    free(ws->heads);
+    free(ws->covered);
+    free(ws->docs);
+    free(ws->entries);
+    free(ws->term_weights);
+    free(ws->pages);
+    free(ws->candidates);
+    free(ws->phrase_sorted);
+    free(ws->scratch);
+    memset(ws, 0, sizeof(*ws));
+}
+
+/* jh_phrase_search_bigram answers a phrase from bigram lists where the pair is indexed and unigram lists for the rest.
+   Components are decoded as SoA through filter, seeking past the excluded pages; the shortest one's pages are
+   intersected with the others' page arrays and only the surviving pages get a position check. A phrase has at most
+   hash_count components, whatever its length. */
+int jh_phrase_search_bigram(jh_search_workspace *ws, const char *words_idx_path, const char *postings_path, const char *bigram_words_path, const char *bigram_postings_path, const jh_page_filter *filter, const jh_u64 *hashes, size_t hash_count, jh_u32 **out_pages, size_t *out_page_count) {
+    jh_search_workspace local;
+    jh_postings_soa *lists;
+    size_t count = 0;
     size_t i;
     size_t result_cap = 0;
     size_t result_count = 0;
     jh_u32 *result_pages = NULL;
+    jh_postings_file_view view;
+    jh_postings_file_view bigram_view;
+    int have_view = 0;
+    int have_bigrams = 0;
+    int missing = 0;
+    int rc = 0;
 
     if (!words_idx_path || !postings_path || !hashes || hash_count == 0 || !out_pages || !out_page_count) {
         return -1;
@@ -1355,99 +3294,121 @@ int jh_phrase_search(const char *words_idx_path, const char *postings_path, cons
         return -2;
     }
 
-    lists = (jh_postings_list *)calloc(hash_count, sizeof(jh_postings_list));
-    if (!lists) {
-        free(lists);
-        return -3;
+    *out_pages = NULL;
+    *out_page_count = 0;
+    if (!ws) {
+        memset(&local, 0, sizeof(local));
+        ws = &local;
+    }
+    if (jh_search_workspace_reserve(ws, hash_count) != 0) {
+        rc = -5;
+    } else if (jh_postings_file_open(postings_path, &view) != 0) {
+        rc = -4;
+    } else {
+        have_view = 1;
+    }
+    if (rc == 0 && bigram_words_path && bigram_postings_path && jh_postings_file_open(bigram_postings_path, &bigram_view) == 0) {
+        have_bigrams = 1;
     }
 
-    for (i = 0; i < hash_count; ++i) {
+    lists = ws->components;
+    if (rc == 0) {
+        memset(ws->covered, 0, hash_count);
+    }
+    for (i = 0; rc == 0 && have_bigrams && i + 1 < hash_count; ++i) {
+        jh_word_dict_entry e;
+        if (jh_word_dict_lookup(bigram_words_path, jh_hash_pair_64(hashes[i], hashes[i + 1]), &e) != 0 || e.postings_count == 0) {
+            continue;
+        }
+        if (jh_word_postings_read_soa(bigram_words_path, &bigram_view, &e, filter, &lists[count], &ws->scratch, &ws->scratch_cap) != 0) {
+            rc = -4;
+            break;
+        }
+        ws->offsets[count++] = (jh_u32)i;
+        ws->covered[i] = 1;
+        ws->covered[i + 1] = 1;
+    }
+    for (i = 0; rc == 0 && !missing && i < hash_count; ++i) {
         jh_word_dict_entry e;
+        if (ws->covered[i]) {
+            continue;
+        }
         if (jh_word_dict_lookup(words_idx_path, hashes[i], &e) != 0 || e.postings_count == 0) {
-            size_t k;
-            for (k = 0; k < i; ++k) {
-                jh_postings_list_free(&lists[k]);
-            }
-            free(lists);
-            *out_pages = NULL;
-            *out_page_count = 0;
-            return 0;
+            missing = 1;
+            break;
         }
-        if (jh_postings_list_read(postings_path, e.postings_offset, &lists[i]) != 0) {
-            size_t k;
-            for (k = 0; k <= i; ++k) {
-                jh_postings_list_free(&lists[k]);
-            }
-            free(lists);
-            return -4;
+        if (jh_word_postings_read_soa(words_idx_path, &view, &e, filter, &lists[count], &ws->scratch, &ws->scratch_cap) != 0) {
+            rc = -4;
+            break;
         }
+        ws->offsets[count++] = (jh_u32)i;
+    }
+    if (have_view) {
+        jh_postings_file_close(&view);
+    }
+    if (have_bigrams) {
+        jh_postings_file_close(&bigram_view);
     }
 
-    {
+    if (rc == 0 && !missing && count > 0) {
         size_t base_idx = 0;
-        jh_u32 d;
-        const jh_postings_list *base = &lists[0];
-        if (hash_count > 1) {
-            for (i = 1; i < hash_count; ++i) {
-                if (lists[i].entry_count < base->entry_count) {
-                    base = &lists[i];
-                    base_idx = i;
+        size_t candidate_count = 0;
+        size_t c;
+        for (i = 1; i < count; ++i) {
+            if (lists[i].doc_count < lists[base_idx].doc_count) {
+                base_idx = i;
+            }
+        }
+        if (jh_u32_buf_reserve(&ws->candidates, &ws->candidate_cap, lists[base_idx].doc_count) != 0) {
+            rc = -5;
+        } else {
+            candidate_count = lists[base_idx].doc_count;
+            memcpy(ws->candidates, lists[base_idx].page_ids, sizeof(jh_u32) * candidate_count);
+            for (i = 0; i < count && candidate_count > 0; ++i) {
+                if (i != base_idx) {
+                    candidate_count = jh_u32_sorted_intersect(ws->candidates, candidate_count, lists[i].page_ids, lists[i].doc_count, ws->candidates);
                 }
             }
         }
-        for (i = 0; i < base->entry_count; ++i) {
-            const jh_posting_entry *base_entry = &base->entries[i];
-            const jh_posting_entry *entries[32];
+        memset(ws->heads, 0, sizeof(jh_u32) * count);
+        for (c = 0; rc == 0 && c < candidate_count; ++c) {
+            jh_u32 d = ws->candidates[c];
             size_t t;
-            if (hash_count > 32) {
-                break;
-            }
-            d = base_entry->page_id;
-            entries[base_idx] = base_entry;
-            for (t = 0; t < hash_count; ++t) {
-                if (t == base_idx) {
-                    continue;
-                }
-                entries[t] = jh_find_posting_in_list(&lists[t], d);
-                if (!entries[t]) {
-                    break;
+            /* Candidates ascend and occur in every list, so each list's head only moves forward. */
+            for (t = 0; t < count; ++t) {
+                const jh_postings_soa *l = &lists[t];
+                while (l->page_ids[ws->heads[t]] != d) {
+                    ws->heads[t]++;
                 }
+                ws->docs[t].page_id = d;
+                ws->docs[t].term_freq = l->term_freqs[ws->heads[t]];
+                ws->docs[t].positions = l->positions + l->position_starts[ws->heads[t]];
+                ws->entries[t] = &ws->docs[t];
             }
-            if (t != hash_count) {
+            if (!jh_phrase_matches_doc(ws->entries, ws->offsets, count, base_idx)) {
                 continue;
             }
-            {
-                const jh_posting_entry *ordered[32];
-                size_t k;
-                for (k = 0; k < hash_count; ++k) {
-                    ordered[k] = entries[k];
-                }
-                if (jh_phrase_matches_doc(ordered, hash_count)) {
-                    if (result_count == result_cap) {
-                        size_t new_cap = result_cap ? result_cap * 2 : 16;
-                        jh_u32 *np = (jh_u32 *)realloc(result_pages, new_cap * sizeof(jh_u32));
-                        if (!np) {
-                            size_t m;
-                            for (m = 0; m < hash_count; ++m) {
-                                jh_postings_list_free(&lists[m]);
-                            }
-                            free(lists);
-                            free(result_pages);
-                            return -5;
-                        }
-                        result_pages = np;
-                        result_cap = new_cap;
-                    }
-                    result_pages[result_count++] = d;
+            if (result_count == result_cap) {
+                size_t new_cap = result_cap ? result_cap * 2 : 16;
+                jh_u32 *np = (jh_u32 *)realloc(result_pages, new_cap * sizeof(jh_u32));
+                if (!np) {
+                    rc = -5;
+                    break;
                 }
+                result_pages = np;
+                result_cap = new_cap;
             }
+            result_pages[result_count++] = d;
         }
     }
 
-    for (i = 0; i < hash_count; ++i) {
-        jh_postings_list_free(&lists[i]);
+    if (ws == &local) {
+        jh_search_workspace_free(&local);
+    }
+    if (rc != 0) {
+        free(result_pages);
+        return rc;
     }
-    free(lists);
 
     *out_pages = result_pages;
     *out_page_count = result_count;
@@ -1546,14 +3507,6 @@ int jh_phrase_search_multi(const char **words_idx_paths, const char **postings_p
     return 0;
 }
 
-static int jh_u32_cmp(const void *a, const void *b) {
-    jh_u32 va = *(const jh_u32 *)a;
-    jh_u32 vb = *(const jh_u32 *)b;
-    if (va < vb) return -1;
-    if (va > vb) return 1;
-    return 0;
-}
-
 static int jh_ranked_hit_cmp_desc(const void *a, const void *b) {
     const jh_ranked_hit *ha = (const jh_ranked_hit *)a;
     const jh_ranked_hit *hb = (const jh_ranked_hit *)b;
@@ -1564,7 +3517,150 @@ static int jh_ranked_hit_cmp_desc(const void *a, const void *b) {
     return 0;
 }
 
+int jh_facets_open(const char *path, jh_facets_view *out) {
+    int fd;
+    struct stat st;
+    void *map;
+    jh_u64 need;
+
+    if (!path || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -2;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -3;
+    }
+    if ((size_t)st.st_size < sizeof(jh_facets_header)) {
+        close(fd);
+        return -4;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -5;
+    }
+    out->data = (const jh_u8 *)map;
+    out->size = (size_t)st.st_size;
+    memcpy(&out->header, map, sizeof(jh_facets_header));
+    need = sizeof(jh_facets_header) + ((jh_u64)out->header.page_count + 2 * (jh_u64)out->header.book_slots) * sizeof(jh_u32);
+    if (memcmp(out->header.magic, "FCOL", 4) != 0 || out->header.version != 1 || need > (jh_u64)out->size) {
+        jh_facets_close(out);
+        return -6;
+    }
+    out->page_book = (const jh_u32 *)(out->data + sizeof(jh_facets_header));
+    out->book_category = out->page_book + out->header.page_count;
+    out->book_author = out->book_category + out->header.book_slots;
+    return 0;
+}
+
+void jh_facets_close(jh_facets_view *view) {
+    if (!view) {
+        return;
+    }
+    if (view->data) {
+        munmap((void *)view->data, view->size);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+int jh_facet_counts_init(const jh_facets_view *view, jh_facet_counts *out) {
+    if (!view || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    out->book_slots = view->header.book_slots;
+    out->category_slots = view->header.category_slots;
+    out->author_slots = view->header.author_slots;
+    out->book_counts = (jh_u32 *)calloc(out->book_slots ? out->book_slots : 1, sizeof(jh_u32));
+    out->category_counts = (jh_u32 *)calloc(out->category_slots ? out->category_slots : 1, sizeof(jh_u32));
+    out->author_counts = (jh_u32 *)calloc(out->author_slots ? out->author_slots : 1, sizeof(jh_u32));
+    if (!out->book_counts || !out->category_counts || !out->author_counts) {
+        jh_facet_counts_free(out);
+        return -2;
+    }
+    return 0;
+}
+
+void jh_facet_counts_free(jh_facet_counts *counts) {
+    if (!counts) {
+        return;
+    }
+    free(counts->book_counts);
+    free(counts->category_counts);
+    free(counts->author_counts);
+    memset(counts, 0, sizeof(*counts));
+}
+
+/* jh_facet_count_page adds one hit on page_id to its book, category and author counters. */
+static void jh_facet_count_page(const jh_facets_view *facets, jh_facet_counts *counts, jh_u32 page_id) {
+    jh_u32 book;
+    jh_u32 v;
+    if (page_id >= facets->header.page_count) {
+        return;
+    }
+    book = facets->page_book[page_id];
+    if (book >= facets->header.book_slots || book >= counts->book_slots) {
+        return;
+    }
+    counts->book_counts[book] += 1;
+    v = facets->book_category[book];
+    if (v < counts->category_slots) {
+        counts->category_counts[v] += 1;
+    }
+    v = facets->book_author[book];
+    if (v < counts->author_slots) {
+        counts->author_counts[v] += 1;
+    }
+}
+
 int jh_rank_results(const jh_postings_list *lists, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, jh_ranked_hit **out_hits, size_t *out_hit_count) {
+    return jh_rank_results_faceted(lists, list_count, require_all_terms, phrase_pages, phrase_page_count, NULL, NULL, out_hits, out_hit_count);
+}
+
+int jh_rank_results_faceted(const jh_postings_list *lists, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, const jh_facets_view *facets, jh_facet_counts *counts, jh_ranked_hit **out_hits, size_t *out_hit_count) {
+    return jh_rank_results_weighted(lists, NULL, list_count, require_all_terms, phrase_pages, phrase_page_count, facets, counts, out_hits, out_hit_count);
+}
+
+int jh_rank_results_weighted(const jh_postings_list *lists, const double *const *hit_weights, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, const jh_facets_view *facets, jh_facet_counts *counts, jh_ranked_hit **out_hits, size_t *out_hit_count) {
+    jh_search_workspace ws;
+    jh_postings_soa *terms = NULL;
+    size_t i;
+    int rc = 0;
+
+    if (!out_hits || !out_hit_count) {
+        return -1;
+    }
+    *out_hits = NULL;
+    *out_hit_count = 0;
+    if (!lists || list_count == 0) {
+        return 0;
+    }
+    memset(&ws, 0, sizeof(ws));
+    terms = jh_search_workspace_terms(&ws, list_count);
+    if (!terms) {
+        rc = -2;
+    }
+    for (i = 0; rc == 0 && i < list_count; ++i) {
+        if (jh_postings_soa_from_list(&lists[i], &terms[i]) != 0) {
+            rc = -2;
+        }
+    }
+    if (rc == 0) {
+        rc = jh_rank_results_soa(&ws, terms, hit_weights, list_count, require_all_terms, phrase_pages, phrase_page_count, facets, counts, out_hits, out_hit_count);
+    }
+    jh_search_workspace_free(&ws);
+    return rc;
+}
+
+/* jh_rank_results_soa scores pages in ascending order, so each list is walked once by a head that only moves forward
+   instead of being searched per page. Every scratch array comes from ws; only the returned hits are allocated. */
+int jh_rank_results_soa(jh_search_workspace *ws, const jh_postings_soa *lists, const double *const *hit_weights, size_t list_count, int require_all_terms, const jh_u32 *phrase_pages, size_t phrase_page_count, const jh_facets_view *facets, jh_facet_counts *counts, jh_ranked_hit **out_hits, size_t *out_hit_count) {
+    jh_search_workspace local;
     size_t i;
     size_t total_docs = 0;
     jh_u32 *pages;
@@ -1575,7 +3671,10 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
     const double prox_weight = 2.0;
     const double phrase_weight = 5.0;
     jh_u32 *phrase_sorted = NULL;
-    double *term_weights = NULL;
+    size_t candidate_count = 0;
+    const jh_u32 *scan;
+    size_t scan_count;
+    int rc = 0;
 
     if (!out_hits || !out_hit_count) {
         return -1;
@@ -1589,29 +3688,51 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
     }
 
     for (i = 0; i < list_count; ++i) {
-        total_docs += lists[i].entry_count;
+        total_docs += lists[i].doc_count;
     }
     if (total_docs == 0) {
         return 0;
     }
 
-    pages = (jh_u32 *)malloc(sizeof(jh_u32) * total_docs);
-    if (!pages) {
-        return -2;
+    if (!ws) {
+        memset(&local, 0, sizeof(local));
+        ws = &local;
+    }
+    if (jh_search_workspace_reserve(ws, list_count) != 0 || jh_u32_buf_reserve(&ws->pages, &ws->page_cap, total_docs) != 0) {
+        rc = -2;
     }
 
-    for (i = 0; i < list_count; ++i) {
-        jh_u32 j;
-        for (j = 0; j < lists[i].entry_count; ++j) {
-            pages[page_count++] = lists[i].entries[j].page_id;
-        }
+    pages = ws->pages;
+    for (i = 0; rc == 0 && i < list_count; ++i) {
+        memcpy(pages + page_count, lists[i].page_ids, sizeof(jh_u32) * lists[i].doc_count);
+        page_count += lists[i].doc_count;
     }
 
-    qsort(pages, page_count, sizeof(jh_u32), jh_u32_cmp);
+    /* With every term required, only pages in the intersection of the lists' page runs can score. */
+    if (rc == 0 && require_all_terms) {
+        size_t base_idx = 0;
+        for (i = 1; i < list_count; ++i) {
+            if (lists[i].doc_count < lists[base_idx].doc_count) {
+                base_idx = i;
+            }
+        }
+        if (jh_u32_buf_reserve(&ws->candidates, &ws->candidate_cap, lists[base_idx].doc_count) != 0) {
+            rc = -6;
+        } else {
+            candidate_count = lists[base_idx].doc_count;
+            memcpy(ws->candidates, lists[base_idx].page_ids, sizeof(jh_u32) * candidate_count);
+            for (i = 0; i < list_count && candidate_count > 0; ++i) {
+                if (i != base_idx) {
+                    candidate_count = jh_u32_sorted_intersect(ws->candidates, candidate_count, lists[i].page_ids, lists[i].doc_count, ws->candidates);
+                }
+            }
+        }
+    }
 
-    {
+    if (rc == 0) {
         size_t w = 0;
         size_t r;
+        qsort(pages, page_count, sizeof(jh_u32), jh_u32_cmp);
         for (r = 0; r < page_count; ++r) {
             if (w == 0 || pages[r] != pages[w - 1]) {
                 pages[w++] = pages[r];
@@ -1620,41 +3741,38 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
         page_count = w;
     }
 
-    if (phrase_pages && phrase_page_count > 0) {
-        phrase_sorted = (jh_u32 *)malloc(sizeof(jh_u32) * phrase_page_count);
-        if (!phrase_sorted) {
-            free(pages);
-            return -3;
+    if (rc == 0 && phrase_pages && phrase_page_count > 0) {
+        if (jh_u32_buf_reserve(&ws->phrase_sorted, &ws->phrase_cap, phrase_page_count) != 0) {
+            rc = -3;
+        } else {
+            phrase_sorted = ws->phrase_sorted;
+            memcpy(phrase_sorted, phrase_pages, sizeof(jh_u32) * phrase_page_count);
+            qsort(phrase_sorted, phrase_page_count, sizeof(jh_u32), jh_u32_cmp);
         }
-        memcpy(phrase_sorted, phrase_pages, sizeof(jh_u32) * phrase_page_count);
-        qsort(phrase_sorted, phrase_page_count, sizeof(jh_u32), jh_u32_cmp);
     }
 
-    term_weights = (double *)malloc(sizeof(double) * list_count);
-    if (!term_weights) {
-        free(pages);
-        free(phrase_sorted);
-        return -4;
-    }
-    for (i = 0; i < list_count; ++i) {
-        jh_u32 df = lists[i].entry_count;
-        if (df == 0) {
-            term_weights[i] = 0.0;
-        } else {
-            term_weights[i] = (double)page_count / (double)df;
+    if (rc == 0) {
+        for (i = 0; i < list_count; ++i) {
+            jh_u32 df = lists[i].doc_count;
+            ws->term_weights[i] = df == 0 ? 0.0 : (double)page_count / (double)df;
+            ws->heads[i] = 0;
+        }
+        hits = (jh_ranked_hit *)malloc(sizeof(jh_ranked_hit) * page_count);
+        if (!hits) {
+            rc = -5;
         }
     }
-
-    hits = (jh_ranked_hit *)malloc(sizeof(jh_ranked_hit) * page_count);
-    if (!hits) {
-        free(pages);
-        free(phrase_sorted);
-        free(term_weights);
-        return -5;
+    if (rc != 0) {
+        if (ws == &local) {
+            jh_search_workspace_free(&local);
+        }
+        return rc;
     }
 
-    for (i = 0; i < page_count; ++i) {
-        jh_u32 d = pages[i];
+    scan = require_all_terms ? ws->candidates : pages;
+    scan_count = require_all_terms ? candidate_count : page_count;
+    for (i = 0; i < scan_count; ++i) {
+        jh_u32 d = scan[i];
         double freq_score = 0.0;
         double prox_score = 0.0;
         double phrase_score = 0.0;
@@ -1662,11 +3780,18 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
         int has_any = 0;
         int has_all = 1;
 
+        /* Advance every head to d; heads[t] is then the entry of d in list t when the list has it. */
         for (t = 0; t < list_count; ++t) {
-            jh_posting_entry *pe = jh_find_posting_in_list(&lists[t], d);
-            if (pe) {
+            const jh_postings_soa *l = &lists[t];
+            jh_u32 h = ws->heads[t];
+            while (h < l->doc_count && l->page_ids[h] < d) {
+                h++;
+            }
+            ws->heads[t] = h;
+            if (h < l->doc_count && l->page_ids[h] == d) {
+                double w = hit_weights && hit_weights[t] ? hit_weights[t][h] : 1.0;
                 has_any = 1;
-                freq_score += term_weights[t] * (double)pe->term_freq;
+                freq_score += ws->term_weights[t] * w * (double)l->term_freqs[h];
             } else {
                 has_all = 0;
             }
@@ -1674,13 +3799,16 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
 
         if (list_count >= 2) {
             for (t = 0; t + 1 < list_count; ++t) {
-                jh_posting_entry *a = jh_find_posting_in_list(&lists[t], d);
-                jh_posting_entry *b = jh_find_posting_in_list(&lists[t + 1], d);
-                if (a && b && a->term_freq > 0 && b->term_freq > 0) {
-                    const jh_u32 *pa = a->positions;
-                    const jh_u32 *pb = b->positions;
-                    jh_u32 na = a->term_freq;
-                    jh_u32 nb = b->term_freq;
+                const jh_postings_soa *la = &lists[t];
+                const jh_postings_soa *lb = &lists[t + 1];
+                jh_u32 ha = ws->heads[t];
+                jh_u32 hb = ws->heads[t + 1];
+                if (ha < la->doc_count && la->page_ids[ha] == d && hb < lb->doc_count && lb->page_ids[hb] == d &&
+                    la->term_freqs[ha] > 0 && lb->term_freqs[hb] > 0) {
+                    const jh_u32 *pa = la->positions + la->position_starts[ha];
+                    const jh_u32 *pb = lb->positions + lb->position_starts[hb];
+                    jh_u32 na = la->term_freqs[ha];
+                    jh_u32 nb = lb->term_freqs[hb];
                     jh_u32 ia = 0;
                     jh_u32 ib = 0;
                     jh_u32 best = (jh_u32)-1;
@@ -1735,12 +3863,15 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
             hits[hits_count].page_id = d;
             hits[hits_count].score = freq_weight * freq_score + prox_weight * prox_score + phrase_score;
             hits_count += 1;
+            if (facets && counts) {
+                jh_facet_count_page(facets, counts, d);
+            }
         }
     }
 
-    free(pages);
-    free(phrase_sorted);
-    free(term_weights);
+    if (ws == &local) {
+        jh_search_workspace_free(&local);
+    }
 
     if (hits_count == 0) {
         free(hits);
@@ -1755,3 +3886,337 @@ int jh_rank_results(const jh_postings_list *lists, size_t list_count, int requir
     *out_hit_count = hits_count;
     return 0;
 }
+
+int jh_snippet_best_window(const jh_postings_list *lists, size_t list_count, jh_u32 page_id, jh_snippet_window *out) {
+    const jh_u32 *pos[JH_SNIPPET_MAX_TERMS];
+    jh_u32 cnt[JH_SNIPPET_MAX_TERMS];
+    jh_u32 idx[JH_SNIPPET_MAX_TERMS];
+    size_t n = 0;
+    size_t i;
+    jh_u32 best_span = 0xffffffffu;
+
+    if (!lists || !out) {
+        return -1;
+    }
+    for (i = 0; i < list_count && n < JH_SNIPPET_MAX_TERMS; ++i) {
+        const jh_posting_entry *pe = jh_find_posting_in_list(&lists[i], page_id);
+        if (!pe || pe->term_freq == 0) {
+            continue;
+        }
+        pos[n] = pe->positions;
+        cnt[n] = pe->term_freq;
+        idx[n] = 0;
+        n++;
+    }
+    if (n == 0) {
+        return 1;
+    }
+    /* Advance the term holding the leftmost position until one term runs out; every
+       window seen this way covers all n terms and the shortest one is kept. */
+    for (;;) {
+        size_t lo_t = 0;
+        jh_u32 lo = pos[0][idx[0]];
+        jh_u32 hi = lo;
+        for (i = 1; i < n; ++i) {
+            jh_u32 v = pos[i][idx[i]];
+            if (v < lo) {
+                lo = v;
+                lo_t = i;
+            }
+            if (v > hi) {
+                hi = v;
+            }
+        }
+        if (hi - lo < best_span) {
+            best_span = hi - lo;
+            out->first_pos = lo;
+            out->last_pos = hi;
+        }
+        if (++idx[lo_t] == cnt[lo_t]) {
+            break;
+        }
+    }
+    out->terms_covered = (jh_u32)n;
+    return 0;
+}
+
+int jh_token_offsets_open(const char *path, jh_token_offsets_view *out) {
+    int fd;
+    struct stat st;
+    void *map;
+
+    if (!path || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -2;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -3;
+    }
+    if ((size_t)st.st_size < sizeof(jh_token_offsets_header)) {
+        close(fd);
+        return -4;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -5;
+    }
+    out->data = (const jh_u8 *)map;
+    out->size = (size_t)st.st_size;
+    memcpy(&out->header, map, sizeof(jh_token_offsets_header));
+    if (memcmp(out->header.magic, "TOFS", 4) != 0 || out->header.version != 1 ||
+        out->header.index_offset % sizeof(jh_u64) != 0 ||
+        out->header.index_offset > (jh_u64)out->size ||
+        ((jh_u64)out->size - out->header.index_offset) / sizeof(jh_u64) < (jh_u64)out->header.page_count + 1) {
+        jh_token_offsets_close(out);
+        return -6;
+    }
+    out->page_offsets = (const jh_u64 *)(out->data + out->header.index_offset);
+    return 0;
+}
+
+void jh_token_offsets_close(jh_token_offsets_view *view) {
+    if (!view) {
+        return;
+    }
+    if (view->data) {
+        munmap((void *)view->data, view->size);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+/* jh_varint_read decodes one LEB128 u32 from [*p, end); returns 0 on truncation. */
+static int jh_varint_read(const jh_u8 **p, const jh_u8 *end, jh_u32 *out) {
+    jh_u32 v = 0;
+    unsigned shift = 0;
+    while (*p < end && shift < 35) {
+        jh_u8 b = *(*p)++;
+        v |= (jh_u32)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return 1;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+int jh_token_offsets_span(const jh_token_offsets_view *view, jh_u32 page_id, jh_u32 first_pos, jh_u32 last_pos, jh_u32 *out_start, jh_u32 *out_end) {
+    const jh_u8 *p;
+    const jh_u8 *end;
+    jh_u32 count;
+    jh_u32 t;
+    jh_u32 prev_end = 0;
+
+    if (!view || !view->data || !out_start || !out_end || last_pos < first_pos) {
+        return -1;
+    }
+    if (page_id >= view->header.page_count) {
+        return 1;
+    }
+    if (view->page_offsets[page_id] > view->page_offsets[page_id + 1] ||
+        view->page_offsets[page_id + 1] > view->header.index_offset) {
+        return -2;
+    }
+    p = view->data + view->page_offsets[page_id];
+    end = view->data + view->page_offsets[page_id + 1];
+    if (!jh_varint_read(&p, end, &count)) {
+        return -2;
+    }
+    if (last_pos >= count) {
+        return 1;
+    }
+    for (t = 0; t <= last_pos; ++t) {
+        jh_u32 gap;
+        jh_u32 len;
+        if (!jh_varint_read(&p, end, &gap) || !jh_varint_read(&p, end, &len)) {
+            return -2;
+        }
+        if (t == first_pos) {
+            *out_start = prev_end + gap;
+        }
+        prev_end += gap + len;
+    }
+    *out_end = prev_end;
+    return 0;
+}
+
+int jh_books_reader_open(const char *path, jh_books_reader *out) {
+    size_t index_bytes;
+    size_t i;
+
+    if (!path || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    out->fd = -1;
+    if (jh_read_books_file_header(path, &out->header) != 0) {
+        return -2;
+    }
+    if (out->header.block_count == 0 || out->header.block_count > (jh_u64)(SIZE_MAX / sizeof(jh_block_index_entry))) {
+        return -5;
+    }
+    if (out->header.compression != JH_BOOKS_COMPRESSION_NONE &&
+        out->header.compression != JH_BOOKS_COMPRESSION_ZSTD &&
+        out->header.compression != JH_BOOKS_COMPRESSION_LZ4) {
+        return -4;
+    }
+    out->fd = open(path, O_RDONLY);
+    if (out->fd < 0) {
+        return -3;
+    }
+    index_bytes = sizeof(jh_block_index_entry) * (size_t)out->header.block_count;
+    out->blocks = (jh_block_index_entry *)malloc(index_bytes);
+    if (!out->blocks) {
+        jh_books_reader_close(out);
+        return -6;
+    }
+    if (pread(out->fd, out->blocks, index_bytes, (off_t)out->header.index_offset) != (ssize_t)index_bytes) {
+        jh_books_reader_close(out);
+        return -7;
+    }
+    for (i = 0; i < JH_BOOKS_CACHE_BLOCKS; ++i) {
+        out->cache[i].block_id = 0xffffffffu;
+    }
+    return 0;
+}
+
+void jh_books_reader_close(jh_books_reader *reader) {
+    size_t i;
+    if (!reader) {
+        return;
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    for (i = 0; i < JH_BOOKS_CACHE_BLOCKS; ++i) {
+        free(reader->cache[i].data);
+    }
+    free(reader->blocks);
+    free(reader->scratch);
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+}
+
+/* jh_books_pread reads exactly len bytes at offset. */
+static int jh_books_pread(int fd, void *buf, size_t len, jh_u64 offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, (char *)buf + done, len - done, (off_t)(offset + done));
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+/* jh_books_reader_block returns block_id decompressed, from the cache or by evicting its least recently used slot. */
+static int jh_books_reader_block(jh_books_reader *reader, jh_u32 block_id, const jh_u8 **out) {
+    const jh_block_index_entry *be = &reader->blocks[block_id];
+    jh_books_cache_slot *victim = &reader->cache[0];
+    size_t i;
+
+    for (i = 0; i < JH_BOOKS_CACHE_BLOCKS; ++i) {
+        jh_books_cache_slot *cs = &reader->cache[i];
+        if (cs->block_id == block_id) {
+            cs->age = ++reader->clock;
+            *out = cs->data;
+            return 0;
+        }
+        if (cs->age < victim->age) {
+            victim = cs;
+        }
+    }
+    if (jh_scratch_reserve(&reader->scratch, &reader->scratch_cap, be->compressed_size) != 0) {
+        return -6;
+    }
+    if (jh_books_pread(reader->fd, reader->scratch, be->compressed_size, be->compressed_offset) != 0) {
+        return -7;
+    }
+    if (victim->size < be->uncompressed_size || !victim->data) {
+        jh_u8 *nd = (jh_u8 *)realloc(victim->data, be->uncompressed_size ? be->uncompressed_size : 1);
+        if (!nd) {
+            return -6;
+        }
+        victim->data = nd;
+        victim->size = be->uncompressed_size;
+    }
+    victim->block_id = 0xffffffffu;
+    switch (reader->header.compression) {
+#ifdef JH_HAVE_ZSTD
+    case JH_BOOKS_COMPRESSION_ZSTD: {
+        ZSTD_DCtx *dctx = jh_thread_dctx();
+        size_t dsize;
+        if (!dctx) {
+            return -6;
+        }
+        dsize = ZSTD_decompressDCtx(dctx, victim->data, be->uncompressed_size, reader->scratch, be->compressed_size);
+        if (ZSTD_isError(dsize) || dsize != be->uncompressed_size) {
+            return -8;
+        }
+        break;
+    }
+#endif
+#ifdef JH_HAVE_LZ4
+    case JH_BOOKS_COMPRESSION_LZ4: {
+        int dsize = LZ4_decompress_safe((const char *)reader->scratch, (char *)victim->data, (int)be->compressed_size, (int)be->uncompressed_size);
+        if (dsize < 0 || (jh_u32)dsize != be->uncompressed_size) {
+            return -8;
+        }
+        break;
+    }
+#endif
+    default:
+        return -4;
+    }
+    victim->block_id = block_id;
+    victim->age = ++reader->clock;
+    *out = victim->data;
+    return 0;
+}
+
+int jh_books_reader_read(jh_books_reader *reader, jh_u32 block_id, jh_u32 offset_in_block, jh_u32 length, char *out) {
+    if (!reader || reader->fd < 0 || (length && !out)) {
+        return -1;
+    }
+    while (length > 0) {
+        const jh_block_index_entry *be;
+        jh_u32 chunk;
+        if ((jh_u64)block_id >= reader->header.block_count) {
+            return -2;
+        }
+        be = &reader->blocks[block_id];
+        if (offset_in_block >= be->uncompressed_size) {
+            offset_in_block -= be->uncompressed_size;
+            block_id++;
+            continue;
+        }
+        chunk = be->uncompressed_size - offset_in_block;
+        if (chunk > length) {
+            chunk = length;
+        }
+        if (reader->header.compression == JH_BOOKS_COMPRESSION_NONE || be->compressed_size == be->uncompressed_size) {
+            if (jh_books_pread(reader->fd, out, chunk, be->compressed_offset + offset_in_block) != 0) {
+                return -7;
+            }
+        } else {
+            const jh_u8 *data;
+            int rc = jh_books_reader_block(reader, block_id, &data);
+            if (rc != 0) {
+                return rc;
+            }
+            memcpy(out, data + offset_in_block, chunk);
+        }
+        out += chunk;
+        length -= chunk;
+        offset_in_block = 0;
+        block_id++;
+    }
+    return 0;
+}
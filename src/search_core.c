@@ -12,7 +12,144 @@ static void jh_die_search(const char *msg) {
     exit(1);
 }
 
-static void jh_search_core_run(const char *words_idx_path, const char *postings_path, const char *query) {
+/* Caps how many lexicon terms one "prefix*" or "term~N" query word may expand to. */
+#define JH_SEARCH_EXPAND_MAX_TERMS 128
+/* Fuzzy candidates gathered before the closest JH_SEARCH_EXPAND_MAX_TERMS are kept. */
+#define JH_SEARCH_FUZZY_MAX_CANDIDATES 1024
+/* A fuzzy hit at edit distance d scores 1 / (1 + d * JH_SEARCH_FUZZY_DISTANCE_PENALTY) of an exact hit. */
+#define JH_SEARCH_FUZZY_DISTANCE_PENALTY 1.0
+
+/* Query term operators: "word*" expands by prefix, "word~" / "word~2" by edit distance 1 / 2. */
+#define JH_QUERY_TERM_EXACT 0
+#define JH_QUERY_TERM_PREFIX 1
+#define JH_QUERY_TERM_FUZZY1 2
+#define JH_QUERY_TERM_FUZZY2 3
+
+/* jh_mark_query_ops records the operator on the last token of each query word and blanks "~N" suffixes in query. */
+static void jh_mark_query_ops(char *query, size_t qlen, jh_token *tokens, size_t tokens_cap, char *workspace, size_t workspace_cap, unsigned char *ops, size_t op_count) {
+    size_t start = 0;
+    size_t index = 0;
+    while (start < qlen) {
+        size_t end = start;
+        unsigned char op = JH_QUERY_TERM_EXACT;
+        while (end < qlen && query[end] != ' ' && query[end] != '\t') {
+            end++;
+        }
+        if (end > start && query[end - 1] == '*') {
+            op = JH_QUERY_TERM_PREFIX;
+        } else if (end > start && query[end - 1] == '~') {
+            op = JH_QUERY_TERM_FUZZY1;
+            query[end - 1] = ' ';
+        } else if (end - start >= 2 && query[end - 2] == '~' && (query[end - 1] == '1' || query[end - 1] == '2')) {
+            op = query[end - 1] == '1' ? JH_QUERY_TERM_FUZZY1 : JH_QUERY_TERM_FUZZY2;
+            query[end - 2] = ' ';
+            query[end - 1] = ' ';
+        }
+        if (end > start) {
+            size_t n = jh_normalize_and_tokenize_arabic_utf8(query + start, end - start, tokens, tokens_cap, workspace, workspace_cap);
+            if (n == (size_t)-1) {
+                return;
+            }
+            index += n;
+            if (n > 0 && op != JH_QUERY_TERM_EXACT && index - 1 < op_count) {
+                ops[index - 1] = op;
+            }
+        }
+        start = end + 1;
+    }
+}
+
+/* jh_expanded_postings_read unions the lists of the lexicon terms the token expands to under op. For fuzzy ops it also
+   returns per-page hit weights that down-weight matches by edit distance; otherwise *out_weights stays NULL. */
+static int jh_expanded_postings_read(const char *words_idx_path, const jh_postings_file_view *view, const jh_token *tok, unsigned char op, const jh_page_filter *filter, jh_postings_list *out, double **out_weights) {
+    char lex_path[1024];
+    jh_lexicon_view lex;
+    jh_u64 hashes[JH_SEARCH_FUZZY_MAX_CANDIDATES];
+    jh_u8 dists[JH_SEARCH_FUZZY_MAX_CANDIDATES];
+    jh_postings_list parts[JH_SEARCH_EXPAND_MAX_TERMS];
+    double part_weights[JH_SEARCH_EXPAND_MAX_TERMS];
+    size_t hash_count = 0;
+    size_t part_count = 0;
+    size_t k;
+    int rc;
+
+    memset(out, 0, sizeof(*out));
+    *out_weights = NULL;
+    if (jh_index_sibling_path(words_idx_path, "words.lex", lex_path, sizeof(lex_path)) != 0 ||
+        jh_lexicon_open(lex_path, &lex) != 0) {
+        return -1;
+    }
+    if (op == JH_QUERY_TERM_PREFIX) {
+        rc = jh_lexicon_expand_prefix(&lex, tok->word, tok->length, JH_SEARCH_EXPAND_MAX_TERMS, hashes, &hash_count);
+    } else {
+        jh_u32 max_dist = op == JH_QUERY_TERM_FUZZY2 ? 2 : 1;
+        jh_u32 d;
+        size_t kept = 0;
+        rc = jh_lexicon_expand_fuzzy(&lex, tok->word, tok->length, max_dist, JH_SEARCH_FUZZY_MAX_CANDIDATES, hashes, dists, &hash_count);
+        /* Keep the closest candidates: exact first, then distance 1, then 2. */
+        for (d = 0; d <= max_dist && kept < JH_SEARCH_EXPAND_MAX_TERMS; ++d) {
+            for (k = kept; k < hash_count && kept < JH_SEARCH_EXPAND_MAX_TERMS; ++k) {
+                if (dists[k] == d) {
+                    jh_u64 h = hashes[k];
+                    jh_u8 dk = dists[k];
+                    hashes[k] = hashes[kept];
+                    dists[k] = dists[kept];
+                    hashes[kept] = h;
+                    dists[kept] = dk;
+                    kept++;
+                }
+            }
+        }
+        hash_count = kept;
+    }
+    jh_lexicon_close(&lex);
+    if (rc < 0) {
+        return -2;
+    }
+    for (k = 0; k < hash_count; ++k) {
+        jh_word_dict_entry e;
+        if (jh_word_dict_lookup(words_idx_path, hashes[k], &e) != 0 || e.postings_count == 0) {
+            continue;
+        }
+        if (jh_word_postings_read_filtered(words_idx_path, view, &e, filter, &parts[part_count]) != 0) {
+            continue;
+        }
+        part_weights[part_count] = op == JH_QUERY_TERM_PREFIX ? 1.0 : 1.0 / (1.0 + (double)dists[k] * JH_SEARCH_FUZZY_DISTANCE_PENALTY);
+        part_count++;
+    }
+    if (op == JH_QUERY_TERM_PREFIX) {
+        rc = jh_postings_list_union(parts, part_count, out);
+    } else {
+        rc = jh_postings_list_union_weighted(parts, part_weights, part_count, out, out_weights);
+    }
+    for (k = 0; k < part_count; ++k) {
+        jh_postings_list_free(&parts[k]);
+    }
+    return rc;
+}
+
+/* jh_print_facets prints the nonzero per-category, per-author and per-book hit counts. */
+static void jh_print_facets(const jh_facet_counts *counts) {
+    jh_u32 k;
+    for (k = 0; k < counts->category_slots; ++k) {
+        if (counts->category_counts[k]) {
+            printf("facet category %u %u\n", k, counts->category_counts[k]);
+        }
+    }
+    for (k = 0; k < counts->author_slots; ++k) {
+        if (counts->author_counts[k]) {
+            printf("facet author %u %u\n", k, counts->author_counts[k]);
+        }
+    }
+    for (k = 0; k < counts->book_slots; ++k) {
+        if (counts->book_counts[k]) {
+            printf("facet book %u %u\n", k, counts->book_counts[k]);
+        }
+    }
+}
+
+/* jh_search_core_run answers one query; ws carries the decode and ranking buffers from one query to the next. */
+static void jh_search_core_run(const char *words_idx_path, const char *postings_path, const jh_postings_file_view *view, jh_search_workspace *ws, const char *query, int stem, const jh_page_filter *filter, const jh_facets_view *facets) {
     size_t qlen = strlen(query);
     size_t workspace_cap = qlen ? qlen * 4 : 16;
     char *workspace = (char *)malloc(workspace_cap);
@@ -21,45 +158,71 @@ static void jh_search_core_run(const char *words_idx_path, const char *postings_
     size_t tok_count;
     jh_u64 *hashes;
     size_t i;
-    jh_postings_list *lists;
+    jh_postings_soa *lists;
+    double **hit_weights;
     jh_word_dict_entry e;
     jh_ranked_hit *hits = NULL;
+    jh_facet_counts counts;
+    int have_counts = 0;
     size_t hit_count = 0;
     jh_u32 *phrase_pages = NULL;
     size_t phrase_page_count = 0;
+    unsigned char *term_ops = (unsigned char *)calloc(tokens_cap, 1);
+    char *qbuf = (char *)malloc(qlen + 1);
+    const jh_token **terms;
 
-    if (!workspace || !tokens) {
+    if (!workspace || !tokens || !term_ops || !qbuf) {
         free(workspace);
         free(tokens);
+        free(term_ops);
+        free(qbuf);
         jh_die_search("alloc query buffers failed");
     }
 
-    tok_count = jh_normalize_and_tokenize_arabic_utf8(query, qlen, tokens, tokens_cap, workspace, workspace_cap);
+    memset(&counts, 0, sizeof(counts));
+    memcpy(qbuf, query, qlen + 1);
+    jh_mark_query_ops(qbuf, qlen, tokens, tokens_cap, workspace, workspace_cap, term_ops, tokens_cap);
+    if (stem) {
+        /* words.lex holds surface forms, so expansion does not apply to the stemmed field. */
+        memset(term_ops, 0, tokens_cap);
+    }
+    tok_count = jh_normalize_and_tokenize_arabic_utf8(qbuf, qlen, tokens, tokens_cap, workspace, workspace_cap);
+    free(qbuf);
     if (tok_count == (size_t)-1) {
         free(workspace);
         free(tokens);
+        free(term_ops);
         jh_die_search("query tokenization failed");
     }
+    if (stem) {
+        jh_light_stem_arabic_tokens(tokens, tok_count);
+    }
     if (tok_count == 0) {
         free(workspace);
         free(tokens);
+        free(term_ops);
         printf("no tokens\n");
         return;
     }
 
     hashes = (jh_u64 *)malloc(sizeof(jh_u64) * tok_count);
-    lists = (jh_postings_list *)calloc(tok_count, sizeof(jh_postings_list));
-    if (!hashes || !lists) {
+    lists = jh_search_workspace_terms(ws, tok_count);
+    hit_weights = (double **)calloc(tok_count, sizeof(double *));
+    terms = (const jh_token **)malloc(sizeof(jh_token *) * tok_count);
+    if (!hashes || !lists || !hit_weights || !terms) {
         free(workspace);
         free(tokens);
+        free(term_ops);
         free(hashes);
-        free(lists);
+        free(hit_weights);
+        free(terms);
         jh_die_search("alloc hashes or lists failed");
     }
 
     {
         size_t term_count = 0;
         int has_or_token = 0;
+        int has_expanded_term = 0;
         int require_all_terms = 1;
 
         for (i = 0; i < tok_count; ++i) {
@@ -70,79 +233,101 @@ static void jh_search_core_run(const char *words_idx_path, const char *postings_
                 continue;
             }
             hashes[term_count] = jh_hash_utf8_64(tokens[i].word, tokens[i].length, 0);
+            terms[term_count] = term_ops[i] ? &tokens[i] : NULL;
+            has_expanded_term |= term_ops[i] != 0;
             term_count++;
         }
 
         if (term_count == 0) {
             free(workspace);
             free(tokens);
+            free(term_ops);
             free(hashes);
-            free(lists);
+            free(hit_weights);
+            free(terms);
             printf("no tokens\n");
             return;
         }
 
         require_all_terms = has_or_token ? 0 : 1;
 
-        if (term_count >= 2 && !has_or_token) {
-            if (jh_phrase_search(words_idx_path, postings_path, hashes, term_count, &phrase_pages, &phrase_page_count) != 0) {
+        if (term_count >= 2 && !has_or_token && !has_expanded_term) {
+            if (jh_phrase_search_filtered(ws, words_idx_path, postings_path, filter, hashes, term_count, &phrase_pages, &phrase_page_count) != 0) {
                 free(workspace);
                 free(tokens);
+                free(term_ops);
                 free(hashes);
-                free(lists);
+                free(hit_weights);
+                free(terms);
                 jh_die_search("phrase_search failed");
             }
         }
 
         for (i = 0; i < term_count; ++i) {
+            lists[i].doc_count = 0;
+            lists[i].positions_count = 0;
+            if (terms[i]) {
+                jh_postings_list expanded;
+                memset(&expanded, 0, sizeof(expanded));
+                if (view->data &&
+                    jh_expanded_postings_read(words_idx_path, view, terms[i], term_ops[terms[i] - tokens], filter, &expanded, &hit_weights[i]) == 0) {
+                    jh_postings_soa_from_list(&expanded, &lists[i]);
+                }
+                jh_postings_list_free(&expanded);
+                continue;
+            }
             if (jh_word_dict_lookup(words_idx_path, hashes[i], &e) != 0) {
                 continue;
             }
-            {
-                FILE *pf = fopen(postings_path, "rb");
-                if (!pf) {
-                    continue;
-                }
-                fclose(pf);
-                if (e.postings_count == 0) {
-                    continue;
-                }
-                if (jh_postings_list_read(postings_path, e.postings_offset, &lists[i]) != 0) {
-                    continue;
-                }
+            if (!view->data || e.postings_count == 0) {
+                continue;
+            }
+            if (jh_word_postings_read_soa(words_idx_path, view, &e, filter, &lists[i], &ws->scratch, &ws->scratch_cap) != 0) {
+                lists[i].doc_count = 0;
+                lists[i].positions_count = 0;
             }
         }
 
-        if (jh_rank_results(lists, term_count, require_all_terms, phrase_pages, phrase_page_count, &hits, &hit_count) != 0) {
+        if (facets && facets->data && jh_facet_counts_init(facets, &counts) == 0) {
+            have_counts = 1;
+        }
+        if (jh_rank_results_soa(ws, lists, (const double *const *)hit_weights, term_count, require_all_terms, phrase_pages, phrase_page_count,
+                                have_counts ? facets : NULL, have_counts ? &counts : NULL, &hits, &hit_count) != 0) {
             size_t k;
             for (k = 0; k < term_count; ++k) {
-                jh_postings_list_free(&lists[k]);
+                free(hit_weights[k]);
             }
             free(workspace);
             free(tokens);
+            free(term_ops);
             free(hashes);
-            free(lists);
+            free(hit_weights);
+            free(terms);
             free(phrase_pages);
+            jh_facet_counts_free(&counts);
             jh_die_search("rank_results failed");
         }
 
         {
             size_t k;
             for (k = 0; k < term_count; ++k) {
-                jh_postings_list_free(&lists[k]);
+                free(hit_weights[k]);
             }
         }
     }
 
     free(workspace);
     free(tokens);
+    free(term_ops);
     free(hashes);
-    free(lists);
+    free(hit_weights);
+    free(terms);
     free(phrase_pages);
 
     if (!hits || hit_count == 0) {
         printf("no results\n");
         free(hits);
+        jh_facet_counts_free(&counts);
         return;
     }
 
@@ -150,9 +335,13 @@ static void jh_search_core_run(const char *words_idx_path, const char *postings_
         printf("%u %.6f\n", hits[i].page_id, hits[i].score);
     }
     free(hits);
+    if (have_counts) {
+        jh_print_facets(&counts);
+    }
+    jh_facet_counts_free(&counts);
 }
 
-static void jh_search_core_run_multi(const char **words_idx_paths, const char **postings_paths, size_t cat_count, const char *query) {
+static void jh_search_core_run_multi(const char **words_idx_paths, const char **postings_paths, size_t cat_count, const char *query, int stem) {
     size_t qlen = strlen(query);
     size_t workspace_cap = qlen ? qlen * 4 : 16;
     char *workspace = (char *)malloc(workspace_cap);
@@ -183,6 +372,9 @@ static void jh_search_core_run_multi(const char **words_idx_paths, const char **
         printf("no tokens\n");
         return;
     }
+    if (stem) {
+        jh_light_stem_arabic_tokens(tokens, tok_count);
+    }
 
     hashes = (jh_u64 *)malloc(sizeof(jh_u64) * tok_count);
     if (!hashes) {
@@ -238,8 +430,117 @@ static double jh_wall_seconds_search(void) {
     return (double)t / (double)CLOCKS_PER_SEC;
 }
 
+/* jh_stem_path points path at its _stem variant when the stemmed field is selected. */
+static const char *jh_stem_path(const char *path, int stem, char *buf, size_t cap) {
+    if (!stem) {
+        return path;
+    }
+    if (jh_index_variant_path(path, "_stem", buf, cap) != 0) {
+        jh_die_search("stem index path too long");
+    }
+    return buf;
+}
+
+/* Most ids one --book/--category/--author/--chapter option may list. */
+#define JH_SEARCH_FILTER_MAX_IDS 256
+
+/* jh_parse_id_list reads comma-separated ids such as "3,17,42" into ids. */
+static size_t jh_parse_id_list(const char *arg, jh_u32 *ids) {
+    size_t count = 0;
+    while (*arg) {
+        char *endp = NULL;
+        unsigned long v = strtoul(arg, &endp, 10);
+        if (endp == arg || count == JH_SEARCH_FILTER_MAX_IDS) {
+            jh_die_search("bad filter id list");
+        }
+        ids[count++] = (jh_u32)v;
+        arg = *endp == ',' ? endp + 1 : endp;
+        if (*endp && *endp != ',') {
+            jh_die_search("bad filter id list");
+        }
+    }
+    return count;
+}
+
+/* jh_compile_filter builds the page filter from the books.idx family stored next to words_idx_path. */
+static void jh_compile_filter(const jh_page_filter_spec *spec, const char *words_idx_path, jh_page_filter *filter) {
+    char books_path[1024];
+    char meta_path[1024];
+    char chapters_path[1024];
+    memset(filter, 0, sizeof(*filter));
+    if (spec->book_count == 0 && spec->category_count == 0 && spec->author_count == 0 && spec->chapter_count == 0) {
+        return;
+    }
+    if (jh_index_sibling_path(words_idx_path, "books.idx", books_path, sizeof(books_path)) != 0 ||
+        jh_index_sibling_path(words_idx_path, "books_meta.idx", meta_path, sizeof(meta_path)) != 0 ||
+        jh_index_sibling_path(words_idx_path, "chapters.idx", chapters_path, sizeof(chapters_path)) != 0 ||
+        jh_page_filter_compile(spec, books_path, meta_path, chapters_path, filter) != 0) {
+        jh_die_search("compile page filter failed");
+    }
+}
+
+/* jh_open_facets maps facets.col next to words_idx_path when --facets was given; otherwise leaves the view empty. */
+static void jh_open_facets(int want_facets, const char *words_idx_path, jh_facets_view *facets) {
+    char path[1024];
+    memset(facets, 0, sizeof(*facets));
+    if (!want_facets) {
+        return;
+    }
+    if (jh_index_sibling_path(words_idx_path, "facets.col", path, sizeof(path)) != 0 ||
+        jh_facets_open(path, facets) != 0) {
+        jh_die_search("open facets.col failed");
+    }
+}
+
 int main(int argc, char **argv) {
     char buf[4096];
+    char words_buf[1024];
+    char postings_buf[1024];
+    jh_postings_file_view view;
+    jh_search_workspace ws;
+    int stem = 0;
+    int want_facets = 0;
+    jh_facets_view facets;
+    static jh_u32 filter_ids[4][JH_SEARCH_FILTER_MAX_IDS];
+    jh_page_filter_spec spec;
+    jh_page_filter filter;
+
+    memset(&spec, 0, sizeof(spec));
+    memset(&ws, 0, sizeof(ws));
+    while (argc >= 2) {
+        if (strcmp(argv[1], "--stem") == 0) {
+            stem = 1;
+            argv++;
+            argc--;
+            continue;
+        }
+        if (strcmp(argv[1], "--facets") == 0) {
+            want_facets = 1;
+            argv++;
+            argc--;
+            continue;
+        }
+        if (argc < 3) {
+            break;
+        }
+        if (strcmp(argv[1], "--book") == 0) {
+            spec.book_count = jh_parse_id_list(argv[2], filter_ids[0]);
+            spec.book_ids = filter_ids[0];
+        } else if (strcmp(argv[1], "--category") == 0) {
+            spec.category_count = jh_parse_id_list(argv[2], filter_ids[1]);
+            spec.category_ids = filter_ids[1];
+        } else if (strcmp(argv[1], "--author") == 0) {
+            spec.author_count = jh_parse_id_list(argv[2], filter_ids[2]);
+            spec.author_ids = filter_ids[2];
+        } else if (strcmp(argv[1], "--chapter") == 0) {
+            spec.chapter_count = jh_parse_id_list(argv[2], filter_ids[3]);
+            spec.chapter_ids = filter_ids[3];
+        } else {
+            break;
+        }
+        argv += 2;
+        argc -= 2;
+    }
 
     if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
         const char *words_idx_path = "words.idx";
@@ -260,6 +561,11 @@ int main(int argc, char **argv) {
             queries_path = argv[4];
         }
 
+        words_idx_path = jh_stem_path(words_idx_path, stem, words_buf, sizeof(words_buf));
+        postings_path = jh_stem_path(postings_path, stem, postings_buf, sizeof(postings_buf));
+        jh_compile_filter(&spec, words_idx_path, &filter);
+        jh_open_facets(want_facets, words_idx_path, &facets);
+
         if (queries_path) {
             qf = fopen(queries_path, "rb");
             if (!qf) {
@@ -269,6 +575,10 @@ int main(int argc, char **argv) {
             qf = stdin;
         }
 
+        if (jh_postings_file_open(postings_path, &view) != 0) {
+            memset(&view, 0, sizeof(view));
+        }
+
         start = jh_wall_seconds_search();
         while (fgets(buf, sizeof(buf), qf)) {
             size_t len = strlen(buf);
@@ -278,10 +588,14 @@ int main(int argc, char **argv) {
             if (buf[0] == 0) {
                 continue;
             }
-            jh_search_core_run(words_idx_path, postings_path, buf);
+            jh_search_core_run(words_idx_path, postings_path, &view, &ws, buf, stem, &filter, &facets);
             count += 1;
         }
         end = jh_wall_seconds_search();
+        jh_search_workspace_free(&ws);
+        jh_postings_file_close(&view);
+        jh_page_filter_free(&filter);
+        jh_facets_close(&facets);
         if (qf != stdin) {
             fclose(qf);
         }
@@ -302,8 +616,14 @@ int main(int argc, char **argv) {
         if (argc > 2) {
             postings_path = argv[2];
         }
+        words_idx_path = jh_stem_path(words_idx_path, stem, words_buf, sizeof(words_buf));
+        postings_path = jh_stem_path(postings_path, stem, postings_buf, sizeof(postings_buf));
+        jh_compile_filter(&spec, words_idx_path, &filter);
+        jh_open_facets(want_facets, words_idx_path, &facets);
 
         if (!fgets(buf, sizeof(buf), stdin)) {
+            jh_page_filter_free(&filter);
+            jh_facets_close(&facets);
             return 0;
         }
         {
@@ -312,37 +632,57 @@ int main(int argc, char **argv) {
                 buf[len - 1] = 0;
             }
         }
-        jh_search_core_run(words_idx_path, postings_path, buf);
+        if (jh_postings_file_open(postings_path, &view) != 0) {
+            memset(&view, 0, sizeof(view));
+        }
+        jh_search_core_run(words_idx_path, postings_path, &view, &ws, buf, stem, &filter, &facets);
+        jh_search_workspace_free(&ws);
+        jh_postings_file_close(&view);
+        jh_page_filter_free(&filter);
+        jh_facets_close(&facets);
         return 0;
     } else {
         int arg_count = argc - 1;
         size_t cat_count;
         const char **words_idx_paths;
         const char **postings_paths;
+        char *stem_paths = NULL;
         size_t i;
 
         if (arg_count % 2 != 0) {
-            fprintf(stderr, "usage: %s [words.idx postings.bin]...\n", argv[0]);
+            fprintf(stderr, "usage: %s [--stem] [--facets] [--book|--category|--author|--chapter ids] [words.idx postings.bin]...\n", argv[0]);
             return 1;
         }
+        if (spec.book_count || spec.category_count || spec.author_count || spec.chapter_count || want_facets) {
+            jh_die_search("filters and facets apply to a single index");
+        }
 
         cat_count = (size_t)(arg_count / 2);
         words_idx_paths = (const char **)malloc(sizeof(char *) * cat_count);
         postings_paths = (const char **)malloc(sizeof(char *) * cat_count);
-        if (!words_idx_paths || !postings_paths) {
+        if (stem) {
+            stem_paths = (char *)malloc(cat_count * 2 * 1024);
+        }
+        if (!words_idx_paths || !postings_paths || (stem && !stem_paths)) {
             free(words_idx_paths);
             free(postings_paths);
+            free(stem_paths);
             jh_die_search("alloc category path arrays failed");
         }
 
         for (i = 0; i < cat_count; ++i) {
             words_idx_paths[i] = argv[1 + (int)(i * 2)];
             postings_paths[i] = argv[1 + (int)(i * 2) + 1];
+            if (stem) {
+                words_idx_paths[i] = jh_stem_path(words_idx_paths[i], stem, stem_paths + i * 2 * 1024, 1024);
+                postings_paths[i] = jh_stem_path(postings_paths[i], stem, stem_paths + (i * 2 + 1) * 1024, 1024);
+            }
         }
 
         if (!fgets(buf, sizeof(buf), stdin)) {
             free(words_idx_paths);
             free(postings_paths);
+            free(stem_paths);
             return 0;
         }
         {
@@ -352,10 +692,11 @@ int main(int argc, char **argv) {
             }
         }
 
-        jh_search_core_run_multi(words_idx_paths, postings_paths, cat_count, buf);
+        jh_search_core_run_multi(words_idx_paths, postings_paths, cat_count, buf, stem);
 
         free(words_idx_paths);
         free(postings_paths);
+        free(stem_paths);
         return 0;
     }
 }
@@ -11,6 +11,58 @@ static void jh_die_snip(const char *msg) {
     exit(1);
 }
 
+/* Bytes of context printed on each side of a snippet, and the widest window highlighted whole. */
+#define JH_SNIPPET_CONTEXT 40
+#define JH_SNIPPET_SPAN_MAX 240
+
+static int jh_u32_cmp_snip(const void *a, const void *b) {
+    jh_u32 x = *(const jh_u32 *)a;
+    jh_u32 y = *(const jh_u32 *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void jh_free_lists(jh_postings_list *lists, size_t count) {
+    size_t k;
+    for (k = 0; k < count; ++k) {
+        jh_postings_list_free(&lists[k]);
+    }
+    free(lists);
+}
+
+/* jh_utf8_head_start steps back up to want bytes from start without splitting a UTF-8 sequence. */
+static size_t jh_utf8_head_start(const char *text, size_t start, size_t want) {
+    size_t h = start > want ? start - want : 0;
+    while (h < start && ((unsigned char)text[h] & 0xC0) == 0x80) {
+        h++;
+    }
+    return h;
+}
+
+/* jh_utf8_tail_end steps forward up to want bytes from end without splitting a UTF-8 sequence. */
+static size_t jh_utf8_tail_end(const char *text, size_t len, size_t end, size_t want) {
+    size_t t = len - end > want ? end + want : len;
+    while (t > end && t < len && ((unsigned char)text[t] & 0xC0) == 0x80) {
+        t--;
+    }
+    return t;
+}
+
+/* jh_snippet_span maps token positions to raw bytes through offsets.bin, re-scanning the page when it is absent. */
+static int jh_snippet_span(const jh_token_offsets_view *offsets, jh_u32 page_id, const char *text, jh_u32 len,
+                           jh_u32 first_pos, jh_u32 last_pos, size_t *start, size_t *end) {
+    if (offsets->data) {
+        jh_u32 s;
+        jh_u32 e;
+        if (jh_token_offsets_span(offsets, page_id, first_pos, last_pos, &s, &e) != 0 || e > len) {
+            return 1;
+        }
+        *start = s;
+        *end = e;
+        return 0;
+    }
+    return jh_token_span_utf8(text, len, first_pos, last_pos, start, end);
+}
+
 static void jh_run_search_and_snippets(const char *books_path,
                                        const char *pages_idx_path,
                                        const char *words_idx_path,
@@ -30,6 +82,7 @@ static void jh_run_search_and_snippets(const char *books_path,
     size_t i;
     jh_postings_list *lists = NULL;
     jh_word_dict_entry e;
+    jh_postings_file_view view;
     jh_ranked_hit *hits = NULL;
     size_t hit_count = 0;
     jh_u32 *phrase_pages = NULL;
@@ -102,16 +155,19 @@ static void jh_run_search_and_snippets(const char *books_path,
         }
     }
 
-    for (i = 0; i < term_count; ++i) {
-        if (jh_word_dict_lookup(words_idx_path, hashes[i], &e) != 0) {
-            continue;
-        }
-        if (e.postings_count == 0) {
-            continue;
-        }
-        if (jh_postings_list_read(postings_path, e.postings_offset, &lists[i]) != 0) {
-            continue;
+    if (jh_postings_file_open(postings_path, &view) == 0) {
+        for (i = 0; i < term_count; ++i) {
+            if (jh_word_dict_lookup(words_idx_path, hashes[i], &e) != 0) {
+                continue;
+            }
+            if (e.postings_count == 0) {
+                continue;
+            }
+            if (jh_word_postings_read(words_idx_path, &view, &e, &lists[i]) != 0) {
+                continue;
+            }
         }
+        jh_postings_file_close(&view);
     }
 
     if (jh_rank_results(lists, term_count, require_all_terms,
@@ -129,24 +185,20 @@ static void jh_run_search_and_snippets(const char *books_path,
         jh_die_snip("rank_results failed");
     }
 
-    {
-        size_t k;
-        for (k = 0; k < term_count; ++k) {
-            jh_postings_list_free(&lists[k]);
-        }
-    }
-
     free(workspace);
     free(tokens);
     free(hashes);
-    free(lists);
-    free(phrase_pages);
 
     if (!hits || hit_count == 0) {
         printf("no results\n");
         free(hits);
+        jh_free_lists(lists, term_count);
+        free(phrase_pages);
         return;
     }
+    if (phrase_pages && phrase_page_count > 1) {
+        qsort(phrase_pages, phrase_page_count, sizeof(jh_u32), jh_u32_cmp_snip);
+    }
 
     {
         size_t h;
@@ -155,6 +207,14 @@ static void jh_run_search_and_snippets(const char *books_path,
         jh_pages_index_header ph;
         jh_page_index_entry *pages = NULL;
         jh_page_index_entry *page_by_id = NULL;
+        jh_token_offsets_view offsets;
+        char offsets_path[1024];
+        jh_page_arena arena;
+        jh_page_slice *slices = NULL;
+        jh_u32 *batch_ids = NULL;
+        size_t *batch_hits = NULL;
+        size_t batch_count = 0;
+        size_t b;
         FILE *pf;
 
         if (jh_read_pages_index_header(pages_idx_path, &ph) != 0) {
@@ -206,9 +266,18 @@ static void jh_run_search_and_snippets(const char *books_path,
         }
         free(pages);
 
+        if (jh_index_sibling_path(pages_idx_path, "offsets.bin", offsets_path, sizeof(offsets_path)) != 0 ||
+            jh_token_offsets_open(offsets_path, &offsets) != 0) {
+            memset(&offsets, 0, sizeof(offsets));
+        }
+        memset(&arena, 0, sizeof(arena));
+
         if (offset >= hit_count) {
+            jh_token_offsets_close(&offsets);
             free(page_by_id);
             free(hits);
+            jh_free_lists(lists, term_count);
+            free(phrase_pages);
             return;
         }
         start_index = offset;
@@ -216,18 +285,37 @@ static void jh_run_search_and_snippets(const char *books_path,
             end_index = start_index + limit;
         }
 
+        /* Load every page shown on this results page in one batch before cutting snippets. */
+        batch_ids = (jh_u32 *)malloc(sizeof(jh_u32) * (end_index - start_index));
+        batch_hits = (size_t *)malloc(sizeof(size_t) * (end_index - start_index));
+        slices = (jh_page_slice *)malloc(sizeof(jh_page_slice) * (end_index - start_index));
+        if (!batch_ids || !batch_hits || !slices) {
+            jh_die_snip("alloc page batch failed");
+        }
         for (h = start_index; h < end_index; ++h) {
             jh_u32 page_id = hits[h].page_id;
-            double score = hits[h].score;
-            char *page_text = NULL;
-            jh_u32 page_len = 0;
-            size_t qlen2 = strlen(query);
-            const char *found = NULL;
-            size_t pos = 0;
-            size_t head_len;
-            size_t tail_len;
-            size_t start;
-            size_t end;
+            /* --exact keeps only pages where the query terms occur as a phrase. */
+            if (exact_only && term_count >= 2 &&
+                !bsearch(&page_id, phrase_pages, phrase_page_count, sizeof(jh_u32), jh_u32_cmp_snip)) {
+                continue;
+            }
+            batch_ids[batch_count] = page_id;
+            batch_hits[batch_count] = h;
+            batch_count++;
+        }
+        if (jh_load_pages_batch(books_path, pages_idx_path, batch_ids, batch_count, &arena, slices) != 0) {
+            jh_die_snip("jh_load_pages_batch failed");
+        }
+
+        for (b = 0; b < batch_count; ++b) {
+            jh_u32 page_id = batch_ids[b];
+            double score = hits[batch_hits[b]].score;
+            const char *page_text = slices[b].text;
+            jh_u32 page_len = slices[b].length;
+            jh_snippet_window win;
+            size_t start = 0;
+            size_t end = 0;
+            int have_span = 0;
             jh_u32 book_id = 0;
             jh_u32 page_number = 0;
 
@@ -237,160 +325,43 @@ static void jh_run_search_and_snippets(const char *books_path,
                 page_number = pe->page_number;
             }
 
-            if (jh_load_page_text(books_path, pages_idx_path,
-                                  page_id, &page_text, &page_len) != 0) {
+            if (slices[b].status != 0) {
                 printf("book %u page %u id %u score %.6f (failed to load text)\n",
                        book_id, page_number, page_id, score);
                 continue;
             }
 
-            while (pos + qlen2 <= page_len) {
-                if (memcmp(page_text + pos, query, qlen2) == 0) {
-                    found = page_text + pos;
-                    break;
-                }
-                pos++;
-            }
-
-            if (!found) {
-                int boundary_found = 0;
-                jh_u32 next_page_id = page_id + 1;
-                if (next_page_id < ph.page_count && page_by_id) {
-                    jh_page_index_entry *pe1 = &page_by_id[page_id];
-                    jh_page_index_entry *pe2 = &page_by_id[next_page_id];
-                    if (pe1->book_id == pe2->book_id) {
-                        char *next_page_text = NULL;
-                        jh_u32 next_page_len = 0;
-                        if (jh_load_page_text(books_path, pages_idx_path,
-                                              next_page_id, &next_page_text, &next_page_len) == 0) {
-                            size_t tail_bytes = page_len > 200 ? 200 : page_len;
-                            size_t head_bytes = next_page_len > 200 ? 200 : next_page_len;
-                            size_t combo_len = tail_bytes + head_bytes;
-                            char *combo = (char *)malloc(combo_len);
-                            if (combo) {
-                                size_t cpos = 0;
-                                memcpy(combo, page_text + (page_len - tail_bytes), tail_bytes);
-                                memcpy(combo + tail_bytes, next_page_text, head_bytes);
-                                while (cpos + qlen2 <= combo_len) {
-                                    if (memcmp(combo + cpos, query, qlen2) == 0) {
-                                        const char *f2 = combo + cpos;
-                                        size_t start2 = (size_t)(f2 - combo);
-                                        size_t head_len2 = start2 > 40 ? 40 : start2;
-                                        size_t tail_len2 = (combo_len - (start2 + qlen2)) > 40 ?
-                                                           40 : (combo_len - (start2 + qlen2));
-                                        printf("book %u pages %u-%u ids %u-%u score %.6f\n",
-                                               book_id, pe1->page_number, pe2->page_number,
-                                               page_id, next_page_id, score);
-                                        printf("  ...%.*s«", (int)head_len2, combo + start2 - head_len2);
-                                        printf("%.*s", (int)qlen2, combo + start2);
-                                        printf("»%.*s...\n", (int)tail_len2, combo + start2 + qlen2);
-                                        boundary_found = 1;
-                                        break;
-                                    }
-                                    cpos++;
-                                }
-                                free(combo);
-                            }
-                            free(next_page_text);
-                        }
-                    }
+            if (jh_snippet_best_window(lists, term_count, page_id, &win) == 0 &&
+                jh_snippet_span(&offsets, page_id, page_text, page_len, win.first_pos, win.last_pos, &start, &end) == 0) {
+                have_span = 1;
+                if (end - start > JH_SNIPPET_SPAN_MAX &&
+                    jh_snippet_span(&offsets, page_id, page_text, page_len, win.first_pos, win.first_pos, &start, &end) != 0) {
+                    have_span = 0;
                 }
-
-                if (!boundary_found) {
-                    if (!exact_only) {
-                        size_t page_snippet_len = page_len > 80 ? 80 : page_len;
-                        char *q_ws = NULL;
-                        jh_token *q_tokens = NULL;
-                        size_t q_ws_cap = qlen2 ? qlen2 * 4 : 16;
-                        size_t q_tok_cap = qlen2 ? qlen2 : 16;
-                        char *p_ws = NULL;
-                        jh_token *p_tokens = NULL;
-                        size_t p_ws_cap = page_len ? page_len * 4 : 16;
-                        size_t p_tok_cap = page_len ? page_len : 16;
-                        size_t q_tok_count = 0;
-                        size_t p_tok_count = 0;
-                        int root_found = 0;
-                        size_t root_start = 0;
-                        size_t root_len = 0;
-                        size_t norm_len = 0;
-
-                        q_ws = (char *)malloc(q_ws_cap);
-                        q_tokens = (jh_token *)malloc(sizeof(jh_token) * q_tok_cap);
-                        p_ws = (char *)malloc(p_ws_cap);
-                        p_tokens = (jh_token *)malloc(sizeof(jh_token) * p_tok_cap);
-
-                        if (q_ws && q_tokens) {
-                            q_tok_count = jh_normalize_and_tokenize_arabic_utf8(query, qlen2,
-                                                                                q_tokens, q_tok_cap,
-                                                                                q_ws, q_ws_cap);
-                        }
-                        if (p_ws && p_tokens) {
-                            p_tok_count = jh_normalize_and_tokenize_arabic_utf8(page_text, page_len,
-                                                                                p_tokens, p_tok_cap,
-                                                                                p_ws, p_ws_cap);
-                        }
-
-                        if (q_tok_count != (size_t)-1 && p_tok_count != (size_t)-1 &&
-                            q_tok_count > 0 && p_tok_count > 0 &&
-                            q_ws && p_ws && q_tokens && p_tokens) {
-                            size_t ti;
-                            size_t qi;
-                            norm_len = (size_t)((p_tokens[p_tok_count - 1].word - p_ws) +
-                                                p_tokens[p_tok_count - 1].length);
-                            for (ti = 0; ti < p_tok_count && !root_found; ++ti) {
-                                for (qi = 0; qi < q_tok_count; ++qi) {
-                                    if (q_tokens[qi].length == p_tokens[ti].length &&
-                                        memcmp(q_tokens[qi].word, p_tokens[ti].word, q_tokens[qi].length) == 0) {
-                                        root_found = 1;
-                                        root_start = (size_t)(p_tokens[ti].word - p_ws);
-                                        root_len = p_tokens[ti].length;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-
-                        printf("book %u page %u id %u score %.6f\n",
-                               book_id, page_number, page_id, score);
-
-                        if (root_found && norm_len > 0 && root_len > 0 && root_start < norm_len) {
-                            size_t head_len_r = root_start > 40 ? 40 : root_start;
-                            size_t tail_len_r = (norm_len - (root_start + root_len)) > 40 ?
-                                                40 : (norm_len - (root_start + root_len));
-                            printf("  ...%.*s«", (int)head_len_r, p_ws + root_start - head_len_r);
-                            printf("%.*s", (int)root_len, p_ws + root_start);
-                            printf("»%.*s...\n", (int)tail_len_r, p_ws + root_start + root_len);
-                        } else {
-                            printf("  ...%.*s...\n", (int)page_snippet_len, page_text);
-                        }
-
-                        free(q_ws);
-                        free(q_tokens);
-                        free(p_ws);
-                        free(p_tokens);
-                    }
-                }
-                free(page_text);
-                continue;
             }
 
-            start = (size_t)(found - page_text);
-            head_len = start > 40 ? 40 : start;
-            tail_len = (page_len - (start + qlen2)) > 40 ?
-                       40 : (page_len - (start + qlen2));
-            end = start + qlen2 + tail_len;
-
             printf("book %u page %u id %u score %.6f\n",
                    book_id, page_number, page_id, score);
-            printf("  ...%.*s«", (int)head_len, page_text + start - head_len);
-            printf("%.*s", (int)qlen2, page_text + start);
-            printf("»%.*s...\n", (int)tail_len, page_text + start + qlen2);
-
-            free(page_text);
+            if (have_span) {
+                size_t head = jh_utf8_head_start(page_text, start, JH_SNIPPET_CONTEXT);
+                size_t tail = jh_utf8_tail_end(page_text, page_len, end, JH_SNIPPET_CONTEXT);
+                printf("  ...%.*s«", (int)(start - head), page_text + head);
+                printf("%.*s", (int)(end - start), page_text + start);
+                printf("»%.*s...\n", (int)(tail - end), page_text + end);
+            } else {
+                printf("  ...%.*s...\n", (int)jh_utf8_tail_end(page_text, page_len, 0, 80), page_text);
+            }
         }
+        free(batch_ids);
+        free(batch_hits);
+        free(slices);
+        jh_page_arena_free(&arena);
+        jh_token_offsets_close(&offsets);
         free(page_by_id);
         free(hits);
     }
+    jh_free_lists(lists, term_count);
+    free(phrase_pages);
 }
 
 int main(int argc, char **argv) {
@@ -257,3 +257,91 @@ size_t jh_normalize_and_tokenize_arabic_utf8(const char *text, size_t text_len,
     }
     return token_count;
 }
+
+int jh_token_span_utf8(const char *text, size_t text_len,
+                       uint32_t first_position, uint32_t last_position,
+                       size_t *out_start, size_t *out_end)
+{
+    size_t i = 0;
+    uint32_t pos = 0;
+    int in_token = 0;
+    int found_start = 0;
+
+    if (!text || !out_start || !out_end || last_position < first_position) {
+        return -1;
+    }
+    while (i < text_len) {
+        size_t cp_start = i;
+        uint32_t cp;
+        if (!jh_utf8_decode_tok(text, text_len, &i, &cp)) {
+            return -1;
+        }
+        cp = jh_normalize_arabic_cp_tok(cp);
+        if (cp == 0) {
+            continue;
+        }
+        if (cp < 0x80 && jh_is_delim((unsigned char)cp)) {
+            if (in_token) {
+                if (pos == last_position) {
+                    *out_end = cp_start;
+                    return 0;
+                }
+                pos++;
+                in_token = 0;
+            }
+            continue;
+        }
+        if (!in_token) {
+            in_token = 1;
+            if (pos == first_position) {
+                *out_start = cp_start;
+                found_start = 1;
+            }
+        }
+    }
+    if (in_token && found_start && pos == last_position) {
+        *out_end = text_len;
+        return 0;
+    }
+    return 1;
+}
+
+size_t jh_token_raw_spans_utf8(const char *text, size_t text_len,
+                               uint32_t *starts, uint32_t *ends, size_t max_tokens)
+{
+    size_t i = 0;
+    size_t token_count = 0;
+    int in_token = 0;
+
+    while (i < text_len) {
+        size_t cp_start = i;
+        uint32_t cp;
+        if (!jh_utf8_decode_tok(text, text_len, &i, &cp)) {
+            return (size_t)-1;
+        }
+        cp = jh_normalize_arabic_cp_tok(cp);
+        if (cp == 0) {
+            continue;
+        }
+        if (cp < 0x80 && jh_is_delim((unsigned char)cp)) {
+            if (in_token) {
+                ends[token_count] = (uint32_t)cp_start;
+                token_count++;
+                in_token = 0;
+            }
+            continue;
+        }
+        if (!in_token) {
+            if (token_count >= max_tokens) {
+                return (size_t)-1;
+            }
+            starts[token_count] = (uint32_t)cp_start;
+            in_token = 1;
+        }
+    }
+    if (in_token) {
+        ends[token_count] = (uint32_t)text_len;
+        token_count++;
+    }
+    return token_count;
+}
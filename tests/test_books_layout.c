@@ -1,4 +1,6 @@
 #include "jamharah/index_format.h"
+#include "jamharah/build_index.h"
+#include "jamharah/tokenize_arabic.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -57,9 +59,13 @@ static void check_books_header(const char *path, jh_books_file_header *hdr_out)
     if (hdr.index_offset == 0) {
         die("books.bin index_offset is zero");
     }
-    printf("[books_layout] books.bin: block_size=%u block_count=%llu\n",
+    if (hdr.compression > JH_BOOKS_COMPRESSION_LZ4) {
+        die("books.bin compression unknown");
+    }
+    printf("[books_layout] books.bin: block_size=%u block_count=%llu compression=%u\n",
            (unsigned)hdr.block_size,
-           (unsigned long long)hdr.block_count);
+           (unsigned long long)hdr.block_count,
+           (unsigned)hdr.compression);
     *hdr_out = hdr;
     printf("[books_layout] check_books_header passed\n");
 }
@@ -207,6 +213,39 @@ static void check_pages_index(const char *path, const jh_books_file_header *book
     printf("[books_layout] check_pages_index passed\n");
 }
 
+static void check_facets_col(const char *path, const char *pages_path) {
+    jh_facets_view view;
+    jh_pages_index_header hdr;
+    jh_page_index_entry e;
+    FILE *f;
+    jh_u32 i;
+
+    if (jh_facets_open(path, &view) != 0) {
+        die("jh_facets_open failed");
+    }
+    if (jh_read_pages_index_header(pages_path, &hdr) != 0) {
+        die("jh_read_pages_index_header failed in check_facets_col");
+    }
+    if (view.header.page_count != hdr.page_count) {
+        die("facets.col page_count mismatch");
+    }
+    f = fopen(pages_path, "rb");
+    if (!f || fseek(f, (long)sizeof(jh_pages_index_header), SEEK_SET) != 0) {
+        die("open pages.idx failed in check_facets_col");
+    }
+    for (i = 0; i < hdr.page_count; ++i) {
+        if (fread(&e, sizeof(e), 1, f) != 1) {
+            die("read pages.idx failed in check_facets_col");
+        }
+        if (view.page_book[i] != e.book_id || e.book_id >= view.header.book_slots) {
+            die("facets.col page_book mismatch");
+        }
+    }
+    fclose(f);
+    jh_facets_close(&view);
+    printf("[books_layout] check_facets_col passed\n");
+}
+
 static void check_chapters_index(const char *path) {
     jh_chapters_index_header hdr;
     FILE *f;
@@ -265,6 +304,7 @@ static void check_titles_bin(const char *path) {
     jh_titles_file_header hdr;
     FILE *f;
     jh_title_entry *entries;
+    long file_size;
     jh_u32 i;
 
     if (jh_read_titles_file_header(path, &hdr) != 0) {
@@ -303,11 +343,25 @@ static void check_titles_bin(const char *path) {
         die("read title entries failed");
     }
 
+    if (fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        free(entries);
+        die("seek titles.bin end failed");
+    }
+    file_size = ftell(f);
+
     for (i = 0; i < hdr.title_count; ++i) {
         jh_title_entry *e = &entries[i];
         char buf[256];
         size_t to_read;
 
+        /* Entries may share deduplicated strings but must stay inside the string section. */
+        if (e->length == 0 || hdr.strings_offset + e->offset + e->length > (jh_u64)file_size) {
+            fclose(f);
+            free(entries);
+            die("title entry out of range");
+        }
+
         if (fseek(f, (long)hdr.strings_offset + (long)e->offset, SEEK_SET) != 0) {
             fclose(f);
             free(entries);
@@ -336,9 +390,9 @@ static void check_titles_bin(const char *path) {
 }
 
 static void run_occurrence_tools(void) {
-    char cmd[256];
+    char cmd[512];
     int rc;
-    snprintf(cmd, sizeof(cmd), "../build_occurrences");
+    snprintf(cmd, sizeof(cmd), "../build_occurrences --stem");
     rc = system(cmd);
     if (rc != 0) {
         fprintf(stderr, "[books_layout] build_occurrences returned %d\n", rc);
@@ -366,6 +420,51 @@ static void run_occurrence_tools(void) {
         die("build_words_index failed");
     }
     printf("[books_layout] build_words_index completed successfully\n");
+    snprintf(cmd, sizeof(cmd),
+             "../build_bigrams && "
+             "../sort_occurrences bigram_occurrences.tmp bigram_occurrences.sorted.tmp && "
+             "../build_postings bigram_occurrences.sorted.tmp postings_bigram.bin && "
+             "../build_words_index bigram_occurrences.sorted.tmp postings_bigram.bin words_bigram.idx");
+    rc = system(cmd);
+    if (rc != 0) {
+        fprintf(stderr, "[books_layout] bigram index build returned %d\n", rc);
+        die("bigram index build failed");
+    }
+    printf("[books_layout] bigram index completed successfully\n");
+    snprintf(cmd, sizeof(cmd),
+             "../sort_occurrences occurrences_stem.tmp occurrences_stem.sorted.tmp && "
+             "../build_postings occurrences_stem.sorted.tmp postings_stem.bin && "
+             "../build_words_index occurrences_stem.sorted.tmp postings_stem.bin words_stem.idx");
+    rc = system(cmd);
+    if (rc != 0) {
+        fprintf(stderr, "[books_layout] stem index build returned %d\n", rc);
+        die("stem index build failed");
+    }
+    printf("[books_layout] stem index completed successfully\n");
+}
+
+/* load_term_table reads the term table stored next to an occurrences file. */
+static jh_u64 *load_term_table(const char *occ_path, jh_u32 *out_count) {
+    jh_u64 *terms = NULL;
+    if (jh_read_term_table(occ_path, &terms, out_count) != 0) {
+        die("jh_read_term_table failed");
+    }
+    return terms;
+}
+
+/* read_occurrence reads the next record of an occurrences file and resolves its term id to the word hash. */
+static int read_occurrence(FILE *f, const jh_u64 *terms, jh_u32 term_count, jh_occurrence_record *out) {
+    jh_term_occurrence rec;
+    if (fread(&rec, sizeof(rec), 1, f) != 1) {
+        return 0;
+    }
+    if (rec.term_id >= term_count) {
+        die("occurrence term_id out of range");
+    }
+    out->word_hash = terms[rec.term_id];
+    out->page_id = rec.page_id;
+    out->position = rec.position;
+    return 1;
 }
 
 static void check_occurrences_sorted(const char *pages_idx_path, const char *occ_path) {
@@ -374,6 +473,8 @@ static void check_occurrences_sorted(const char *pages_idx_path, const char *occ
     FILE *of;
     jh_occurrence_record prev;
     jh_occurrence_record cur;
+    jh_u32 term_count;
+    jh_u64 *terms = load_term_table(occ_path, &term_count);
     int have_prev = 0;
     if (jh_read_pages_index_header(pages_idx_path, &ph) != 0) {
         die("jh_read_pages_index_header failed in check_occurrences_sorted");
@@ -387,11 +488,7 @@ static void check_occurrences_sorted(const char *pages_idx_path, const char *occ
     if (!of) {
         die("open occurrences file failed");
     }
-    for (;;) {
-        size_t n = fread(&cur, sizeof(jh_occurrence_record), 1, of);
-        if (n == 0) {
-            break;
-        }
+    while (read_occurrence(of, terms, term_count, &cur)) {
         if (cur.page_id >= ph.page_count) {
             fclose(of);
             die("occurrence page_id out of range");
@@ -414,13 +511,14 @@ static void check_occurrences_sorted(const char *pages_idx_path, const char *occ
         have_prev = 1;
     }
     fclose(of);
+    free(terms);
     printf("[books_layout] occurrences sorted check passed\n");
 }
 
 static void check_postings_bin(const char *occ_path, const char *postings_path) {
     jh_postings_file_header hdr;
     FILE *f;
-    jh_occurrence_record rec;
+    jh_term_occurrence rec;
     jh_u64 count = 0;
     if (jh_read_postings_file_header(postings_path, &hdr) != 0) {
         die("jh_read_postings_file_header failed");
@@ -436,7 +534,7 @@ static void check_postings_bin(const char *occ_path, const char *postings_path)
         die("open occurrences.sorted.tmp failed");
     }
     for (;;) {
-        size_t n = fread(&rec, sizeof(jh_occurrence_record), 1, f);
+        size_t n = fread(&rec, sizeof(jh_term_occurrence), 1, f);
         if (n == 0) {
             break;
         }
@@ -457,8 +555,12 @@ static void check_words_index(const char *occ_path, const char *dict_path) {
     jh_word_dict_entry cur;
     int have_prev = 0;
     jh_occurrence_record occ;
+    jh_u32 term_count;
+    jh_u64 *terms;
     jh_u64 distinct_words = 0;
     jh_u64 prev_hash = 0;
+    jh_u64 inline_count = 0;
+    jh_u64 i;
 
     df = fopen(dict_path, "rb");
     if (!df) {
@@ -472,16 +574,13 @@ static void check_words_index(const char *occ_path, const char *dict_path) {
         fclose(df);
         die("words.idx magic mismatch");
     }
-    if (wh.version != 1) {
+    if (wh.version != 2) {
         fclose(df);
         die("words.idx version mismatch");
     }
 
-    while (1) {
+    for (i = 0; i < wh.entry_count; i++) {
         size_t n = fread(&cur, 1, sizeof(cur), df);
-        if (n == 0) {
-            break;
-        }
         if (n != sizeof(cur)) {
             fclose(df);
             die("partial words.idx entry read");
@@ -492,6 +591,14 @@ static void check_words_index(const char *occ_path, const char *dict_path) {
                 die("words.idx not sorted by word_hash");
             }
         }
+        if (cur.postings_offset & JH_POSTINGS_REF_INLINE) {
+            jh_u32 len = JH_POSTINGS_REF_INLINE_LENGTH(cur.postings_offset);
+            if (len == 0 || len > JH_WORD_DICT_INLINE_MAX) {
+                fclose(df);
+                die("words.idx inline postings length out of range");
+            }
+            inline_count += 1;
+        }
         prev = cur;
         have_prev = 1;
     }
@@ -501,23 +608,287 @@ static void check_words_index(const char *occ_path, const char *dict_path) {
     if (!of) {
         die("open occurrences.sorted.tmp failed in check_words_index");
     }
-    while (1) {
-        size_t n = fread(&occ, sizeof(jh_occurrence_record), 1, of);
-        if (n == 0) {
-            break;
-        }
+    terms = load_term_table(occ_path, &term_count);
+    while (read_occurrence(of, terms, term_count, &occ)) {
         if (!distinct_words || occ.word_hash != prev_hash) {
             distinct_words += 1;
             prev_hash = occ.word_hash;
         }
     }
     fclose(of);
+    free(terms);
 
     if (wh.entry_count != distinct_words) {
         die("words.idx entry_count mismatch");
     }
 
-    printf("[books_layout] words.idx header and sorting check passed\n");
+    printf("[books_layout] words.idx header and sorting check passed (%llu inline lists)\n",
+           (unsigned long long)inline_count);
+}
+
+static void check_token_offsets(const char *path) {
+    jh_token_offsets_view view;
+    jh_pages_index_header hdr;
+    jh_u32 page_id;
+    jh_u32 checked = 0;
+
+    if (jh_token_offsets_open(path, &view) != 0) {
+        die("jh_token_offsets_open failed");
+    }
+    if (jh_read_pages_index_header("pages.idx", &hdr) != 0 || view.header.page_count != hdr.page_count) {
+        die("offsets.bin page_count mismatch");
+    }
+    for (page_id = 0; page_id < hdr.page_count && page_id < 32; ++page_id) {
+        char *text = NULL;
+        jh_u32 len = 0;
+        jh_u32 pos;
+        jh_u32 s;
+        jh_u32 e;
+        if (jh_load_page_text("books.bin", "pages.idx", page_id, &text, &len) != 0) {
+            die("jh_load_page_text failed in check_token_offsets");
+        }
+        for (pos = 0; jh_token_offsets_span(&view, page_id, pos, pos, &s, &e) == 0; ++pos) {
+            size_t rs = 0;
+            size_t re = 0;
+            if (jh_token_span_utf8(text, len, pos, pos, &rs, &re) != 0 || rs != s || re != e) {
+                fprintf(stderr, "page %u token %u: sidecar %u-%u scan %zu-%zu\n", page_id, pos, s, e, rs, re);
+                die("offsets.bin span mismatch");
+            }
+            checked++;
+        }
+        free(text);
+    }
+    if (checked == 0) {
+        die("no token spans checked in check_token_offsets");
+    }
+    jh_token_offsets_close(&view);
+    printf("[books_layout] check_token_offsets passed (%u tokens)\n", checked);
+}
+
+static void check_pages_batch(void) {
+    jh_pages_index_header hdr;
+    jh_u32 ids[8];
+    jh_page_slice slices[8];
+    jh_page_arena arena;
+    size_t i;
+
+    if (jh_read_pages_index_header("pages.idx", &hdr) != 0 || hdr.page_count < 4) {
+        die("pages.idx unusable in check_pages_batch");
+    }
+    ids[0] = hdr.page_count - 1;
+    ids[1] = 0;
+    ids[2] = hdr.page_count / 2;
+    ids[3] = 1;
+    ids[4] = 0;
+    ids[5] = hdr.page_count;
+    ids[6] = hdr.page_count / 2 + 1;
+    ids[7] = 2;
+    memset(&arena, 0, sizeof(arena));
+    if (jh_load_pages_batch("books.bin", "pages.idx", ids, 8, &arena, slices) != 0) {
+        die("jh_load_pages_batch failed");
+    }
+    for (i = 0; i < 8; ++i) {
+        char *text = NULL;
+        jh_u32 len = 0;
+        int rc = jh_load_page_text("books.bin", "pages.idx", ids[i], &text, &len);
+        if ((rc == 0) != (slices[i].status == 0)) {
+            die("jh_load_pages_batch status mismatch");
+        }
+        if (rc == 0 && (slices[i].length != len || memcmp(slices[i].text, text, len) != 0)) {
+            die("jh_load_pages_batch text mismatch");
+        }
+        free(text);
+    }
+    jh_page_arena_free(&arena);
+    printf("[books_layout] check_pages_batch passed\n");
+}
+
+static int compare_occ_by_page(const void *a, const void *b) {
+    const jh_occurrence_record *x = (const jh_occurrence_record *)a;
+    const jh_occurrence_record *y = (const jh_occurrence_record *)b;
+    if (x->page_id != y->page_id) {
+        return x->page_id < y->page_id ? -1 : 1;
+    }
+    if (x->position != y->position) {
+        return x->position < y->position ? -1 : 1;
+    }
+    return 0;
+}
+
+static void check_bigram_phrases(const char *occ_path) {
+    FILE *f;
+    jh_occurrence_record *occ;
+    jh_u32 term_count;
+    jh_u64 *terms = load_term_table(occ_path, &term_count);
+    long size;
+    size_t count;
+    size_t i;
+    size_t checked = 0;
+    f = fopen(occ_path, "rb");
+    if (!f) {
+        die("open occurrences.sorted.tmp failed in check_bigram_phrases");
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    count = (size_t)size / sizeof(jh_term_occurrence);
+    occ = (jh_occurrence_record *)malloc(count * sizeof(jh_occurrence_record) + 1);
+    if (!occ) {
+        die("alloc occurrences failed in check_bigram_phrases");
+    }
+    for (i = 0; i < count; ++i) {
+        if (!read_occurrence(f, terms, term_count, &occ[i])) {
+            die("read occurrences failed in check_bigram_phrases");
+        }
+    }
+    fclose(f);
+    free(terms);
+    qsort(occ, count, sizeof(jh_occurrence_record), compare_occ_by_page);
+    for (i = 0; i + 2 < count && checked < 200; i += 997) {
+        jh_u64 hashes[3];
+        jh_u32 *with_pages = NULL;
+        jh_u32 *without_pages = NULL;
+        jh_u32 *filtered_pages = NULL;
+        size_t with_count = 0;
+        size_t without_count = 0;
+        size_t filtered_count = 0;
+        jh_page_range range;
+        jh_page_filter filter;
+        if (occ[i + 2].page_id != occ[i].page_id || occ[i + 2].position != occ[i].position + 2) {
+            continue;
+        }
+        hashes[0] = occ[i].word_hash;
+        hashes[1] = occ[i + 1].word_hash;
+        hashes[2] = occ[i + 2].word_hash;
+        if (jh_phrase_search_bigram(NULL, "words.idx", "postings.bin", "words_bigram.idx", "postings_bigram.bin", NULL, hashes, 3, &with_pages, &with_count) != 0 ||
+            jh_phrase_search_bigram(NULL, "words.idx", "postings.bin", NULL, NULL, NULL, hashes, 3, &without_pages, &without_count) != 0) {
+            die("jh_phrase_search_bigram failed");
+        }
+        if (with_count != without_count || with_count == 0 ||
+            memcmp(with_pages, without_pages, with_count * sizeof(jh_u32)) != 0) {
+            die("bigram phrase results differ from unigram results");
+        }
+        range.first = occ[i].page_id;
+        range.end = occ[i].page_id + 1;
+        memset(&filter, 0, sizeof(filter));
+        filter.ranges = &range;
+        filter.count = 1;
+        filter.active = 1;
+        if (jh_phrase_search_filtered(NULL, "words.idx", "postings.bin", &filter, hashes, 3, &filtered_pages, &filtered_count) != 0) {
+            die("jh_phrase_search_filtered failed");
+        }
+        if (filtered_count != 1 || filtered_pages[0] != occ[i].page_id) {
+            die("filtered phrase results escape the page filter");
+        }
+        free(filtered_pages);
+        free(with_pages);
+        free(without_pages);
+        checked += 1;
+    }
+    for (i = 0; i + 40 <= count; i += 40) {
+        jh_u64 hashes[40];
+        jh_u32 *pages = NULL;
+        size_t page_count = 0;
+        size_t k;
+        if (occ[i + 39].page_id != occ[i].page_id || occ[i + 39].position != occ[i].position + 39) {
+            continue;
+        }
+        for (k = 0; k < 40; ++k) {
+            hashes[k] = occ[i + k].word_hash;
+        }
+        if (jh_phrase_search_filtered(NULL, "words.idx", "postings.bin", NULL, hashes, 40, &pages, &page_count) != 0) {
+            die("jh_phrase_search_filtered failed on a long phrase");
+        }
+        for (k = 0; k < page_count && pages[k] != occ[i].page_id; ++k) {
+        }
+        if (k == page_count) {
+            die("long phrase misses the page it was taken from");
+        }
+        free(pages);
+        checked += 1;
+        break;
+    }
+    free(occ);
+    if (checked == 0) {
+        die("no phrases checked in check_bigram_phrases");
+    }
+    printf("[books_layout] bigram phrase check passed (%zu phrases)\n", checked);
+}
+
+static void check_same_file(const char *a_path, const char *b_path) {
+    FILE *a = fopen(a_path, "rb");
+    FILE *b = fopen(b_path, "rb");
+    char abuf[4096];
+    char bbuf[4096];
+    size_t an;
+    size_t bn;
+    if (!a || !b) {
+        die("open files to compare failed");
+    }
+    do {
+        an = fread(abuf, 1, sizeof(abuf), a);
+        bn = fread(bbuf, 1, sizeof(bbuf), b);
+        if (an != bn || memcmp(abuf, bbuf, an) != 0) {
+            fprintf(stderr, "[books_layout] %s differs from %s\n", a_path, b_path);
+            die("in-process index build differs from staged build");
+        }
+    } while (an > 0);
+    fclose(a);
+    fclose(b);
+}
+
+/* check_build_index runs jh_build_index on the unsorted occurrences and expects the staged tools' exact output. */
+static void check_build_index(void) {
+    jh_build_index_stats stats;
+    if (jh_build_index("occurrences.tmp", "postings_inproc.bin", "words_inproc.idx", NULL, &stats) != 0) {
+        die("jh_build_index failed");
+    }
+    if (stats.run_count != 1 || stats.word_count == 0) {
+        die("jh_build_index stats mismatch");
+    }
+    check_same_file("postings.bin", "postings_inproc.bin");
+    check_same_file("words.idx", "words_inproc.idx");
+    remove("postings_inproc.bin");
+    remove("words_inproc.idx");
+    printf("[books_layout] check_build_index passed: words=%llu postings=%llu\n",
+           (unsigned long long)stats.word_count, (unsigned long long)stats.total_postings);
+}
+
+/* check_inverter feeds the occurrences to two inverter parts under a tiny budget and expects the staged output. */
+static void check_inverter(void) {
+    jh_inverter inv;
+    jh_build_index_stats stats;
+    jh_occurrence_record occ;
+    jh_u32 term_count;
+    jh_u64 *terms = load_term_table("occurrences.tmp", &term_count);
+    FILE *f = fopen("occurrences.tmp", "rb");
+    if (!f) {
+        die("open occurrences.tmp failed");
+    }
+    if (jh_inverter_init(&inv, 2, 256 * 1024, "inv_check") != 0) {
+        die("jh_inverter_init failed");
+    }
+    /* A fan-in of 2 forces the spilled partials through multi-pass merges. */
+    inv.fan_in = 2;
+    while (read_occurrence(f, terms, term_count, &occ)) {
+        if (jh_inverter_add(&inv, occ.page_id % 2, occ.word_hash, occ.page_id, occ.position) != 0) {
+            die("jh_inverter_add failed");
+        }
+    }
+    fclose(f);
+    free(terms);
+    if (jh_inverter_finish(&inv, "postings_inverted.bin", "words_inverted.idx", &stats) != 0) {
+        die("jh_inverter_finish failed");
+    }
+    jh_inverter_free(&inv);
+    if (stats.run_count < 3) {
+        die("jh_inverter did not spill partial indexes");
+    }
+    check_same_file("postings.bin", "postings_inverted.bin");
+    check_same_file("words.idx", "words_inverted.idx");
+    remove("postings_inverted.bin");
+    remove("words_inverted.idx");
+    printf("[books_layout] check_inverter passed: partials=%llu\n", (unsigned long long)stats.run_count);
 }
 
 int main(void) {
@@ -544,6 +915,10 @@ int main(void) {
     check_pages_index("pages.idx", &books_hdr);
     printf("[books_layout] Checking chapters.idx\n");
     check_chapters_index("chapters.idx");
+    printf("[books_layout] Checking batched page loads\n");
+    check_pages_batch();
+    printf("[books_layout] Checking facets.col\n");
+    check_facets_col("facets.col", "pages.idx");
     printf("[books_layout] Checking titles.bin\n");
     check_titles_bin("titles.bin");
     printf("[books_layout] Building and checking occurrences\n");
@@ -553,6 +928,18 @@ int main(void) {
     check_postings_bin("occurrences.sorted.tmp", "postings.bin");
     printf("[books_layout] Checking words.idx\n");
     check_words_index("occurrences.sorted.tmp", "words.idx");
+    printf("[books_layout] Checking in-process index build\n");
+    check_build_index();
+    printf("[books_layout] Checking in-memory inversion\n");
+    check_inverter();
+    printf("[books_layout] Checking offsets.bin\n");
+    check_token_offsets("offsets.bin");
+    printf("[books_layout] Checking stemmed field\n");
+    check_occurrences_sorted("pages.idx", "occurrences_stem.sorted.tmp");
+    check_postings_bin("occurrences.sorted.tmp", "postings_stem.bin");
+    check_words_index("occurrences_stem.sorted.tmp", "words_stem.idx");
+    printf("[books_layout] Checking bigram phrase index\n");
+    check_bigram_phrases("occurrences.sorted.tmp");
 
     printf("[books_layout] All real-books checks passed\n");
     return 0;
@@ -2,6 +2,7 @@
 #include "jamharah/normalize_arabic.h"
 #include "jamharah/tokenize_arabic.h"
 #include "jamharah/hash.h"
+#include "jamharah/build_index.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -250,6 +251,634 @@ static int test_postings_phrase_and_cursor_basic(void) {
     return 0;
 }
 
+/* test_postings_file_view_basic checks that cursors over a mapped uncompressed file see the list in place. */
+static int test_postings_file_view_basic(void) {
+    const char *path = "test_postings_view.bin";
+    jh_postings_file_header hdr;
+    jh_u8 buf[64];
+    jh_u8 len_buf[4];
+    size_t size = 0;
+    FILE *f;
+    jh_postings_file_view view;
+    jh_postings_cursor cur;
+    jh_posting_entry e;
+    jh_u32 pos_buf[8];
+    int rc;
+
+    test_build_simple_postings(buf, &size);
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "PSTB", 4);
+    hdr.version = 1;
+    hdr.total_postings = 3;
+    hdr.blocks_data_offset = sizeof(hdr);
+    len_buf[0] = (jh_u8)size;
+    len_buf[1] = 0;
+    len_buf[2] = 0;
+    len_buf[3] = 0;
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return 1;
+    }
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        fwrite(len_buf, 1, 4, f) != 4 ||
+        fwrite(buf, 1, size, f) != size) {
+        fclose(f);
+        fprintf(stderr, "write postings view file failed\n");
+        return 1;
+    }
+    fclose(f);
+
+    rc = jh_postings_file_open(path, &view);
+    if (rc != 0) {
+        fprintf(stderr, "postings_file_open rc=%d\n", rc);
+        return 1;
+    }
+    rc = jh_postings_file_cursor(&view, sizeof(hdr), &cur, NULL, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "postings_file_cursor rc=%d\n", rc);
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    if (cur.data != view.data + sizeof(hdr) + 4) {
+        fprintf(stderr, "postings_file_cursor copied the block\n");
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    rc = jh_postings_cursor_next(&cur, &e, pos_buf, 8);
+    if (rc != 0 || e.page_id != 3 || e.term_freq != 2 || pos_buf[1] != 3) {
+        fprintf(stderr, "postings_file_cursor first doc mismatch rc=%d\n", rc);
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    rc = jh_postings_file_cursor(&view, sizeof(hdr) + 1, &cur, NULL, NULL);
+    if (rc == 0) {
+        fprintf(stderr, "postings_file_cursor accepted a truncated block\n");
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    jh_postings_file_close(&view);
+    remove(path);
+    return 0;
+}
+
+/* test_postings_page_filter_basic checks advance_to seeking and that filtered parsing keeps only pages in range. */
+static int test_postings_page_filter_basic(void) {
+    jh_u8 buf[64];
+    size_t size = 0;
+    jh_postings_cursor cur;
+    jh_posting_entry e;
+    jh_u32 pos_buf[8];
+    jh_page_range ranges[2];
+    jh_page_filter filter;
+    jh_postings_list pl;
+    int rc;
+
+    test_build_simple_postings(buf, &size);
+    jh_postings_cursor_init(&cur, buf, size);
+    rc = jh_postings_cursor_advance_to(&cur, 4, &e, pos_buf, 8);
+    if (rc != 0 || e.page_id != 10 || e.term_freq != 1 || e.positions[0] != 5) {
+        fprintf(stderr, "advance_to rc=%d page=%u\n", rc, e.page_id);
+        return 1;
+    }
+    rc = jh_postings_cursor_advance_to(&cur, 11, &e, pos_buf, 8);
+    if (rc != 1) {
+        fprintf(stderr, "advance_to past end rc=%d\n", rc);
+        return 1;
+    }
+
+    ranges[0].first = 0;
+    ranges[0].end = 3;
+    ranges[1].first = 8;
+    ranges[1].end = 20;
+    memset(&filter, 0, sizeof(filter));
+    filter.ranges = ranges;
+    filter.count = 2;
+    filter.active = 1;
+    rc = jh_postings_list_parse_filtered(buf, size, &filter, &pl);
+    if (rc != 0 || pl.entry_count != 1 || pl.entries[0].page_id != 10 || pl.entries[0].positions[0] != 5) {
+        fprintf(stderr, "parse_filtered rc=%d count=%u\n", rc, pl.entry_count);
+        jh_postings_list_free(&pl);
+        return 1;
+    }
+    jh_postings_list_free(&pl);
+    if (!jh_page_filter_contains(&filter, 9) || jh_page_filter_contains(&filter, 3)) {
+        fprintf(stderr, "page filter contains mismatch\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* test_write_index_file writes a books.idx-style file: a 24-byte header with the count at offset 8, then the entries. */
+static int test_write_index_file(const char *path, const char magic[4], const void *entries, size_t entry_size, jh_u32 count) {
+    jh_books_index_header hdr;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, magic, 4);
+    hdr.version = 1;
+    hdr.book_count = count;
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) || fwrite(entries, entry_size, count, f) != count) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* test_page_filter_range checks that filter holds exactly the given ranges. */
+static int test_page_filter_range(const char *what, const jh_page_filter *filter, const jh_u32 *bounds, size_t range_count) {
+    size_t i;
+    if (!filter->active || filter->count != range_count) {
+        fprintf(stderr, "page_filter_compile %s active=%d count=%zu expected %zu\n", what, filter->active, filter->count, range_count);
+        return 1;
+    }
+    for (i = 0; i < range_count; ++i) {
+        if (filter->ranges[i].first != bounds[2 * i] || filter->ranges[i].end != bounds[2 * i + 1]) {
+            fprintf(stderr, "page_filter_compile %s range %zu = [%u,%u)\n", what, i, filter->ranges[i].first, filter->ranges[i].end);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* test_page_filter_compile_basic compiles book, category, author and chapter specs against small index files, with
+   the spec ids and books_meta.idx deliberately unsorted. */
+static int test_page_filter_compile_basic(void) {
+    static const char books_magic[4] = { 'B', 'K', 'I', 'X' };
+    static const char meta_magic[4] = { 'B', 'K', 'M', 'T' };
+    static const char chapters_magic[4] = { 'C', 'H', 'I', 'X' };
+    const char *books_path = "test_filter_books.idx";
+    const char *meta_path = "test_filter_books_meta.idx";
+    const char *chapters_path = "test_filter_chapters.idx";
+    jh_book_index_entry books[4];
+    jh_book_meta_entry meta[4];
+    jh_chapter_index_entry chapters[6];
+    jh_page_filter_spec spec;
+    jh_page_filter filter;
+    jh_u32 book_ids[3] = { 4, 1, 3 };
+    jh_u32 category_ids[1] = { 7 };
+    jh_u32 author_ids[1] = { 5 };
+    jh_u32 chapter_ids[3] = { 6, 2, 3 };
+    jh_u32 empty_book[1] = { 2 };
+    jh_u32 empty_chapter[1] = { 5 };
+    jh_u32 meta_order[4] = { 4, 1, 3, 2 };
+    jh_u32 meta_category[4] = { 7, 7, 8, 7 };
+    jh_u32 meta_author[4] = { 5, 6, 5, 6 };
+    jh_u32 chapter_book[6] = { 1, 1, 2, 2, 4, 4 };
+    jh_u32 chapter_first[6] = { 0, 4, 10, 15, 30, 35 };
+    jh_u32 chapter_pages[6] = { 4, 6, 5, 5, 5, 5 };
+    jh_u32 combined[4] = { 4, 10, 35, 40 };
+    jh_u32 disjoint[4] = { 0, 10, 20, 30 };
+    jh_u32 by_author[2] = { 30, 40 };
+    jh_u32 i;
+    int rc;
+    int failed = 0;
+
+    memset(books, 0, sizeof(books));
+    memset(meta, 0, sizeof(meta));
+    memset(chapters, 0, sizeof(chapters));
+    for (i = 0; i < 4; ++i) {
+        books[i].book_id = i + 1;
+        books[i].first_page_id = i * 10;
+        books[i].page_count = 10;
+        meta[i].book_id = meta_order[i];
+        meta[i].category_id = meta_category[i];
+        meta[i].author_id = meta_author[i];
+    }
+    for (i = 0; i < 6; ++i) {
+        chapters[i].chapter_id = i + 1;
+        chapters[i].book_id = chapter_book[i];
+        chapters[i].first_page_id = chapter_first[i];
+        chapters[i].page_count = chapter_pages[i];
+    }
+    if (test_write_index_file(books_path, books_magic, books, sizeof(books[0]), 4) != 0 ||
+        test_write_index_file(meta_path, meta_magic, meta, sizeof(meta[0]), 4) != 0 ||
+        test_write_index_file(chapters_path, chapters_magic, chapters, sizeof(chapters[0]), 6) != 0) {
+        fprintf(stderr, "write filter index files failed\n");
+        return 1;
+    }
+
+    /* Books 4, 1, 3 in category 7 leave books 1 and 4; chapters 2, 3, 6 then cut them to [4,10) and [35,40). */
+    memset(&spec, 0, sizeof(spec));
+    spec.book_ids = book_ids;
+    spec.book_count = 3;
+    spec.category_ids = category_ids;
+    spec.category_count = 1;
+    spec.chapter_ids = chapter_ids;
+    spec.chapter_count = 3;
+    rc = jh_page_filter_compile(&spec, books_path, meta_path, chapters_path, &filter);
+    if (rc != 0 || test_page_filter_range("combined", &filter, combined, 2) != 0 ||
+        !jh_page_filter_contains(&filter, 4) || jh_page_filter_contains(&filter, 12) || jh_page_filter_contains(&filter, 30)) {
+        fprintf(stderr, "page_filter_compile combined rc=%d\n", rc);
+        failed = 1;
+    }
+    jh_page_filter_free(&filter);
+
+    memset(&spec, 0, sizeof(spec));
+    spec.book_ids = book_ids + 1;
+    spec.book_count = 2;
+    rc = jh_page_filter_compile(&spec, books_path, NULL, NULL, &filter);
+    if (!failed && (rc != 0 || test_page_filter_range("disjoint", &filter, disjoint, 2) != 0 ||
+                    !jh_page_filter_contains(&filter, 25) || jh_page_filter_contains(&filter, 15))) {
+        fprintf(stderr, "page_filter_compile disjoint rc=%d\n", rc);
+        failed = 1;
+    }
+    jh_page_filter_free(&filter);
+
+    memset(&spec, 0, sizeof(spec));
+    spec.category_ids = category_ids;
+    spec.category_count = 1;
+    spec.author_ids = author_ids;
+    spec.author_count = 1;
+    rc = jh_page_filter_compile(&spec, books_path, meta_path, NULL, &filter);
+    if (!failed && (rc != 0 || test_page_filter_range("author", &filter, by_author, 1) != 0)) {
+        fprintf(stderr, "page_filter_compile author rc=%d\n", rc);
+        failed = 1;
+    }
+    jh_page_filter_free(&filter);
+
+    /* Book 2 and chapter 5 (in book 4) share no pages: the filter is active but empty. */
+    memset(&spec, 0, sizeof(spec));
+    spec.book_ids = empty_book;
+    spec.book_count = 1;
+    spec.chapter_ids = empty_chapter;
+    spec.chapter_count = 1;
+    rc = jh_page_filter_compile(&spec, books_path, meta_path, chapters_path, &filter);
+    if (!failed && (rc != 0 || test_page_filter_range("empty", &filter, NULL, 0) != 0 ||
+                    jh_page_filter_contains(&filter, 12) || jh_page_filter_contains(&filter, 32))) {
+        fprintf(stderr, "page_filter_compile empty rc=%d\n", rc);
+        failed = 1;
+    }
+    jh_page_filter_free(&filter);
+
+    remove(books_path);
+    remove(meta_path);
+    remove(chapters_path);
+    return failed;
+}
+
+/* test_postings_block_codec_raw checks the codec-byte layout with a raw block after padding past the header. */
+static int test_postings_block_codec_raw(void) {
+    const char *path = "test_postings_codec.bin";
+    jh_postings_file_header hdr;
+    jh_u8 buf[64];
+    jh_u8 pad[8];
+    jh_u8 frame[5];
+    size_t size = 0;
+    FILE *f;
+    jh_postings_file_view view;
+    jh_postings_list list;
+    jh_u64 first_offset = sizeof(hdr) + sizeof(pad);
+    jh_u64 second_offset;
+    int rc;
+
+    test_build_simple_postings(buf, &size);
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "PSTB", 4);
+    hdr.version = 1;
+    hdr.flags = JH_POSTINGS_FLAG_BLOCK_CODEC;
+    hdr.total_postings = 3;
+    hdr.blocks_data_offset = first_offset;
+    memset(pad, 0, sizeof(pad));
+    second_offset = first_offset + 4 + 1 + size;
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return 1;
+    }
+    frame[0] = (jh_u8)(size + 1);
+    frame[1] = 0;
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = JH_POSTINGS_CODEC_RAW;
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        fwrite(pad, 1, sizeof(pad), f) != sizeof(pad) ||
+        fwrite(frame, 1, 5, f) != 5 ||
+        fwrite(buf, 1, size, f) != size) {
+        fclose(f);
+        fprintf(stderr, "write postings codec file failed\n");
+        return 1;
+    }
+    frame[0] = (jh_u8)(size + 1);
+    frame[4] = 9;
+    if (fwrite(frame, 1, 5, f) != 5 || fwrite(buf, 1, size, f) != size) {
+        fclose(f);
+        fprintf(stderr, "write postings codec file failed\n");
+        return 1;
+    }
+    fclose(f);
+
+    rc = jh_postings_list_read(path, first_offset, &list);
+    if (rc != 0 || list.entry_count != 2 || list.entries[1].page_id != 10) {
+        fprintf(stderr, "codec raw list read rc=%d\n", rc);
+        jh_postings_list_free(&list);
+        return 1;
+    }
+    jh_postings_list_free(&list);
+
+    rc = jh_postings_file_open(path, &view);
+    if (rc != 0) {
+        fprintf(stderr, "postings_file_open codec rc=%d\n", rc);
+        return 1;
+    }
+    rc = jh_postings_file_list_read(&view, second_offset, &list);
+    if (rc == 0) {
+        fprintf(stderr, "unknown postings codec accepted\n");
+        jh_postings_list_free(&list);
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    jh_postings_file_close(&view);
+    remove(path);
+    return 0;
+}
+
+/* test_postings_shared_block_basic resolves packed refs into a shared block through the block index. */
+static int test_postings_shared_block_basic(void) {
+    const char *path = "test_postings_shared.bin";
+    jh_postings_file_header hdr;
+    jh_postings_block_index_entry be;
+    jh_postings_block_member members[2];
+    jh_u8 list[64];
+    jh_u8 len_buf[4];
+    size_t size = 0;
+    jh_u32 member_count = 2;
+    jh_u32 payload_size;
+    FILE *f;
+    jh_postings_file_view view;
+    jh_postings_cursor cur;
+    jh_posting_entry e;
+    jh_u32 pos_buf[8];
+    jh_u32 tiny[4] = { 1, 4, 1, 6 };
+    int rc;
+
+    test_build_simple_postings(list, &size);
+    members[0].word_id = 3;
+    members[0].offset = (jh_u32)(4 + sizeof(members));
+    members[0].length = (jh_u32)size;
+    members[1].word_id = 5;
+    members[1].offset = members[0].offset + (jh_u32)size;
+    members[1].length = (jh_u32)sizeof(tiny);
+    payload_size = members[1].offset + members[1].length;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "PSTB", 4);
+    hdr.version = 1;
+    hdr.total_postings = 4;
+    hdr.blocks_data_offset = sizeof(hdr);
+    hdr.block_count = 1;
+    hdr.block_index_offset = sizeof(hdr) + 4 + payload_size;
+    memset(&be, 0, sizeof(be));
+    be.first_word_id = 3;
+    be.last_word_id = 5;
+    be.uncompressed_size = payload_size;
+    be.compressed_offset = sizeof(hdr);
+    be.compressed_size = payload_size;
+    memcpy(len_buf, &payload_size, 4);
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return 1;
+    }
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        fwrite(len_buf, 1, 4, f) != 4 ||
+        fwrite(&member_count, 1, 4, f) != 4 ||
+        fwrite(members, 1, sizeof(members), f) != sizeof(members) ||
+        fwrite(list, 1, size, f) != size ||
+        fwrite(tiny, 1, sizeof(tiny), f) != sizeof(tiny) ||
+        fwrite(&be, 1, sizeof(be), f) != sizeof(be)) {
+        fclose(f);
+        fprintf(stderr, "write shared postings file failed\n");
+        return 1;
+    }
+    fclose(f);
+
+    rc = jh_postings_file_open(path, &view);
+    if (rc != 0) {
+        fprintf(stderr, "postings_file_open shared rc=%d\n", rc);
+        return 1;
+    }
+    rc = jh_postings_file_cursor(&view, JH_POSTINGS_REF_PACK(0, 1), &cur, NULL, NULL);
+    if (rc != 0 || cur.data != view.data + sizeof(hdr) + 4 + members[1].offset) {
+        fprintf(stderr, "shared block cursor rc=%d\n", rc);
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    rc = jh_postings_cursor_next(&cur, &e, pos_buf, 8);
+    if (rc != 0 || e.page_id != 4 || e.term_freq != 1 || pos_buf[0] != 6) {
+        fprintf(stderr, "shared block member mismatch rc=%d\n", rc);
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    rc = jh_postings_file_cursor(&view, JH_POSTINGS_REF_PACK(0, 0), &cur, NULL, NULL);
+    if (rc != 0 || jh_postings_cursor_next(&cur, &e, pos_buf, 8) != 0 || e.page_id != 3 || e.term_freq != 2) {
+        fprintf(stderr, "shared block first member mismatch rc=%d\n", rc);
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    if (jh_postings_file_cursor(&view, JH_POSTINGS_REF_PACK(0, 2), &cur, NULL, NULL) == 0 ||
+        jh_postings_file_cursor(&view, JH_POSTINGS_REF_PACK(1, 0), &cur, NULL, NULL) == 0) {
+        fprintf(stderr, "shared block accepted an out-of-range ref\n");
+        jh_postings_file_close(&view);
+        return 1;
+    }
+    jh_postings_file_close(&view);
+    remove(path);
+    return 0;
+}
+
+#if defined(JH_HAVE_ZSTD) || defined(JH_HAVE_LZ4)
+#define TEST_CODEC_WORDS 4000
+
+static jh_u32 test_codec_doc_count(jh_u32 k) {
+    return k % 97 == 0 ? 3000 : 2 + (k * 7) % 60;
+}
+
+/* test_postings_codec_roundtrip builds a compressed postings.bin large enough to train a dictionary and reads every
+   list back: large lists go through plain frames, the rest through dictionary or LZ4 frames and shared blocks. */
+static int test_postings_codec_roundtrip(void) {
+    const char *postings_path = "test_codec_postings.bin";
+    const char *words_path = "test_codec_words.idx";
+    jh_inverter inv;
+    jh_build_index_stats stats;
+    jh_postings_file_view view;
+    jh_u32 k;
+    int rc;
+
+    if (jh_inverter_init(&inv, 1, 64u * 1024u * 1024u, "test_codec_part") != 0) {
+        fprintf(stderr, "codec inverter init failed\n");
+        return 1;
+    }
+    for (k = 0; k < TEST_CODEC_WORDS; ++k) {
+        jh_u64 hash = (jh_u64)(k + 1) * 0x9e3779b97f4a7c15ull;
+        jh_u32 j;
+        for (j = 0; j < test_codec_doc_count(k); ++j) {
+            jh_u32 page = 1 + j * (1 + k % 3) + k % 5;
+            jh_u32 t;
+            for (t = 0; t <= j % 2; ++t) {
+                if (jh_inverter_add(&inv, 0, hash, page, 3 * t + k % 4) != 0) {
+                    fprintf(stderr, "codec inverter add failed\n");
+                    jh_inverter_free(&inv);
+                    return 1;
+                }
+            }
+        }
+    }
+    memset(&stats, 0, sizeof(stats));
+    rc = jh_inverter_finish(&inv, postings_path, words_path, &stats);
+    jh_inverter_free(&inv);
+    if (rc != 0 || !(stats.postings_flags & JH_POSTINGS_FLAG_BLOCK_CODEC) || stats.shared_blocks == 0) {
+        fprintf(stderr, "codec postings build rc=%d\n", rc);
+        return 1;
+    }
+#ifdef JH_HAVE_ZSTD
+    if (stats.dict_size == 0 || stats.codec_blocks[JH_POSTINGS_CODEC_ZSTD] == 0 ||
+        stats.codec_blocks[JH_POSTINGS_CODEC_ZSTD_DICT] == 0) {
+        fprintf(stderr, "codec build skipped zstd frames: dict=%u zstd=%llu dict_frames=%llu\n", (unsigned)stats.dict_size,
+                (unsigned long long)stats.codec_blocks[JH_POSTINGS_CODEC_ZSTD],
+                (unsigned long long)stats.codec_blocks[JH_POSTINGS_CODEC_ZSTD_DICT]);
+        return 1;
+    }
+#else
+    if (stats.dict_size != 0 || stats.codec_blocks[JH_POSTINGS_CODEC_LZ4] == 0) {
+        fprintf(stderr, "codec build skipped lz4 frames\n");
+        return 1;
+    }
+#endif
+
+    rc = jh_postings_file_open(postings_path, &view);
+    if (rc != 0 || view.header.blocks_data_offset != sizeof(jh_postings_file_header)) {
+        fprintf(stderr, "codec postings open rc=%d\n", rc);
+        if (rc == 0) {
+            jh_postings_file_close(&view);
+        }
+        return 1;
+    }
+    for (k = 0; k < TEST_CODEC_WORDS && rc == 0; ++k) {
+        jh_word_dict_entry e;
+        jh_postings_list list;
+        jh_u32 j;
+        if (jh_word_dict_lookup(words_path, (jh_u64)(k + 1) * 0x9e3779b97f4a7c15ull, &e) != 0 ||
+            jh_word_postings_read(words_path, &view, &e, &list) != 0) {
+            fprintf(stderr, "codec list %u unreadable\n", (unsigned)k);
+            rc = 1;
+            break;
+        }
+        if (list.entry_count != test_codec_doc_count(k)) {
+            rc = 1;
+        }
+        for (j = 0; rc == 0 && j < list.entry_count; ++j) {
+            const jh_posting_entry *pe = &list.entries[j];
+            jh_u32 t;
+            if (pe->page_id != 1 + j * (1 + k % 3) + k % 5 || pe->term_freq != 1 + j % 2) {
+                rc = 1;
+            }
+            for (t = 0; rc == 0 && t < pe->term_freq; ++t) {
+                if (pe->positions[t] != 3 * t + k % 4) {
+                    rc = 1;
+                }
+            }
+        }
+        if (rc != 0) {
+            fprintf(stderr, "codec list %u differs after round trip\n", (unsigned)k);
+        }
+        jh_postings_list_free(&list);
+    }
+    jh_postings_file_close(&view);
+    remove(postings_path);
+    remove(words_path);
+    return rc;
+}
+#endif
+
+/* test_postings_soa_decode_basic checks the struct-of-arrays decode, its filtered form and sorted intersection. */
+static int test_postings_soa_decode_basic(void) {
+    jh_u8 a_buf[64];
+    jh_u8 b_buf[64];
+    size_t a_size = 0;
+    size_t b_size = 0;
+    jh_postings_soa a;
+    jh_postings_soa b;
+    jh_u32 common[4];
+    jh_page_range range;
+    jh_page_filter filter;
+    size_t n;
+    int rc;
+
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    test_build_and_postings(a_buf, &a_size, b_buf, &b_size);
+
+    rc = jh_postings_soa_decode(a_buf, a_size, &a);
+    if (rc != 0 || a.doc_count != 2 || a.page_ids[0] != 3 || a.page_ids[1] != 20) {
+        fprintf(stderr, "soa_decode a rc=%d\n", rc);
+        jh_postings_soa_free(&a);
+        return 1;
+    }
+    if (a.term_freqs[1] != 1 || a.positions[a.position_starts[1]] != 5) {
+        fprintf(stderr, "soa_decode a positions mismatch\n");
+        jh_postings_soa_free(&a);
+        return 1;
+    }
+    rc = jh_postings_soa_decode(b_buf, b_size, &b);
+    if (rc != 0 || b.doc_count != 2 || b.page_ids[1] != 30) {
+        fprintf(stderr, "soa_decode b rc=%d\n", rc);
+        jh_postings_soa_free(&a);
+        jh_postings_soa_free(&b);
+        return 1;
+    }
+
+    n = jh_u32_sorted_intersect(a.page_ids, a.doc_count, b.page_ids, b.doc_count, common);
+    if (n != 1 || common[0] != 3) {
+        fprintf(stderr, "u32_sorted_intersect n=%zu\n", n);
+        jh_postings_soa_free(&a);
+        jh_postings_soa_free(&b);
+        return 1;
+    }
+
+    rc = jh_postings_soa_decode(b_buf, b_size, &a);
+    if (rc != 0 || a.doc_count != 2 || a.page_ids[1] != 30 || a.positions[1] != 6) {
+        fprintf(stderr, "soa_decode reuse rc=%d\n", rc);
+        jh_postings_soa_free(&a);
+        jh_postings_soa_free(&b);
+        return 1;
+    }
+
+    range.first = 10;
+    range.end = 40;
+    memset(&filter, 0, sizeof(filter));
+    filter.ranges = &range;
+    filter.count = 1;
+    filter.active = 1;
+    rc = jh_postings_soa_decode_filtered(a_buf, a_size, &filter, &b);
+    if (rc != 0 || b.doc_count != 1 || b.page_ids[0] != 20 || b.term_freqs[0] != 1 || b.position_starts[0] != 0 ||
+        b.positions[0] != 5) {
+        fprintf(stderr, "soa_decode_filtered rc=%d\n", rc);
+        jh_postings_soa_free(&a);
+        jh_postings_soa_free(&b);
+        return 1;
+    }
+    range.first = 4;
+    range.end = 20;
+    rc = jh_postings_soa_decode_filtered(a_buf, a_size, &filter, &b);
+    if (rc != 0 || b.doc_count != 0) {
+        fprintf(stderr, "soa_decode_filtered empty rc=%d\n", rc);
+        jh_postings_soa_free(&a);
+        jh_postings_soa_free(&b);
+        return 1;
+    }
+
+    jh_postings_soa_free(&a);
+    jh_postings_soa_free(&b);
+    return 0;
+}
+
 static int test_normalize_arabic_basic(void) {
     const char in[] =
         "\xD8\xA2\xD8\xA3\xD8\xA5\xD8\xA7"
@@ -461,6 +1090,391 @@ static int test_word_dict_lookup_basic(void) {
     return 0;
 }
 
+/* test_word_dict_inline_postings reads an inline list from words.idx without a postings view. */
+static int test_word_dict_inline_postings(void) {
+    const char *path = "test_words_inline.idx";
+    jh_word_dict_header hdr;
+    jh_word_dict_entry entries[2];
+    jh_u8 list[64];
+    size_t size = 0;
+    jh_u8 pad[3] = { 0, 0, 0 };
+    FILE *f;
+    jh_word_dict_entry out;
+    jh_postings_list pl;
+    int rc;
+
+    test_build_simple_postings(list, &size);
+    memcpy(hdr.magic, "WDIX", 4);
+    hdr.version = 2;
+    hdr.reserved = 0;
+    hdr.entry_count = 2;
+    entries[0].word_hash = 11;
+    entries[0].postings_offset = 100;
+    entries[0].postings_count = 4;
+    entries[1].word_hash = 22;
+    entries[1].postings_offset = JH_POSTINGS_REF_INLINE_MAKE(sizeof(pad), size);
+    entries[1].postings_count = 3;
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return 1;
+    }
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        fwrite(entries, 1, sizeof(entries), f) != sizeof(entries) ||
+        fwrite(pad, 1, sizeof(pad), f) != sizeof(pad) ||
+        fwrite(list, 1, size, f) != size) {
+        fclose(f);
+        fprintf(stderr, "write inline words.idx failed\n");
+        return 1;
+    }
+    fclose(f);
+
+    rc = jh_word_dict_lookup(path, 22, &out);
+    if (rc != 0 || !(out.postings_offset & JH_POSTINGS_REF_INLINE)) {
+        fprintf(stderr, "inline lookup rc=%d\n", rc);
+        return 1;
+    }
+    rc = jh_word_postings_read(path, NULL, &out, &pl);
+    if (rc != 0 || pl.entry_count != 2 || pl.entries[0].page_id != 3 || pl.entries[1].page_id != 10) {
+        fprintf(stderr, "inline postings read rc=%d\n", rc);
+        jh_postings_list_free(&pl);
+        return 1;
+    }
+    jh_postings_list_free(&pl);
+    remove(path);
+    return 0;
+}
+
+static int test_lexicon_expand_basic(void) {
+    const char *path = "test_words.lex";
+    const char *words[4] = { "ab", "abc", "abd", "b" };
+    jh_u8 shared[4] = { 0, 2, 0, 0 };
+    jh_u64 offsets[2];
+    jh_lexicon_header hdr;
+    jh_lexicon_view lex;
+    jh_u64 hashes[4];
+    jh_u8 dists[4];
+    size_t count = 0;
+    jh_u64 offset = sizeof(hdr);
+    FILE *f;
+    int rc;
+    int i;
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to create %s\n", path);
+        return 1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    fwrite(&hdr, 1, sizeof(hdr), f);
+    for (i = 0; i < 4; ++i) {
+        jh_u8 lens[2];
+        jh_u64 hash = (jh_u64)(i + 1);
+        if (i % 2 == 0) {
+            offsets[i / 2] = offset;
+        }
+        lens[0] = shared[i];
+        lens[1] = (jh_u8)(strlen(words[i]) - shared[i]);
+        fwrite(lens, 1, 2, f);
+        fwrite(words[i] + shared[i], 1, lens[1], f);
+        fwrite(&hash, 1, sizeof(hash), f);
+        offset += 2 + lens[1] + sizeof(hash);
+    }
+    fwrite(offsets, sizeof(jh_u64), 2, f);
+    memcpy(hdr.magic, "WLEX", 4);
+    hdr.version = 1;
+    hdr.term_count = 4;
+    hdr.block_terms = 2;
+    hdr.block_count = 2;
+    hdr.block_index_offset = offset;
+    fseek(f, 0, SEEK_SET);
+    fwrite(&hdr, 1, sizeof(hdr), f);
+    fclose(f);
+
+    rc = jh_lexicon_open(path, &lex);
+    if (rc != 0) {
+        fprintf(stderr, "jh_lexicon_open rc=%d\n", rc);
+        return 1;
+    }
+    rc = jh_lexicon_expand_prefix(&lex, "ab", 2, 4, hashes, &count);
+    if (rc != 0 || count != 3 || hashes[0] != 1 || hashes[1] != 2 || hashes[2] != 3) {
+        fprintf(stderr, "expand ab rc=%d count=%zu\n", rc, count);
+        jh_lexicon_close(&lex);
+        return 1;
+    }
+    rc = jh_lexicon_expand_prefix(&lex, "ab", 2, 2, hashes, &count);
+    if (rc != 1 || count != 2) {
+        fprintf(stderr, "capped expand rc=%d count=%zu\n", rc, count);
+        jh_lexicon_close(&lex);
+        return 1;
+    }
+    rc = jh_lexicon_expand_prefix(&lex, "abd", 3, 4, hashes, &count);
+    if (rc != 0 || count != 1 || hashes[0] != 3) {
+        fprintf(stderr, "expand abd rc=%d count=%zu\n", rc, count);
+        jh_lexicon_close(&lex);
+        return 1;
+    }
+    rc = jh_lexicon_expand_prefix(&lex, "c", 1, 4, hashes, &count);
+    if (rc != 0 || count != 0) {
+        fprintf(stderr, "expand c rc=%d count=%zu\n", rc, count);
+        jh_lexicon_close(&lex);
+        return 1;
+    }
+    rc = jh_lexicon_expand_fuzzy(&lex, "ab", 2, 1, 4, hashes, dists, &count);
+    if (rc != 0 || count != 4 || dists[0] != 0 || dists[1] != 1 || dists[2] != 1 || hashes[3] != 4 || dists[3] != 1) {
+        fprintf(stderr, "fuzzy ab rc=%d count=%zu\n", rc, count);
+        jh_lexicon_close(&lex);
+        return 1;
+    }
+    rc = jh_lexicon_expand_fuzzy(&lex, "abx", 3, 1, 4, hashes, dists, &count);
+    if (rc != 0 || count != 3 || hashes[0] != 1 || hashes[2] != 3) {
+        fprintf(stderr, "fuzzy abx rc=%d count=%zu\n", rc, count);
+        jh_lexicon_close(&lex);
+        return 1;
+    }
+    jh_lexicon_close(&lex);
+    remove(path);
+    return 0;
+}
+
+static int test_postings_list_union_basic(void) {
+    jh_u32 pos_a[] = { 1, 5, 2 };
+    jh_u32 pos_b[] = { 3, 4 };
+    jh_posting_entry ea[2];
+    jh_posting_entry eb[2];
+    jh_postings_list lists[2];
+    jh_postings_list out;
+    const double weights[2] = { 1.0, 0.5 };
+    double *hit_weights = NULL;
+    const double *row;
+    jh_ranked_hit *hits = NULL;
+    size_t hit_count = 0;
+    int rc;
+
+    ea[0].page_id = 1;
+    ea[0].term_freq = 2;
+    ea[0].positions = &pos_a[0];
+    ea[1].page_id = 4;
+    ea[1].term_freq = 1;
+    ea[1].positions = &pos_a[2];
+    eb[0].page_id = 1;
+    eb[0].term_freq = 1;
+    eb[0].positions = &pos_b[0];
+    eb[1].page_id = 2;
+    eb[1].term_freq = 1;
+    eb[1].positions = &pos_b[1];
+    memset(lists, 0, sizeof(lists));
+    lists[0].entries = ea;
+    lists[0].entry_count = 2;
+    lists[1].entries = eb;
+    lists[1].entry_count = 2;
+
+    rc = jh_postings_list_union(lists, 2, &out);
+    if (rc != 0 || out.entry_count != 3 ||
+        out.entries[0].page_id != 1 || out.entries[0].term_freq != 3 ||
+        out.entries[0].positions[0] != 1 || out.entries[0].positions[1] != 3 || out.entries[0].positions[2] != 5 ||
+        out.entries[1].page_id != 2 || out.entries[2].page_id != 4) {
+        fprintf(stderr, "union rc=%d count=%u\n", rc, out.entry_count);
+        jh_postings_list_free(&out);
+        return 1;
+    }
+    jh_postings_list_free(&out);
+
+    rc = jh_postings_list_union_weighted(lists, weights, 2, &out, &hit_weights);
+    if (rc != 0 || out.entry_count != 3 || hit_weights[0] < 0.83 || hit_weights[0] > 0.84 ||
+        hit_weights[1] != 0.5 || hit_weights[2] != 1.0) {
+        fprintf(stderr, "union_weighted rc=%d count=%u\n", rc, out.entry_count);
+        jh_postings_list_free(&out);
+        free(hit_weights);
+        return 1;
+    }
+    row = hit_weights;
+    rc = jh_rank_results_weighted(&out, &row, 1, 0, NULL, 0, NULL, NULL, &hits, &hit_count);
+    if (rc != 0 || hit_count != 3 || hits[1].page_id != 4 || hits[2].page_id != 2) {
+        fprintf(stderr, "rank_results_weighted rc=%d count=%zu\n", rc, hit_count);
+        free(hits);
+        jh_postings_list_free(&out);
+        free(hit_weights);
+        return 1;
+    }
+    free(hits);
+    jh_postings_list_free(&out);
+    free(hit_weights);
+    return 0;
+}
+
+/* test_make_single_list builds a list with one occurrence at position 0 on each of the given pages. */
+static int test_make_single_list(const jh_u32 *pages, jh_u32 count, jh_postings_list *out) {
+    jh_u32 i;
+    memset(out, 0, sizeof(*out));
+    out->entries = (jh_posting_entry *)calloc(count, sizeof(jh_posting_entry));
+    out->positions_storage = (jh_u32 *)calloc(count, sizeof(jh_u32));
+    if (!out->entries || !out->positions_storage) {
+        jh_postings_list_free(out);
+        return -1;
+    }
+    out->entry_count = count;
+    out->positions_count = count;
+    for (i = 0; i < count; ++i) {
+        out->entries[i].page_id = pages[i];
+        out->entries[i].term_freq = 1;
+        out->entries[i].positions = out->positions_storage + i;
+    }
+    return 0;
+}
+
+/* test_facet_counts_expect compares counts against the expected book, category and author columns. */
+static int test_facet_counts_expect(const char *what, const jh_facet_counts *counts, const jh_u32 *books, const jh_u32 *categories, const jh_u32 *authors) {
+    jh_u32 i;
+    for (i = 0; i < counts->book_slots; ++i) {
+        if (counts->book_counts[i] != books[i]) {
+            fprintf(stderr, "facets %s book %u count=%u expected %u\n", what, i, counts->book_counts[i], books[i]);
+            return 1;
+        }
+    }
+    for (i = 0; i < counts->category_slots; ++i) {
+        if (counts->category_counts[i] != categories[i]) {
+            fprintf(stderr, "facets %s category %u count=%u expected %u\n", what, i, counts->category_counts[i], categories[i]);
+            return 1;
+        }
+    }
+    for (i = 0; i < counts->author_slots; ++i) {
+        if (counts->author_counts[i] != authors[i]) {
+            fprintf(stderr, "facets %s author %u count=%u expected %u\n", what, i, counts->author_counts[i], authors[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* test_rank_results_facets ranks hand-built lists against a small facets.col and checks the counts of the emitted
+   hits; book 2 has no metadata, so its hits count for the book only. */
+static int test_rank_results_facets(void) {
+    const char *path = "test_facets.col";
+    jh_facets_header hdr;
+    jh_u32 page_book[10] = { 0, 0, 1, 1, 1, 2, 2, 3, 3, 3 };
+    jh_u32 book_category[4] = { 0, 1, JH_FACET_NONE, 1 };
+    jh_u32 book_author[4] = { 2, JH_FACET_NONE, JH_FACET_NONE, 0 };
+    jh_u32 pages_a[5] = { 0, 2, 3, 5, 7 };
+    jh_u32 pages_b[4] = { 2, 5, 8, 9 };
+    jh_u32 any_books[4] = { 1, 2, 1, 3 };
+    jh_u32 any_categories[2] = { 1, 5 };
+    jh_u32 any_authors[3] = { 3, 0, 1 };
+    jh_u32 all_books[4] = { 0, 1, 1, 0 };
+    jh_u32 all_categories[2] = { 0, 1 };
+    jh_u32 all_authors[3] = { 0, 0, 0 };
+    jh_postings_list lists[2];
+    jh_facets_view facets;
+    jh_facet_counts counts;
+    jh_ranked_hit *hits = NULL;
+    size_t hit_count = 0;
+    FILE *f;
+    int rc;
+    int failed = 0;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "FCOL", 4);
+    hdr.version = 1;
+    hdr.page_count = 10;
+    hdr.book_slots = 4;
+    hdr.category_slots = 2;
+    hdr.author_slots = 3;
+    f = fopen(path, "wb");
+    if (!f) {
+        return 1;
+    }
+    if (fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        fwrite(page_book, 1, sizeof(page_book), f) != sizeof(page_book) ||
+        fwrite(book_category, 1, sizeof(book_category), f) != sizeof(book_category) ||
+        fwrite(book_author, 1, sizeof(book_author), f) != sizeof(book_author)) {
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    if (jh_facets_open(path, &facets) != 0) {
+        fprintf(stderr, "facets_open failed\n");
+        return 1;
+    }
+    memset(lists, 0, sizeof(lists));
+    if (test_make_single_list(pages_a, 5, &lists[0]) != 0 || test_make_single_list(pages_b, 4, &lists[1]) != 0) {
+        jh_postings_list_free(&lists[0]);
+        jh_facets_close(&facets);
+        return 1;
+    }
+
+    /* Any term: pages 0, 2, 3, 5, 7, 8, 9. */
+    if (jh_facet_counts_init(&facets, &counts) != 0) {
+        failed = 1;
+    } else {
+        rc = jh_rank_results_faceted(lists, 2, 0, NULL, 0, &facets, &counts, &hits, &hit_count);
+        if (rc != 0 || hit_count != 7 || test_facet_counts_expect("any", &counts, any_books, any_categories, any_authors) != 0) {
+            fprintf(stderr, "rank_results_faceted any rc=%d count=%zu\n", rc, hit_count);
+            failed = 1;
+        }
+        free(hits);
+        hits = NULL;
+        jh_facet_counts_free(&counts);
+    }
+
+    /* All terms: pages 2 and 5 only. */
+    if (!failed && jh_facet_counts_init(&facets, &counts) != 0) {
+        failed = 1;
+    } else if (!failed) {
+        rc = jh_rank_results_faceted(lists, 2, 1, NULL, 0, &facets, &counts, &hits, &hit_count);
+        if (rc != 0 || hit_count != 2 || test_facet_counts_expect("all", &counts, all_books, all_categories, all_authors) != 0) {
+            fprintf(stderr, "rank_results_faceted all rc=%d count=%zu\n", rc, hit_count);
+            failed = 1;
+        }
+        free(hits);
+        jh_facet_counts_free(&counts);
+    }
+
+    jh_postings_list_free(&lists[0]);
+    jh_postings_list_free(&lists[1]);
+    jh_facets_close(&facets);
+    remove(path);
+    return failed;
+}
+
+static int test_snippet_window_basic(void) {
+    jh_u32 pos_a[] = { 0, 9 };
+    jh_u32 pos_b[] = { 4, 11 };
+    jh_posting_entry ea;
+    jh_posting_entry eb;
+    jh_postings_list lists[2];
+    jh_snippet_window win;
+    const char *text = "aa, bb cc dd ee ff gg hh ii jj kk ll";
+    size_t start = 0;
+    size_t end = 0;
+
+    ea.page_id = 3;
+    ea.term_freq = 2;
+    ea.positions = pos_a;
+    eb.page_id = 3;
+    eb.term_freq = 2;
+    eb.positions = pos_b;
+    memset(lists, 0, sizeof(lists));
+    lists[0].entries = &ea;
+    lists[0].entry_count = 1;
+    lists[1].entries = &eb;
+    lists[1].entry_count = 1;
+
+    if (jh_snippet_best_window(lists, 2, 3, &win) != 0 || win.first_pos != 9 || win.last_pos != 11 || win.terms_covered != 2) {
+        fprintf(stderr, "snippet window mismatch\n");
+        return 1;
+    }
+    if (jh_snippet_best_window(lists, 2, 4, &win) != 1) {
+        fprintf(stderr, "snippet window on missing page\n");
+        return 1;
+    }
+    if (jh_token_span_utf8(text, strlen(text), 1, 2, &start, &end) != 0 || start != 4 || end != 9) {
+        fprintf(stderr, "token span mismatch %zu %zu\n", start, end);
+        return 1;
+    }
+    return 0;
+}
+
 static int test_rank_results_basic(void) {
     jh_postings_list lists[2];
     jh_postings_list a;
@@ -578,6 +1592,29 @@ int main(void) {
     if (test_postings_phrase_and_cursor_basic() != 0) {
         return 1;
     }
+    if (test_postings_page_filter_basic() != 0) {
+        return 1;
+    }
+    if (test_page_filter_compile_basic() != 0) {
+        return 1;
+    }
+    if (test_postings_file_view_basic() != 0) {
+        return 1;
+    }
+    if (test_postings_block_codec_raw() != 0) {
+        return 1;
+    }
+    if (test_postings_shared_block_basic() != 0) {
+        return 1;
+    }
+    if (test_postings_soa_decode_basic() != 0) {
+        return 1;
+    }
+#if defined(JH_HAVE_ZSTD) || defined(JH_HAVE_LZ4)
+    if (test_postings_codec_roundtrip() != 0) {
+        return 1;
+    }
+#endif
     if (test_normalize_arabic_basic() != 0) {
         return 1;
     }
@@ -593,8 +1630,23 @@ int main(void) {
     if (test_word_dict_lookup_basic() != 0) {
         return 1;
     }
+    if (test_word_dict_inline_postings() != 0) {
+        return 1;
+    }
+    if (test_lexicon_expand_basic() != 0) {
+        return 1;
+    }
+    if (test_postings_list_union_basic() != 0) {
+        return 1;
+    }
+    if (test_snippet_window_basic() != 0) {
+        return 1;
+    }
     if (test_rank_results_basic() != 0) {
         return 1;
     }
+    if (test_rank_results_facets() != 0) {
+        return 1;
+    }
     return 0;
 }
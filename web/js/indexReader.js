@@ -264,6 +264,12 @@ export function readBooksHeader(view) {
   return { magic, version, compression, blockSize, blockCount, indexOffset };
 }
 
+function assertBooksUncompressed(booksHeader) {
+  if (booksHeader.compression !== 0) {
+    throw new Error("compressed books.bin (codec " + booksHeader.compression + ") not supported in JS reader; export with JH_BOOKS_CODEC=none");
+  }
+}
+
 export function readBlockIndexEntry(view, baseOffsetBytes, index) {
   const size = 32;
   const off = baseOffsetBytes + index * size;
@@ -534,14 +540,16 @@ export function readPostingsHeader(view) {
   const magic = readMagic(view, 0);
   const version = view.getUint32(4, true);
   const flags = view.getUint32(8, true);
-  const total_postings = readU64(view, 16);
-  const block_count = readU64(view, 24);
-  const block_index_offset = readU64(view, 32);
-  const blocks_data_offset = readU64(view, 40);
+  const dict_size = view.getUint32(12, true);
+  const total_postings = readU64(view, 20);
+  const block_count = readU64(view, 28);
+  const block_index_offset = readU64(view, 36);
+  const blocks_data_offset = readU64(view, 44);
   return {
     magic,
     version,
     flags,
+    dict_size,
     total_postings,
     block_count,
     block_index_offset,
@@ -569,8 +577,8 @@ export function readPostingsBlockIndexEntry(view, baseOffsetBytes, index) {
 export function readWordDictHeader(view) {
   const magic = readMagic(view, 0);
   const version = view.getUint32(4, true);
-  const entry_count_lo = view.getUint32(8, true);
-  const entry_count_hi = view.getUint32(12, true);
+  const entry_count_lo = view.getUint32(12, true);
+  const entry_count_hi = view.getUint32(16, true);
   const entry_count = BigInt(entry_count_lo) | (BigInt(entry_count_hi) << 32n);
   return { magic, version, entry_count };
 }
@@ -586,12 +594,12 @@ export function readWordDictEntry(view, baseOffsetBytes, index) {
 
 export function wordDictBinarySearch(view, targetHash) {
   const hdr = readWordDictHeader(view);
-  if (hdr.magic !== "WDIX" || hdr.version !== 1) {
+  if (hdr.magic !== "WDIX" || (hdr.version !== 1 && hdr.version !== 2)) {
     throw new Error("invalid WDIX header");
   }
   let lo = 0n;
   let hi = hdr.entry_count;
-  const base = 16;
+  const base = 20;
 
   while (lo < hi) {
     const mid = lo + (hi - lo) / 2n;
@@ -611,12 +619,12 @@ export function wordDictBinarySearch(view, targetHash) {
 }
 
 export async function loadWordDictHeaderRange(url) {
-  const view = await fetchRangeAsDataView(url, 0n, 16n);
+  const view = await fetchRangeAsDataView(url, 0n, 20n);
   return readWordDictHeader(view);
 }
 
 export async function loadWordDictEntryRange(url, index) {
-  const start = 16n + BigInt(index) * 24n;
+  const start = 20n + BigInt(index) * 24n;
   const view = await fetchRangeAsDataView(url, start, 24n);
   return readWordDictEntry(view, 0, 0);
 }
@@ -656,37 +664,94 @@ export function parsePostingsList(view, offsetBytes) {
   };
 }
 
+export function postingsListDataOffset(view, hdr, blockOffset) {
+  if (hdr.flags & 2) {
+    const codec = view.getUint8(blockOffset + 4);
+    if (codec !== 0) {
+      throw new Error("compressed postings codec " + codec + " not supported in JS reader");
+    }
+    return blockOffset + 5;
+  }
+  return blockOffset + 4;
+}
+
+const POSTINGS_REF_PACKED = 1n << 63n;
+const POSTINGS_REF_INLINE = 1n << 62n;
+
+export function isInlinePostingsRef(postingsOffset) {
+  return (BigInt(postingsOffset) & POSTINGS_REF_INLINE) !== 0n;
+}
+
+export function inlinePostingsOffset(dictView, postingsOffset) {
+  const hdr = readWordDictHeader(dictView);
+  const rel = BigInt(postingsOffset) & 0xffffffffffn;
+  return Number(20n + hdr.entry_count * 24n + rel);
+}
+
+export function postingsListOffset(view, hdr, postingsOffset) {
+  const ref = BigInt(postingsOffset);
+  if (!(ref & POSTINGS_REF_PACKED)) {
+    return postingsListDataOffset(view, hdr, Number(ref));
+  }
+  const blockId = Number((ref >> 32n) & 0x3fffffffn);
+  const member = Number(ref & 0xffffffffn);
+  const be = readPostingsBlockIndexEntry(view, Number(hdr.block_index_offset), blockId);
+  const block = postingsListDataOffset(view, hdr, Number(be.compressed_offset));
+  const memberOffset = view.getUint32(block + 4 + member * 12 + 4, true);
+  return block + memberOffset;
+}
+
 export function parsePostingsPages(view, offsetBytes) {
   const list = parsePostingsList(view, offsetBytes);
   return list.entries.map(e => e.page_id);
 }
 
 export async function readPostingsPages(url, postingsOffset) {
+  if (isInlinePostingsRef(postingsOffset)) {
+    throw new Error("inline postings are stored in words.idx");
+  }
   const key = url + ":" + String(postingsOffset);
   if (postingsPagesCache.has(key)) {
     return postingsPagesCache.get(key);
   }
   const view = await loadBinaryAsDataView(url);
   const hdr = readPostingsHeader(view);
-  if (hdr.flags & 1) {
+  if ((hdr.flags & 1) && !(hdr.flags & 2)) {
     throw new Error("compressed postings not supported in JS reader");
   }
-  const base = Number(postingsOffset);
-  const blockSize = view.getUint32(base, true);
-  const pages = parsePostingsPages(view, base + 4);
+  const pages = parsePostingsPages(view, postingsListOffset(view, hdr, postingsOffset));
   postingsPagesCache.set(key, pages);
   return pages;
 }
 
 export async function readPostingsPagesRange(url, postingsOffset) {
-  const headerView = await fetchRangeAsDataView(url, postingsOffset, 4n);
+  if (isInlinePostingsRef(postingsOffset)) {
+    throw new Error("inline postings are stored in words.idx");
+  }
+  const hdr = readPostingsHeader(await fetchRangeAsDataView(url, 0n, 52n));
+  if ((hdr.flags & 1) && !(hdr.flags & 2)) {
+    throw new Error("compressed postings not supported in JS reader");
+  }
+  const ref = BigInt(postingsOffset);
+  let frameOffset = ref;
+  if (ref & POSTINGS_REF_PACKED) {
+    const blockId = (ref >> 32n) & 0x3fffffffn;
+    const entryView = await fetchRangeAsDataView(url, hdr.block_index_offset + blockId * 40n, 40n);
+    frameOffset = readPostingsBlockIndexEntry(entryView, 0, 0).compressed_offset;
+  }
+  const headerView = await fetchRangeAsDataView(url, frameOffset, 4n);
   const blockSize = headerView.getUint32(0, true);
   const dataView = await fetchRangeAsDataView(
     url,
-    postingsOffset + 4n,
-    BigInt(blockSize)
+    frameOffset,
+    4n + BigInt(blockSize)
   );
-  return parsePostingsPages(dataView, 0);
+  let start = postingsListDataOffset(dataView, hdr, 0);
+  if (ref & POSTINGS_REF_PACKED) {
+    const member = Number(ref & 0xffffffffn);
+    start += dataView.getUint32(start + 4 + member * 12 + 4, true);
+  }
+  return parsePostingsPages(dataView, start);
 }
 
 export function findPageIndexEntry(view, pageId) {
@@ -715,6 +780,7 @@ export async function readPageText(booksUrl, pagesIdxUrl, pageId) {
 
   const booksView = await loadBinaryAsDataView(booksUrl);
   const booksHeader = readBooksHeader(booksView);
+  assertBooksUncompressed(booksHeader);
   const blockIndexBase = Number(booksHeader.indexOffset);
   const blockEntry = readBlockIndexEntry(booksView, blockIndexBase, pe.block_id);
 
@@ -745,6 +811,7 @@ export async function readPageTextRange(booksUrl, pagesIdxUrl, pageId) {
   }
   const headerView = await fetchRangeAsDataView(booksUrl, 0n, 36n);
   const booksHeader = readBooksHeader(headerView);
+  assertBooksUncompressed(booksHeader);
   const blockIndexBase = booksHeader.indexOffset;
   const blockEntryOffset = blockIndexBase + BigInt(pe.block_id) * 32n;
   const blockEntryView = await fetchRangeAsDataView(booksUrl, blockEntryOffset, 32n);
@@ -1013,7 +1080,7 @@ export async function browserPhraseSearch(wordsIdxUrl, postingsUrl, query) {
   const dictView = await loadBinaryAsDataView(wordsIdxUrl);
   const postingsView = await loadBinaryAsDataView(postingsUrl);
   const hdr = readPostingsHeader(postingsView);
-  if (hdr.flags & 1) {
+  if ((hdr.flags & 1) && !(hdr.flags & 2)) {
     throw new Error("compressed postings not supported in JS reader");
   }
 
@@ -1028,9 +1095,11 @@ export async function browserPhraseSearch(wordsIdxUrl, postingsUrl, query) {
     const key = postingsUrl + ":" + String(entry.postings_offset);
     let list = postingsListCache.get(key);
     if (!list) {
-      const base = Number(entry.postings_offset);
-      const blockSize = postingsView.getUint32(base, true);
-      list = parsePostingsList(postingsView, base + 4);
+      if (isInlinePostingsRef(entry.postings_offset)) {
+        list = parsePostingsList(dictView, inlinePostingsOffset(dictView, entry.postings_offset));
+      } else {
+        list = parsePostingsList(postingsView, postingsListOffset(postingsView, hdr, entry.postings_offset));
+      }
       postingsListCache.set(key, list);
     }
     lists.push(list);